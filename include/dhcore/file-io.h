@@ -28,6 +28,7 @@
 
 /* fwd declarations */
 struct pak_file;
+struct zip_archive;
 
 /**
  * Basic file type, used in file io functions, if =NULL then it is either invalid or not created
@@ -51,7 +52,10 @@ enum seek_mode
 enum file_type
 {
     FILE_TYPE_MEM, /**< file resides in memory */
-    FILE_TYPE_DSK /**< file resides on disk */
+    FILE_TYPE_DSK, /**< file resides on disk */
+    FILE_TYPE_MMAP, /**< file is mapped into memory (read-only), or is a view into mapped memory */
+    FILE_TYPE_CHUNKED, /**< file resides in memory, as a list of fixed size blocks */
+    FILE_TYPE_STREAM /**< file is read (read-only) on demand by a callback, see fio_attachstream */
 };
 
 /**
@@ -76,7 +80,10 @@ void fio_releasemgr();
  * @endcode
  * @param directory directory on the disk to add to root directories of virtual-filesystem
  * @param monitor Enables file monitoring for the entire directory files and it's subtree
- * (Requires @e _FILEMON_ compiler preprocessor)
+ * (Native inotify backend on linux, other platforms require @e _FILEMON_ compiler preprocessor)
+ * @remark Contents of virtual-directories are indexed on the first lookup, so resolving paths is a -
+ * hash lookup instead of probing every directory on disk. Paths that are not found are also cached.
+ * Monitored directories refresh the index on file changes, for others call fio_refreshvdirs
  * @ingroup fileio
  */
 CORE_API int fio_addvdir(const char* directory, int monitor);
@@ -87,9 +94,18 @@ CORE_API int fio_addvdir(const char* directory, int monitor);
  */
 CORE_API void fio_clearvdirs();
 
+/**
+ * Drops the index and cached missing paths of virtual-directories, they will be rebuilt on next -
+ * lookup. Call it after files are added or removed in (non-monitored) virtual-directories
+ * @ingroup fileio
+ */
+CORE_API void fio_refreshvdirs();
+
 /**
  * Add/clear pak files to the virtual-filesystems\n
  * Files inside pak-file behaves like a virtual-disk, and are referenced same as virtual-directories\n
+ * Directories of the added paks are merged into a single index, if a file exists in multiple paks -
+ * the first added pak has priority. pak is added with priority 0 (see fio_addpak_layer)\n
  * **Note** handling of opening and closing the pak-files must be managed by user
  * @see pak_file
  * @see fio_addvdir
@@ -97,6 +113,25 @@ CORE_API void fio_clearvdirs();
  */
 CORE_API void fio_addpak(struct pak_file* pak);
 
+/**
+ * Add pak file as a layer to the virtual-filesystem, files in paks with higher priority override -
+ * the ones in lower priority paks (patches), paks with same priority keep the add order\n
+ * Merged index is rebuilt, so paks should be added at load time and not while files are being -
+ * opened from other threads
+ * @param priority priority of the layer, higher priorities win
+ * @see fio_addpak
+ * @see fio_removepak
+ * @ingroup fileio
+ */
+CORE_API result_t fio_addpak_layer(struct pak_file* pak, int priority);
+
+/**
+ * Remove pak file from the virtual-filesystem, files that are overridden by the pak are fetched -
+ * from the lower priority paks again. Pak should be closed by user after removal
+ * @ingroup fileio
+ */
+CORE_API void fio_removepak(struct pak_file* pak);
+
 /*!
  * \brief fio_addbundle
  * \ingroup fileio
@@ -109,6 +144,24 @@ CORE_API void fio_addbundle(const char *bundle_name);
  */
 CORE_API void fio_clearpaks();
 
+/**
+ * Add/clear zip archives to the virtual-filesystems\n
+ * Zip archives are searched after pak files, entries are found by the hash index that is built -
+ * when the archive is opened (zip_open). fio_openmmap returns views into the archive for stored -
+ * (not compressed) entries\n
+ * **Note** handling of opening and closing the zip archives must be managed by user
+ * @see zip_open
+ * @see fio_addpak
+ * @ingroup fileio
+ */
+CORE_API void fio_addzip(struct zip_archive* zip);
+
+/**
+ * Clear zip archives list in the virtual filesystem
+ * @ingroup fileio
+ */
+CORE_API void fio_clearzips();
+
  /**
   * Create a file in memory
   * @param alloc memory allocator for internal file data
@@ -118,6 +171,20 @@ CORE_API void fio_clearpaks();
   */
 CORE_API file_t fio_createmem(struct allocator* alloc, const char* name, uint mem_id);
 
+/**
+ * Create a chunked file in memory (FILE_TYPE_CHUNKED) for writing large data
+
+ * Data is stored in a list of fixed size blocks (64KB) that are taken from a shared pool,
+ * so writing is linear time and the data is never reallocated or copied on growth. Files can be -
+ * read and seeked like memory files, but fio_getptr returns NULL, use fio_savemem to write the -
+ * file to disk (gather write), or fio_detachmem to get the data as one contiguous buffer
+ * @param alloc memory allocator for the contiguous buffer that fio_detachmem returns
+ * @param name name alias (or filepath) that will be binded to the file
+ * @return valid file handle or NULL if failed
+ * @ingroup fileio
+ */
+CORE_API file_t fio_createmem_chunked(struct allocator* alloc, const char* name, uint mem_id);
+
 /**
  * Open a file from disk into memory
  * @param filepath filepath to the file on disk (must exist), filepath will first check -
@@ -146,7 +213,9 @@ CORE_API char* fio_loadtext(struct allocator *alloc, const char *filepath, int i
 
 /**
  * Detach buffer from memory file, after file is detached\n
- * Note that file is *NOT* closed after detaching it's memory, user must close it after detach
+ * Note that file is *NOT* closed after detaching it's memory, user must close it after detach\n
+ * Chunked files (fio_createmem_chunked) are flattened into a new buffer, which is allocated with -
+ * the allocator of the file, and their blocks are released
  * @param outsize output size of the buffer
  * @param palloc pointer (out) to the allocator that used to create file buffer
  * @return file data buffer, caller should manage freeing the buffer
@@ -154,6 +223,108 @@ CORE_API char* fio_loadtext(struct allocator *alloc, const char *filepath, int i
  */
 CORE_API void* fio_detachmem(file_t f, size_t* outsize, struct allocator** palloc);
 
+/**
+ * Writes the whole data of a memory file (memory, chunked or mapped) to a file on disk\n
+ * Blocks of chunked files are written with gather writes, without flattening them
+ * @param filepath path of the file on disk, it will be created or overwritten
+ * @ingroup fileio
+ */
+CORE_API result_t fio_savemem(file_t f, const char* filepath);
+
+/**
+ * Maps a file from disk into memory for reading, data is not copied, pages are loaded by the OS on
+ * first access. file data can be accessed directly with fio_getptr\n
+ * If filepath exists in any of the added paks (or zips), the file is fetched with pak_getfile_mapped
+ * (zip_getfile_mapped), which returns a view into the mapped pak for uncompressed entries
+ * @param filepath filepath to the file on disk (must exist), filepath will first check -
+ * virtual-filesystems for valid path unless ignore_vfs option is set
+ * @return valid file handle (FILE_TYPE_MMAP) or NULL if failed
+ * @ingroup fileio
+ */
+CORE_API file_t fio_openmmap(const char* filepath, int ignore_vfs);
+
+/**
+ * Creates a read-only file (FILE_TYPE_MMAP) over existing memory, memory is not copied or owned -
+ * by the file, so it must be valid until file is closed
+ * @param name name alias (or filepath) that will be binded to the file
+ * @return valid file handle or NULL if failed
+ * @ingroup fileio
+ */
+CORE_API file_t fio_createview(const void* data, size_t size, const char* name);
+
+/**
+ * Callback for closing views that are created with fio_attachview
+ * @param data pointer to the data of the view
+ * @param param user parameter that is passed to fio_attachview
+ * @ingroup fileio
+ */
+typedef void (*pfn_fio_closeview)(const void* data, void* param);
+
+/**
+ * Creates a read-only view (FILE_TYPE_MMAP) over existing memory, same as fio_createview, but -
+ * @e close_fn is called when the file is closed, so owner of the data can release it (refcounting)
+ * @param name name alias (or filepath) that will be binded to the file
+ * @param close_fn callback that is called on fio_close
+ * @param param user parameter for the callback
+ * @return valid file handle or NULL if failed
+ * @ingroup fileio
+ */
+CORE_API file_t fio_attachview(const void* data, size_t size, const char* name,
+                               pfn_fio_closeview close_fn, void* param);
+
+/**
+ * Callback for reading data of stream files that are created with fio_attachstream
+ * @param buffer destination buffer
+ * @param offset offset (bytes) in the file to start reading
+ * @param size number of bytes to read, range is always inside the file
+ * @param param user parameter that is passed to fio_attachstream
+ * @return number of bytes that is read, less than size if error occurs
+ * @ingroup fileio
+ */
+typedef size_t (*pfn_fio_readstream)(void* buffer, size_t offset, size_t size, void* param);
+
+/**
+ * Callback for closing stream files that are created with fio_attachstream
+ * @param param user parameter that is passed to fio_attachstream
+ * @ingroup fileio
+ */
+typedef void (*pfn_fio_closestream)(void* param);
+
+/**
+ * Creates a read-only file (FILE_TYPE_STREAM) that reads it's data with @e read_fn on each -
+ * fio_read, data is not kept by the file. Files can be seeked, fio_getptr returns NULL. Useful -
+ * for reading large files in parts, without loading them into memory (see pak_openstream)
+ * @param size size of the file (bytes)
+ * @param name name alias (or filepath) that will be binded to the file
+ * @param read_fn callback that reads the data
+ * @param close_fn callback that is called on fio_close, can be NULL
+ * @param param user parameter for the callbacks
+ * @return valid file handle or NULL if failed
+ * @ingroup fileio
+ */
+CORE_API file_t fio_attachstream(size_t size, const char* name, pfn_fio_readstream read_fn,
+                                 pfn_fio_closestream close_fn, void* param);
+
+/**
+ * Returns pointer to the beginning of file data for memory and mapped files (zero-copy access)\n
+ * For memory files, pointer is invalidated after writing to the file
+ * @return pointer to file data, NULL for disk, chunked and stream files
+ * @ingroup fileio
+ */
+CORE_API const void* fio_getptr(file_t f);
+
+/**
+ * Sets buffering of disk files (fio_createdisk, fio_opendisk) that are opened afterwards\n
+ * Disk files read/write through native file descriptors with their own aligned buffers, -
+ * so sequential fio_read/fio_write calls don't make a system call each. Reads that are larger -
+ * than the buffer go directly into the destination
+ * @param buffer_size buffer size of each file (bytes), default is 128KB, 0 disables buffering
+ * @param direct_size files that are this size or larger are read with direct I/O (O_DIRECT), -
+ * bypassing file cache of the OS, useful for streaming huge files once. 0 disables (default)
+ * @ingroup fileio
+ */
+CORE_API void fio_setdiskbuffer(size_t buffer_size, size_t direct_size);
+
 /**
  * Create a file on disk
  * @param ignore_vfs sets if we have to ignore opening from virtual-filesystems
@@ -185,6 +356,30 @@ CORE_API void fio_close(file_t f);
  */
 CORE_API int fio_seek(file_t f, enum seek_mode seek, int offset);
 
+/**
+ * Destination buffer of fio_readv
+ * @ingroup fileio
+ */
+struct fio_iovec
+{
+    void* buffer;
+    size_t size;
+};
+
+/**
+ * Reads data from file into multiple buffers (scatter read), same as calling fio_read for each -
+ * buffer in order, but in one call\n
+ * Memory and mapped files are copied in a single pass, large reads from disk files are done with
+ * one system call (preadv) directly into the buffers. For disk files with direct I/O (see -
+ * fio_setdiskbuffer), buffers and file offsets that are aligned to UTIL_FD_ALIGN are read without
+ * intermediate copies
+ * @param iov array of destination buffers
+ * @param cnt number of buffers
+ * @return number of bytes that is read, less than total size of buffers at the end of the file
+ * @ingroup fileio
+ */
+CORE_API size_t fio_readv(file_t f, const struct fio_iovec* iov, int cnt);
+
 /**
  * Reads data from file
  * @param buffer output buffer, buffer should have enough size of (item_size*items_cnt)
@@ -218,7 +413,9 @@ CORE_API size_t fio_getsize(file_t f);
 CORE_API size_t fio_getpos(file_t f);
 
 /**
- * Returns file-path, the one that is called with fio_openXXX functions
+ * Returns file-path, the one that is called with fio_openXXX functions\n
+ * Paths are interned, files that are opened with the same path share one copy of it, -
+ * returned string is valid until the file is closed
  * @ingroup fileio
  */
 CORE_API const char* fio_getpath(file_t f);
@@ -242,6 +439,82 @@ CORE_API enum file_type fio_gettype(file_t f);
  */
 CORE_API enum file_mode fio_getmode(file_t f);
 
+/**
+ * Asynchronous load priorities, higher priority requests are picked first by I/O threads
+ * @see fio_openmem_async
+ * @ingroup fileio
+ */
+enum fio_async_priority
+{
+    FIO_ASYNC_LOW = 0,
+    FIO_ASYNC_NORMAL,
+    FIO_ASYNC_HIGH,
+    FIO_ASYNC_PRIORITY_CNT
+};
+
+/**
+ * Completion callback for asynchronous loads, called in the thread that calls fio_async_update
+ * @param f loaded memory file, NULL if loading failed. callback owns the file and must close it
+ * @param filepath filepath that is passed to fio_openmem_async
+ * @param req request handle that is returned by fio_openmem_async
+ * @ingroup fileio
+ */
+typedef void (*pfn_fio_async)(file_t f, const char* filepath, reshandle_t req, void* param);
+
+/**
+ * Initializes asynchronous file loading, must be called after file manager is initialized\n
+ * @param thread_cnt number of I/O threads
+ * @param max_requests maximum number of in-flight requests (queued, loading or waiting for -
+ * completion), fio_openmem_async fails if there are more
+ * @ingroup fileio
+ */
+CORE_API result_t fio_async_initmgr(int thread_cnt, int max_requests);
+
+/**
+ * Stops I/O threads and releases asynchronous loading, remaining requests are discarded without -
+ * calling their callbacks. called automatically on file manager release
+ * @ingroup fileio
+ */
+CORE_API void fio_async_releasemgr();
+
+/**
+ * Loads a file into memory in the background, same as fio_openmem (searches paks, zips and -
+ * virtual-directories), vdirs, paks and zips should not be added/removed while requests are in-flight
+ * @param alloc allocator for the memory file, must be thread-safe
+ * @param pr priority of the request
+ * @param callback called from fio_async_update when loading is finished
+ * @param param user parameter that is passed to callback
+ * @return request handle, INVALID_HANDLE if there are too many in-flight requests
+ * @ingroup fileio
+ */
+CORE_API reshandle_t fio_openmem_async(struct allocator* alloc, const char* filepath,
+                                       int ignore_vfs, uint mem_id, enum fio_async_priority pr,
+                                       pfn_fio_async callback, void* param);
+
+/**
+ * Cancels asynchronous request that is still waiting in the queue, callback will not be called -
+ * for the request. Requests that are already being loaded (or loaded) can't be cancelled, their -
+ * callbacks are called by fio_async_update as usual
+ * @return TRUE if request is cancelled, FALSE if request is already started, completed or -
+ * not found
+ * @ingroup fileio
+ */
+CORE_API int fio_async_cancel(reshandle_t req);
+
+/**
+ * Delivers finished asynchronous loads to their callbacks, must be called regularly (for example -
+ * each frame in the main thread), all callbacks are called within this function
+ * @return number of delivered requests
+ * @ingroup fileio
+ */
+CORE_API int fio_async_update();
+
+/**
+ * Returns number of in-flight asynchronous requests
+ * @ingroup fileio
+ */
+CORE_API int fio_async_pending();
+
 /**
  * @ingroup fileio
  */
@@ -260,10 +533,22 @@ CORE_API void fio_mon_reg(const char* filepath, pfn_fio_modify fn, reshandle_t h
 CORE_API void fio_mon_unreg(const char* filepath);
 
 /**
+ * Delivers file changes of monitored virtual-directories to registered callbacks (fio_mon_reg), -
+ * must be called regularly, all callbacks are called within this function\n
+ * Changes are collected until no file is changed for the debounce window (see fio_mon_setdebounce),
+ * then delivered in one batch, each changed file is delivered once per batch
  * @ingroup fileio
  */
 CORE_API void fio_mon_update();
 
+/**
+ * Sets debounce window of file monitoring, default is 100ms
+ * @param msecs time (milliseconds) that files must stay unchanged before changes are delivered, -
+ * continuous changes are delivered after 10x the window anyway
+ * @ingroup fileio
+ */
+CORE_API void fio_mon_setdebounce(uint msecs);
+
 /**
  * @ingroup fileio
  */
@@ -318,6 +603,11 @@ public:
         return File(fio_opendisk(filepath, ignore_vfs));
     }
 
+    static File open_mmap(const char *filepath, bool ignore_vfs = false)
+    {
+        return File(fio_openmmap(filepath, ignore_vfs));
+    }
+
     static File attach_mem(void *buff, size_t size, const char *alias,
                              allocator *alloc = mem_heap(), uint mem_id = 0)
     {
@@ -349,6 +639,12 @@ public:
         return fm;
     }
 
+    const void* ptr() const
+    {
+        ASSERT(m_file);
+        return fio_getptr(m_file);
+    }
+
     file_mode mode() const
     {
         ASSERT(m_file);
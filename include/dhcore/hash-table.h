@@ -27,6 +27,13 @@
  * @defgroup htable Hash-table
  */
 
+/**
+ * Number of keys that are processed together in *_find_batch functions, bucket addresses of each
+ * group are prefetched before they are resolved
+ * @ingroup htable
+ */
+#define HASHTABLE_BATCH_SIZE 16
+
 
  /**
  * hash table item, used in open/fixed hash tables
@@ -122,6 +129,17 @@ CORE_API void hashtable_chained_remove(struct hashtable_chained* table,
   */
 CORE_API struct hashtable_item_chained* hashtable_chained_find(const struct hashtable_chained* table,
                                                                uint hash_key);
+/**
+ * finds multiple keys in hash table, bucket addresses are computed and prefetched first, then
+ * keys are resolved, which hides memory latency for large lookups
+ * @param keys array of hash keys
+ * @param cnt number of keys
+ * @param items output array of found items (must have @e cnt elements), NULL if key is not found
+ * @ingroup htable
+ */
+CORE_API void hashtable_chained_find_batch(const struct hashtable_chained* table,
+                                           const uint* keys, int cnt,
+                                           OUT struct hashtable_item_chained** items);
 /**
  * clears hash table items
  * @ingroup htable
@@ -193,6 +211,17 @@ CORE_API void hashtable_fixed_remove(struct hashtable_fixed* table, struct hasht
   */
 CORE_API struct hashtable_item* hashtable_fixed_find(const struct hashtable_fixed* table,
                                                      uint hash_key);
+/**
+ * finds multiple keys in hash table, bucket addresses are computed and prefetched first, then
+ * keys are resolved, which hides memory latency for large lookups
+ * @param keys array of hash keys
+ * @param cnt number of keys
+ * @param items output array of found items (must have @e cnt elements), NULL if key is not found
+ * @ingroup htable
+ */
+CORE_API void hashtable_fixed_find_batch(const struct hashtable_fixed* table,
+                                         const uint* keys, int cnt,
+                                         OUT struct hashtable_item** items);
 /**
  * clears hash table items
  * @ingroup htable
@@ -269,15 +298,125 @@ CORE_API void hashtable_open_remove(struct hashtable_open* table, struct hashtab
   */
 CORE_API struct hashtable_item* hashtable_open_find(const struct hashtable_open* table,
                                                     uint hash_key);
+/**
+ * finds multiple keys in hash table, bucket addresses are computed and prefetched first, then
+ * keys are resolved, which hides memory latency for large lookups
+ * @param keys array of hash keys
+ * @param cnt number of keys
+ * @param items output array of found items (must have @e cnt elements), NULL if key is not found
+ * @ingroup htable
+ */
+CORE_API void hashtable_open_find_batch(const struct hashtable_open* table,
+                                        const uint* keys, int cnt,
+                                        OUT struct hashtable_item** items);
 /**
  * clears hash table items
  * @ingroup htable
  */
 CORE_API void hashtable_open_clear(struct hashtable_open* table);
 
+/**
+ * frozen hash table item, key/value pair that is stored in the frozen table blob
+ * @ingroup htable
+ */
+struct hashtable_frozen_item
+{
+    uint hash;  /**< hash */
+    uint value; /**< saved user value */
+};
+
+/**
+ * frozen hash table : read-only table that is built once from a known set of keys with minimal
+ * perfect hashing (hash and displace), every lookup is a single probe\n
+ * Table data lives in a flat, position independent blob, which can be saved to disk and loaded
+ * (or mapped) back without rebuilding or allocating anything
+ * @ingroup htable
+ */
+struct hashtable_frozen
+{
+    struct allocator* alloc;    /* allocator of the blob, NULL if blob is owned by caller */
+    void* blob;
+    size_t blob_size;
+    const uint* disps;  /* displacement for each bucket */
+    const struct hashtable_frozen_item* items;
+    uint items_cnt;
+    uint buckets_cnt;
+    uint seed;
+
+#ifdef __cplusplus
+    hashtable_frozen()
+    {
+        alloc = NULL;
+        blob = NULL;
+        blob_size = 0;
+        disps = NULL;
+        items = NULL;
+        items_cnt = 0;
+        buckets_cnt = 0;
+        seed = 0;
+    }
+#endif
+};
+
+/* frozen hash table functions
+ **
+ * build: creates the table blob from key/value arrays
+ * @param alloc allocator for the table blob
+ * @param tmp_alloc allocator for temporary buffers that are used during the build
+ * @param keys array of hash keys, keys must be unique
+ * @param values array of values for each key
+ * @param cnt number of keys/values
+ * @return RET_FAIL if keys are not unique
+ * @ingroup htable
+ */
+CORE_API result_t hashtable_frozen_build(struct allocator* alloc, struct allocator* tmp_alloc,
+                                         struct hashtable_frozen* table,
+                                         const uint* keys, const uint* values, int cnt,
+                                         uint mem_id);
+
+/**
+ * loads the table from a blob that is previously built with @e hashtable_frozen_build\n
+ * No memory is allocated, the blob is referenced by the table, so it must stay valid until the
+ * table is destroyed
+ * @param blob blob data, must be 4 byte aligned
+ * @ingroup htable
+ */
+CORE_API result_t hashtable_frozen_load(struct hashtable_frozen* table, const void* blob,
+                                        size_t blob_size);
+
+/**
+ * destroy hash table, frees the blob if it's created by build
+ * @ingroup htable
+ */
+CORE_API void hashtable_frozen_destroy(struct hashtable_frozen* table);
+
+/**
+ * returns table's blob, which can be written to disk and loaded later with @e hashtable_frozen_load
+ * @ingroup htable
+ */
+CORE_API const void* hashtable_frozen_getblob(const struct hashtable_frozen* table,
+                                              OUT size_t* blob_size);
+
+/**
+ * checks if hash table is empty
+ * @ingroup htable
+ */
+CORE_API int hashtable_frozen_isempty(const struct hashtable_frozen* table);
+
+/**
+ * finds hash table by key
+ * @return found item, NULL if not found
+ * @ingroup htable
+ */
+CORE_API const struct hashtable_frozen_item* hashtable_frozen_find(
+    const struct hashtable_frozen* table, uint hash_key);
+
 #ifdef __cplusplus
 namespace dh {
 
+/* Note: const char* keys are hashed at runtime with hash_str, for constant names, pass
+ * HASH_LITERAL("name") as the key instead, which is evaluated at compile-time */
+
 /* HashTableFixed */
 template <typename T, iptr_t Invalid = 0>
 class HashtableFixed
@@ -324,6 +463,18 @@ public:
         return value(hash_str(key));
     }
 
+    /* looks up multiple keys with prefetching, values of keys that are not found are 'Invalid' */
+    void find_batch(const uint *keys, int cnt, T *values) const
+    {
+        hashtable_item *items[HASHTABLE_BATCH_SIZE];
+        for (int i = 0; i < cnt; i += HASHTABLE_BATCH_SIZE)   {
+            int c = (cnt - i) < HASHTABLE_BATCH_SIZE ? (cnt - i) : HASHTABLE_BATCH_SIZE;
+            hashtable_fixed_find_batch(&m_table, keys + i, c, items);
+            for (int k = 0; k < c; k++)
+                values[i + k] = (items[k] != nullptr) ? (T)(items[k]->value) : (T)(Invalid);
+        }
+    }
+
     void remove(const char *key)
     {
         remove(hash_str(key));
@@ -398,6 +549,18 @@ public:
         return value(hash_str(key));
     }
 
+    /* looks up multiple keys with prefetching, values of keys that are not found are 'Invalid' */
+    void find_batch(const uint *keys, int cnt, T *values) const
+    {
+        hashtable_item *items[HASHTABLE_BATCH_SIZE];
+        for (int i = 0; i < cnt; i += HASHTABLE_BATCH_SIZE)   {
+            int c = (cnt - i) < HASHTABLE_BATCH_SIZE ? (cnt - i) : HASHTABLE_BATCH_SIZE;
+            hashtable_open_find_batch(&m_table, keys + i, c, items);
+            for (int k = 0; k < c; k++)
+                values[i + k] = (items[k] != nullptr) ? (T)(items[k]->value) : (T)(Invalid);
+        }
+    }
+
     void remove(const char *key)
     {
         remove(hash_str(key));
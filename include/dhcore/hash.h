@@ -31,6 +31,12 @@
  * @defgroup hash Hashing functions
  */
 
+/**
+ * Seed value that is used by @e hash_str, compile-time hashes (HASH_LITERAL) also use this seed
+ * @ingroup hash
+ */
+#define HASH_STR_SEED 98424
+
 #ifdef _ARCH64_
 typedef struct hash_s
 {
@@ -166,5 +172,106 @@ CORE_API uint hash_murmurincr_end(struct hash_incr* h);
  */
 CORE_API uint hash_str(const char* str);
 
+/**
+ * Hashes an array of null-terminated strings, and fills the @e hashes array with results\n
+ * Useful for C code to build name tables once (on init) instead of hashing names on every lookup
+ * @param hashes output array, must have at least @e cnt items
+ * @param strs array of null-terminated strings
+ * @ingroup hash
+ */
+CORE_API void hash_str_table(uint* hashes, const char* const* strs, uint cnt);
+
+#if defined(_HAVE_CONSTEXPR_)
+namespace dh {
+
+/* murmur3 32bit, evaluated at compile-time. Reads blocks in little-endian order, which is the
+ * same result as hash_murmur32 on supported platforms (x86/ARM) */
+namespace hash_internal {
+    constexpr uint rotl32(uint x, int r)
+    {
+        return (x << r) | (x >> (32 - r));
+    }
+
+    constexpr uint xorshift(uint h, int s)
+    {
+        return h ^ (h >> s);
+    }
+
+    constexpr uint fmix32(uint h)
+    {
+        return xorshift(xorshift(xorshift(h, 16)*0x85ebca6bu, 13)*0xc2b2ae35u, 16);
+    }
+
+    constexpr uint byte(const char* s, size_t i)
+    {
+        return (uint)(unsigned char)s[i];
+    }
+
+    constexpr uint block32(const char* s, size_t i)
+    {
+        return byte(s, i) | (byte(s, i+1) << 8) | (byte(s, i+2) << 16) | (byte(s, i+3) << 24);
+    }
+
+    constexpr uint mixk(uint k)
+    {
+        return rotl32(k*0xcc9e2d51u, 15)*0x1b873593u;
+    }
+
+    constexpr uint body(const char* s, size_t nblocks, size_t i, uint h)
+    {
+        return (i == nblocks) ? h :
+            body(s, nblocks, i + 1, rotl32(h ^ mixk(block32(s, i*4)), 13)*5 + 0xe6546b64u);
+    }
+
+    constexpr uint tailk(const char* t, size_t rem)
+    {
+        return (rem == 3) ? ((byte(t, 2) << 16) | (byte(t, 1) << 8) | byte(t, 0)) :
+               (rem == 2) ? ((byte(t, 1) << 8) | byte(t, 0)) :
+               (rem == 1) ? byte(t, 0) : 0;
+    }
+
+    constexpr uint tail(const char* t, size_t rem, uint h)
+    {
+        return (rem == 0) ? h : (h ^ mixk(tailk(t, rem)));
+    }
+
+    constexpr size_t strlen_const(const char* s)
+    {
+        return (*s != 0) ? (1 + strlen_const(s + 1)) : 0;
+    }
+
+    constexpr uint murmur32(const char* s, size_t len, uint seed)
+    {
+        return fmix32(tail(s + (len/4)*4, len & 3, body(s, len/4, 0, seed)) ^ (uint)len);
+    }
+
+    template <uint H>
+    struct HashConst
+    {
+        static const uint value = H;
+    };
+}   /* hash_internal */
+
+/**
+ * Compile-time version of @e hash_str, returns exactly the same value as hash_str
+ * @ingroup hash
+ */
+constexpr uint hash_str_const(const char* str)
+{
+    return hash_internal::murmur32(str, hash_internal::strlen_const(str), HASH_STR_SEED);
+}
+
+}   /* dh */
+
+/**
+ * Hashes a string literal, in C++ the hash is evaluated at compile-time, in C it falls back to
+ * @e hash_str. Example: HASH_LITERAL("position")
+ * @ingroup hash
+ */
+#define HASH_LITERAL(s) (dh::hash_internal::HashConst<dh::hash_str_const(s)>::value)
+#else
+#define HASH_LITERAL(s) hash_str(s)
+#endif
+
 
 #endif
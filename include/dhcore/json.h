@@ -88,6 +88,27 @@ CORE_API json_t json_parsefilef(file_t f, struct allocator* tmp_alloc);
  */
 CORE_API json_t json_parsestring(const char* str);
 
+/**
+ * Parse JSON string into a read-only tree, structure of the data is indexed with SIMD (SSE2) -
+ * and the whole tree (nodes and decoded strings) is built in a single allocation, so it's -
+ * faster to parse and destroy than json_parsestring\n
+ * All get functions work on the tree, but it must not be modified (set, add, replace items). -
+ * Destroy it with json_destroy
+ * @param str JSON data, doesn't need to be null-terminated
+ * @param len size of the data (bytes)
+ * @param alloc allocator for the tree and temp buffers
+ * @return JSON object, NULL if error occured
+ * @ingroup JSON
+ */
+CORE_API json_t json_parsedom(const char* str, size_t len, struct allocator* alloc);
+
+/**
+ * Parse JSON file into a read-only tree, memory and mapped files are parsed in place
+ * @see json_parsedom
+ * @ingroup JSON
+ */
+CORE_API json_t json_parsedomf(file_t f, struct allocator* alloc);
+
 /**
  * Save JSON data to file
  * @param filepath path to the file on the disk
@@ -289,6 +310,119 @@ CORE_API void json_replaceitem_inobj(json_t obj, const char* name, json_t item);
  */
 CORE_API void json_replaceitem_inarr(json_t obj, int idx, json_t item);
 
+/**
+ * Events of the streaming JSON reader
+ * @see json_reader_next
+ * @ingroup JSON
+ */
+enum json_event
+{
+    JSON_EVENT_NONE = 0, /**< reader is created, no value is read yet */
+    JSON_EVENT_ERROR, /**< parse error, error is reported with err_printf */
+    JSON_EVENT_END, /**< root value and the rest of the file is read */
+    JSON_EVENT_OBJECT_BEGIN,
+    JSON_EVENT_OBJECT_END,
+    JSON_EVENT_ARRAY_BEGIN,
+    JSON_EVENT_ARRAY_END,
+    JSON_EVENT_KEY, /**< name of the next value in object, see json_reader_gets */
+    JSON_EVENT_STRING,
+    JSON_EVENT_NUM,
+    JSON_EVENT_BOOL,
+    JSON_EVENT_NULL
+};
+
+/**
+ * Streaming (pull) JSON reader, reads values one by one without building a JSON tree
+ * @ingroup JSON
+ */
+struct json_reader;
+typedef struct json_reader* json_reader_t;
+
+/**
+ * Callback for json_parsesax, called for every event of the reader
+ * @return FALSE to stop parsing
+ * @ingroup JSON
+ */
+typedef int (*pfn_json_sax)(json_reader_t r, enum json_event e, void* param);
+
+/**
+ * Creates streaming reader for the file, starting from the current position of the file\n
+ * Disk files are read in fixed size chunks, memory and mapped files are read in place. Nodes are -
+ * not allocated, keys and strings are decoded into a single buffer that is reused for every event
+ * @param alloc allocator for the reader and it's buffers
+ * @return reader, NULL if out of memory
+ * @see json_reader_next
+ * @ingroup JSON
+ */
+CORE_API json_reader_t json_reader_create(file_t f, struct allocator* alloc);
+
+/**
+ * @ingroup JSON
+ */
+CORE_API void json_reader_destroy(json_reader_t r);
+
+/**
+ * Reads the next token of the file\n
+ * Example:
+ * @code
+ * json_reader_t r = json_reader_create(f, mem_heap());
+ * enum json_event e;
+ * while ((e = json_reader_next(r)) > JSON_EVENT_END)   {
+ *     if (e == JSON_EVENT_KEY && str_isequal(json_reader_gets(r, NULL), "name"))
+ *         ...
+ * }
+ * json_reader_destroy(r);
+ * @endcode
+ * @return read event, after JSON_EVENT_END or JSON_EVENT_ERROR, same event is returned
+ * @ingroup JSON
+ */
+CORE_API enum json_event json_reader_next(json_reader_t r);
+
+/**
+ * Skips the value of the last event: if last event is a key, it's value is skipped, if it's the -
+ * beginning of an object or array, reader skips to the end of it. Skipped containers are only -
+ * scanned for their boundaries and are not validated
+ * @ingroup JSON
+ */
+CORE_API result_t json_reader_skip(json_reader_t r);
+
+/**
+ * Returns decoded key or string of the last event (or text of the number), the buffer is valid -
+ * until the next call to json_reader_next
+ * @param plen optional length of the string (bytes)
+ * @ingroup JSON
+ */
+CORE_API const char* json_reader_gets(json_reader_t r, OUT size_t* plen);
+
+/**
+ * @ingroup JSON
+ */
+CORE_API fl64 json_reader_getf(json_reader_t r);
+
+/**
+ * @ingroup JSON
+ */
+CORE_API int json_reader_geti(json_reader_t r);
+
+/**
+ * @ingroup JSON
+ */
+CORE_API int json_reader_getb(json_reader_t r);
+
+/**
+ * Number of objects/arrays that contain the current position
+ * @ingroup JSON
+ */
+CORE_API int json_reader_getdepth(json_reader_t r);
+
+/**
+ * Parses the file with a streaming reader, and calls the callback for every event (SAX)
+ * @return RET_OK if whole file is parsed, RET_ABORT if callback stopped parsing
+ * @see json_reader_create
+ * @ingroup JSON
+ */
+CORE_API result_t json_parsesax(file_t f, struct allocator* alloc, pfn_json_sax fn, void* param);
+
 #ifdef __cplusplus
 namespace dh {
 
@@ -43,8 +43,12 @@
  * @b MT_ATOMIC_SET(dest_ptr, value): set atomic value\n
  * @b MT_ATOMIC_INCR(dest_ptr) : increment atomic, returns new value\n
  * @b MT_ATOMIC_DECR(dest_ptr): decrements atomic, returns new value\n
+ * @b MT_ATOMIC_ADD(dest_ptr, value): adds value to atomic, returns new value\n
  * @b MT_ATOMIC_CASTPTR(dest, cmp_ptr, new_ptr): compare-and-swap pointer, returns original value\n
  * @b MT_ATOMIC_SETPTR(dest, ptr): set atomic pointer\n
+ * @b MT_ATOMIC_LOAD_ACQ(src): loads value with acquire semantics (later reads are not moved up)\n
+ * @b MT_ATOMIC_STORE_REL(dest, value): stores value with release semantics (prior writes are
+ * visible before the store)\n
  * @ingroup mt
  */
  
@@ -69,10 +73,17 @@ typedef int64 volatile atom_t;
     InterlockedIncrement(&(dest))
 #define MT_ATOMIC_DECR(dest_ptr)   \
     InterlockedDecrement(&(dest))
+#define MT_ATOMIC_ADD(dest, value)  \
+    (InterlockedExchangeAdd(&(dest), (value)) + (value))
 #define MT_ATOMIC_CASTPTR(dest, cmp, new_ptr)  \
     InterlockedCompareExchangePointer(&(dest), (new_ptr), (cmp))
 #define MT_ATOMIC_SETPTR(dest, ptr)   \
     InterlockedExchangePointer(&(dest), (ptr))
+/* msvc volatile accesses have acquire/release semantics, barrier keeps the compiler in order */
+#define MT_ATOMIC_LOAD_ACQ(src) \
+    (_ReadWriteBarrier(), (src))
+#define MT_ATOMIC_STORE_REL(dest, value)   \
+    do { _ReadWriteBarrier(); (dest) = (value); } while (0)
 #elif defined(_POSIXLIB_)
 /* unix/linux specific */
 #define MT_ATOMIC_CAS(dest, cmp_value, swap_value)     \
@@ -85,10 +96,16 @@ typedef int64 volatile atom_t;
     __sync_add_and_fetch(&(dest), 1)
 #define MT_ATOMIC_DECR(dest)   \
     __sync_sub_and_fetch(&(dest), 1)
+#define MT_ATOMIC_ADD(dest, value)  \
+    __sync_add_and_fetch(&(dest), (value))
 #define MT_ATOMIC_CASTPTR(dest, cmp, new_ptr)  \
 	__sync_val_compare_and_swap(&(dest), (cmp), (new_ptr))
 #define MT_ATOMIC_SETPTR(dest, ptr) \
 	__sync_lock_test_and_set(&(dest), (ptr))
+#define MT_ATOMIC_LOAD_ACQ(src) \
+    __atomic_load_n(&(src), __ATOMIC_ACQUIRE)
+#define MT_ATOMIC_STORE_REL(dest, value)   \
+    __atomic_store_n(&(dest), (value), __ATOMIC_RELEASE)
 #endif
 
 /**
@@ -30,16 +30,50 @@ struct pak_header
     uint64 items_offset;
     uint64 items_cnt;
     uint compress_mode;
+    uint64 table_offset;    /* v1.1: offset of the frozen hash-table blob (path -> file_id) */
+    uint table_size;        /* v1.1: size of the frozen hash-table blob (bytes) */
+    uint block_size;        /* v1.2: compressed entries are split into blocks of this size */
+    uint64 strings_offset;  /* v2.0: offset of the string table (item paths) */
+    uint strings_size;      /* v2.0: size of the string table (bytes) */
+    uint64 hashes_offset;   /* v2.1: offset of hashes of the stored (compressed) data, 0 if none */
 };
 
-/* pak file item, for each file in the pak I store one of these */
+/* v1.2 compressed entry layout (at pak_item::offset, pak_item::size bytes in total):
+ * uint offsets[block_cnt+1]: offset of each compressed block, relative to the entry start,
+ *                            offsets[0] is the size of the offsets table itself
+ * blocks: each block is compressed independently (block_size bytes unzipped, last may be smaller)
+ *         a block that doesn't shrink is stored as-is, so it's compressed size == unzipped size
+ * v1.3: each item stores the codec of it's data, entries of different codecs can be in the same
+ *       pak. items of older paks are smaller (no codec field), codec comes from compress_mode */
+
+/* v2.0 directory layout, stored after files data, it's contiguous so it can be read in one go
+ * (or used directly from the mapped pak) and doesn't need any per-item work on open:
+ * items (items_offset, aligned to 16): pak_item[items_cnt], file_id = index + 1
+ * hashes (hashes_offset, aligned to 16, v2.1): hash_t[items_cnt], murmur128 of the data that is
+ *         stored in the pak for each item, used for verifying compressed data before decompressing
+ * table (table_offset, aligned to 16): frozen hash-table blob (hash_str(path) -> file_id)
+ * strings (strings_offset): null terminated paths of the items, referenced by path_offset */
+
+/* pak file item (v2.0), fixed size, for each file in the pak I store one of these */
 struct pak_item
+{
+    uint64 offset;               /* offset in the pak (in bytes) */
+    uint size;                 /* actual compressed size (in bytes) */
+    uint unzip_size;           /* unzipped size (in bytes) */
+    hash_t hash;                 /* hash for data validity */
+    uint codec;                /* compress_codec of the data (see zip.h) */
+    uint path_offset;          /* filepath (alias) of the file, offset in the string table */
+};
+
+/* pak file item of v1.x paks (v1.0..v1.2 items don't have codec field) */
+struct pak_item_v1
 {
     char filepath[DH_PATH_MAX];   /* filepath (alias) of the file for referencing */
     uint64 offset;               /* offset in the pak (in bytes) */
     uint size;                 /* actual compressed size (in bytes) */
     uint unzip_size;           /* unzipped size (in bytes) */
     hash_t hash;                 /* hash for data validity */
+    uint codec;                /* v1.3: compress_codec of the data (see zip.h) */
 };
 #pragma pack(pop)
 
@@ -26,6 +26,8 @@
 #include "pool-alloc.h"
 #include "zip.h"
 #include "file-io.h"
+#include "hash.h"
+#include "mt.h"
 
 /**
  * @defgroup pak Pak files
@@ -33,6 +35,40 @@
 
 /* fwd declarations */
 struct file_mgr;
+struct pak_item;
+struct pak_cache;
+
+/**
+ * Flags for pak_putfiles
+ * @ingroup pak
+ */
+enum pak_put_flags
+{
+    PAK_PUT_DEDUP = (1<<0) /**< files with identical content (hash) share the same data in the pak */
+};
+
+/**
+ * Verification policies of the fetched files (pak_getfile), see pak_setverify
+ * @ingroup pak
+ */
+enum pak_verify
+{
+    PAK_VERIFY_ALWAYS = 0, /**< verify hash of every fetched file (default) */
+    PAK_VERIFY_FIRST, /**< verify only the first fetch of each file, later fetches are trusted */
+    PAK_VERIFY_SAMPLED, /**< verify one of every 'sample_rate' fetches */
+    PAK_VERIFY_OFF /**< don't verify */
+};
+
+/**
+ * Flags for pak_setverify
+ * @ingroup pak
+ */
+enum pak_verify_flags
+{
+    /** verify stored (compressed) data before decompressing, instead of the decompressed data.
+     * It's cheaper for compressed files, paks older than v2.1 fall back to decompressed data */
+    PAK_VERIFY_COMPRESSED = (1<<0)
+};
 
 /**
  * pak file - contains zipped archive of multiple files\n
@@ -43,18 +79,38 @@ struct file_mgr;
 struct pak_file
 {
     FILE *f;
-    struct hashtable_open table; /* hash-table for referencing pak files */
-    struct array items; /* file items in the pak (see pak-file.c) */
-    enum compress_mode compress_mode; /* compression mode (see zip.h) */
+    struct hashtable_open table; /* hash-table for referencing pak files (create, v1.0 paks) */
+    struct hashtable_frozen ftable; /* prebuilt hash-table that is loaded from the pak (v1.1) */
+    const struct pak_item* items; /* directory items (see pak-file-fmt.h), file_id = index + 1 */
+    uint item_cnt;
+    const char* strings; /* string table of the directory, items reference their paths in it */
+    void* dir; /* directory that is read from the file, NULL if it's used from the mapped pak */
+    size_t dir_size;
+    struct allocator* alloc;
+    struct array new_items; /* create mode: items that are put into the pak */
+    struct array new_strings; /* create mode: string table of the new items */
+    const hash_t* zip_hashes; /* hashes of the stored data of the items (v2.1), can be NULL */
+    struct array new_hashes; /* create mode: hashes of the stored data of the new items */
+    enum pak_verify verify; /* verification policy (see pak_setverify) */
+    uint verify_flags;
+    uint sample_rate;
+    atom_t* verified; /* PAK_VERIFY_FIRST: bitmap of items that are verified */
+    atom_t fetch_cnt; /* PAK_VERIFY_SAMPLED: number of fetches */
+    const uint8* map; /* whole pak file mapped into memory (read mode), NULL if mapping failed */
+    size_t map_size;
+    enum compress_mode compress_mode; /* compression mode of new entries (see zip.h) */
+    uint block_size; /* compressed entries are stored in blocks (v1.2), 0 for single stream */
     int init_create;
     struct allocator table_alloc;
+    struct pak_cache* cache; /* shared cache of decompressed entries (see pak_setcache), can be NULL */
 };
 
 /**
  * Create pak file on disk and get it ready for putting files in it
  * @param alloc memory allocator for internal pak_file data
  * @param pakfilepath pak file which will be created on disk (absolute path)
- * @param mode zip compression mode
+ * @param mode zip compression mode, each entry keeps it's own codec, so @e compress_mode can be -
+ * changed between pak_putfile calls to mix codecs in one pak
  * @see zip
  * @ingroup pak
  */
@@ -76,6 +132,63 @@ CORE_API result_t pak_open(struct pak_file* pak, struct allocator* alloc, const
  */
 CORE_API void pak_close(struct pak_file* pak);
 
+/**
+ * Releases memory mapping of the opened pak, file data will be fetched with positional reads
+ * afterwards. If the directory is used from the mapped pak, it will be copied into memory
+ * @ingroup pak
+ */
+CORE_API result_t pak_unmap(struct pak_file* pak);
+
+/**
+ * Sets verification policy for fetching files from the pak (pak_getfile, pak_getfile_mapped)\n
+ * By default, hash of each file is calculated and checked on every fetch, which can cost as much as
+ * decompression. This function is not thread-safe, call it before fetching files from threads
+ * @param verify verification policy
+ * @param flags combination of pak_verify_flags
+ * @param sample_rate PAK_VERIFY_SAMPLED: one of every @e sample_rate fetches is verified
+ * @see pak_verify
+ * @ingroup pak
+ */
+CORE_API result_t pak_setverify(struct pak_file* pak, enum pak_verify verify, uint flags,
+                                uint sample_rate);
+
+/**
+ * Creates cache of decompressed pak entries, which can be shared by multiple paks (patches, DLCs)\n
+ * Entries are keyed by the hash of their content, so identical files in different paks are -
+ * decompressed once. Least recently used entries are evicted when cache size exceeds the budget, -
+ * entries that have open views are never evicted. Cache is thread-safe
+ * @param budget maximum size (bytes) of the cached data
+ * @return cache, NULL if failed
+ * @see pak_setcache
+ * @ingroup pak
+ */
+CORE_API struct pak_cache* pak_cache_create(size_t budget);
+
+/**
+ * Destroys the cache, all views that are fetched from the cache must be closed before
+ * @ingroup pak
+ */
+CORE_API void pak_cache_destroy(struct pak_cache* cache);
+
+/**
+ * Returns cache statistics
+ * @param phits number of fetches that are served from the cache, can be NULL
+ * @param pmisses number of fetches that are decompressed into the cache, can be NULL
+ * @return size (bytes) of the cached data
+ * @ingroup pak
+ */
+CORE_API size_t pak_cache_getstats(struct pak_cache* cache, OUT uint64* phits,
+                                   OUT uint64* pmisses);
+
+/**
+ * Sets cache for the opened pak, pak_getfile_mapped fetches compressed entries (and entries of -
+ * unmapped paks) through the cache, and returns refcounted read-only views into it. Views are -
+ * valid until they are closed, even after the pak is closed
+ * @param cache cache that is created with pak_cache_create, NULL to disable caching
+ * @ingroup pak
+ */
+CORE_API void pak_setcache(struct pak_file* pak, struct pak_cache* cache);
+
 /**
  * Checks if pak file is opened
  * @ingroup pak
@@ -93,6 +206,22 @@ CORE_API int pak_isopen(struct pak_file* pak);
 CORE_API result_t pak_putfile(struct pak_file* pak, struct allocator* tmp_alloc, 
     file_t src_file, const char* dest_path);
 
+/**
+ * Compress and put multiple opened files into pak\n
+ * Files are read, hashed and compressed concurrently by task manager workers (and the caller), -
+ * then written into the pak in the same order by the caller, so the output is identical to calling -
+ * pak_putfile for each file. If task manager is not initialized, files are processed by the caller
+ * @param tmp_alloc temp-allocator for internal memory allocation
+ * @param src_files array of source files which must be already opened
+ * @param dest_paths array of destination filepaths (aliases), one for each source file
+ * @param file_cnt number of files
+ * @param flags combination of pak_put_flags
+ * @see pak_put_flags
+ * @ingroup pak
+ */
+CORE_API result_t pak_putfiles(struct pak_file* pak, struct allocator* tmp_alloc,
+    const file_t* src_files, const char* const* dest_paths, int file_cnt, uint flags);
+
 /**
  * Find a file in pak
  * @param filepath filepath (case sensitive) of dest_path provided in 'pak_putfile' when -
@@ -103,7 +232,8 @@ CORE_API result_t pak_putfile(struct pak_file* pak, struct allocator* tmp_alloc,
 CORE_API uint pak_findfile(struct pak_file* pak, const char* filepath);
 
 /**
- * Decompress and get a file from pak
+ * Decompress and get a file from pak\n
+ * Thread-safe: any number of threads can fetch files from the same opened pak concurrently
  * @param alloc memory allocator for creating memory file
  * @param tmp_alloc temp-allocator for internal memory allocation
  * @param file_id file-id of the file in the pak, must be fetched from 'pak_findfile'
@@ -113,6 +243,82 @@ CORE_API uint pak_findfile(struct pak_file* pak, const char* filepath);
 CORE_API file_t pak_getfile(struct pak_file* pak, struct allocator* alloc,
                             struct allocator* tmp_alloc, uint file_id, uint mem_id);
 
+/**
+ * Decompress and get a file from pak, same as pak_getfile, but blocks of large compressed -
+ * entries are decompressed concurrently by task manager workers, which is faster for big files. -
+ * If task manager is not initialized, file is processed by the caller. Must be called from -
+ * the main thread, same as tsk_dispatch
+ * @param alloc memory allocator for creating memory file
+ * @param tmp_alloc temp-allocator for internal memory allocation
+ * @param file_id file-id of the file in the pak, must be fetched from 'pak_findfile'
+ * @return handle to the opened file in memory, ready to read
+ * @ingroup pak
+ */
+CORE_API file_t pak_getfile_parallel(struct pak_file* pak, struct allocator* alloc,
+                                     struct allocator* tmp_alloc, uint file_id, uint mem_id);
+
+/**
+ * Get a file from pak without copying, if possible\n
+ * Uncompressed entries of mapped paks are returned as views (FILE_TYPE_MMAP) into the mapped pak,
+ * which are valid until the pak is closed. Compressed entries are decompressed directly from the -
+ * mapped data into a memory file, same as pak_getfile, or fetched from the cache as views, if -
+ * the pak has a cache (see pak_setcache)
+ * @param alloc memory allocator for creating memory file (compressed entries)
+ * @param tmp_alloc temp-allocator for internal memory allocation
+ * @param file_id file-id of the file in the pak, must be fetched from 'pak_findfile'
+ * @return handle to the opened file, ready to read, use fio_getptr for direct access to the data
+ * @ingroup pak
+ */
+CORE_API file_t pak_getfile_mapped(struct pak_file* pak, struct allocator* alloc,
+                                   struct allocator* tmp_alloc, uint file_id, uint mem_id);
+
+/**
+ * Decompress and get multiple files from pak, which is faster than calling pak_getfile for each file\n
+ * Requests are sorted by their offset in the pak, so the data is read forward, and neighbor -
+ * entries of unmapped paks are coalesced into large reads. Entries are decompressed (and -
+ * verified) concurrently by task manager workers while the caller reads the next entries. -
+ * If task manager is not initialized, files are processed by the caller. Must be called from -
+ * the main thread, same as tsk_dispatch
+ * @param alloc memory allocator for creating memory files
+ * @param tmp_alloc temp-allocator for internal memory allocation
+ * @param file_ids file-ids of the files in the pak, must be fetched from 'pak_findfile'
+ * @param file_cnt number of files
+ * @param files outputs memory files, one for each file-id in the same order, NULL for files that -
+ * are failed to load
+ * @return RET_OK if all files are loaded
+ * @ingroup pak
+ */
+CORE_API result_t pak_getfiles_batch(struct pak_file* pak, struct allocator* alloc,
+                                     struct allocator* tmp_alloc, const uint* file_ids,
+                                     int file_cnt, OUT file_t* files, uint mem_id);
+
+/**
+ * Reads a range of a file from pak without decompressing the whole file\n
+ * For compressed v1.2 paks, only the blocks that overlap the range are decompressed, so it can be -
+ * used for streaming and random access to large files. Data validity (hash) is not checked
+ * @param tmp_alloc temp-allocator for internal memory allocation
+ * @param file_id file-id of the file in the pak, must be fetched from 'pak_findfile'
+ * @param offset offset (bytes) in the unzipped file to start reading
+ * @param size number of bytes to read
+ * @return number of bytes that is read, 0 if error occurs
+ * @ingroup pak
+ */
+CORE_API size_t pak_readfile(struct pak_file* pak, struct allocator* tmp_alloc, uint file_id,
+                             void* buffer, size_t offset, size_t size);
+
+/**
+ * Opens a file from pak for streaming reads (FILE_TYPE_STREAM), without decompressing the -
+ * whole file. Each fio_read decompresses only the blocks it needs (see pak_readfile), the last -
+ * decompressed block is kept by the file, so small sequential reads are cheap. Files can be -
+ * seeked. Compressed entries of v1.0/v1.1 paks are decompressed into memory, same as pak_getfile. -
+ * Data validity (hash) is not checked. Any number of streams can be opened from multiple threads
+ * @param alloc allocator for the stream data and it's temp buffers
+ * @param file_id file-id of the file in the pak, must be fetched from 'pak_findfile'
+ * @return handle to the opened file, ready to read, valid until the pak is closed
+ * @ingroup pak
+ */
+CORE_API file_t pak_openstream(struct pak_file* pak, struct allocator* alloc, uint file_id);
+
 /**
  * Creates/allocates list of files inside pak-file
  * @param alloc memory allocator for the list
@@ -0,0 +1,211 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#ifndef __RINGQUEUE_H__
+#define __RINGQUEUE_H__
+
+#include "types.h"
+#include "core-api.h"
+#include "allocator.h"
+
+/**
+ * @defgroup ringq Ring queue
+ * Bounded lock-free FIFO queue, for passing items between threads without locking a mutex\n
+ * Items are copied by value into a fixed-size ring of cells, each cell has a sequence number that
+ * tells producers/consumers if the cell is free or published (based on D. Vyukov's bounded queue).
+ * Producer and consumer indexes are placed on separate cache lines to avoid false sharing.\n
+ * The queue type defines which sides can be accessed from multiple threads, single sides skip
+ * the atomic compare-and-swap, so use the most restrictive type that fits.\n
+ * Usage example:\n
+ * @code
+ * struct ring_queue q;
+ * ringq_create(mem_heap(), &q, RINGQ_MPSC, sizeof(struct job*), 1024, 0);
+ *
+ * // producer threads
+ * if (!ringq_push(&q, &job))
+ *     // queue is full, try again later
+ *
+ * // consumer thread
+ * struct job* jobs[32];
+ * int cnt = ringq_pop_batch(&q, jobs, 32);
+ * @endcode
+ * @ingroup ringq
+ */
+
+/**
+ * Padding between producer and consumer indexes
+ * @ingroup ringq
+ */
+#define RINGQ_CACHELINE 64
+
+/**
+ * Ring queue types, single producer/consumer sides are faster (no CAS)
+ * @ingroup ringq
+ */
+enum ringq_type
+{
+    RINGQ_MPMC = 0, /**< multiple producers, multiple consumers */
+    RINGQ_SPMC = 0x1, /**< single producer, multiple consumers */
+    RINGQ_MPSC = 0x2, /**< multiple producers, single consumer */
+    RINGQ_SPSC = 0x3 /**< single producer, single consumer */
+};
+
+#define RINGQ_SINGLE_PRODUCER 0x1
+#define RINGQ_SINGLE_CONSUMER 0x2
+
+struct ring_queue
+{
+    struct allocator* alloc;
+    uint8* cells;   /* each cell: sequence (uint) + item data */
+    uint mask;  /* capacity - 1 */
+    uint item_sz;
+    uint cell_sz;
+    uint flags; /* ringq_type */
+    uint8 _pad0[RINGQ_CACHELINE];
+    volatile uint tail;  /* producers index */
+    uint8 _pad1[RINGQ_CACHELINE];
+    volatile uint head;  /* consumers index */
+    uint8 _pad2[RINGQ_CACHELINE];
+};
+
+/**
+ * Creates ring queue
+ * @param type queue type, defines which sides are accessed by multiple threads
+ * @param item_sz size of each item (bytes), items are copied into the queue
+ * @param capacity maximum number of items in the queue, rounded up to power of two
+ * @ingroup ringq
+ */
+CORE_API result_t ringq_create(struct allocator* alloc, struct ring_queue* rq,
+                               enum ringq_type type, int item_sz, int capacity, uint mem_id);
+
+/**
+ * Destroys ring queue, no other thread must be accessing the queue
+ * @ingroup ringq
+ */
+CORE_API void ringq_destroy(struct ring_queue* rq);
+
+/**
+ * Pushes a copy of item to the end of the queue
+ * @return TRUE if item is pushed, FALSE if queue is full
+ * @ingroup ringq
+ */
+CORE_API int ringq_push(struct ring_queue* rq, const void* item);
+
+/**
+ * Pops item from the front of the queue
+ * @param item (out) receives a copy of the item
+ * @return TRUE if item is popped, FALSE if queue is empty
+ * @ingroup ringq
+ */
+CORE_API int ringq_pop(struct ring_queue* rq, void* item);
+
+/**
+ * Pushes multiple items with a single index update, items are pushed in order and stay
+ * contiguous in the queue
+ * @param items array of items, item_cnt*item_sz bytes
+ * @return number of pushed items, can be less than item_cnt if the queue is (almost) full
+ * @ingroup ringq
+ */
+CORE_API int ringq_push_batch(struct ring_queue* rq, const void* items, int item_cnt);
+
+/**
+ * Pops multiple items with a single index update
+ * @param items (out) array receiving the items, must have max_cnt*item_sz bytes
+ * @return number of popped items, 0 if queue is empty
+ * @ingroup ringq
+ */
+CORE_API int ringq_pop_batch(struct ring_queue* rq, void* items, int max_cnt);
+
+/**
+ * Returns number of items in the queue, the value is approximate if other threads are accessing
+ * the queue
+ * @ingroup ringq
+ */
+CORE_API int ringq_count(const struct ring_queue* rq);
+
+/**
+ * @ingroup ringq
+ */
+INLINE int ringq_capacity(const struct ring_queue* rq)
+{
+    return (int)(rq->mask + 1);
+}
+
+#ifdef __cplusplus
+#include "mem-mgr.h"
+
+namespace dh {
+
+// Ring queue wrapper, items are copied by value with memcpy, so T must be a POD type
+template <typename T>
+class RingQueue
+{
+private:
+    ring_queue m_rq;
+
+public:
+    RingQueue()
+    {
+        memset(&m_rq, 0x00, sizeof(m_rq));
+    }
+
+    result_t create(ringq_type type, int capacity, uint mem_id = 0, allocator* alloc = mem_heap())
+    {
+        return ringq_create(alloc, &m_rq, type, sizeof(T), capacity, mem_id);
+    }
+
+    void destroy()
+    {
+        ringq_destroy(&m_rq);
+    }
+
+    bool push(const T& item)
+    {
+        return ringq_push(&m_rq, &item) != FALSE;
+    }
+
+    bool pop(T* item)
+    {
+        return ringq_pop(&m_rq, item) != FALSE;
+    }
+
+    int push_batch(const T* items, int item_cnt)
+    {
+        return ringq_push_batch(&m_rq, items, item_cnt);
+    }
+
+    int pop_batch(T* items, int max_cnt)
+    {
+        return ringq_pop_batch(&m_rq, items, max_cnt);
+    }
+
+    int count() const
+    {
+        return ringq_count(&m_rq);
+    }
+
+    int capacity() const
+    {
+        return ringq_capacity(&m_rq);
+    }
+
+    operator ring_queue*()  {   return &m_rq;   }
+    operator const ring_queue*() const  {   return &m_rq;   }
+};
+
+}   /* dh */
+#endif
+
+#endif /* __RINGQUEUE_H__ */
@@ -69,10 +69,11 @@
 #include "core-api.h"
 
 /**
- * Macro to reference RPC parameter names, insert name without double quotes. Example: RPC_VALUE(myval)
+ * Macro to reference RPC parameter names, insert name without double quotes. Example: RPC_VALUE(myval)\n
+ * In C++ the name hash is evaluated at compile-time (see HASH_LITERAL)
  * @ingroup rpc
  */
-#define RPC_VALUE(name) hash_str(#name)
+#define RPC_VALUE(name) HASH_LITERAL(#name)
 
  /**
   * This macro is used in registering RPC structure members, defines that member variable is packed 
@@ -140,6 +141,7 @@ struct rpc_vblock
     struct allocator* alloc;
     uint value_cnt;
     struct rpc_value* values;
+    uint* name_hashes;  /* precomputed name hash for each value */
     struct hashtable_fixed vtbl;   /* value table, key: name(hash), value: index to value */
     uint buff_size;
     uint8* buff;    /* buffer that holds all values */
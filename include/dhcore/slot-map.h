@@ -0,0 +1,299 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#ifndef __SLOTMAP_H__
+#define __SLOTMAP_H__
+
+#include "types.h"
+#include "core-api.h"
+#include "allocator.h"
+
+/**
+ * @defgroup slotmap Slot-map
+ * Slot-map container: items are referenced by stable handles (index + generation), while item data
+ * is kept densely packed for fast iteration. Removing an item moves the last item into it's place,
+ * so handles stay valid but dense indexes and pointers may change.\n
+ * Items can be split into multiple streams (struct-of-arrays), each stream is a separate packed
+ * buffer, so iterating over a field only touches the memory of that field\n
+ * Usage example:\n
+ * @code
+ * struct slot_map sm;
+ * const int streams[] = {sizeof(struct vec3f), sizeof(float)};  // position, radius
+ * slotmap_create(mem_heap(), &sm, streams, 2, 100, 100, 0);
+ * reshandle_t h = slotmap_add(&sm);
+ * *(float*)slotmap_get(&sm, h, 1) = 1.0f;
+ *
+ * // iterate over radiuses only
+ * float* radiuses = SLOTMAP_STREAM(sm, float, 1);
+ * for (int i = 0; i < SLOTMAP_COUNT(sm); i++)
+ *     radiuses[i] *= 2.0f;
+ *
+ * slotmap_remove(&sm, h);
+ * slotmap_destroy(&sm);
+ * @endcode
+ * @ingroup slotmap
+ */
+
+/**
+ * Maximum number of streams (SoA fields) for each slot-map
+ * @ingroup slotmap
+ */
+#define SLOTMAP_STREAMS_MAX 8
+
+/**
+ * Returns packed buffer of the stream, buffer has SLOTMAP_COUNT items
+ * @ingroup slotmap
+ */
+#define SLOTMAP_STREAM(sm, type, stream)   ((type*)(sm).streams[(stream)])
+
+/**
+ * Returns number of items in the slot-map
+ * @ingroup slotmap
+ */
+#define SLOTMAP_COUNT(sm)   ((sm).item_cnt)
+
+/**
+ * Handle index/generation parts
+ * @ingroup slotmap
+ */
+#define SLOTMAP_HANDLE_INDEX(h)    ((uint)((h) & 0xffffffff))
+#define SLOTMAP_HANDLE_GEN(h)      ((uint)((h) >> 32))
+#define SLOTMAP_MAKE_HANDLE(idx, gen)  ((((reshandle_t)(gen)) << 32) | (reshandle_t)(idx))
+
+/* sparse slot, referenced by handle index */
+struct slotmap_slot
+{
+    uint dense_idx; /* index to dense items, or next free slot if slot is free */
+    uint gen;   /* generation, increased on each remove */
+};
+
+struct slot_map
+{
+    struct allocator* alloc;
+    struct slotmap_slot* slots;  /* sparse slots, item: max_cnt */
+    uint* dense_slots;  /* dense index -> slot index, item: max_cnt */
+    void* streams[SLOTMAP_STREAMS_MAX];  /* dense item data for each stream */
+    int stream_sizes[SLOTMAP_STREAMS_MAX];   /* item size of each stream (bytes) */
+    int stream_cnt;
+    int item_cnt;
+    int max_cnt;
+    int expand_sz;
+    uint free_slot;    /* head of free slots list, INVALID_INDEX if empty */
+    uint mem_id;
+
+#ifdef __cplusplus
+    slot_map()
+    {
+        alloc = nullptr;
+        slots = nullptr;
+        dense_slots = nullptr;
+        memset(streams, 0x00, sizeof(streams));
+        memset(stream_sizes, 0x00, sizeof(stream_sizes));
+        stream_cnt = 0;
+        item_cnt = 0;
+        max_cnt = 0;
+        expand_sz = 0;
+        free_slot = INVALID_INDEX;
+        mem_id = 0;
+    }
+#endif
+};
+
+/**
+ * Creates slot-map
+ * @param alloc allocator for internal buffers
+ * @param stream_sizes item size (bytes) for each stream, pass one stream for array-of-structs layout
+ * @param stream_cnt number of streams, maximum is SLOTMAP_STREAMS_MAX
+ * @param init_item_cnt initial maximum item count
+ * @param expand_cnt number of items to expand if needed
+ * @ingroup slotmap
+ */
+CORE_API result_t slotmap_create(struct allocator* alloc, struct slot_map* sm,
+                                 const int* stream_sizes, int stream_cnt,
+                                 int init_item_cnt, int expand_cnt, uint mem_id);
+
+/**
+ * Destroys slot-map
+ * @ingroup slotmap
+ */
+CORE_API void slotmap_destroy(struct slot_map* sm);
+
+/**
+ * Adds new item to the end of dense streams. item data is not initialized
+ * @return handle to new item, INVALID_HANDLE if out of memory
+ * @ingroup slotmap
+ */
+CORE_API reshandle_t slotmap_add(struct slot_map* sm);
+
+/**
+ * Removes item from slot-map, last item is moved into the place of removed item, and handle is
+ * invalidated (further accesses with this handle fails)
+ * @ingroup slotmap
+ */
+CORE_API void slotmap_remove(struct slot_map* sm, reshandle_t hdl);
+
+/**
+ * Checks if handle is valid (item is not removed)
+ * @ingroup slotmap
+ */
+CORE_API int slotmap_isvalid(const struct slot_map* sm, reshandle_t hdl);
+
+/**
+ * Returns item's current index in dense streams, -1 if handle is invalid
+ * @ingroup slotmap
+ */
+CORE_API int slotmap_index(const struct slot_map* sm, reshandle_t hdl);
+
+/**
+ * Returns handle of the item in dense index
+ * @ingroup slotmap
+ */
+CORE_API reshandle_t slotmap_handle(const struct slot_map* sm, int idx);
+
+/**
+ * Returns pointer to item's data in the stream, NULL if handle is invalid\n
+ * Pointers are not stable, they are invalidated after remove/add
+ * @ingroup slotmap
+ */
+CORE_API void* slotmap_get(const struct slot_map* sm, reshandle_t hdl, int stream);
+
+/**
+ * Removes all items, all handles are invalidated
+ * @ingroup slotmap
+ */
+CORE_API void slotmap_clear(struct slot_map* sm);
+
+/**
+ * @ingroup slotmap
+ */
+INLINE int slotmap_isempty(const struct slot_map* sm)
+{
+    return (sm->item_cnt == 0);
+}
+
+#ifdef __cplusplus
+#include "err.h"
+#include "mem-mgr.h"
+
+namespace dh {
+
+// Slot-map with single stream (array-of-structs)
+// Limitations: Container type must not do anything in constructor/destructor. All operations are
+// in memory (memcpy, malloc), so no c++ stuff will happen on add/remove
+template <typename T>
+class SlotMap
+{
+private:
+    slot_map m_sm;
+
+public:
+    SlotMap()
+    {
+    }
+
+    result_t create(int item_cnt, int expand_cnt, uint mem_id = 0, allocator *alloc = mem_heap())
+    {
+        const int stream_size = sizeof(T);
+        return slotmap_create(alloc, &m_sm, &stream_size, 1, item_cnt, expand_cnt, mem_id);
+    }
+
+    void destroy()
+    {
+        slotmap_destroy(&m_sm);
+    }
+
+    reshandle_t add()
+    {
+        return slotmap_add(&m_sm);
+    }
+
+    reshandle_t add(const T& item)
+    {
+        reshandle_t hdl = slotmap_add(&m_sm);
+        if (hdl != INVALID_HANDLE)
+            *static_cast<T*>(slotmap_get(&m_sm, hdl, 0)) = item;
+        return hdl;
+    }
+
+    void remove(reshandle_t hdl)
+    {
+        slotmap_remove(&m_sm, hdl);
+    }
+
+    bool is_valid(reshandle_t hdl) const
+    {
+        return slotmap_isvalid(&m_sm, hdl);
+    }
+
+    T* get(reshandle_t hdl) const
+    {
+        return static_cast<T*>(slotmap_get(&m_sm, hdl, 0));
+    }
+
+    reshandle_t handle(int idx) const
+    {
+        return slotmap_handle(&m_sm, idx);
+    }
+
+    int index(reshandle_t hdl) const
+    {
+        return slotmap_index(&m_sm, hdl);
+    }
+
+    void clear()
+    {
+        slotmap_clear(&m_sm);
+    }
+
+    bool empty() const
+    {
+        return slotmap_isempty(&m_sm);
+    }
+
+    int count() const
+    {
+        return SLOTMAP_COUNT(m_sm);
+    }
+
+    T* items()
+    {
+        return SLOTMAP_STREAM(m_sm, T, 0);
+    }
+
+    const T* items() const
+    {
+        return SLOTMAP_STREAM(m_sm, T, 0);
+    }
+
+    T& operator[](int idx)
+    {
+        ASSERT(idx < m_sm.item_cnt);
+        return SLOTMAP_STREAM(m_sm, T, 0)[idx];
+    }
+
+    const T& operator[](int idx) const
+    {
+        ASSERT(idx < m_sm.item_cnt);
+        return SLOTMAP_STREAM(m_sm, T, 0)[idx];
+    }
+
+    operator const slot_map*() const  {    return &m_sm;  }
+    operator slot_map*()   {   return &m_sm;  }
+};
+
+}   /* dh */
+#endif
+
+#endif /* __SLOTMAP_H__ */
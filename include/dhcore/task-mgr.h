@@ -113,6 +113,7 @@ CORE_API void tsk_releasemgr();
  * @param thread_cnt Maximum number of threads that the task will dispatch
  * @param params User defined pointer for input data for the callback
  * @param result User defined pointer for output data for the callback
+ * @return Job Id of the dispatched task, 0 if no thread is available or task manager is not initialized
  * @see pfn_tsk_run
  * @see tsk_wait
  * @see tsk_destroy
@@ -158,6 +158,13 @@
   #define _EXTERN_EXPORT_
 #endif
 
+/* constexpr support (C++11), msvc doesn't report proper __cplusplus value, check version instead */
+#if defined(__cplusplus) && !defined(SWIG)
+  #if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+    #define _HAVE_CONSTEXPR_
+  #endif
+#endif
+
 /* common data-type defs */
 typedef int int32;
 typedef long long int int64;
@@ -295,6 +302,16 @@ typedef int iptr_t;
   #define FORCE_INLINE    INLINE
 #endif
 
+/* prefetch memory address into cache, it's just a hint and doesn't fault on invalid addresses */
+#if defined(_GNUC_)
+  #define PREFETCH(addr)  __builtin_prefetch((const void*)(addr))
+#elif defined(_MSVC_) && defined(_X86_64_)
+  #include <xmmintrin.h>
+  #define PREFETCH(addr)  _mm_prefetch((const char*)(addr), _MM_HINT_T0)
+#else
+  #define PREFETCH(addr)
+#endif
+
 /* bitwise operators */
 #define BIT_CHECK(v, b)     (((v)&(b)) != 0)
 #define BIT_ADD(v, b)       ((v) |= (b))
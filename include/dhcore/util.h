@@ -24,6 +24,7 @@
 #include "types.h"
 #include "core-api.h"
 #include "allocator.h"
+#include <stdio.h>
 
 /* terminal ANSI colors for UNIX console only 
    In case of windows, we will translate these to API calls internally
@@ -183,4 +184,112 @@ CORE_API char* util_readtextfile(const char* txt_filepath, struct allocator* all
 
 CORE_API void util_ttyecho();
 
+/**
+ * maps a file into memory for reading (read-only, shared mapping)
+ * @param filepath path of the file on disk
+ * @param psize (out) size of the mapped file
+ * @return pointer to the mapped file data, NULL if failed or file is empty, must be unmapped with
+ * util_unmapfile
+ * @ingroup util
+ */
+CORE_API void* util_mapfile(const char* filepath, OUT size_t* psize);
+
+/**
+ * unmaps a file that is mapped with util_mapfile
+ * @ingroup util
+ */
+CORE_API void util_unmapfile(void* ptr, size_t size);
+
+/**
+ * reads data from an absolute offset of the file, without using or changing the file position\n
+ * unlike fseek/fread, multiple threads can read from the same file concurrently
+ * @param f file opened with fopen (binary), stdio buffers are bypassed
+ * @return number of bytes that is read
+ * @ingroup util
+ */
+CORE_API size_t util_readat(FILE* f, void* buffer, size_t size, uint64 offset);
+
+/**
+ * writes multiple buffers to the current position of the file with gather writes (writev), -
+ * stdio buffers of the file are flushed before writing
+ * @param buffers array of buffers to write, in order
+ * @param sizes size of each buffer (bytes)
+ * @param cnt number of buffers
+ * @return number of bytes that is written
+ * @ingroup util
+ */
+CORE_API size_t util_writegather(FILE* f, const void* const* buffers, const size_t* sizes, int cnt);
+
+/**
+ * flags for util_openfd
+ * @ingroup util
+ */
+enum util_fd_flags
+{
+    UTIL_FD_READ = (1<<0), /**< open existing file for reading */
+    UTIL_FD_WRITE = (1<<1), /**< create (or truncate) file for writing */
+    UTIL_FD_SEQUENTIAL = (1<<2), /**< hint that the file is accessed sequentially (read-ahead) */
+    UTIL_FD_DIRECT = (1<<3) /**< bypass file cache of the OS (O_DIRECT), offsets, sizes and -
+                              buffers of reads must be aligned to UTIL_FD_ALIGN */
+};
+
+#define UTIL_FD_ALIGN 4096
+#define UTIL_FD_INVALID ((iptr_t)-1)
+
+/**
+ * opens native file descriptor (handle on windows) of the file, without stdio buffering
+ * @param flags combination of util_fd_flags
+ * @param psize (out) size of the file (optional)
+ * @return file descriptor, UTIL_FD_INVALID if failed
+ * @ingroup util
+ */
+CORE_API iptr_t util_openfd(const char* filepath, uint flags, OUT uint64* psize);
+
+/**
+ * closes file descriptor that is opened with util_openfd
+ * @ingroup util
+ */
+CORE_API void util_closefd(iptr_t fd);
+
+/**
+ * reads data from an absolute offset of the file descriptor (pread)
+ * @return number of bytes that is read, less than @e size at the end of the file or on errors
+ * @ingroup util
+ */
+CORE_API size_t util_readfd(iptr_t fd, void* buffer, size_t size, uint64 offset);
+
+/**
+ * writes data to an absolute offset of the file descriptor (pwrite)
+ * @return number of bytes that is written
+ * @ingroup util
+ */
+CORE_API size_t util_writefd(iptr_t fd, const void* buffer, size_t size, uint64 offset);
+
+/**
+ * reads data from an absolute offset of the file descriptor into multiple buffers with scatter -
+ * reads (preadv), buffers are filled in order
+ * @param buffers array of destination buffers
+ * @param sizes size of each buffer (bytes)
+ * @param cnt number of buffers
+ * @return number of bytes that is read
+ * @ingroup util
+ */
+CORE_API size_t util_readscatter(iptr_t fd, void* const* buffers, const size_t* sizes, int cnt,
+                                 uint64 offset);
+
+/**
+ * callback for util_walkdir
+ * @param filepath path of the file, relative to the walked directory, with '/' separators
+ * @ingroup util
+ */
+typedef void (*pfn_util_walkdir)(const char* filepath, void* param);
+
+/**
+ * walks a directory recursively and calls @e fn for each file (directories are not reported)\n
+ * symbolic links to directories are not followed
+ * @return FALSE if directory could not be opened
+ * @ingroup util
+ */
+CORE_API int util_walkdir(const char* dir, pfn_util_walkdir fn, void* param);
+
 #endif /* UTIL_H_ */
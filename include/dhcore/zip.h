@@ -18,7 +18,7 @@
 
 /**
  * @defgroup zip Zip
- * Low-level buffer compression/decompression using miniz library (INFLATE)\n
+ * Low-level buffer compression/decompression using miniz library (INFLATE) and LZ4\n
  * @ingroup zip
  */
 
@@ -26,8 +26,8 @@
 #include "core-api.h"
 #include "file-io.h"
 
-struct mz_zip_archive_tag;
-typedef struct mz_zip_archive_tag* zip_t;
+struct zip_archive;
+typedef struct zip_archive* zip_t;
 
 /**
  * @ingroup zip
@@ -37,12 +37,33 @@ enum compress_mode
     COMPRESS_NORMAL = 0,
     COMPRESS_FAST,
     COMPRESS_BEST,
-    COMPRESS_NONE
+    COMPRESS_NONE,
+    COMPRESS_LZ4 /**< LZ4: lower ratio, but decompresses many times faster than INFLATE */
 };
 
+/**
+ * Codec (data format) of compressed buffers, the codec is determined by @e compress_mode and
+ * must be stored alongside compressed data in order to decompress it
+ * @see zip_getcodec
+ * @ingroup zip
+ */
+enum compress_codec
+{
+    COMPRESS_CODEC_DEFLATE = 0, /**< zlib stream (miniz) */
+    COMPRESS_CODEC_LZ4 = 1, /**< LZ4 block */
+    COMPRESS_CODEC_STORE = 2 /**< not compressed */
+};
+
+/**
+ * Returns codec which is used for compressing buffers with the given mode
+ * @ingroup zip
+ */
+CORE_API enum compress_codec zip_getcodec(enum compress_mode mode);
+
 /**
  * Roughly estimate maximum size of the compressed buffer, it's recommended that you evaluate 
- * and allocated compressed buffer size with this function, then pass it to @e zip_compress
+ * and allocated compressed buffer size with this function, then pass it to @e zip_compress\n
+ * Returned size is enough for all compression modes
  * @param src_size Size (bytes) of uncompressed buffer
  * @return Estimated size of compressed target buffer
  * @see zip_compress
@@ -62,18 +83,82 @@ CORE_API size_t zip_compress(void* dest_buffer, size_t dest_size, const void* bu
     enum compress_mode mode);
 
 /**
- * Decompress buffer from memory
+ * Decompress buffer from memory, buffer must be compressed with INFLATE codec
+ * (any mode except COMPRESS_LZ4)
  * @param dest_buffer Uncompressed destination buffer 
  * @param dest_size Uncompressed buffer size, this value should be saved when buffer is compressed
  * @return actual Size of uncompressed buffer
+ * @see zip_decompress_codec
  * @ingroup zip
  */
 CORE_API size_t zip_decompress(void* dest_buffer, size_t dest_size, const void* buffer, size_t size);
 
+/**
+ * Decompress buffer from memory, which is compressed with the specified codec
+ * @param dest_buffer Uncompressed destination buffer
+ * @param dest_size Uncompressed buffer size, this value should be saved when buffer is compressed
+ * @param codec Codec of the compressed buffer
+ * @return actual Size of uncompressed buffer, 0 if data is invalid
+ * @see zip_getcodec
+ * @ingroup zip
+ */
+CORE_API size_t zip_decompress_codec(void* dest_buffer, size_t dest_size, const void* buffer,
+                                     size_t size, enum compress_codec codec);
+
+/**
+ * Opens zip archive for reading, archive is mapped into memory and a hash index is built over -
+ * it's central directory, so entries are found in constant time
+ * @return zip handle, NULL if failed
+ * @see fio_addzip
+ * @ingroup zip
+ */
 CORE_API zip_t zip_open(const char *filepath);
+
+/**
+ * Opens zip archive from memory, buffer is not copied and must be valid until archive is closed
+ * @ingroup zip
+ */
 CORE_API zip_t zip_open_mem(const char *buff, size_t buff_sz);
 
+/**
+ * Closes zip archive, views that are fetched by zip_getfile_mapped are invalid after this call
+ * @ingroup zip
+ */
 CORE_API void zip_close(zip_t zip);
+
+/**
+ * Find a file in zip archive
+ * @param filepath path of the entry in the archive (case insensitive)
+ * @return id of the file, 0 if file is not found
+ * @ingroup zip
+ */
+CORE_API uint zip_findfile(zip_t zip, const char* filepath);
+
+/**
+ * Decompress a file from zip archive into a memory file
+ * @param file_id id of the file, must be fetched from zip_findfile
+ * @param alloc memory allocator for creating memory file
+ * @ingroup zip
+ */
+CORE_API file_t zip_getfile_id(zip_t zip, uint file_id, struct allocator* alloc, uint mem_id);
+
+/**
+ * Get a file from zip archive without copying, if possible\n
+ * Stored (not compressed) entries of archives in memory are returned as views (FILE_TYPE_MMAP) -
+ * into the archive, which are valid until the archive is closed, their CRC is not checked. -
+ * Compressed entries are decompressed into a memory file, same as zip_getfile_id
+ * @param file_id id of the file, must be fetched from zip_findfile
+ * @param alloc memory allocator for creating memory file (compressed entries)
+ * @ingroup zip
+ */
+CORE_API file_t zip_getfile_mapped(zip_t zip, uint file_id, struct allocator* alloc,
+                                   uint mem_id);
+
+/**
+ * Find and decompress a file from zip archive into a memory file
+ * @param filepath path of the entry in the archive (case insensitive)
+ * @ingroup zip
+ */
 CORE_API file_t zip_getfile(zip_t zip, const char *filepath, struct allocator *alloc);
 
 #endif /* __ZIP_H__ */
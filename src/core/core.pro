@@ -48,6 +48,7 @@ SOURCES += \
     hash-table.c \
     hwinfo.c \
     json.c \
+    json-dom.c \
     log.c \
     mem-mgr.c \
     net-socket.c \
@@ -65,9 +66,13 @@ SOURCES += \
     variant.c \
     vec-math.c \
     zip.c \
+    slot-map.c \
+    ring-queue.c \
+    file-io-async.c \
     deps/cJSON/cJSON.c \
     deps/commander/commander.c \
     deps/miniz/miniz.c \
+    deps/lz4/lz4.c \
     path.c \
     static-vars.cpp
 
@@ -100,6 +105,7 @@ macx {
 # linux
 unix:!macx  {
     SOURCES += \
+        platform/linux/filemon-lnx.c \
         platform/linux/hwinfo-lnx.c \
         platform/linux/timer-lnx.c \
         platform/linux/util-lnx.c
@@ -149,5 +155,7 @@ HEADERS = \
     ../../include/dhcore/vec-math.h \
     ../../include/dhcore/win.h \
     ../../include/dhcore/zip.h \
-    ../../include/dhcore/path.h
+    ../../include/dhcore/path.h \
+    ../../include/dhcore/slot-map.h \
+    ../../include/dhcore/ring-queue.h
 
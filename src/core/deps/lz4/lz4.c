@@ -0,0 +1,230 @@
+/*
+ * lz4.c - compact LZ4 block format codec
+ * See lz4.h for details. This file is placed in the public domain.
+ */
+
+#include <string.h>
+#include "lz4.h"
+
+typedef unsigned char  lz4_byte;
+typedef unsigned int   lz4_u32;
+typedef unsigned short lz4_u16;
+
+#define LZ4_MINMATCH        4
+#define LZ4_LASTLITERALS    5   /* last 5 bytes of a block are always literals */
+#define LZ4_MFLIMIT         12  /* last match must start at least 12 bytes before end of block */
+#define LZ4_MAX_DISTANCE    65535
+#define LZ4_HASHLOG         12
+#define LZ4_SKIPTRIGGER     6   /* skip faster over incompressible data */
+#define LZ4_ML_MASK         15
+#define LZ4_RUN_MASK        15
+
+static lz4_u32 lz4_read32(const void* p)
+{
+    lz4_u32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static lz4_u32 lz4_hash(lz4_u32 seq)
+{
+    return (seq*2654435761U) >> (32 - LZ4_HASHLOG);
+}
+
+/* writes the remainder of a literal/match length that doesn't fit in the token */
+static lz4_byte* lz4_writelen(lz4_byte* op, size_t len)
+{
+    while (len >= 255)  {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (lz4_byte)len;
+    return op;
+}
+
+int LZ4_compressBound(int inputSize)
+{
+    return LZ4_COMPRESSBOUND(inputSize);
+}
+
+int LZ4_compress_default(const char* src, char* dst, int srcSize, int dstCapacity)
+{
+    lz4_u32 table[1 << LZ4_HASHLOG];
+    const lz4_byte* base = (const lz4_byte*)src;
+    const lz4_byte* ip = base;
+    const lz4_byte* anchor = base;
+    const lz4_byte* iend = base + srcSize;
+    const lz4_byte* mflimit = iend - LZ4_MFLIMIT;
+    const lz4_byte* matchlimit = iend - LZ4_LASTLITERALS;
+    lz4_byte* op = (lz4_byte*)dst;
+    lz4_byte* oend = op + dstCapacity;
+
+    if (srcSize < 0 || srcSize > LZ4_MAX_INPUT_SIZE || dstCapacity <= 0)
+        return 0;
+
+    if (srcSize > LZ4_MFLIMIT)  {
+        unsigned search_cnt = 1u << LZ4_SKIPTRIGGER;
+        memset(table, 0x00, sizeof(table));
+        ip++;
+
+        while (ip < mflimit)    {
+            lz4_u32 h = lz4_hash(lz4_read32(ip));
+            const lz4_byte* ref = base + table[h];
+            table[h] = (lz4_u32)(ip - base);
+
+            if (ip - ref > LZ4_MAX_DISTANCE || lz4_read32(ref) != lz4_read32(ip))  {
+                ip += search_cnt++ >> LZ4_SKIPTRIGGER;
+                continue;
+            }
+            search_cnt = 1u << LZ4_SKIPTRIGGER;
+
+            /* extend match backwards over pending literals */
+            while (ip > anchor && ref > base && ip[-1] == ref[-1])  {
+                ip--;
+                ref--;
+            }
+
+            /* extend match forward */
+            const lz4_byte* mp = ip + LZ4_MINMATCH;
+            const lz4_byte* rp = ref + LZ4_MINMATCH;
+            while (mp < matchlimit && *mp == *rp)   {
+                mp++;
+                rp++;
+            }
+
+            size_t lit_len = (size_t)(ip - anchor);
+            size_t match_len = (size_t)(mp - ip) - LZ4_MINMATCH;
+            if ((size_t)(oend - op) < 1 + lit_len/255 + 1 + lit_len + 2 + match_len/255 + 1)
+                return 0;
+
+            /* sequence: token, literals, offset, match length */
+            lz4_byte* token = op++;
+            if (lit_len >= LZ4_RUN_MASK)    {
+                *token = LZ4_RUN_MASK << 4;
+                op = lz4_writelen(op, lit_len - LZ4_RUN_MASK);
+            }   else    {
+                *token = (lz4_byte)(lit_len << 4);
+            }
+            memcpy(op, anchor, lit_len);
+            op += lit_len;
+
+            lz4_u16 offset = (lz4_u16)(ip - ref);
+            *op++ = (lz4_byte)(offset & 0xff);
+            *op++ = (lz4_byte)(offset >> 8);
+
+            if (match_len >= LZ4_ML_MASK)   {
+                *token |= LZ4_ML_MASK;
+                op = lz4_writelen(op, match_len - LZ4_ML_MASK);
+            }   else    {
+                *token |= (lz4_byte)match_len;
+            }
+
+            ip = anchor = mp;
+            if (ip < mflimit)
+                table[lz4_hash(lz4_read32(ip - 2))] = (lz4_u32)(ip - 2 - base);
+        }
+    }
+
+    /* last literals */
+    size_t lit_len = (size_t)(iend - anchor);
+    if ((size_t)(oend - op) < 1 + (lit_len + 255 - LZ4_RUN_MASK)/255 + lit_len)
+        return 0;
+    if (lit_len >= LZ4_RUN_MASK)    {
+        *op++ = LZ4_RUN_MASK << 4;
+        op = lz4_writelen(op, lit_len - LZ4_RUN_MASK);
+    }   else    {
+        *op++ = (lz4_byte)(lit_len << 4);
+    }
+    memcpy(op, anchor, lit_len);
+    op += lit_len;
+
+    return (int)(op - (lz4_byte*)dst);
+}
+
+/* reads the remainder of a literal/match length, returns 0 if input ends prematurely */
+static const lz4_byte* lz4_readlen(const lz4_byte* ip, const lz4_byte* iend, size_t* len)
+{
+    unsigned s;
+    do  {
+        if (ip >= iend)
+            return 0;
+        s = *ip++;
+        *len += s;
+    }   while (s == 255);
+    return ip;
+}
+
+int LZ4_decompress_safe(const char* src, char* dst, int compressedSize, int dstCapacity)
+{
+    const lz4_byte* ip = (const lz4_byte*)src;
+    const lz4_byte* iend = ip + compressedSize;
+    lz4_byte* op = (lz4_byte*)dst;
+    lz4_byte* ostart = op;
+    lz4_byte* oend = op + dstCapacity;
+
+    if (compressedSize <= 0 || dstCapacity < 0)
+        return -1;
+
+    for (;;)    {
+        unsigned token = *ip++;
+
+        /* literals */
+        size_t len = token >> 4;
+        if (len == LZ4_RUN_MASK && (ip = lz4_readlen(ip, iend, &len)) == 0)
+            return -1;
+        if (len <= 16 && iend - ip >= 16 && oend - op >= 16)    {
+            /* short literals: fixed size copy, bytes past len are overwritten later */
+            memcpy(op, ip, 16);
+        }   else    {
+            if (len > (size_t)(iend - ip) || len > (size_t)(oend - op))
+                return -1;
+            memcpy(op, ip, len);
+        }
+        op += len;
+        ip += len;
+
+        /* last sequence has no match part */
+        if (ip == iend)
+            break;
+
+        /* match */
+        if (iend - ip < 2)
+            return -1;
+        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - ostart))
+            return -1;
+
+        len = token & LZ4_ML_MASK;
+        if (len == LZ4_ML_MASK && (ip = lz4_readlen(ip, iend, &len)) == 0)
+            return -1;
+        len += LZ4_MINMATCH;
+        if (len > (size_t)(oend - op))
+            return -1;
+        if (ip >= iend)
+            return -1;
+
+        const lz4_byte* match = op - offset;
+        if (offset >= 8 && (size_t)(oend - op) >= len + 8)  {
+            /* copy in 8 byte chunks (each chunk is disjoint, even if the match overlaps),
+             * may write up to 7 bytes past the match, which are overwritten later */
+            lz4_byte* mend = op + len;
+            do  {
+                memcpy(op, match, 8);
+                op += 8;
+                match += 8;
+            }   while (op < mend);
+            op = mend;
+        }   else if (offset >= len)  {
+            memcpy(op, match, len);
+            op += len;
+        }   else    {
+            /* short repeating pattern */
+            lz4_byte* mend = op + len;
+            while (op < mend)
+                *op++ = *match++;
+        }
+    }
+
+    return (int)(op - ostart);
+}
@@ -0,0 +1,40 @@
+/*
+ * lz4.h - compact LZ4 block format codec
+ *
+ * Implements the LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md)
+ * with a subset of the reference library's API, so output is readable by any LZ4 decoder and
+ * the reference lz4.c can be dropped in as a replacement.
+ *
+ * Compressor is a single-pass greedy matcher with a 4096 entry hash table (16kb on stack).
+ * Decompressor validates every sequence, it never reads or writes outside the given buffers.
+ *
+ * This file is placed in the public domain.
+ */
+
+#ifndef LZ4_H_
+#define LZ4_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LZ4_MAX_INPUT_SIZE  0x7E000000   /* 2 113 929 216 bytes */
+#define LZ4_COMPRESSBOUND(isize)  \
+    ((unsigned)(isize) > (unsigned)LZ4_MAX_INPUT_SIZE ? 0 : (isize) + ((isize)/255) + 16)
+
+/* maximum size of the compressed data in the worst case (incompressible input) */
+int LZ4_compressBound(int inputSize);
+
+/* compresses srcSize bytes from src into dst, which has dstCapacity bytes
+ * returns number of bytes written into dst, or 0 if compression fails (dst is too small) */
+int LZ4_compress_default(const char* src, char* dst, int srcSize, int dstCapacity);
+
+/* decompresses compressedSize bytes from src into dst, which has dstCapacity bytes
+ * returns number of bytes decompressed into dst, or a negative value if data is malformed */
+int LZ4_decompress_safe(const char* src, char* dst, int compressedSize, int dstCapacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LZ4_H_ */
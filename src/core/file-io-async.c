@@ -0,0 +1,331 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#include "dhcore/file-io.h"
+#include "dhcore/mt.h"
+#include "dhcore/err.h"
+#include "dhcore/log.h"
+#include "dhcore/str.h"
+#include "dhcore/slot-map.h"
+#include "dhcore/ring-queue.h"
+
+/* asynchronous loads: requests are kept in a slot-map (guarded by mutex), their handles are passed
+ * through lock-free queues: pending queues (one per priority) to I/O threads, and completion queue
+ * back to the thread that calls fio_async_update */
+
+/*************************************************************************************************
+ * types
+ */
+enum fio_async_state
+{
+    FIO_ASYNC_QUEUED = 0,
+    FIO_ASYNC_LOADING,
+    FIO_ASYNC_DONE,
+    FIO_ASYNC_CANCELED
+};
+
+struct fio_async_req
+{
+    char filepath[DH_PATH_MAX];
+    struct allocator* alloc;
+    uint mem_id;
+    int ignore_vfs;
+    enum fio_async_state state;
+    pfn_fio_async callback;
+    void* param;
+    file_t file;
+};
+
+struct fio_async_thread
+{
+    mt_thread t;
+    uint signal_id;
+};
+
+struct fio_async_mgr
+{
+    mt_mutex mtx;
+    struct slot_map reqs;   /* item: fio_async_req */
+    struct ring_queue pending[FIO_ASYNC_PRIORITY_CNT];  /* item: reshandle_t */
+    struct ring_queue completed;    /* item: reshandle_t */
+    mt_event ev;
+    struct fio_async_thread* threads;
+    int thread_cnt;
+    int max_requests;
+    int volatile quit;
+};
+
+/*************************************************************************************************
+ * globals
+ */
+static struct fio_async_mgr* g_fio_async = NULL;
+
+/*************************************************************************************************/
+static int fio_async_popreq(reshandle_t* phdl)
+{
+    for (int i = FIO_ASYNC_PRIORITY_CNT - 1; i >= 0; i--)   {
+        if (ringq_pop(&g_fio_async->pending[i], phdl))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static result_t fio_async_kernel(mt_thread thread)
+{
+    struct fio_async_thread* at = (struct fio_async_thread*)mt_thread_getparam1(thread);
+    reshandle_t hdl;
+    char filepath[DH_PATH_MAX];
+
+    if (g_fio_async->quit)
+        return RET_ABORT;
+
+    if (!fio_async_popreq(&hdl))   {
+        mt_event_wait(g_fio_async->ev, at->signal_id, MT_TIMEOUT_INFINITE);
+        return g_fio_async->quit ? RET_ABORT : RET_OK;
+    }
+
+    /* copy request data, so the mutex is not held while loading */
+    mt_mutex_lock(&g_fio_async->mtx);
+    struct fio_async_req* req = (struct fio_async_req*)slotmap_get(&g_fio_async->reqs, hdl, 0);
+    ASSERT(req);
+    int canceled = (req->state == FIO_ASYNC_CANCELED);
+    struct allocator* alloc = req->alloc;
+    uint mem_id = req->mem_id;
+    int ignore_vfs = req->ignore_vfs;
+    if (!canceled)  {
+        strcpy(filepath, req->filepath);
+        req->state = FIO_ASYNC_LOADING;
+    }
+    mt_mutex_unlock(&g_fio_async->mtx);
+
+    if (!canceled)  {
+        file_t f = fio_openmem(alloc, filepath, ignore_vfs, mem_id);
+
+        mt_mutex_lock(&g_fio_async->mtx);
+        req = (struct fio_async_req*)slotmap_get(&g_fio_async->reqs, hdl, 0);
+        req->file = f;
+        if (req->state != FIO_ASYNC_CANCELED)
+            req->state = FIO_ASYNC_DONE;
+        mt_mutex_unlock(&g_fio_async->mtx);
+    }
+
+    /* completed queue has room for all requests, so push never fails */
+    ringq_push(&g_fio_async->completed, &hdl);
+    return RET_OK;
+}
+
+result_t fio_async_initmgr(int thread_cnt, int max_requests)
+{
+    ASSERT(thread_cnt > 0);
+    ASSERT(max_requests > 0);
+
+    if (g_fio_async != NULL)
+        return RET_FAIL;
+
+    struct fio_async_mgr* mgr = (struct fio_async_mgr*)ALLOC(sizeof(struct fio_async_mgr), 0);
+    if (mgr == NULL)
+        return RET_OUTOFMEMORY;
+    memset(mgr, 0x00, sizeof(struct fio_async_mgr));
+    g_fio_async = mgr;
+
+    result_t r;
+    mt_mutex_init(&mgr->mtx);
+    mgr->max_requests = max_requests;
+
+    const int req_size = sizeof(struct fio_async_req);
+    r = slotmap_create(mem_heap(), &mgr->reqs, &req_size, 1, max_requests, 1, 0);
+    if (IS_FAIL(r)) {
+        err_printn(__FILE__, __LINE__, r);
+        fio_async_releasemgr();
+        return r;
+    }
+
+    for (int i = 0; i < FIO_ASYNC_PRIORITY_CNT; i++)    {
+        r = ringq_create(mem_heap(), &mgr->pending[i], RINGQ_MPMC, sizeof(reshandle_t),
+                         max_requests, 0);
+        if (IS_FAIL(r)) {
+            err_printn(__FILE__, __LINE__, r);
+            fio_async_releasemgr();
+            return r;
+        }
+    }
+
+    r = ringq_create(mem_heap(), &mgr->completed, RINGQ_MPSC, sizeof(reshandle_t), max_requests,
+                     0);
+    if (IS_FAIL(r)) {
+        err_printn(__FILE__, __LINE__, r);
+        fio_async_releasemgr();
+        return r;
+    }
+
+    mgr->ev = mt_event_create(mem_heap());
+    mgr->threads = (struct fio_async_thread*)ALLOC(sizeof(struct fio_async_thread)*thread_cnt, 0);
+    if (mgr->ev == NULL || mgr->threads == NULL)  {
+        err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+        fio_async_releasemgr();
+        return RET_OUTOFMEMORY;
+    }
+    memset(mgr->threads, 0x00, sizeof(struct fio_async_thread)*thread_cnt);
+
+    /* signals must be added before threads start waiting on them */
+    for (int i = 0; i < thread_cnt; i++)
+        mgr->threads[i].signal_id = mt_event_addsignal(mgr->ev);
+
+    for (int i = 0; i < thread_cnt; i++)    {
+        struct fio_async_thread* at = &mgr->threads[i];
+        at->t = mt_thread_create(fio_async_kernel, NULL, NULL, MT_THREAD_NORMAL, 0, 0, at, NULL);
+        if (at->t == NULL)  {
+            err_print(__FILE__, __LINE__, "file-mgr: creating async I/O thread failed");
+            fio_async_releasemgr();
+            return RET_FAIL;
+        }
+        mgr->thread_cnt++;
+    }
+
+    log_printf(LOG_INFO, "  Async file loading: %d threads, %d max requests", thread_cnt,
+        max_requests);
+    return RET_OK;
+}
+
+void fio_async_releasemgr()
+{
+    struct fio_async_mgr* mgr = g_fio_async;
+    if (mgr == NULL)
+        return;
+
+    /* wake up and stop I/O threads */
+    mgr->quit = TRUE;
+    for (int i = 0; i < mgr->thread_cnt; i++)
+        mt_event_trigger(mgr->ev, mgr->threads[i].signal_id);
+    for (int i = 0; i < mgr->thread_cnt; i++)
+        mt_thread_destroy(mgr->threads[i].t);
+
+    /* close files of undelivered requests */
+    for (int i = 0; i < SLOTMAP_COUNT(mgr->reqs); i++)  {
+        struct fio_async_req* req = &SLOTMAP_STREAM(mgr->reqs, struct fio_async_req, 0)[i];
+        if (req->file != NULL)
+            fio_close(req->file);
+    }
+
+    if (mgr->threads != NULL)
+        FREE(mgr->threads);
+    if (mgr->ev != NULL)
+        mt_event_destroy(mgr->ev);
+    ringq_destroy(&mgr->completed);
+    for (int i = 0; i < FIO_ASYNC_PRIORITY_CNT; i++)
+        ringq_destroy(&mgr->pending[i]);
+    slotmap_destroy(&mgr->reqs);
+    mt_mutex_release(&mgr->mtx);
+
+    FREE(mgr);
+    g_fio_async = NULL;
+}
+
+reshandle_t fio_openmem_async(struct allocator* alloc, const char* filepath, int ignore_vfs,
+                              uint mem_id, enum fio_async_priority pr,
+                              pfn_fio_async callback, void* param)
+{
+    ASSERT(g_fio_async);
+    ASSERT(callback);
+    ASSERT(pr < FIO_ASYNC_PRIORITY_CNT);
+
+    mt_mutex_lock(&g_fio_async->mtx);
+    if (SLOTMAP_COUNT(g_fio_async->reqs) >= g_fio_async->max_requests)   {
+        mt_mutex_unlock(&g_fio_async->mtx);
+        return INVALID_HANDLE;
+    }
+
+    reshandle_t hdl = slotmap_add(&g_fio_async->reqs);
+    if (hdl == INVALID_HANDLE)  {
+        mt_mutex_unlock(&g_fio_async->mtx);
+        return INVALID_HANDLE;
+    }
+
+    struct fio_async_req* req = (struct fio_async_req*)slotmap_get(&g_fio_async->reqs, hdl, 0);
+    memset(req, 0x00, sizeof(struct fio_async_req));
+    str_safecpy(req->filepath, sizeof(req->filepath), filepath);
+    req->alloc = alloc;
+    req->mem_id = mem_id;
+    req->ignore_vfs = ignore_vfs;
+    req->state = FIO_ASYNC_QUEUED;
+    req->callback = callback;
+    req->param = param;
+    mt_mutex_unlock(&g_fio_async->mtx);
+
+    /* pending queues have room for all requests, so push never fails */
+    ringq_push(&g_fio_async->pending[pr], &hdl);
+
+    /* wake up I/O threads, signals are sticky, so waking idle threads is cheap */
+    for (int i = 0; i < g_fio_async->thread_cnt; i++)
+        mt_event_trigger(g_fio_async->ev, g_fio_async->threads[i].signal_id);
+
+    return hdl;
+}
+
+int fio_async_cancel(reshandle_t req)
+{
+    ASSERT(g_fio_async);
+
+    mt_mutex_lock(&g_fio_async->mtx);
+    struct fio_async_req* r = (struct fio_async_req*)slotmap_get(&g_fio_async->reqs, req, 0);
+    /* requests that are taken by I/O threads are delivered */
+    int canceled = (r != NULL && r->state == FIO_ASYNC_QUEUED);
+    if (canceled)
+        r->state = FIO_ASYNC_CANCELED;
+    mt_mutex_unlock(&g_fio_async->mtx);
+
+    return canceled;
+}
+
+int fio_async_update()
+{
+    ASSERT(g_fio_async);
+
+    reshandle_t hdls[32];
+    struct fio_async_req req;
+    int delivered = 0;
+    int cnt;
+
+    while ((cnt = ringq_pop_batch(&g_fio_async->completed, hdls, 32)) > 0)  {
+        for (int i = 0; i < cnt; i++)   {
+            mt_mutex_lock(&g_fio_async->mtx);
+            struct fio_async_req* r = (struct fio_async_req*)slotmap_get(&g_fio_async->reqs,
+                hdls[i], 0);
+            ASSERT(r);
+            memcpy(&req, r, sizeof(req));
+            slotmap_remove(&g_fio_async->reqs, hdls[i]);
+            mt_mutex_unlock(&g_fio_async->mtx);
+
+            if (req.state != FIO_ASYNC_CANCELED)    {
+                req.callback(req.file, req.filepath, hdls[i], req.param);
+                delivered++;
+            }   else if (req.file != NULL)  {
+                fio_close(req.file);
+            }
+        }
+    }
+
+    return delivered;
+}
+
+int fio_async_pending()
+{
+    ASSERT(g_fio_async);
+
+    mt_mutex_lock(&g_fio_async->mtx);
+    int cnt = SLOTMAP_COUNT(g_fio_async->reqs);
+    mt_mutex_unlock(&g_fio_async->mtx);
+    return cnt;
+}
@@ -20,11 +20,15 @@
 #include "dhcore/numeric.h"
 #include "dhcore/str.h"
 #include "dhcore/pak-file.h"
+#include "dhcore/pak-file-fmt.h"
+#include "dhcore/zip.h"
 #include "dhcore/log.h"
 #include "dhcore/hash-table.h"
+#include "dhcore/hash.h"
 #include "dhcore/mt.h"
 #include "dhcore/util.h"
 #include "dhcore/path.h"
+#include "dhcore/timer.h"
 
 #if defined(_FILEMON_)
 /* You'll need 3rdparty EFSW library (forked): https://bitbucket.org/sepul/efsw */
@@ -33,9 +37,32 @@
 #undef EFSW_DYNAMIC
 #endif
 
+/* without efsw, linux uses native inotify backend (platform/linux/filemon-lnx.c) */
+#if defined(_LINUX_) && !defined(_FILEMON_)
+#define FIO_MON_INOTIFY
+#endif
+
+#if defined(_FILEMON_) || defined(FIO_MON_INOTIFY)
+#define FIO_MON_ENABLED
+#endif
+
 #define MEM_BLOCK_SIZE 4096
-#define MON_BUFFER_SIZE (256*1024)
+#define MEM_CHUNK_SIZE (64*1024)
+#define MEM_CHUNK_CACHE 64  /* maximum number of free blocks that are kept for chunked files */
+#define DISK_BUFFER_SIZE (128*1024)
 #define MON_ITEM_SIZE 200
+#define MON_PENDING_SIZE 509
+#define MON_POOL_BLOCK 256
+#define MON_DEBOUNCE 100    /* default debounce window (msecs) */
+#define MON_MAX_DELAY 10    /* continuous changes are delivered after MON_MAX_DELAY*debounce */
+#define VDIR_INDEX_SIZE 1024
+#define VDIR_POOL_BLOCK 1024
+#define VDIR_MISSES_MAX 4096
+#define VDIR_CHECK_SEED 3571
+#define PATH_TABLE_SIZE 1021
+#define PATH_POOL_BLOCK 512
+#define PAK_INDEX_SIZE 1024
+#define PAK_POOL_BLOCK 1024
 
 // Fwd declare: IOS
 #ifdef _IOS_
@@ -43,6 +70,15 @@ int fio_ios_add_bundle(const char *bundle_name);
 const char* fio_ios_resolve_path(char *outstr, int outstr_sz, int bundle_id, const char *filepath);
 #endif
 
+// Fwd declare: inotify
+#if defined(FIO_MON_INOTIFY)
+typedef void (*pfn_fio_lnx_mon)(const char* filepath, int modified, int listing, void* param);
+int fio_lnx_mon_addwatch(const char* dir);
+void fio_lnx_mon_removewatch(int root_id);
+void fio_lnx_mon_poll(pfn_fio_lnx_mon fn, void* param);
+void fio_lnx_mon_release();
+#endif
+
 /*************************************************************************************************
  * types
  */
@@ -57,15 +93,43 @@ struct vdir
 
 #if defined(_FILEMON_)
     efsw_watchid watchid;
-    mt_mutex mtx;
-    void* volatile backbuff;
-    void* volatile frontbuff;
-    struct array backarr;  /* item: char[DH_PATH_MAX] */
-    struct array frontarr; /* item: char[DH_PATH_MAX] */
+#elif defined(FIO_MON_INOTIFY)
+    int watchid;
 #endif
 };
 
-#if defined(_FILEMON_)
+/* interned path of open files, files that are opened with the same path share it */
+struct fio_path
+{
+    uint key;   /* hash_str(str) */
+    uint refcnt;
+    int shared; /* path is in the path table, FALSE for paths with colliding hashes */
+    char str[1];
+};
+
+/* vdir index entry, check is a second hash of the path for rejecting hash_str collisions */
+struct vdir_entry
+{
+    uint key;
+    uint check;
+    uint vdir_idx;
+};
+
+/* paks that are added to file-mgr, layers with higher priority override the lower ones */
+struct pak_layer
+{
+    struct pak_file* pak;
+    int priority;
+};
+
+/* merged pak index entry, highest priority pak that contains the path */
+struct pak_entry_ref
+{
+    struct pak_file* pak;
+    uint file_id;
+};
+
+#if defined(FIO_MON_ENABLED)
 struct mon_item
 {
     pfn_fio_modify fn;
@@ -73,6 +137,13 @@ struct mon_item
     uptr_t param1;
     uptr_t param2;
 };
+
+/* modified file that is waiting for the debounce window to be delivered */
+struct mon_event
+{
+    char filepath[DH_PATH_MAX];
+    uint key;   /* hash_str(filepath) */
+};
 #endif
 
 /**
@@ -83,12 +154,53 @@ struct file_mgr
 {
     mt_mutex diskfile_mtx;
     mt_mutex memfile_mtx;
+    mt_mutex mmapfile_mtx;
+    mt_mutex chunkfile_mtx;
+    mt_mutex streamfile_mtx;
 
     struct pool_alloc diskfile_alloc;
     struct pool_alloc memfile_alloc;
+    struct pool_alloc mmapfile_alloc;
+    struct pool_alloc chunkfile_alloc;
+    struct pool_alloc streamfile_alloc;
+    uint8* free_chunks;   /* free blocks of chunked files, linked by their first bytes */
+    int free_chunks_cnt;
+    size_t disk_buffsize;   /* buffer size of disk files, 0 if they are not buffered */
+    size_t disk_directsize; /* disk files larger than this are read with direct I/O, 0 to disable */
     struct array vdirs;   /* item: vdir */
-    struct array paks;    /* item: pak_file */
-    struct hashtable_open mon_table;    /* key: filepath(hashed), value: pointer to mon_item */
+    struct array paks;    /* item: pak_layer, highest priority first */
+    struct hashtable_chained pak_index; /* key: hash_str(filepath), value: index to pak_entries */
+    struct array pak_entries;   /* item: pak_entry_ref */
+    struct pool_alloc pak_index_pool;   /* items of pak_index */
+    struct allocator pak_index_alloc;
+    struct array zips;    /* item: zip_t */
+    mt_mutex vdir_mtx;    /* protects vdir index and misses, resolving paths is thread-safe */
+    struct hashtable_chained vdir_index; /* key: hash_str(filepath), value: index to vdir_entries */
+    struct array vdir_entries;  /* item: vdir_entry */
+    struct hashtable_chained vdir_misses;  /* negative lookups, key: hash_str(filepath), value: check */
+    struct pool_alloc vdir_index_pool;  /* items of vdir_index */
+    struct pool_alloc vdir_misses_pool; /* items of vdir_misses */
+    struct allocator vdir_index_alloc;
+    struct allocator vdir_misses_alloc;
+    atom_t vdir_dirty;    /* index must be rebuilt on next lookup (vdirs or their files changed) */
+    mt_mutex path_mtx;    /* protects interned paths, files are opened and closed from any thread */
+    struct hashtable_chained path_table;  /* key: hash_str(path), value: fio_path* */
+    struct pool_alloc path_pool;  /* items of path_table */
+    struct allocator path_pool_alloc;
+#if defined(FIO_MON_ENABLED)
+    struct hashtable_chained mon_table; /* key: filepath(hashed), value: pointer to mon_item */
+    struct pool_alloc mon_table_pool;   /* items of mon_table */
+    struct allocator mon_table_alloc;
+    mt_mutex mon_mtx;     /* protects pending events, efsw reports changes from it's own thread */
+    struct array mon_events;  /* item: mon_event, pending changes */
+    struct array mon_batch;   /* item: mon_event, changes that are being delivered */
+    struct hashtable_chained mon_pending;  /* key: hash_str(filepath), value: index to mon_events */
+    struct pool_alloc mon_pending_pool;   /* items of mon_pending */
+    struct allocator mon_pending_alloc;
+    uint64 mon_first_tick;  /* first change of the pending batch */
+    uint64 mon_last_tick;   /* last change of the pending batch */
+    uint mon_debounce;    /* msecs */
+#endif
 #ifdef _MOBILE_
     struct array bundles;
 #endif
@@ -100,7 +212,7 @@ struct file_mgr
 struct file_header
 {
     enum file_type type;
-    char path[DH_PATH_MAX];
+    struct fio_path* path;
     size_t size;
     enum file_mode mode;
     pfnio_file_read read_fn;
@@ -109,7 +221,14 @@ struct file_header
 
 struct disk_file
 {
-    FILE* file;
+    iptr_t fd;
+    uint8* buffer;  /* aligned (UTIL_FD_ALIGN), read-ahead data (read) or pending data (write) */
+    void* buffer_raw;   /* allocated pointer of the buffer */
+    size_t buffer_size;
+    size_t buffer_len;  /* valid bytes in the buffer */
+    uint64 buffer_offset;   /* file offset of the buffer data */
+    uint64 offset;
+    int direct; /* opened with direct I/O, reads must be aligned */
 };
 
 struct mem_file
@@ -121,26 +240,103 @@ struct mem_file
     uint mem_id;
 };
 
+struct chunk_file
+{
+    struct allocator* alloc;    /* allocator of the flattened buffer (fio_detachmem) */
+    struct array chunks;    /* item: uint8*, blocks of MEM_CHUNK_SIZE bytes */
+    size_t offset;
+    uint mem_id;
+};
+
+struct mmap_file
+{
+    const uint8* data;
+    size_t offset;
+    int owner;  /* data is mapped by the file itself and must be unmapped on close */
+    pfn_fio_closeview close_fn; /* called on close, for views that reference owned data */
+    void* close_param;
+};
+
+struct stream_file
+{
+    pfn_fio_readstream read_fn;
+    pfn_fio_closestream close_fn;
+    void* param;
+    size_t offset;
+};
+
 /*************************************************************************************************/
 /* callbacks for directory monitoring */
-#if defined(_FILEMON_)
+#if defined(FIO_MON_ENABLED)
+static result_t fio_mon_initmgr();
+static void fio_mon_releasemgr();
 static int fio_vdir_initmon(struct vdir* vd);
 static void fio_vdir_releasemon(struct vdir* vd);
 #endif
 
 static size_t fio_readdisk(file_t f, void* buffer, size_t item_size, size_t items_cnt);
 static size_t fio_writedisk(file_t f, const void* buffer, size_t item_size, size_t items_cnt);
+static size_t fio_readvdisk(file_t f, const struct fio_iovec* iov, int cnt);
 static size_t fio_readmem(file_t f, void* buffer, size_t item_size, size_t items_cnt);
 static size_t fio_writemem(file_t f, const void* buffer, size_t item_size, size_t items_cnt);
+static size_t fio_readmmap(file_t f, void* buffer, size_t item_size, size_t items_cnt);
+static size_t fio_readchunks(file_t f, void* buffer, size_t item_size, size_t items_cnt);
+static size_t fio_writechunks(file_t f, const void* buffer, size_t item_size, size_t items_cnt);
+static size_t fio_readstream(file_t f, void* buffer, size_t item_size, size_t items_cnt);
 
-/* resolve and open a filepath from the disk */
-static FILE* open_resolvepath(const char* filepath);
+/* resolve a filepath from the disk */
+static const char* fio_resolvepath(char* outpath, const char* filepath);
+static void fio_vdir_buildindex();
+static void fio_pak_clearindex();
 
 
 /*************************************************************************************************
  * globals
  */
 static struct file_mgr* g_fio = NULL;
+static struct fio_path g_fio_nopath = {0, 0, FALSE, ""};  /* used if interning fails (no memory) */
+
+/* returns shared copy of the path, or adds a new one, must be released with fio_path_release */
+static struct fio_path* fio_path_intern(const char* path)
+{
+    uint key = hash_str(path);
+
+    mt_mutex_lock(&g_fio->path_mtx);
+    struct hashtable_item_chained* item = hashtable_chained_find(&g_fio->path_table, key);
+    struct fio_path* p = item != NULL ? (struct fio_path*)item->value : NULL;
+    if (p != NULL && str_isequal(p->str, path)) {
+        p->refcnt++;
+    }   else    {
+        size_t len = strlen(path);
+        struct fio_path* np = (struct fio_path*)A_ALLOC(mem_heap(), sizeof(struct fio_path) + len, 0);
+        if (np != NULL) {
+            np->key = key;
+            np->refcnt = 1;
+            np->shared = p == NULL &&
+                IS_OK(hashtable_chained_add(&g_fio->path_table, key, (iptr_t)np));
+            memcpy(np->str, path, len + 1);
+        }
+        p = np != NULL ? np : &g_fio_nopath;
+    }
+    mt_mutex_unlock(&g_fio->path_mtx);
+    return p;
+}
+
+static void fio_path_release(struct fio_path* p)
+{
+    if (p == NULL || p == &g_fio_nopath)
+        return;
+
+    mt_mutex_lock(&g_fio->path_mtx);
+    if (--p->refcnt == 0)   {
+        if (p->shared)  {
+            hashtable_chained_remove(&g_fio->path_table,
+                                     hashtable_chained_find(&g_fio->path_table, p->key));
+        }
+        A_FREE(mem_heap(), p);
+    }
+    mt_mutex_unlock(&g_fio->path_mtx);
+}
 
 //
 static uint8* fio_alloc_diskbuff()
@@ -159,8 +355,33 @@ static uint8* fio_alloc_membuff()
     return ptr;
 }
 
+static uint8* fio_alloc_mmapbuff()
+{
+    mt_mutex_lock(&g_fio->mmapfile_mtx);
+    uint8 *ptr = (uint8*)mem_pool_alloc(&g_fio->mmapfile_alloc);
+    mt_mutex_unlock(&g_fio->mmapfile_mtx);
+    return ptr;
+}
+
+static uint8* fio_alloc_chunkbuff()
+{
+    mt_mutex_lock(&g_fio->chunkfile_mtx);
+    uint8 *ptr = (uint8*)mem_pool_alloc(&g_fio->chunkfile_alloc);
+    mt_mutex_unlock(&g_fio->chunkfile_mtx);
+    return ptr;
+}
+
+static uint8* fio_alloc_streambuff()
+{
+    mt_mutex_lock(&g_fio->streamfile_mtx);
+    uint8 *ptr = (uint8*)mem_pool_alloc(&g_fio->streamfile_alloc);
+    mt_mutex_unlock(&g_fio->streamfile_mtx);
+    return ptr;
+}
+
 static void fio_free_diskbuff(uint8 *buff)
 {
+    fio_path_release(((struct file_header*)buff)->path);
     mt_mutex_lock(&g_fio->diskfile_mtx);
     mem_pool_free(&g_fio->diskfile_alloc, buff);
     mt_mutex_unlock(&g_fio->diskfile_mtx);
@@ -168,11 +389,67 @@ static void fio_free_diskbuff(uint8 *buff)
 
 static void fio_free_membuff(uint8 *buff)
 {
+    fio_path_release(((struct file_header*)buff)->path);
     mt_mutex_lock(&g_fio->memfile_mtx);
     mem_pool_free(&g_fio->memfile_alloc, buff);
     mt_mutex_unlock(&g_fio->memfile_mtx);
 }
 
+static void fio_free_mmapbuff(uint8 *buff)
+{
+    fio_path_release(((struct file_header*)buff)->path);
+    mt_mutex_lock(&g_fio->mmapfile_mtx);
+    mem_pool_free(&g_fio->mmapfile_alloc, buff);
+    mt_mutex_unlock(&g_fio->mmapfile_mtx);
+}
+
+static void fio_free_chunkbuff(uint8 *buff)
+{
+    fio_path_release(((struct file_header*)buff)->path);
+    mt_mutex_lock(&g_fio->chunkfile_mtx);
+    mem_pool_free(&g_fio->chunkfile_alloc, buff);
+    mt_mutex_unlock(&g_fio->chunkfile_mtx);
+}
+
+static void fio_free_streambuff(uint8 *buff)
+{
+    fio_path_release(((struct file_header*)buff)->path);
+    mt_mutex_lock(&g_fio->streamfile_mtx);
+    mem_pool_free(&g_fio->streamfile_alloc, buff);
+    mt_mutex_unlock(&g_fio->streamfile_mtx);
+}
+
+/* blocks of chunked files, a few free blocks are kept for reuse, rest is returned to the heap */
+static uint8* fio_alloc_chunk()
+{
+    mt_mutex_lock(&g_fio->chunkfile_mtx);
+    uint8* chunk = g_fio->free_chunks;
+    if (chunk != NULL)  {
+        g_fio->free_chunks = *((uint8**)chunk);
+        g_fio->free_chunks_cnt--;
+    }
+    mt_mutex_unlock(&g_fio->chunkfile_mtx);
+
+    if (chunk == NULL)
+        chunk = (uint8*)A_ALIGNED_ALLOC(mem_heap(), MEM_CHUNK_SIZE, 0);
+    return chunk;
+}
+
+static void fio_free_chunk(uint8* chunk)
+{
+    mt_mutex_lock(&g_fio->chunkfile_mtx);
+    if (g_fio->free_chunks_cnt < MEM_CHUNK_CACHE)   {
+        *((uint8**)chunk) = g_fio->free_chunks;
+        g_fio->free_chunks = chunk;
+        g_fio->free_chunks_cnt++;
+        chunk = NULL;
+    }
+    mt_mutex_unlock(&g_fio->chunkfile_mtx);
+
+    if (chunk != NULL)
+        A_ALIGNED_FREE(mem_heap(), chunk);
+}
+
 /*************************************************************************************************/
 result_t fio_initmgr()
 {
@@ -182,11 +459,15 @@ result_t fio_initmgr()
     if (g_fio == NULL)
         return RET_OUTOFMEMORY;
     memset(g_fio, 0x00, sizeof(struct file_mgr));
+    g_fio->disk_buffsize = DISK_BUFFER_SIZE;
 
     result_t r;
 
     mt_mutex_init(&g_fio->memfile_mtx);
     mt_mutex_init(&g_fio->diskfile_mtx);
+    mt_mutex_init(&g_fio->mmapfile_mtx);
+    mt_mutex_init(&g_fio->chunkfile_mtx);
+    mt_mutex_init(&g_fio->streamfile_mtx);
 
     r = mem_pool_create(mem_heap(), &g_fio->diskfile_alloc,
                         sizeof(struct file_header) + sizeof(struct disk_file), 32, 0);
@@ -202,18 +483,95 @@ result_t fio_initmgr()
         return r;
     }
 
+    r = mem_pool_create(mem_heap(), &g_fio->mmapfile_alloc,
+                        sizeof(struct file_header) + sizeof(struct mmap_file), 32, 0);
+    if (IS_FAIL(r))   {
+        err_printn(__FILE__, __LINE__, r);
+        return r;
+    }
+
+    r = mem_pool_create(mem_heap(), &g_fio->chunkfile_alloc,
+                        sizeof(struct file_header) + sizeof(struct chunk_file), 32, 0);
+    if (IS_FAIL(r))   {
+        err_printn(__FILE__, __LINE__, r);
+        return r;
+    }
+
+    r = mem_pool_create(mem_heap(), &g_fio->streamfile_alloc,
+                        sizeof(struct file_header) + sizeof(struct stream_file), 32, 0);
+    if (IS_FAIL(r))   {
+        err_printn(__FILE__, __LINE__, r);
+        return r;
+    }
+
     r = arr_create(mem_heap(), &g_fio->vdirs, sizeof(struct vdir), 5, 5, 0);
     if (IS_FAIL(r))     {
         err_printn(__FILE__, __LINE__, r);
         return r;
     }
 
-    r = arr_create(mem_heap(), &g_fio->paks, sizeof(struct pak_file*), 5, 5, 0);
+    r = arr_create(mem_heap(), &g_fio->paks, sizeof(struct pak_layer), 5, 5, 0);
+    if (IS_OK(r))   {
+        r = arr_create(mem_heap(), &g_fio->pak_entries, sizeof(struct pak_entry_ref),
+                       PAK_INDEX_SIZE, PAK_INDEX_SIZE, 0);
+    }
+    if (IS_OK(r))   {
+        r = mem_pool_create(mem_heap(), &g_fio->pak_index_pool,
+                            sizeof(struct hashtable_item_chained), PAK_POOL_BLOCK, 0);
+    }
+    if (IS_OK(r))
+        mem_pool_bindalloc(&g_fio->pak_index_pool, &g_fio->pak_index_alloc);
+    if (IS_FAIL(r))     {
+        err_printn(__FILE__, __LINE__, r);
+        return r;
+    }
+
+    r = arr_create(mem_heap(), &g_fio->zips, sizeof(zip_t), 5, 5, 0);
+    if (IS_FAIL(r))     {
+        err_printn(__FILE__, __LINE__, r);
+        return r;
+    }
+
+    mt_mutex_init(&g_fio->path_mtx);
+    r = mem_pool_create(mem_heap(), &g_fio->path_pool, sizeof(struct hashtable_item_chained),
+                        PATH_POOL_BLOCK, 0);
+    if (IS_OK(r))   {
+        mem_pool_bindalloc(&g_fio->path_pool, &g_fio->path_pool_alloc);
+        r = hashtable_chained_create(mem_heap(), &g_fio->path_pool_alloc, &g_fio->path_table,
+                                     PATH_TABLE_SIZE, 0);
+    }
     if (IS_FAIL(r))     {
         err_printn(__FILE__, __LINE__, r);
         return r;
     }
 
+    /* chained tables, because misses are common and they don't probe the whole table on misses */
+    mt_mutex_init(&g_fio->vdir_mtx);
+    r = mem_pool_create(mem_heap(), &g_fio->vdir_index_pool, sizeof(struct hashtable_item_chained),
+                        VDIR_POOL_BLOCK, 0);
+    if (IS_OK(r))   {
+        r = mem_pool_create(mem_heap(), &g_fio->vdir_misses_pool,
+                            sizeof(struct hashtable_item_chained), VDIR_POOL_BLOCK, 0);
+    }
+    if (IS_OK(r))   {
+        mem_pool_bindalloc(&g_fio->vdir_index_pool, &g_fio->vdir_index_alloc);
+        mem_pool_bindalloc(&g_fio->vdir_misses_pool, &g_fio->vdir_misses_alloc);
+        r = hashtable_chained_create(mem_heap(), &g_fio->vdir_index_alloc, &g_fio->vdir_index,
+                                     VDIR_INDEX_SIZE, 0);
+    }
+    if (IS_OK(r))   {
+        r = hashtable_chained_create(mem_heap(), &g_fio->vdir_misses_alloc, &g_fio->vdir_misses,
+                                     VDIR_MISSES_MAX, 0);
+    }
+    if (IS_OK(r))   {
+        r = arr_create(mem_heap(), &g_fio->vdir_entries, sizeof(struct vdir_entry),
+                       VDIR_INDEX_SIZE, VDIR_INDEX_SIZE, 0);
+    }
+    if (IS_FAIL(r)) {
+        err_printn(__FILE__, __LINE__, r);
+        return r;
+    }
+
 #ifdef _MOBILE_
     r = arr_create(mem_heap(), &g_fio->bundles, sizeof(int), 5, 5, 0);
     if (IS_FAIL(r)) {
@@ -222,8 +580,8 @@ result_t fio_initmgr()
     }
 #endif
 
-#if defined(_FILEMON_)
-    r = hashtable_open_create(mem_heap(), &g_fio->mon_table, MON_ITEM_SIZE, MON_ITEM_SIZE, 0);
+#if defined(FIO_MON_ENABLED)
+    r = fio_mon_initmgr();
     if (IS_FAIL(r)) {
         err_printn(__FILE__, __LINE__, r);
         return r;
@@ -236,42 +594,63 @@ result_t fio_initmgr()
 void fio_releasemgr()
 {
     if (g_fio != NULL)  {
-#if defined(_FILEMON_)
-        /* search for remaining registered monitor items and delete them */
-        int cnt = 0;
-        for (int i = 0; i < g_fio->mon_table.items_cnt; i++) {
-            struct hashtable_item* item = &g_fio->mon_table.items[i];
-            if (item->hash != 0)    {
-                struct mon_item* mitem = (struct mon_item*)item->value;
-                FREE(mitem);
-                cnt ++;
-            }
-        }
-  #if defined(_DEBUG_)
-        if (cnt > 0)
-            log_printf(LOG_INFO, "file-mgr: destroyed %d file monitors", cnt);
-  #endif
-#endif
+        fio_async_releasemgr();
 
         /* */
         fio_clearvdirs();
 
-#if defined(_FILEMON_)
-        if (g_fio->watcher != NULL)
-            efsw_destroy(g_fio->watcher);
+#if defined(FIO_MON_ENABLED)
+        fio_mon_releasemgr();
 #endif
 
 #ifdef _MOBILE_
         arr_destroy(&g_fio->bundles);
 #endif
 
-        hashtable_open_destroy(&g_fio->mon_table);
         arr_destroy(&g_fio->vdirs);
         arr_destroy(&g_fio->paks);
+        fio_pak_clearindex();
+        arr_destroy(&g_fio->pak_entries);
+        mem_pool_destroy(&g_fio->pak_index_pool);
+        arr_destroy(&g_fio->zips);
+        if (g_fio->vdir_index.pslots != NULL)
+            hashtable_chained_destroy(&g_fio->vdir_index);
+        hashtable_chained_destroy(&g_fio->vdir_misses);
+        mem_pool_destroy(&g_fio->vdir_index_pool);
+        mem_pool_destroy(&g_fio->vdir_misses_pool);
+        arr_destroy(&g_fio->vdir_entries);
+        mt_mutex_release(&g_fio->vdir_mtx);
+
+        /* paths of the files that are not closed */
+        if (g_fio->path_table.pslots != NULL)   {
+            for (int i = 0; i < g_fio->path_table.slots_cnt; i++)   {
+                for (struct linked_list* node = g_fio->path_table.pslots[i]; node != NULL;
+                     node = node->next)
+                {
+                    struct hashtable_item_chained* item =
+                        (struct hashtable_item_chained*)node->data;
+                    A_FREE(mem_heap(), (void*)item->value);
+                }
+            }
+            hashtable_chained_destroy(&g_fio->path_table);
+        }
+        mem_pool_destroy(&g_fio->path_pool);
+        mt_mutex_release(&g_fio->path_mtx);
         mt_mutex_release(&g_fio->memfile_mtx);
         mt_mutex_release(&g_fio->diskfile_mtx);
+        mt_mutex_release(&g_fio->mmapfile_mtx);
+        mt_mutex_release(&g_fio->chunkfile_mtx);
+        mt_mutex_release(&g_fio->streamfile_mtx);
         mem_pool_destroy(&g_fio->memfile_alloc);
         mem_pool_destroy(&g_fio->diskfile_alloc);
+        mem_pool_destroy(&g_fio->mmapfile_alloc);
+        mem_pool_destroy(&g_fio->chunkfile_alloc);
+        mem_pool_destroy(&g_fio->streamfile_alloc);
+        while (g_fio->free_chunks != NULL)  {
+            uint8* next = *((uint8**)g_fio->free_chunks);
+            A_ALIGNED_FREE(mem_heap(), g_fio->free_chunks);
+            g_fio->free_chunks = next;
+        }
 
         FREE(g_fio);
         g_fio = NULL;
@@ -299,8 +678,9 @@ int fio_addvdir(const char* directory, int monitor)
     memset(vd, 0x00, sizeof(struct vdir));
     vd->monitor = monitor;
     path_norm(vd->path, dir);
+    MT_ATOMIC_SET(g_fio->vdir_dirty, TRUE);
 
-#if defined(_FILEMON_)
+#if defined(FIO_MON_ENABLED)
     if (monitor)
         return fio_vdir_initmon(vd);
 #else
@@ -330,7 +710,7 @@ void fio_addbundle(const char *bundle_name)
 
 void fio_clearvdirs()
 {
-#if defined(_FILEMON_)
+#if defined(FIO_MON_ENABLED)
     for (int i = 0; i < g_fio->vdirs.item_cnt; i++)  {
         struct vdir* vd = &((struct vdir*)g_fio->vdirs.buffer)[i];
         if (vd->monitor)
@@ -338,21 +718,187 @@ void fio_clearvdirs()
     }
 #endif
     arr_clear(&g_fio->vdirs);
+    MT_ATOMIC_SET(g_fio->vdir_dirty, TRUE);
+}
+
+void fio_refreshvdirs()
+{
+    MT_ATOMIC_SET(g_fio->vdir_dirty, TRUE);
+}
+
+static void fio_pak_clearindex()
+{
+    if (g_fio->pak_index.pslots != NULL)    {
+        hashtable_chained_destroy(&g_fio->pak_index);
+        memset(&g_fio->pak_index, 0x00, sizeof(g_fio->pak_index));
+    }
+    arr_clear(&g_fio->pak_entries);
+}
+
+/* merges directories of the added paks into a single index, so opening a file is one lookup
+ * instead of probing every pak. the index is built aside and replaces the current one only if
+ * building succeeds */
+static result_t fio_pak_buildindex()
+{
+    const struct pak_layer* layers = (const struct pak_layer*)g_fio->paks.buffer;
+    int item_cnt = 0;
+    for (int i = 0; i < g_fio->paks.item_cnt; i++)
+        item_cnt += (int)layers[i].pak->item_cnt;
+    if (item_cnt == 0)  {
+        fio_pak_clearindex();
+        return RET_OK;
+    }
+
+    struct hashtable_chained index;
+    struct array entries;
+    memset(&index, 0x00, sizeof(index));
+    memset(&entries, 0x00, sizeof(entries));
+
+    /* table is sized by the number of items, so chains stay short */
+    result_t r = arr_create(mem_heap(), &entries, sizeof(struct pak_entry_ref), item_cnt,
+                            PAK_INDEX_SIZE, 0);
+    if (IS_OK(r))   {
+        r = hashtable_chained_create(mem_heap(), &g_fio->pak_index_alloc, &index,
+                                     maxi(item_cnt, PAK_INDEX_SIZE), 0);
+    }
+
+    /* layers are sorted by priority, so the first pak that contains the path wins
+     * paths are referenced by hash, same as pak_findfile */
+    for (int i = 0; i < g_fio->paks.item_cnt && IS_OK(r); i++) {
+        struct pak_file* pak = layers[i].pak;
+        for (uint k = 0; k < pak->item_cnt && IS_OK(r); k++)  {
+            uint key = hash_str(pak->strings + pak->items[k].path_offset);
+            if (hashtable_chained_find(&index, key) != NULL)
+                continue;
+
+            struct pak_entry_ref* e = (struct pak_entry_ref*)arr_add(&entries);
+            if (e == NULL)  {
+                r = RET_OUTOFMEMORY;
+                break;
+            }
+            e->pak = pak;
+            e->file_id = k + 1;
+            r = hashtable_chained_add(&index, key, entries.item_cnt - 1);
+        }
+    }
+
+    if (IS_FAIL(r)) {
+        if (index.pslots != NULL)
+            hashtable_chained_destroy(&index);
+        arr_destroy(&entries);
+        return r;
+    }
+
+    fio_pak_clearindex();
+    arr_destroy(&g_fio->pak_entries);
+    memcpy(&g_fio->pak_index, &index, sizeof(index));
+    memcpy(&g_fio->pak_entries, &entries, sizeof(entries));
+    return RET_OK;
+}
+
+/* looks up the merged index for the file, returns FALSE if none of the paks contain it
+ * if there is no index (building it failed), paks are probed by their priority */
+static int fio_pak_find(const char* filepath, OUT struct pak_entry_ref* ref)
+{
+    /* if path starts with '/' ignore the first char */
+    const char* rpath = (filepath[0] == '/') ? (filepath + 1) : filepath;
+
+    if (g_fio->pak_index.pslots == NULL)    {
+        const struct pak_layer* layers = (const struct pak_layer*)g_fio->paks.buffer;
+        for (int i = 0; i < g_fio->paks.item_cnt; i++) {
+            uint file_id = pak_findfile(layers[i].pak, rpath);
+            if (file_id != 0)   {
+                ref->pak = layers[i].pak;
+                ref->file_id = file_id;
+                return TRUE;
+            }
+        }
+        return FALSE;
+    }
+
+    struct hashtable_item_chained* item = hashtable_chained_find(&g_fio->pak_index,
+                                                                 hash_str(rpath));
+    if (item == NULL)
+        return FALSE;
+    *ref = ((const struct pak_entry_ref*)g_fio->pak_entries.buffer)[item->value];
+    return TRUE;
 }
 
 void fio_addpak(struct pak_file* pak)
+{
+    fio_addpak_layer(pak, 0);
+}
+
+result_t fio_addpak_layer(struct pak_file* pak, int priority)
 {
     ASSERT(pak);
     ASSERT(pak_isopen(pak));
 
-    struct pak_file** ppaks = (struct pak_file**)arr_add(&g_fio->paks);
-    ASSERT(ppaks);
-    *ppaks = pak;
+    struct pak_layer* layer = (struct pak_layer*)arr_add(&g_fio->paks);
+    if (layer == NULL)
+        return RET_OUTOFMEMORY;
+
+    /* keep layers sorted by priority (descending), paks with same priority keep the add order */
+    struct pak_layer* layers = (struct pak_layer*)g_fio->paks.buffer;
+    int idx = g_fio->paks.item_cnt - 1;
+    while (idx > 0 && layers[idx - 1].priority < priority)  {
+        layers[idx] = layers[idx - 1];
+        idx--;
+    }
+    layers[idx].pak = pak;
+    layers[idx].priority = priority;
+
+    /* current index stays valid if building the new one fails, so drop the layer */
+    result_t r = fio_pak_buildindex();
+    if (IS_FAIL(r)) {
+        memmove(&layers[idx], &layers[idx + 1],
+                (g_fio->paks.item_cnt - idx - 1)*sizeof(struct pak_layer));
+        g_fio->paks.item_cnt--;
+        err_printn(__FILE__, __LINE__, r);
+        return r;
+    }
+    return RET_OK;
+}
+
+void fio_removepak(struct pak_file* pak)
+{
+    struct pak_layer* layers = (struct pak_layer*)g_fio->paks.buffer;
+    for (int i = 0; i < g_fio->paks.item_cnt; i++) {
+        if (layers[i].pak == pak) {
+            memmove(&layers[i], &layers[i + 1],
+                    (g_fio->paks.item_cnt - i - 1)*sizeof(struct pak_layer));
+            g_fio->paks.item_cnt--;
+
+            /* current index references the removed pak, if building the new one fails, drop it
+             * and let lookups probe the remaining paks */
+            result_t r = fio_pak_buildindex();
+            if (IS_FAIL(r)) {
+                fio_pak_clearindex();
+                err_printn(__FILE__, __LINE__, r);
+            }
+            return;
+        }
+    }
 }
 
 void fio_clearpaks()
 {
     arr_clear(&g_fio->paks);
+    fio_pak_clearindex();
+}
+
+void fio_addzip(zip_t zip)
+{
+    ASSERT(zip);
+
+    zip_t* pzips = (zip_t*)arr_add(&g_fio->zips);
+    ASSERT(pzips);
+    *pzips = zip;
+}
+
+void fio_clearzips()
+{
+    arr_clear(&g_fio->zips);
 }
 
 file_t fio_createmem(struct allocator* alloc, const char* name, uint mem_id)
@@ -368,7 +914,7 @@ file_t fio_createmem(struct allocator* alloc, const char* name, uint mem_id)
 
     /* header */
     header->type = FILE_TYPE_MEM;
-    strcpy(header->path, name);
+    header->path = fio_path_intern(name);
     header->size = 0;
     header->mode = FILE_MODE_WRITE;
     header->write_fn = fio_writemem;
@@ -388,6 +934,45 @@ file_t fio_createmem(struct allocator* alloc, const char* name, uint mem_id)
     return file_buf;
 }
 
+file_t fio_createmem_chunked(struct allocator* alloc, const char* name, uint mem_id)
+{
+    uint8* file_buf = (uint8*)fio_alloc_chunkbuff();
+
+    if (file_buf == NULL)
+        return NULL;
+    memset(file_buf, 0x00, g_fio->chunkfile_alloc.item_sz);
+
+    struct file_header* header = (struct file_header*)file_buf;
+    struct chunk_file* f = (struct chunk_file*)(file_buf + sizeof(struct file_header));
+
+    /* header */
+    header->type = FILE_TYPE_CHUNKED;
+    header->path = fio_path_intern(name);
+    header->size = 0;
+    header->mode = FILE_MODE_WRITE;
+    header->write_fn = fio_writechunks;
+    header->read_fn = fio_readchunks;
+
+    /* data */
+    if (IS_FAIL(arr_create(mem_heap(), &f->chunks, sizeof(uint8*), 16, 64, mem_id)))  {
+        fio_free_chunkbuff(file_buf);
+        return NULL;
+    }
+    f->alloc = alloc;
+    f->offset = 0;
+    f->mem_id = mem_id;
+
+    return file_buf;
+}
+
+static void fio_releasechunks(struct chunk_file* fdata)
+{
+    uint8** chunks = (uint8**)fdata->chunks.buffer;
+    for (int i = 0; i < fdata->chunks.item_cnt; i++)
+        fio_free_chunk(chunks[i]);
+    arr_destroy(&fdata->chunks);
+}
+
 char* fio_loadtext(struct allocator *alloc, const char *filepath, int ignore_vfs, uint mem_id,
                    OUT OPTIONAL size_t *size)
 {
@@ -415,12 +1000,17 @@ file_t fio_openmem(struct allocator* alloc, const char* filepath, int ignore_vfs
 {
     /* if memory file is requested and we have pak files, first try loading from paks */
     if (!ignore_vfs && !arr_isempty(&g_fio->paks))    {
-        struct pak_file** paks = (struct pak_file**)g_fio->paks.buffer;
-        uint paks_cnt = g_fio->paks.item_cnt;
-        for (uint i = 0; i < paks_cnt; i++)   {
-            uint file_id = pak_findfile(paks[i], filepath);
+        struct pak_entry_ref e;
+        if (fio_pak_find(filepath, &e))
+            return pak_getfile(e.pak, alloc, mem_heap(), e.file_id, mem_id);
+    }
+
+    if (!ignore_vfs && !arr_isempty(&g_fio->zips))    {
+        zip_t* zips = (zip_t*)g_fio->zips.buffer;
+        for (int i = 0; i < g_fio->zips.item_cnt; i++)  {
+            uint file_id = zip_findfile(zips[i], filepath);
             if (file_id != 0)
-                return pak_getfile(paks[i], alloc, mem_heap(), file_id, mem_id);
+                return zip_getfile_id(zips[i], file_id, alloc, mem_id);
         }
     }
 
@@ -433,36 +1023,37 @@ file_t fio_openmem(struct allocator* alloc, const char* filepath, int ignore_vfs
     struct file_header* header = (struct file_header*)file_buf;
     struct mem_file* f = (struct mem_file*)(file_buf + sizeof(struct file_header));
 
-    FILE* ff = !ignore_vfs ? open_resolvepath(filepath) : fopen(filepath, "rb");
-    if (ff == NULL)     {
+    char path[DH_PATH_MAX];
+    const char* diskpath = !ignore_vfs ? fio_resolvepath(path, filepath) : filepath;
+    uint64 size;
+    iptr_t fd = diskpath != NULL ?
+        util_openfd(diskpath, UTIL_FD_READ | UTIL_FD_SEQUENTIAL, &size) : UTIL_FD_INVALID;
+    if (fd == UTIL_FD_INVALID)  {
         fio_free_membuff(file_buf);
         return NULL;
     }
 
     /* header */
     header->type = FILE_TYPE_MEM;
-    strcpy(header->path, filepath);
+    header->path = fio_path_intern(filepath);
     header->mode = FILE_MODE_READ;
-
-    fseek(ff, 0, SEEK_END);
-    header->size = ftell(ff);
-    fseek(ff, 0, SEEK_SET);
+    header->size = (size_t)size;
     header->read_fn = fio_readmem;
 
     /* data */
     f->buffer = (uint8*)A_ALLOC(alloc, header->size+1, mem_id);
     if (f->buffer == NULL)  {
-        fclose(ff);
+        util_closefd(fd);
         fio_free_membuff(file_buf);
         return NULL;
     }
-    fread(f->buffer, header->size, 1, ff);
+    util_readfd(fd, f->buffer, header->size, 0);
     f->alloc = alloc;
     f->max_size = header->size;
     f->offset = 0;
     f->mem_id = mem_id;
 
-    fclose(ff);
+    util_closefd(fd);
     return file_buf;
 }
 
@@ -479,7 +1070,7 @@ file_t fio_attachmem(struct allocator* alloc, void* buffer,
 
     /* header  */
     header->type = FILE_TYPE_MEM;
-    strcpy(header->path, name);
+    header->path = fio_path_intern(name);
     header->mode = FILE_MODE_READ;
     header->size = size;
     header->read_fn = fio_readmem;
@@ -494,13 +1085,48 @@ file_t fio_attachmem(struct allocator* alloc, void* buffer,
     return file_buf;
 }
 
+/* copies blocks of the chunked file into one buffer, and releases the blocks */
+static void* fio_flattenchunks(file_t f, size_t* outsize, struct allocator** palloc)
+{
+    struct file_header* header = (struct file_header*)f;
+    struct chunk_file* fdata = (struct chunk_file*)((uint8*)f + sizeof(struct file_header));
+
+    *outsize = 0;
+    if (fdata->chunks.buffer == NULL || header->size == 0)
+        return NULL;
+
+    uint8* buffer = (uint8*)A_ALLOC(fdata->alloc, header->size, fdata->mem_id);
+    if (buffer == NULL) {
+        err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+        return NULL;
+    }
+
+    const uint8** chunks = (const uint8**)fdata->chunks.buffer;
+    for (size_t offset = 0, i = 0; offset < header->size; offset += MEM_CHUNK_SIZE, i++)
+        memcpy(buffer + offset, chunks[i], minsz(header->size - offset, MEM_CHUNK_SIZE));
+
+    *outsize = header->size;
+    if (palloc != NULL)
+        *palloc = fdata->alloc;
+
+    fio_releasechunks(fdata);
+    memset(fdata, 0x00, sizeof(struct chunk_file));
+    return buffer;
+}
+
 void* fio_detachmem(file_t f, size_t* outsize, struct allocator** palloc)
 {
     struct file_header* header = (struct file_header*)f;
     struct mem_file* fdata = (struct mem_file*)((uint8*)f + sizeof(struct file_header));
 
-    if (fdata->buffer == NULL)
+    if (header->type == FILE_TYPE_CHUNKED)
+        return fio_flattenchunks(f, outsize, palloc);
+
+    ASSERT(header->type == FILE_TYPE_MEM);
+    if (header->type != FILE_TYPE_MEM || fdata->buffer == NULL)  {
+        *outsize = 0;
         return NULL;
+    }
 
     void* buffer = fdata->buffer;
     *outsize = header->size;
@@ -512,28 +1138,223 @@ void* fio_detachmem(file_t f, size_t* outsize, struct allocator** palloc)
     return buffer;
 }
 
-file_t fio_createdisk(const char* filepath)
+result_t fio_savemem(file_t f, const char* filepath)
 {
-    uint8* file_buf = (uint8*)fio_alloc_diskbuff();
+    struct file_header* header = (struct file_header*)f;
+    ASSERT(header->type != FILE_TYPE_DSK && header->type != FILE_TYPE_STREAM);
+    if (header->type == FILE_TYPE_DSK || header->type == FILE_TYPE_STREAM)
+        return RET_INVALIDARG;
+
+    FILE* ff = fopen(filepath, "wb");
+    if (ff == NULL) {
+        err_printf(__FILE__, __LINE__, "could not open file '%s' for writing", filepath);
+        return RET_FILE_ERROR;
+    }
+
+    size_t write_sz;
+    if (header->type == FILE_TYPE_CHUNKED)  {
+        /* gather write blocks in batches, last block is partially filled */
+        struct chunk_file* fdata = (struct chunk_file*)((uint8*)f + sizeof(struct file_header));
+        const void** chunks = (const void**)fdata->chunks.buffer;
+        size_t sizes[64];
+        write_sz = 0;
+        for (size_t offset = 0, i = 0; offset < header->size; i += 64) {
+            int cnt = 0;
+            for (; cnt < 64 && offset < header->size; cnt++, offset += MEM_CHUNK_SIZE)
+                sizes[cnt] = minsz(header->size - offset, MEM_CHUNK_SIZE);
+            write_sz += util_writegather(ff, chunks + i, sizes, cnt);
+        }
+    }   else    {
+        write_sz = fwrite(fio_getptr(f), 1, header->size, ff);
+    }
+    fclose(ff);
+
+    if (write_sz != header->size)   {
+        err_printf(__FILE__, __LINE__, "writing file '%s' failed", filepath);
+        return RET_FILE_ERROR;
+    }
+    return RET_OK;
+}
 
+static file_t fio_createmmap(const void* data, size_t size, const char* name, int owner)
+{
+    uint8* file_buf = (uint8*)fio_alloc_mmapbuff();
     if (file_buf == NULL)
         return NULL;
-    memset(file_buf, 0x00, g_fio->diskfile_alloc.item_sz);
+    memset(file_buf, 0x00, g_fio->mmapfile_alloc.item_sz);
 
     struct file_header* header = (struct file_header*)file_buf;
-    struct disk_file* f = (struct disk_file*)(file_buf + sizeof(struct file_header));
+    struct mmap_file* f = (struct mmap_file*)(file_buf + sizeof(struct file_header));
 
     /* header */
-    header->type = FILE_TYPE_DSK;
-    header->mode = FILE_MODE_WRITE;
-    strcpy(header->path, filepath);
-    header->size = 0;
-    header->write_fn = fio_writedisk;
+    header->type = FILE_TYPE_MMAP;
+    header->path = fio_path_intern(name);
+    header->mode = FILE_MODE_READ;
+    header->size = size;
+    header->read_fn = fio_readmmap;
 
     /* data */
-    f->file = fopen(filepath, "wb");
-    if (f->file == NULL)    {
-        fio_free_diskbuff(file_buf);
+    f->data = (const uint8*)data;
+    f->offset = 0;
+    f->owner = owner;
+
+    return file_buf;
+}
+
+file_t fio_openmmap(const char* filepath, int ignore_vfs)
+{
+    if (!ignore_vfs && !arr_isempty(&g_fio->paks))    {
+        struct pak_entry_ref e;
+        if (fio_pak_find(filepath, &e))
+            return pak_getfile_mapped(e.pak, mem_heap(), mem_heap(), e.file_id, 0);
+    }
+
+    if (!ignore_vfs && !arr_isempty(&g_fio->zips))    {
+        zip_t* zips = (zip_t*)g_fio->zips.buffer;
+        for (int i = 0; i < g_fio->zips.item_cnt; i++)  {
+            uint file_id = zip_findfile(zips[i], filepath);
+            if (file_id != 0)
+                return zip_getfile_mapped(zips[i], file_id, mem_heap(), 0);
+        }
+    }
+
+    char resolved[DH_PATH_MAX];
+    const char* path = !ignore_vfs ? fio_resolvepath(resolved, filepath) : filepath;
+    if (path == NULL)
+        return NULL;
+
+    size_t size;
+    void* data = util_mapfile(path, &size);
+    if (data == NULL)
+        return NULL;
+
+    file_t f = fio_createmmap(data, size, filepath, TRUE);
+    if (f == NULL)
+        util_unmapfile(data, size);
+    return f;
+}
+
+file_t fio_createview(const void* data, size_t size, const char* name)
+{
+    ASSERT(data != NULL || size == 0);
+    return fio_createmmap(data, size, name, FALSE);
+}
+
+file_t fio_attachview(const void* data, size_t size, const char* name, pfn_fio_closeview close_fn,
+                      void* param)
+{
+    ASSERT(data != NULL || size == 0);
+    file_t f = fio_createmmap(data, size, name, FALSE);
+    if (f != NULL)  {
+        struct mmap_file* fdata = (struct mmap_file*)((uint8*)f + sizeof(struct file_header));
+        fdata->close_fn = close_fn;
+        fdata->close_param = param;
+    }
+    return f;
+}
+
+file_t fio_attachstream(size_t size, const char* name, pfn_fio_readstream read_fn,
+                        pfn_fio_closestream close_fn, void* param)
+{
+    ASSERT(read_fn != NULL);
+    uint8* file_buf = (uint8*)fio_alloc_streambuff();
+    if (file_buf == NULL)
+        return NULL;
+    memset(file_buf, 0x00, g_fio->streamfile_alloc.item_sz);
+
+    struct file_header* header = (struct file_header*)file_buf;
+    struct stream_file* f = (struct stream_file*)(file_buf + sizeof(struct file_header));
+
+    /* header */
+    header->type = FILE_TYPE_STREAM;
+    header->path = fio_path_intern(name);
+    header->mode = FILE_MODE_READ;
+    header->size = size;
+    header->read_fn = fio_readstream;
+
+    /* data */
+    f->read_fn = read_fn;
+    f->close_fn = close_fn;
+    f->param = param;
+    f->offset = 0;
+
+    return file_buf;
+}
+
+const void* fio_getptr(file_t f)
+{
+    struct file_header* header = (struct file_header*)f;
+    if (header->type == FILE_TYPE_MEM)  {
+        struct mem_file* fdata = (struct mem_file*)((uint8*)f + sizeof(struct file_header));
+        return fdata->buffer;
+    }   else if (header->type == FILE_TYPE_MMAP)    {
+        struct mmap_file* fdata = (struct mmap_file*)((uint8*)f + sizeof(struct file_header));
+        return fdata->data;
+    }
+    return NULL;
+}
+
+/* buffer is rounded up to UTIL_FD_ALIGN, size 0 leaves the file unbuffered */
+static int fio_disk_allocbuff(struct disk_file* f, size_t size)
+{
+    if (size == 0)
+        return TRUE;
+
+    size = (size + UTIL_FD_ALIGN - 1) & ~((size_t)UTIL_FD_ALIGN - 1);
+    f->buffer_raw = A_ALLOC(mem_heap(), size + UTIL_FD_ALIGN, 0);
+    if (f->buffer_raw == NULL)
+        return FALSE;
+    f->buffer = (uint8*)(((uptr_t)f->buffer_raw + UTIL_FD_ALIGN - 1) &
+                         ~((uptr_t)UTIL_FD_ALIGN - 1));
+    f->buffer_size = size;
+    return TRUE;
+}
+
+/* writes pending data of the disk file (write mode) */
+static int fio_disk_flush(struct disk_file* f)
+{
+    if (f->buffer_len == 0)
+        return TRUE;
+
+    size_t len = f->buffer_len;
+    f->buffer_len = 0;
+    return util_writefd(f->fd, f->buffer, len, f->buffer_offset) == len;
+}
+
+void fio_setdiskbuffer(size_t buffer_size, size_t direct_size)
+{
+    g_fio->disk_buffsize = buffer_size;
+    g_fio->disk_directsize = direct_size;
+}
+
+file_t fio_createdisk(const char* filepath)
+{
+    uint8* file_buf = (uint8*)fio_alloc_diskbuff();
+
+    if (file_buf == NULL)
+        return NULL;
+    memset(file_buf, 0x00, g_fio->diskfile_alloc.item_sz);
+
+    struct file_header* header = (struct file_header*)file_buf;
+    struct disk_file* f = (struct disk_file*)(file_buf + sizeof(struct file_header));
+
+    /* header */
+    header->type = FILE_TYPE_DSK;
+    header->mode = FILE_MODE_WRITE;
+    header->path = fio_path_intern(filepath);
+    header->size = 0;
+    header->write_fn = fio_writedisk;
+
+    /* data */
+    f->fd = util_openfd(filepath, UTIL_FD_WRITE, NULL);
+    if (f->fd == UTIL_FD_INVALID)   {
+        fio_free_diskbuff(file_buf);
+        return NULL;
+    }
+
+    if (!fio_disk_allocbuff(f, g_fio->disk_buffsize))  {
+        util_closefd(f->fd);
+        fio_free_diskbuff(file_buf);
         return NULL;
     }
 
@@ -554,53 +1375,162 @@ file_t fio_opendisk(const char* filepath, int ignore_vfs)
     /* header */
     header->type = FILE_TYPE_DSK;
     header->mode = FILE_MODE_READ;
-    strcpy(header->path, filepath);
+    header->path = fio_path_intern(filepath);
     header->read_fn = fio_readdisk;
 
     /* data */
-    f->file = !ignore_vfs ? open_resolvepath(filepath) : fopen(filepath, "rb");
-    if (f->file == NULL)    {
+    char path[DH_PATH_MAX];
+    const char* diskpath = !ignore_vfs ? fio_resolvepath(path, filepath) : filepath;
+    uint64 size;
+    f->fd = diskpath != NULL ?
+        util_openfd(diskpath, UTIL_FD_READ | UTIL_FD_SEQUENTIAL, &size) : UTIL_FD_INVALID;
+    if (f->fd == UTIL_FD_INVALID)   {
         fio_free_diskbuff(file_buf);
         return NULL;
     }
+    header->size = (size_t)size;
+
+    /* huge files are streamed with direct I/O, so they don't thrash the file cache of the OS,
+     * falls back to cached reads if file-system doesn't support it */
+    size_t buffsize = g_fio->disk_buffsize;
+    if (buffsize > 0 && g_fio->disk_directsize > 0 && size >= g_fio->disk_directsize)    {
+        iptr_t fd = util_openfd(diskpath, UTIL_FD_READ | UTIL_FD_DIRECT, NULL);
+        if (fd != UTIL_FD_INVALID)  {
+            util_closefd(f->fd);
+            f->fd = fd;
+            f->direct = TRUE;
+        }
+    }
 
-    /* size */
-    fseek(f->file, 0, SEEK_END);
-    header->size = ftell(f->file);
-    fseek(f->file, 0, SEEK_SET);
+    /* small files don't need the whole buffer */
+    if (!fio_disk_allocbuff(f, minsz(buffsize, header->size)))   {
+        util_closefd(f->fd);
+        fio_free_diskbuff(file_buf);
+        return NULL;
+    }
 
     return file_buf;
 }
 
-static FILE* open_resolvepath(const char* filepath)
+/* finds filepath in bundles/virtual-directories, returns full path in outpath or NULL if not found */
+static const char* fio_resolvepath(char* outpath, const char* filepath)
 {
     ASSERT(g_fio);
-    char testpath[DH_PATH_MAX];
 
 #ifdef _IOS_
     int bundle_cnt = g_fio->bundles.item_cnt;
     int* bundles = (int*)g_fio->bundles.buffer;
     for (int i = 0; i < bundle_cnt; i++)    {
         if (bundles[i])  {
-            fio_ios_resolve_path(testpath, sizeof(testpath), bundles[i], filepath);
-            if (!util_pathisdir(testpath))  {
-                return fopen(testpath, "rb");
-            }
+            fio_ios_resolve_path(outpath, DH_PATH_MAX, bundles[i], filepath);
+            if (!util_pathisdir(outpath))
+                return outpath;
         }
     }
 #endif
 
     struct vdir* vds = (struct vdir*)g_fio->vdirs.buffer;
     uint item_cnt = g_fio->vdirs.item_cnt;
+    if (item_cnt == 0)
+        return NULL;
+
+    uint key = hash_str(filepath);
+    uint check = hash_murmur32(filepath, strlen(filepath), VDIR_CHECK_SEED);
+    struct hashtable_item_chained* item;
+
+    /* look in the index of vdir contents and negative lookups */
+    mt_mutex_lock(&g_fio->vdir_mtx);
+    if (MT_ATOMIC_CAS(g_fio->vdir_dirty, TRUE, FALSE) == TRUE)
+        fio_vdir_buildindex();
+
+    item = g_fio->vdir_index.pslots != NULL ? hashtable_chained_find(&g_fio->vdir_index, key) : NULL;
+    if (item != NULL)   {
+        const struct vdir_entry* e = &((struct vdir_entry*)g_fio->vdir_entries.buffer)[item->value];
+        if (e->check == check && e->vdir_idx < item_cnt)    {
+            mt_mutex_unlock(&g_fio->vdir_mtx);
+            return path_join(outpath, vds[e->vdir_idx].path, filepath, NULL);
+        }
+    }
+
+    item = hashtable_chained_find(&g_fio->vdir_misses, key);
+    if (item != NULL && (uint)item->value == check) {
+        mt_mutex_unlock(&g_fio->vdir_mtx);
+        return NULL;
+    }
+    mt_mutex_unlock(&g_fio->vdir_mtx);
+
+    /* not indexed: file is added after indexing, or path is spelled differently (case, separators)
+     * probe vdirs on disk and remember the result */
+    const char* r = NULL;
+    uint vdir_idx = 0;
     for (uint i = 0; i < item_cnt; i++)   {
-        struct vdir* vd = &vds[i];
-        path_join(testpath, vd->path, filepath, NULL);
-        if (path_exists(testpath) == 1)  {
-            return fopen(testpath, "rb");
+        path_join(outpath, vds[i].path, filepath, NULL);
+        if (path_exists(outpath) == 1)  {
+            r = outpath;
+            vdir_idx = i;
+            break;
         }
     }
 
-    return NULL;
+    mt_mutex_lock(&g_fio->vdir_mtx);
+    if (r != NULL)  {
+        struct vdir_entry* e = g_fio->vdir_index.pslots != NULL ?
+            (struct vdir_entry*)arr_add(&g_fio->vdir_entries) : NULL;
+        if (e != NULL)  {
+            e->key = key;
+            e->check = check;
+            e->vdir_idx = vdir_idx;
+            hashtable_chained_add(&g_fio->vdir_index, key, g_fio->vdir_entries.item_cnt - 1);
+        }
+    }   else if (hashtable_chained_find(&g_fio->vdir_misses, key) == NULL)  {
+        if (g_fio->vdir_misses.items_cnt >= VDIR_MISSES_MAX)
+            hashtable_chained_clear(&g_fio->vdir_misses);
+        hashtable_chained_add(&g_fio->vdir_misses, key, check);
+    }
+    mt_mutex_unlock(&g_fio->vdir_mtx);
+
+    return r;
+}
+
+static void fio_vdir_indexfile(const char* filepath, void* param)
+{
+    struct vdir_entry* e = (struct vdir_entry*)arr_add(&g_fio->vdir_entries);
+    if (e == NULL)
+        return;
+    e->key = hash_str(filepath);
+    e->check = hash_murmur32(filepath, strlen(filepath), VDIR_CHECK_SEED);
+    e->vdir_idx = (uint)(uptr_t)param;
+}
+
+/* walks virtual directories and builds the index of their files, vdir_mtx must be locked */
+static void fio_vdir_buildindex()
+{
+    hashtable_chained_clear(&g_fio->vdir_misses);
+    if (g_fio->vdir_index.pslots != NULL)
+        hashtable_chained_destroy(&g_fio->vdir_index);
+    arr_clear(&g_fio->vdir_entries);
+
+    struct vdir* vds = (struct vdir*)g_fio->vdirs.buffer;
+    for (int i = 0; i < g_fio->vdirs.item_cnt; i++)
+        util_walkdir(vds[i].path, fio_vdir_indexfile, (void*)(uptr_t)i);
+
+    /* table is sized by the number of files, so chains stay short */
+    int entry_cnt = g_fio->vdir_entries.item_cnt;
+    result_t r = hashtable_chained_create(mem_heap(), &g_fio->vdir_index_alloc, &g_fio->vdir_index,
+                                          maxi(entry_cnt, VDIR_INDEX_SIZE), 0);
+    if (IS_FAIL(r)) {
+        err_printn(__FILE__, __LINE__, r);
+        arr_clear(&g_fio->vdir_entries);
+        return;
+    }
+
+    /* first vdir that contains the file has priority, same as probing vdirs in order
+     * on hash_str collisions, the latter path is not indexed and resolves by probing */
+    const struct vdir_entry* entries = (const struct vdir_entry*)g_fio->vdir_entries.buffer;
+    for (int i = 0; i < entry_cnt; i++) {
+        if (hashtable_chained_find(&g_fio->vdir_index, entries[i].key) == NULL)
+            hashtable_chained_add(&g_fio->vdir_index, entries[i].key, i);
+    }
 }
 
 void fio_close(file_t f)
@@ -618,11 +1548,34 @@ void fio_close(file_t f)
         fio_free_membuff((uint8*)f);
     }    else if (header->type == FILE_TYPE_DSK)    {
         struct disk_file* fdata = (struct disk_file*)((uint8*)f + sizeof(struct file_header));
-        if (fdata->file != NULL)    {
-            fclose(fdata->file);
-            fdata->file = NULL;
+        if (fdata->fd != UTIL_FD_INVALID)   {
+            if (header->mode == FILE_MODE_WRITE)
+                fio_disk_flush(fdata);
+            util_closefd(fdata->fd);
+            fdata->fd = UTIL_FD_INVALID;
         }
+        if (fdata->buffer_raw != NULL)
+            A_FREE(mem_heap(), fdata->buffer_raw);
         fio_free_diskbuff((uint8*)f);
+    }    else if (header->type == FILE_TYPE_CHUNKED)    {
+        struct chunk_file* fdata = (struct chunk_file*)((uint8*)f + sizeof(struct file_header));
+        if (fdata->chunks.buffer != NULL)
+            fio_releasechunks(fdata);
+        fio_free_chunkbuff((uint8*)f);
+    }    else if (header->type == FILE_TYPE_MMAP)   {
+        struct mmap_file* fdata = (struct mmap_file*)((uint8*)f + sizeof(struct file_header));
+        if (fdata->owner && fdata->data != NULL)
+            util_unmapfile((void*)fdata->data, header->size);
+        if (fdata->close_fn != NULL)
+            fdata->close_fn(fdata->data, fdata->close_param);
+        fdata->data = NULL;
+        fio_free_mmapbuff((uint8*)f);
+    }    else if (header->type == FILE_TYPE_STREAM)    {
+        struct stream_file* fdata = (struct stream_file*)((uint8*)f + sizeof(struct file_header));
+        if (fdata->close_fn != NULL)
+            fdata->close_fn(fdata->param);
+        fdata->read_fn = NULL;
+        fio_free_streambuff((uint8*)f);
     }
 }
 
@@ -649,17 +1602,65 @@ int fio_seek(file_t f, enum seek_mode seek, int offset)
         }
         fdata->offset = clampsz(fdata->offset, 0, header->size);
         return (int)fdata->offset;
+    }    else if (header->type == FILE_TYPE_CHUNKED)    {
+        struct chunk_file* fdata = (struct chunk_file*)((uint8*)f + sizeof(struct file_header));
+        switch (seek)   {
+            case SEEK_MODE_CUR:
+                fdata->offset += offset;
+                break;
+            case SEEK_MODE_START:
+                fdata->offset = offset;
+                break;
+            case SEEK_MODE_END:
+                fdata->offset = header->size - offset;
+                break;
+        }
+        fdata->offset = clampsz(fdata->offset, 0, header->size);
+        return (int)fdata->offset;
     }    else if (header->type == FILE_TYPE_DSK)    {
         struct disk_file* fdata = (struct disk_file*)((uint8*)f + sizeof(struct file_header));
-        int seek_std;
+        if (header->mode == FILE_MODE_WRITE)
+            fio_disk_flush(fdata);
+
+        /* position is kept by the file, read-ahead buffer stays valid */
+        int64 pos;
         switch (seek)   {
-            case SEEK_MODE_CUR:     seek_std = SEEK_CUR;    break;
-            case SEEK_MODE_START:   seek_std = SEEK_SET;    break;
-            case SEEK_MODE_END:     seek_std = SEEK_END;    break;
-            default:				seek_std = SEEK_SET;	break;
+            case SEEK_MODE_CUR:     pos = (int64)fdata->offset + offset;    break;
+            case SEEK_MODE_END:     pos = (int64)header->size + offset;     break;
+            default:                pos = offset;                           break;
         }
-        fseek(fdata->file, offset, seek_std);
-        return (int)ftell(fdata->file);
+        fdata->offset = pos > 0 ? (uint64)pos : 0;
+        return (int)fdata->offset;
+    }    else if (header->type == FILE_TYPE_MMAP)   {
+        struct mmap_file* fdata = (struct mmap_file*)((uint8*)f + sizeof(struct file_header));
+        switch (seek)   {
+            case SEEK_MODE_CUR:
+                fdata->offset += offset;
+                break;
+            case SEEK_MODE_START:
+                fdata->offset = offset;
+                break;
+            case SEEK_MODE_END:
+                fdata->offset = header->size - offset;
+                break;
+        }
+        fdata->offset = clampsz(fdata->offset, 0, header->size);
+        return (int)fdata->offset;
+    }    else if (header->type == FILE_TYPE_STREAM)    {
+        struct stream_file* fdata = (struct stream_file*)((uint8*)f + sizeof(struct file_header));
+        switch (seek)   {
+            case SEEK_MODE_CUR:
+                fdata->offset += offset;
+                break;
+            case SEEK_MODE_START:
+                fdata->offset = offset;
+                break;
+            case SEEK_MODE_END:
+                fdata->offset = header->size - offset;
+                break;
+        }
+        fdata->offset = clampsz(fdata->offset, 0, header->size);
+        return (int)fdata->offset;
     }
 
     return -1;
@@ -679,16 +1680,188 @@ size_t fio_write(file_t f, const void* buffer, size_t item_size, size_t items_cn
     return header->write_fn(f, buffer, item_size, items_cnt);
 }
 
+size_t fio_readv(file_t f, const struct fio_iovec* iov, int cnt)
+{
+    ASSERT(f != NULL);
+    struct file_header* header = (struct file_header*)f;
+    ASSERT(header->read_fn);
+
+    if (header->type == FILE_TYPE_MEM || header->type == FILE_TYPE_MMAP)   {
+        const uint8* data;
+        size_t* poffset;
+        if (header->type == FILE_TYPE_MEM)  {
+            struct mem_file* fdata = (struct mem_file*)((uint8*)f + sizeof(struct file_header));
+            data = fdata->buffer;
+            poffset = &fdata->offset;
+        }   else    {
+            struct mmap_file* fdata = (struct mmap_file*)((uint8*)f + sizeof(struct file_header));
+            data = fdata->data;
+            poffset = &fdata->offset;
+        }
+
+        size_t total = 0;
+        for (int i = 0; i < cnt && *poffset < header->size; i++)    {
+            size_t sz = minsz(iov[i].size, header->size - *poffset);
+            memcpy(iov[i].buffer, data + *poffset, sz);
+            *poffset += sz;
+            total += sz;
+        }
+        return total;
+    }   else if (header->type == FILE_TYPE_DSK) {
+        return fio_readvdisk(f, iov, cnt);
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < cnt; i++)   {
+        size_t sz = header->read_fn(f, iov[i].buffer, 1, iov[i].size);
+        total += sz;
+        if (sz < iov[i].size)
+            break;
+    }
+    return total;
+}
+
 static size_t fio_readdisk(file_t f, void* buffer, size_t item_size, size_t items_cnt)
 {
     struct disk_file* fdata = (struct disk_file*)((uint8*)f + sizeof(struct file_header));
-    return fread(buffer, item_size, items_cnt, fdata->file);
+    uint8* dest = (uint8*)buffer;
+    size_t size = item_size*items_cnt;
+    size_t remain = size;
+
+    while (remain > 0)  {
+        /* copy from read-ahead buffer */
+        if (fdata->offset >= fdata->buffer_offset &&
+            fdata->offset < fdata->buffer_offset + fdata->buffer_len)
+        {
+            size_t idx = (size_t)(fdata->offset - fdata->buffer_offset);
+            size_t sz = minsz(remain, fdata->buffer_len - idx);
+            memcpy(dest, fdata->buffer + idx, sz);
+            dest += sz;
+            remain -= sz;
+            fdata->offset += sz;
+            continue;
+        }
+
+        /* large reads go directly into destination, direct I/O reads aligned destinations
+         * directly, regardless of the size */
+        if ((!fdata->direct && remain >= fdata->buffer_size) ||
+            (fdata->direct && remain >= UTIL_FD_ALIGN &&
+             (((uptr_t)dest | (uptr_t)fdata->offset) & (UTIL_FD_ALIGN-1)) == 0))
+        {
+            size_t sz = fdata->direct ? (remain & ~((size_t)UTIL_FD_ALIGN - 1)) : remain;
+            size_t read_sz = util_readfd(fdata->fd, dest, sz, fdata->offset);
+            dest += read_sz;
+            remain -= read_sz;
+            fdata->offset += read_sz;
+            if (read_sz < sz)
+                break;
+            continue;
+        }
+
+        /* refill read-ahead buffer */
+        uint64 start = fdata->direct ?
+            (fdata->offset & ~((uint64)UTIL_FD_ALIGN - 1)) : fdata->offset;
+        fdata->buffer_offset = start;
+        fdata->buffer_len = util_readfd(fdata->fd, fdata->buffer, fdata->buffer_size, start);
+        if (start + fdata->buffer_len <= fdata->offset)
+            break;  /* end of file */
+    }
+
+    return (size - remain)/item_size;
+}
+
+static size_t fio_readvdisk(file_t f, const struct fio_iovec* iov, int cnt)
+{
+    struct disk_file* fdata = (struct disk_file*)((uint8*)f + sizeof(struct file_header));
+    size_t total = 0;
+    size_t remain = 0;
+    int idx = 0;
+    size_t skip = 0;    /* bytes of iov[idx] that are already read */
+
+    /* data that is already in read-ahead buffer */
+    while (idx < cnt && fdata->offset >= fdata->buffer_offset &&
+           fdata->offset < fdata->buffer_offset + fdata->buffer_len)
+    {
+        size_t buff_idx = (size_t)(fdata->offset - fdata->buffer_offset);
+        size_t sz = minsz(iov[idx].size - skip, fdata->buffer_len - buff_idx);
+        memcpy((uint8*)iov[idx].buffer + skip, fdata->buffer + buff_idx, sz);
+        fdata->offset += sz;
+        total += sz;
+        skip += sz;
+        if (skip == iov[idx].size)  {
+            skip = 0;
+            idx++;
+        }
+    }
+
+    for (int i = idx; i < cnt; i++)
+        remain += iov[i].size;
+    remain -= skip;
+
+    /* large reads are scattered directly into the buffers with a single system call for each
+     * batch, direct I/O needs aligned buffers, so it reads them one by one */
+    if (!fdata->direct && remain >= fdata->buffer_size)    {
+        void* buffers[64];
+        size_t sizes[64];
+        while (idx < cnt)   {
+            int n = 0;
+            size_t batch_sz = 0;
+            for (; n < 64 && idx + n < cnt; n++)   {
+                buffers[n] = (uint8*)iov[idx + n].buffer + (n == 0 ? skip : 0);
+                sizes[n] = iov[idx + n].size - (n == 0 ? skip : 0);
+                batch_sz += sizes[n];
+            }
+
+            size_t read_sz = util_readscatter(fdata->fd, buffers, sizes, n, fdata->offset);
+            fdata->offset += read_sz;
+            total += read_sz;
+            if (read_sz < batch_sz)
+                break;
+            idx += n;
+            skip = 0;
+        }
+        return total;
+    }
+
+    for (; idx < cnt; idx++)    {
+        size_t sz = iov[idx].size - skip;
+        size_t read_sz = fio_readdisk(f, (uint8*)iov[idx].buffer + skip, 1, sz);
+        total += read_sz;
+        skip = 0;
+        if (read_sz < sz)
+            break;
+    }
+    return total;
 }
 
 static size_t fio_writedisk(file_t f, const void* buffer, size_t item_size, size_t items_cnt)
 {
+    struct file_header* header = (struct file_header*)f;
     struct disk_file* fdata = (struct disk_file*)((uint8*)f + sizeof(struct file_header));
-    return fwrite(buffer, item_size, items_cnt, fdata->file);
+    size_t size = item_size*items_cnt;
+    if (size == 0)
+        return items_cnt;
+
+    if (fdata->buffer_len + size > fdata->buffer_size)  {
+        if (!fio_disk_flush(fdata))
+            return 0;
+
+        /* large writes go directly to the file */
+        if (size >= fdata->buffer_size) {
+            size_t write_sz = util_writefd(fdata->fd, buffer, size, fdata->offset);
+            fdata->offset += write_sz;
+            header->size = maxsz(header->size, (size_t)fdata->offset);
+            return write_sz/item_size;
+        }
+    }
+
+    if (fdata->buffer_len == 0)
+        fdata->buffer_offset = fdata->offset;
+    memcpy(fdata->buffer + fdata->buffer_len, buffer, size);
+    fdata->buffer_len += size;
+    fdata->offset += size;
+    header->size = maxsz(header->size, (size_t)fdata->offset);
+    return items_cnt;
 }
 
 static size_t fio_readmem(file_t f, void* buffer, size_t item_size, size_t items_cnt)
@@ -707,6 +1880,38 @@ static size_t fio_readmem(file_t f, void* buffer, size_t item_size, size_t items
     return (read_sz/item_size);
 }
 
+static size_t fio_readmmap(file_t f, void* buffer, size_t item_size, size_t items_cnt)
+{
+    struct file_header* header = (struct file_header*)f;
+    struct mmap_file* fdata = (struct mmap_file*)((uint8*)f + sizeof(struct file_header));
+    size_t read_sz = item_size * items_cnt;
+    if ((read_sz + fdata->offset) > header->size)   {
+        read_sz = header->size - fdata->offset;
+        read_sz -= (read_sz % item_size);
+    }
+    if (read_sz != 0)   {
+        memcpy(buffer, fdata->data + fdata->offset, read_sz);
+        fdata->offset += read_sz;
+    }
+    return (read_sz/item_size);
+}
+
+static size_t fio_readstream(file_t f, void* buffer, size_t item_size, size_t items_cnt)
+{
+    struct file_header* header = (struct file_header*)f;
+    struct stream_file* fdata = (struct stream_file*)((uint8*)f + sizeof(struct file_header));
+    size_t read_sz = item_size * items_cnt;
+    if ((read_sz + fdata->offset) > header->size)   {
+        read_sz = header->size - fdata->offset;
+        read_sz -= (read_sz % item_size);
+    }
+    if (read_sz != 0)   {
+        read_sz = fdata->read_fn(buffer, fdata->offset, read_sz, fdata->param);
+        fdata->offset += read_sz;
+    }
+    return (read_sz/item_size);
+}
+
 static size_t fio_writemem(file_t f, const void* buffer, size_t item_size, size_t items_cnt)
 {
     struct file_header* header = (struct file_header*)f;
@@ -715,10 +1920,11 @@ static size_t fio_writemem(file_t f, const void* buffer, size_t item_size, size_
     size_t write_sz = item_size * items_cnt;
     size_t offset = fdata->offset;
 
-    /* grow buffer if necessary */
+    /* grow buffer if necessary, at least double the size, so sequential writes don't
+     * reallocate and copy the buffer on every block */
     if ((write_sz + offset) > fdata->max_size)   {
         size_t grow_sz = write_sz + offset - fdata->max_size;
-        size_t expand_sz = ((grow_sz/MEM_BLOCK_SIZE) + 1)*MEM_BLOCK_SIZE;
+        size_t expand_sz = maxsz(((grow_sz/MEM_BLOCK_SIZE) + 1)*MEM_BLOCK_SIZE, fdata->max_size);
 
         fdata->buffer = (uint8*)A_REALLOC(fdata->alloc, fdata->buffer, expand_sz + fdata->max_size,
                                           fdata->mem_id);
@@ -737,6 +1943,72 @@ static size_t fio_writemem(file_t f, const void* buffer, size_t item_size, size_
     return items_cnt;
 }
 
+static size_t fio_readchunks(file_t f, void* buffer, size_t item_size, size_t items_cnt)
+{
+    struct file_header* header = (struct file_header*)f;
+    struct chunk_file* fdata = (struct chunk_file*)((uint8*)f + sizeof(struct file_header));
+    size_t read_sz = item_size * items_cnt;
+    if ((read_sz + fdata->offset) > header->size)   {
+        read_sz = header->size - fdata->offset;
+        read_sz -= (read_sz % item_size);
+    }
+
+    const uint8** chunks = (const uint8**)fdata->chunks.buffer;
+    uint8* dest = (uint8*)buffer;
+    size_t offset = fdata->offset;
+    size_t remain = read_sz;
+    while (remain > 0)  {
+        size_t chunk_offset = offset % MEM_CHUNK_SIZE;
+        size_t sz = minsz(remain, MEM_CHUNK_SIZE - chunk_offset);
+        memcpy(dest, chunks[offset/MEM_CHUNK_SIZE] + chunk_offset, sz);
+        dest += sz;
+        offset += sz;
+        remain -= sz;
+    }
+    fdata->offset = offset;
+    return (read_sz/item_size);
+}
+
+static size_t fio_writechunks(file_t f, const void* buffer, size_t item_size, size_t items_cnt)
+{
+    struct file_header* header = (struct file_header*)f;
+    struct chunk_file* fdata = (struct chunk_file*)((uint8*)f + sizeof(struct file_header));
+
+    size_t write_sz = item_size * items_cnt;
+    size_t end = fdata->offset + write_sz;
+
+    /* add blocks until written range is covered */
+    while ((size_t)fdata->chunks.item_cnt*MEM_CHUNK_SIZE < end)  {
+        uint8* chunk = fio_alloc_chunk();
+        if (chunk == NULL)
+            return 0;
+        uint8** pchunk = (uint8**)arr_add(&fdata->chunks);
+        if (pchunk == NULL) {
+            fio_free_chunk(chunk);
+            return 0;
+        }
+        *pchunk = chunk;
+    }
+
+    uint8** chunks = (uint8**)fdata->chunks.buffer;
+    const uint8* src = (const uint8*)buffer;
+    size_t offset = fdata->offset;
+    size_t remain = write_sz;
+    while (remain > 0)  {
+        size_t chunk_offset = offset % MEM_CHUNK_SIZE;
+        size_t sz = minsz(remain, MEM_CHUNK_SIZE - chunk_offset);
+        memcpy(chunks[offset/MEM_CHUNK_SIZE] + chunk_offset, src, sz);
+        src += sz;
+        offset += sz;
+        remain -= sz;
+    }
+
+    fdata->offset = end;
+    if (end > header->size)
+        header->size = end;
+    return items_cnt;
+}
+
 size_t fio_getsize(file_t f)
 {
     struct file_header* header = (struct file_header*)f;
@@ -751,7 +2023,16 @@ size_t fio_getpos(file_t f)
         return fdata->offset;
     }    else if (header->type == FILE_TYPE_DSK)    {
         struct disk_file* fdata = (struct disk_file*)((uint8*)f + sizeof(struct file_header));
-        return ftell(fdata->file);
+        return (size_t)fdata->offset;
+    }    else if (header->type == FILE_TYPE_MMAP)   {
+        struct mmap_file* fdata = (struct mmap_file*)((uint8*)f + sizeof(struct file_header));
+        return fdata->offset;
+    }    else if (header->type == FILE_TYPE_CHUNKED)    {
+        struct chunk_file* fdata = (struct chunk_file*)((uint8*)f + sizeof(struct file_header));
+        return fdata->offset;
+    }    else if (header->type == FILE_TYPE_STREAM)    {
+        struct stream_file* fdata = (struct stream_file*)((uint8*)f + sizeof(struct file_header));
+        return fdata->offset;
     }
     return 0;
 }
@@ -759,7 +2040,7 @@ size_t fio_getpos(file_t f)
 const char* fio_getpath(file_t f)
 {
     struct file_header* header = (struct file_header*)f;
-    return header->path;
+    return header->path->str;
 }
 
 int fio_isopen(file_t f)
@@ -770,7 +2051,16 @@ int fio_isopen(file_t f)
         return (fdata->buffer != NULL);
     }    else if (header->type == FILE_TYPE_DSK)    {
         struct disk_file* fdata = (struct disk_file*)((uint8*)f + sizeof(struct file_header));
-        return (fdata->file != NULL);
+        return (fdata->fd != UTIL_FD_INVALID);
+    }    else if (header->type == FILE_TYPE_MMAP)   {
+        struct mmap_file* fdata = (struct mmap_file*)((uint8*)f + sizeof(struct file_header));
+        return (fdata->data != NULL);
+    }    else if (header->type == FILE_TYPE_CHUNKED)    {
+        struct chunk_file* fdata = (struct chunk_file*)((uint8*)f + sizeof(struct file_header));
+        return (fdata->chunks.buffer != NULL);
+    }    else if (header->type == FILE_TYPE_STREAM)    {
+        struct stream_file* fdata = (struct stream_file*)((uint8*)f + sizeof(struct file_header));
+        return (fdata->read_fn != NULL);
     }
     return FALSE;
 }
@@ -790,114 +2080,214 @@ enum file_mode fio_getmode(file_t f)
 /*************************************************************************************************
  * file change monitoring routines
  */
+#if defined(FIO_MON_ENABLED)
+static result_t fio_mon_initmgr()
+{
+    mt_mutex_init(&g_fio->mon_mtx);
+    g_fio->mon_debounce = MON_DEBOUNCE;
+
+    /* chained tables, most of the changed files are not registered */
+    result_t r = mem_pool_create(mem_heap(), &g_fio->mon_table_pool,
+                                 sizeof(struct hashtable_item_chained), MON_POOL_BLOCK, 0);
+    if (IS_OK(r))   {
+        r = mem_pool_create(mem_heap(), &g_fio->mon_pending_pool,
+                            sizeof(struct hashtable_item_chained), MON_POOL_BLOCK, 0);
+    }
+    if (IS_OK(r))   {
+        mem_pool_bindalloc(&g_fio->mon_table_pool, &g_fio->mon_table_alloc);
+        mem_pool_bindalloc(&g_fio->mon_pending_pool, &g_fio->mon_pending_alloc);
+        r = hashtable_chained_create(mem_heap(), &g_fio->mon_table_alloc, &g_fio->mon_table,
+                                     MON_ITEM_SIZE, 0);
+    }
+    if (IS_OK(r))   {
+        r = hashtable_chained_create(mem_heap(), &g_fio->mon_pending_alloc, &g_fio->mon_pending,
+                                     MON_PENDING_SIZE, 0);
+    }
+    if (IS_OK(r))
+        r = arr_create(mem_heap(), &g_fio->mon_events, sizeof(struct mon_event), 32, 32, 0);
+    if (IS_OK(r))
+        r = arr_create(mem_heap(), &g_fio->mon_batch, sizeof(struct mon_event), 32, 32, 0);
+    return r;
+}
+
+static void fio_mon_releasemgr()
+{
 #if defined(_FILEMON_)
-int fio_find_file(const struct array* files, const char* filepath);
+    if (g_fio->watcher != NULL)
+        efsw_destroy(g_fio->watcher);
+#else
+    fio_lnx_mon_release();
+#endif
+
+    /* search for remaining registered monitor items and delete them */
+    int cnt = 0;
+    if (g_fio->mon_table.pslots != NULL)    {
+        for (int i = 0; i < g_fio->mon_table.slots_cnt; i++) {
+            for (struct linked_list* node = g_fio->mon_table.pslots[i]; node != NULL;
+                 node = node->next)
+            {
+                struct hashtable_item_chained* item = (struct hashtable_item_chained*)node->data;
+                FREE((struct mon_item*)item->value);
+                cnt ++;
+            }
+        }
+        hashtable_chained_destroy(&g_fio->mon_table);
+    }
+#if defined(_DEBUG_)
+    if (cnt > 0)
+        log_printf(LOG_INFO, "file-mgr: destroyed %d file monitors", cnt);
+#endif
+
+    if (g_fio->mon_pending.pslots != NULL)
+        hashtable_chained_destroy(&g_fio->mon_pending);
+    mem_pool_destroy(&g_fio->mon_table_pool);
+    mem_pool_destroy(&g_fio->mon_pending_pool);
+    arr_destroy(&g_fio->mon_events);
+    arr_destroy(&g_fio->mon_batch);
+    mt_mutex_release(&g_fio->mon_mtx);
+}
+
+/* adds modified file to pending changes, files that are already pending are not added again */
+static void fio_mon_addevent(const char* filepath)
+{
+    uint key = hash_str(filepath);
+    uint64 tick = timer_querytick();
+
+    mt_mutex_lock(&g_fio->mon_mtx);
+    const struct mon_event* events = (const struct mon_event*)g_fio->mon_events.buffer;
+    struct hashtable_item_chained* item = hashtable_chained_find(&g_fio->mon_pending, key);
+    if (item == NULL || !str_isequal(events[item->value].filepath, filepath))    {
+        if (g_fio->mon_events.item_cnt == 0)
+            g_fio->mon_first_tick = tick;
+
+        struct mon_event* e = (struct mon_event*)arr_add(&g_fio->mon_events);
+        if (e != NULL)  {
+            str_safecpy(e->filepath, sizeof(e->filepath), filepath);
+            e->key = key;
+            /* hash collisions are rare, colliding path is just not deduplicated */
+            if (item == NULL)
+                hashtable_chained_add(&g_fio->mon_pending, key, g_fio->mon_events.item_cnt - 1);
+        }
+    }
+    g_fio->mon_last_tick = tick;
+    mt_mutex_unlock(&g_fio->mon_mtx);
+}
 
+#if defined(_FILEMON_)
 void fio_mon_callback(efsw_watcher watcher,
     efsw_watchid watchid, const char* dir, const char* filename,
     enum efsw_action action, const char* old_filename, void* param)
 {
-    if (action == EFSW_MODIFIED || action == EFSW_MOVED)    {
-        struct vdir* vd = (struct vdir*)param;
+    /* files are added/removed from vdirs, index must be rebuilt */
+    if (action == EFSW_ADD || action == EFSW_DELETE || action == EFSW_MOVED)
+        MT_ATOMIC_SET(g_fio->vdir_dirty, TRUE);
 
-        mt_mutex_lock(&vd->mtx);
-        struct array* arr = (struct array*)vd->backbuff;
+    if (action == EFSW_MODIFIED || action == EFSW_MOVED)    {
         char filepath_unix[DH_PATH_MAX];
         path_tounix(filepath_unix, filename);
-
-        if (!fio_find_file(arr, filepath_unix))   {
-            char* filepath = (char*)arr_add(arr);
-            ASSERT(filepath);
-            strcpy(filepath, filepath_unix);
-        }
-
-        mt_mutex_unlock(&vd->mtx);
+        fio_mon_addevent(filepath_unix);
     }
 }
+#else
+static void fio_mon_callback(const char* filepath, int modified, int listing, void* param)
+{
+    /* files are added/removed from vdirs, index must be rebuilt */
+    if (listing)
+        MT_ATOMIC_SET(g_fio->vdir_dirty, TRUE);
+    if (modified)
+        fio_mon_addevent(filepath);
+}
+#endif
 
 static int fio_vdir_initmon(struct vdir* vd)
 {
+#if defined(_FILEMON_)
     if (g_fio->watcher == NULL) {
         g_fio->watcher = efsw_create(FALSE);
         if (g_fio->watcher == NULL) {
             log_print(LOG_WARNING, "file-mgr: could not init file monitoring");
+            vd->monitor = FALSE;
             return FALSE;
         }
     }
 
-    mt_mutex_init(&vd->mtx);
-
-    arr_create(mem_heap(), &vd->backarr, DH_PATH_MAX, 10, 10, 0);
-    arr_create(mem_heap(), &vd->frontarr, DH_PATH_MAX, 10, 10, 0);
-    vd->frontbuff = &vd->frontarr;
-    vd->backbuff = &vd->backarr;
-
-    vd->watchid = efsw_addwatch(g_fio->watcher, vd->path, fio_mon_callback, TRUE, vd);
+    vd->watchid = efsw_addwatch(g_fio->watcher, vd->path, fio_mon_callback, TRUE, NULL);
     if (vd->watchid == -1)  {
         log_printf(LOG_WARNING, "file-mgr: %s", efsw_getlasterror());
+        vd->monitor = FALSE;
         return FALSE;
     }
 
     efsw_watch(g_fio->watcher);
+#else
+    vd->watchid = fio_lnx_mon_addwatch(vd->path);
+    if (vd->watchid == -1)  {
+        log_printf(LOG_WARNING, "file-mgr: could not monitor directory '%s'", vd->path);
+        vd->monitor = FALSE;
+        return FALSE;
+    }
+#endif
     return TRUE;
 }
 
 static void fio_vdir_releasemon(struct vdir* vd)
 {
+#if defined(_FILEMON_)
     ASSERT(g_fio->watcher);
     efsw_removewatch_byid(g_fio->watcher, vd->watchid);
-
-    mt_mutex_release(&vd->mtx);
-
-    arr_destroy(&vd->backarr);
-    arr_destroy(&vd->frontarr);
-
-    vd->frontbuff = NULL;
-    vd->backbuff = NULL;
+#else
+    fio_lnx_mon_removewatch(vd->watchid);
+#endif
 }
 
-
-int fio_find_file(const struct array* files, const char* filepath)
+void fio_mon_update()
 {
-    for (int i = 0; i < files->item_cnt; i++)    {
-        const char* f = ((char*)files->buffer) + i*DH_PATH_MAX;
-        if (str_isequal(f, filepath))
-            return TRUE;
+#if defined(FIO_MON_INOTIFY)
+    fio_lnx_mon_poll(fio_mon_callback, NULL);
+#endif
+
+    /* pending changes are delivered together when files are not changed for the debounce window,
+     * so files that are rewritten many times (hot-reload storms) are delivered once */
+    mt_mutex_lock(&g_fio->mon_mtx);
+    if (g_fio->mon_events.item_cnt == 0)    {
+        mt_mutex_unlock(&g_fio->mon_mtx);
+        return;
     }
-    return FALSE;
-}
 
-void fio_mon_update()
-{
-    /* move through vdirs and look for changes within their file-system */
-    for (int i = 0; i < g_fio->vdirs.item_cnt; i++)  {
-        struct vdir* vd = &((struct vdir*)g_fio->vdirs.buffer)[i];
-        if (!vd->monitor)
-            continue;
+    uint64 tick = timer_querytick();
+    fl64 debounce = (fl64)g_fio->mon_debounce/1000.0;
+    if (timer_calctm(g_fio->mon_last_tick, tick) < debounce &&
+        timer_calctm(g_fio->mon_first_tick, tick) < debounce*MON_MAX_DELAY)
+    {
+        mt_mutex_unlock(&g_fio->mon_mtx);
+        return;
+    }
 
-        /* swap back_arr with front_arr
-         * use mutex to ensure that we don't swap back/front in the middle of adding */
-        mt_mutex_lock(&vd->mtx);
-        swapptr((void**)&vd->backbuff, (void**)&vd->frontbuff);
-        mt_mutex_unlock(&vd->mtx);
-
-        /* check with registered file items and see we have a match */
-        struct array* arr = (struct array*)vd->frontbuff;
-        for (int c = 0; c < arr->item_cnt; c++)  {
-            const char* filepath = ((char*)arr->buffer) + c*DH_PATH_MAX;
-
-            struct hashtable_item* item = hashtable_open_find(&g_fio->mon_table,
-                hash_str(filepath));
-            if (item != NULL)   {
-                struct mon_item* mitem = (struct mon_item*)item->value;
-                mitem->fn(filepath, mitem->hdl, mitem->param1, mitem->param2);
-            }
+    struct array tmp = g_fio->mon_batch;
+    g_fio->mon_batch = g_fio->mon_events;
+    g_fio->mon_events = tmp;
+    hashtable_chained_clear(&g_fio->mon_pending);
+    mt_mutex_unlock(&g_fio->mon_mtx);
+
+    /* check with registered file items and see we have a match */
+    const struct mon_event* events = (const struct mon_event*)g_fio->mon_batch.buffer;
+    for (int i = 0; i < g_fio->mon_batch.item_cnt; i++)  {
+        struct hashtable_item_chained* item = hashtable_chained_find(&g_fio->mon_table,
+                                                                     events[i].key);
+        if (item != NULL)   {
+            struct mon_item* mitem = (struct mon_item*)item->value;
+            mitem->fn(events[i].filepath, mitem->hdl, mitem->param1, mitem->param2);
         }
-
-        arr_clear(arr);
     }
+    arr_clear(&g_fio->mon_batch);
 }
 
+void fio_mon_setdebounce(uint msecs)
+{
+    mt_mutex_lock(&g_fio->mon_mtx);
+    g_fio->mon_debounce = msecs;
+    mt_mutex_unlock(&g_fio->mon_mtx);
+}
 
 void fio_mon_reg(const char* filepath, pfn_fio_modify fn, reshandle_t hdl,
     uptr_t param1, uptr_t param2)
@@ -909,15 +2299,16 @@ void fio_mon_reg(const char* filepath, pfn_fio_modify fn, reshandle_t hdl,
     mitem->param1 = param1;
     mitem->param2 = param2;
 
-    hashtable_open_add(&g_fio->mon_table, hash_str(filepath), (uint64)((uptr_t)mitem));
+    hashtable_chained_add(&g_fio->mon_table, hash_str(filepath), (iptr_t)mitem);
 }
 
 void fio_mon_unreg(const char* filepath)
 {
-    struct hashtable_item* item = hashtable_open_find(&g_fio->mon_table, hash_str(filepath));
+    struct hashtable_item_chained* item = hashtable_chained_find(&g_fio->mon_table,
+                                                                 hash_str(filepath));
     if (item != NULL)   {
-        hashtable_open_remove(&g_fio->mon_table, item);
         struct mon_item* mitem = (struct mon_item*)item->value;
+        hashtable_chained_remove(&g_fio->mon_table, item);
         FREE(mitem);
     }
 }
@@ -944,6 +2335,10 @@ void fio_mon_update()
     ASSERT(0);  /* Not built with _FILEMON_ preprocessor ! */
 }
 
+void fio_mon_setdebounce(uint msecs)
+{
+}
+
 int fio_mon_avail()
 {
     return FALSE;
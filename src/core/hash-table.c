@@ -15,6 +15,12 @@
 
 #include "dhcore/hash-table.h"
 #include "dhcore/err.h"
+#include "dhcore/numeric.h"
+
+#define FROZEN_SIGN 0x5a524648  /* HFRZ */
+#define FROZEN_BUCKET_SIZE 4    /* average number of keys in each bucket */
+#define FROZEN_SEED_TRIES 16
+#define FROZEN_DISP_PRIME 0x9e3779b9
 
 static const int g_primes[] = {
     2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71, 73, 79, 83, 89, 97,
@@ -85,6 +91,8 @@ static int probe_linear(int idx, uint hash, int slot_cnt, const struct hashtable
 static void hashtable_open_reorder(struct hashtable_open* table, struct hashtable_item* items,
                                    int cnt);
 static int hashtable_get_prime(int n);
+static void hashtable_find_batch(const struct hashtable_item* items, int slots_cnt,
+                                 const uint* keys, int cnt, struct hashtable_item** result);
 
 /*************************************************************************************************/
 /* chained hash table */
@@ -164,6 +172,45 @@ struct hashtable_item_chained* hashtable_chained_find(const struct hashtable_cha
     return NULL;
 }
 
+void hashtable_chained_find_batch(const struct hashtable_chained* table, const uint* keys, int cnt,
+                                  struct hashtable_item_chained** result)
+{
+    int idxs[HASHTABLE_BATCH_SIZE];
+    struct linked_list* nodes[HASHTABLE_BATCH_SIZE];
+
+    for (int i = 0; i < cnt; i += HASHTABLE_BATCH_SIZE)  {
+        int c = mini(cnt - i, HASHTABLE_BATCH_SIZE);
+
+        /* calculate slots and prefetch slot pointers */
+        for (int k = 0; k < c; k++)  {
+            idxs[k] = keys[i+k] % table->slots_cnt;
+            PREFETCH(&table->pslots[idxs[k]]);
+        }
+
+        /* fetch first nodes of the chains and prefetch them */
+        for (int k = 0; k < c; k++)  {
+            nodes[k] = table->pslots[idxs[k]];
+            if (nodes[k] != NULL)
+                PREFETCH(nodes[k]->data);
+        }
+
+        /* resolve */
+        for (int k = 0; k < c; k++)  {
+            uint hash_key = keys[i+k];
+            struct linked_list* node = nodes[k];
+            result[i+k] = NULL;
+            while (node != NULL)    {
+                struct hashtable_item_chained* item = (struct hashtable_item_chained*)node->data;
+                if (item->hash == hash_key)  {
+                    result[i+k] = item;
+                    break;
+                }
+                node = node->next;
+            }
+        }
+    }
+}
+
 void hashtable_chained_clear(struct hashtable_chained* table)
 {
     for (int i = 0; i < table->slots_cnt; i++)   {
@@ -252,6 +299,12 @@ struct hashtable_item* hashtable_fixed_find(const struct hashtable_fixed* table,
         return NULL;
 }
 
+void hashtable_fixed_find_batch(const struct hashtable_fixed* table, const uint* keys, int cnt,
+                                struct hashtable_item** result)
+{
+    hashtable_find_batch(table->items, table->slots_cnt, keys, cnt, result);
+}
+
 void hashtable_fixed_clear(struct hashtable_fixed* table)
 {
     memset(table->items, 0x00, sizeof(struct hashtable_item)*table->slots_cnt);
@@ -366,6 +419,11 @@ struct hashtable_item* hashtable_open_find(const struct hashtable_open* table, u
         return NULL;
 }
 
+void hashtable_open_find_batch(const struct hashtable_open* table, const uint* keys, int cnt,
+                               struct hashtable_item** result)
+{
+    hashtable_find_batch(table->items, table->slots_cnt, keys, cnt, result);
+}
 
 void hashtable_open_clear(struct hashtable_open* table)
 {
@@ -373,6 +431,244 @@ void hashtable_open_clear(struct hashtable_open* table)
     table->items_cnt = 0;
 }
 
+/*************************************************************************************************
+ * hashtable_frozen
+ * Minimal perfect hashing with CHD (hash, displace), keys are distributed in buckets and buckets
+ * are placed (biggest first) by searching for a displacement value that puts all their keys into
+ * free slots.
+ * blob layout: frozen_header, uint disps[buckets_cnt], hashtable_frozen_item items[items_cnt]
+ */
+struct frozen_header
+{
+    uint sign;
+    uint items_cnt;
+    uint buckets_cnt;
+    uint seed;
+};
+
+INLINE uint frozen_mix(uint key, uint seed)
+{
+    uint h = key ^ seed;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+INLINE uint frozen_slot(uint key, uint seed, uint disp, uint items_cnt)
+{
+    return frozen_mix(key, seed + disp*FROZEN_DISP_PRIME) % items_cnt;
+}
+
+static size_t frozen_blob_size(uint items_cnt, uint buckets_cnt)
+{
+    return sizeof(struct frozen_header) + sizeof(uint)*buckets_cnt +
+        sizeof(struct hashtable_frozen_item)*items_cnt;
+}
+
+/* tries to place all buckets with the given seed, returns FALSE if keys are not unique (dup=TRUE)
+ * or a bucket couldn't be placed */
+static int frozen_place(struct hashtable_frozen_item* items, uint* disps, uint items_cnt,
+                        uint buckets_cnt, uint seed, const uint* keys, const uint* values,
+                        uint* bucket_starts, uint* sorted, uint* order, uint* slots, uint8* used,
+                        OUT int* dup)
+{
+    uint cnt = items_cnt;
+    *dup = FALSE;
+
+    /* counting sort of keys by bucket */
+    memset(bucket_starts, 0x00, sizeof(uint)*(buckets_cnt + 1));
+    for (uint i = 0; i < cnt; i++)
+        bucket_starts[frozen_mix(keys[i], seed) % buckets_cnt + 1]++;
+    uint max_size = 0;
+    for (uint i = 0; i < buckets_cnt; i++)   {
+        max_size = maxui(max_size, bucket_starts[i+1]);
+        bucket_starts[i+1] += bucket_starts[i];
+    }
+    for (uint i = 0; i < buckets_cnt; i++)
+        order[i] = bucket_starts[i];    /* use 'order' as temp write cursor */
+    for (uint i = 0; i < cnt; i++)
+        sorted[order[frozen_mix(keys[i], seed) % buckets_cnt]++] = i;
+
+    /* order buckets by size (biggest first) */
+    uint order_cnt = 0;
+    for (uint sz = max_size; sz > 0; sz--)    {
+        for (uint b = 0; b < buckets_cnt; b++)   {
+            if (bucket_starts[b+1] - bucket_starts[b] == sz)
+                order[order_cnt++] = b;
+        }
+    }
+
+    memset(used, 0x00, items_cnt);
+    memset(disps, 0x00, sizeof(uint)*buckets_cnt);
+    uint max_disp = maxui(items_cnt*16, 1024);
+
+    for (uint i = 0; i < order_cnt; i++) {
+        uint b = order[i];
+        const uint* bkeys = &sorted[bucket_starts[b]];
+        uint bsize = bucket_starts[b+1] - bucket_starts[b];
+
+        /* duplicate keys always fall in the same bucket */
+        for (uint k = 0; k < bsize; k++) {
+            for (uint j = k + 1; j < bsize; j++) {
+                if (keys[bkeys[k]] == keys[bkeys[j]])    {
+                    *dup = TRUE;
+                    return FALSE;
+                }
+            }
+        }
+
+        uint disp;
+        for (disp = 1; disp < max_disp; disp++)  {
+            uint k;
+            for (k = 0; k < bsize; k++)  {
+                uint slot = frozen_slot(keys[bkeys[k]], seed, disp, items_cnt);
+                if (used[slot])
+                    break;
+                /* collision with previous keys of the same bucket */
+                used[slot] = 2;
+                slots[k] = slot;
+            }
+
+            if (k == bsize)
+                break;
+
+            /* revert temp marks */
+            for (uint j = 0; j < k; j++)
+                used[slots[j]] = 0;
+        }
+
+        if (disp == max_disp)
+            return FALSE;
+
+        disps[b] = disp;
+        for (uint k = 0; k < bsize; k++) {
+            used[slots[k]] = 1;
+            items[slots[k]].hash = keys[bkeys[k]];
+            items[slots[k]].value = values[bkeys[k]];
+        }
+    }
+
+    return TRUE;
+}
+
+result_t hashtable_frozen_build(struct allocator* alloc, struct allocator* tmp_alloc,
+                                struct hashtable_frozen* table,
+                                const uint* keys, const uint* values, int cnt, uint mem_id)
+{
+    memset(table, 0x00, sizeof(struct hashtable_frozen));
+
+    uint items_cnt = (uint)cnt;
+    uint buckets_cnt = maxui(items_cnt/FROZEN_BUCKET_SIZE, 1);
+    size_t blob_size = frozen_blob_size(items_cnt, buckets_cnt);
+
+    uint8* blob = (uint8*)A_ALLOC(alloc, blob_size, mem_id);
+    if (blob == NULL)
+        return RET_OUTOFMEMORY;
+    memset(blob, 0x00, blob_size);
+
+    struct frozen_header* header = (struct frozen_header*)blob;
+    uint* disps = (uint*)(blob + sizeof(struct frozen_header));
+    struct hashtable_frozen_item* items = (struct hashtable_frozen_item*)(disps + buckets_cnt);
+
+    header->sign = FROZEN_SIGN;
+    header->items_cnt = items_cnt;
+    header->buckets_cnt = buckets_cnt;
+
+    if (items_cnt > 0)  {
+        /* temp buffers */
+        size_t tmp_size = sizeof(uint)*(buckets_cnt + 1) + sizeof(uint)*items_cnt*2 +
+            sizeof(uint)*buckets_cnt + items_cnt;
+        uint8* tmp = (uint8*)A_ALLOC(tmp_alloc, tmp_size, mem_id);
+        if (tmp == NULL)    {
+            A_FREE(alloc, blob);
+            return RET_OUTOFMEMORY;
+        }
+        uint* bucket_starts = (uint*)tmp;
+        uint* sorted = bucket_starts + buckets_cnt + 1;
+        uint* slots = sorted + items_cnt;
+        uint* order = slots + items_cnt;
+        uint8* used = (uint8*)(order + buckets_cnt);
+
+        int placed = FALSE;
+        int dup = FALSE;
+        for (uint i = 0; i < FROZEN_SEED_TRIES && !placed && !dup; i++)    {
+            header->seed = hash_u64(((uint64)i << 32) | items_cnt);
+            placed = frozen_place(items, disps, items_cnt, buckets_cnt, header->seed, keys, values,
+                                  bucket_starts, sorted, order, slots, used, &dup);
+        }
+
+        A_FREE(tmp_alloc, tmp);
+
+        if (!placed)    {
+            A_FREE(alloc, blob);
+            if (dup)
+                err_print(__FILE__, __LINE__, "frozen hash-table: keys are not unique");
+            else
+                err_print(__FILE__, __LINE__, "frozen hash-table: could not build perfect hash");
+            return RET_FAIL;
+        }
+    }
+
+    hashtable_frozen_load(table, blob, blob_size);
+    table->alloc = alloc;
+    return RET_OK;
+}
+
+result_t hashtable_frozen_load(struct hashtable_frozen* table, const void* blob, size_t blob_size)
+{
+    const struct frozen_header* header = (const struct frozen_header*)blob;
+    memset(table, 0x00, sizeof(struct hashtable_frozen));
+
+    if (blob_size < sizeof(struct frozen_header) || header->sign != FROZEN_SIGN ||
+        header->buckets_cnt == 0 ||
+        blob_size < frozen_blob_size(header->items_cnt, header->buckets_cnt))
+    {
+        return RET_INVALIDARG;
+    }
+
+    table->blob = (void*)blob;
+    table->blob_size = blob_size;
+    table->items_cnt = header->items_cnt;
+    table->buckets_cnt = header->buckets_cnt;
+    table->seed = header->seed;
+    table->disps = (const uint*)((const uint8*)blob + sizeof(struct frozen_header));
+    table->items = (const struct hashtable_frozen_item*)(table->disps + table->buckets_cnt);
+    return RET_OK;
+}
+
+void hashtable_frozen_destroy(struct hashtable_frozen* table)
+{
+    if (table->alloc != NULL && table->blob != NULL)
+        A_FREE(table->alloc, table->blob);
+    memset(table, 0x00, sizeof(struct hashtable_frozen));
+}
+
+const void* hashtable_frozen_getblob(const struct hashtable_frozen* table, OUT size_t* blob_size)
+{
+    *blob_size = table->blob_size;
+    return table->blob;
+}
+
+int hashtable_frozen_isempty(const struct hashtable_frozen* table)
+{
+    return (table->items_cnt == 0);
+}
+
+const struct hashtable_frozen_item* hashtable_frozen_find(const struct hashtable_frozen* table,
+                                                          uint hash_key)
+{
+    if (table->items_cnt == 0)
+        return NULL;
+
+    uint disp = table->disps[frozen_mix(hash_key, table->seed) % table->buckets_cnt];
+    const struct hashtable_frozen_item* item =
+        &table->items[frozen_slot(hash_key, table->seed, disp, table->items_cnt)];
+    return (item->hash == hash_key) ? item : NULL;
+}
+
 /*************************************************************************************************/
 static int probe_linear(int idx, uint hash, int slot_cnt, const struct hashtable_item* items)
 {
@@ -384,6 +680,36 @@ static int probe_linear(int idx, uint hash, int slot_cnt, const struct hashtable
     return -1;
 }
 
+/* batch find for fixed/open tables: first pass calculates bucket indexes of a group of keys and
+ * prefetches them, second pass resolves the keys, so cache misses of the group are overlapped */
+static void hashtable_find_batch(const struct hashtable_item* items, int slots_cnt,
+                                 const uint* keys, int cnt, struct hashtable_item** result)
+{
+    int idxs[HASHTABLE_BATCH_SIZE];
+
+    if (slots_cnt == 0) {
+        memset(result, 0x00, sizeof(struct hashtable_item*)*cnt);
+        return;
+    }
+
+    for (int i = 0; i < cnt; i += HASHTABLE_BATCH_SIZE)  {
+        int c = mini(cnt - i, HASHTABLE_BATCH_SIZE);
+
+        for (int k = 0; k < c; k++)  {
+            idxs[k] = keys[i+k] % slots_cnt;
+            PREFETCH(&items[idxs[k]]);
+        }
+
+        for (int k = 0; k < c; k++)  {
+            uint hash_key = keys[i+k];
+            int idx = idxs[k];
+            if (items[idx].hash != hash_key)
+                idx = probe_linear(idx, hash_key, slots_cnt, items);
+            result[i+k] = (idx != -1) ? (struct hashtable_item*)&items[idx] : NULL;
+        }
+    }
+}
+
 struct pn_cacheitem
 {
     int n;
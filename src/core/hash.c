@@ -15,8 +15,6 @@
 
 #include "dhcore/hash.h"
 
-#define HSEED 98424
-
 #define HASH_M 0x5bd1e995
 #define HASH_R 24
 #define MMIX(h, k) { k *= HASH_M; k ^= k >> HASH_R; k *= HASH_M; h *= HASH_M; h ^= k; }
@@ -89,7 +87,13 @@ static void hash_mixtail(struct hash_incr* h, const uint8** pdata, size_t* psize
 /* Hash functions */
 uint hash_str(const char* str)
 {
-    return hash_murmur32(str, strlen(str), HSEED);
+    return hash_murmur32(str, strlen(str), HASH_STR_SEED);
+}
+
+void hash_str_table(uint* hashes, const char* const* strs, uint cnt)
+{
+    for (uint i = 0; i < cnt; i++)
+        hashes[i] = hash_murmur32(strs[i], strlen(strs[i]), HASH_STR_SEED);
 }
 
 uint hash_murmur32(const void* key, size_t size_bytes, uint seed)
@@ -0,0 +1,591 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+/* read-only JSON trees, parsed in two stages:
+ * 1) structural index: input is classified in 64 byte blocks into bitmasks (quotes, backslashes,
+ *    operators, whitespace), strings are masked out with prefix-xor of the unescaped quotes, and
+ *    positions of the operators, string and scalar starts are written to an index
+ * 2) tree: index is walked once, and cJSON nodes and decoded strings are written into a single
+ *    block that is sized from the index, so json_t accessors work on it and it's freed at once */
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_SIMD_SSE_)
+#include <emmintrin.h>
+#endif
+
+#include "cJSON/cJSON.h"
+
+#include "dhcore/json.h"
+#include "dhcore/mem-mgr.h"
+#include "dhcore/err.h"
+#include "dhcore/numeric.h"
+
+#define JSON_DOM_NODE 0x200     /* type flag of the nodes, upper bits are ignored by cJSON */
+#define JSON_DOM_ROOT 0x400     /* type flag of the root, arena header is placed before it */
+#define JSON_DOM_DEPTH 1024
+#define JSON_DOM_NUMLEN 64
+
+#define JSON_BITS_ODD 0xaaaaaaaaaaaaaaaaull
+
+struct json_dom
+{
+    struct allocator* alloc;
+    size_t size;
+};
+
+struct json_dom_level
+{
+    cJSON* node;
+    cJSON* last;    /* last child */
+};
+
+struct json_dom_parser
+{
+    const char* str;
+    size_t len;
+    const uint* idx;
+    uint idx_cnt;
+    cJSON* nodes;   /* next free node */
+    cJSON* nodes_end;
+    char* strs;     /* next free string byte */
+    struct json_dom_level stack[JSON_DOM_DEPTH];
+};
+
+/*************************************************************************************************/
+INLINE uint json_dom_ctz(uint64 n)
+{
+#if defined(_GNUC_)
+    return (uint)__builtin_ctzll(n);
+#else
+    uint i = 0;
+    while ((n & 1) == 0)    {
+        n >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+/* block masks: bit i is set if character i of the block is in the class */
+struct json_dom_masks
+{
+    uint64 quote;
+    uint64 bs;
+    uint64 op;
+    uint64 ws;
+};
+
+#if defined(_SIMD_SSE_)
+INLINE uint64 json_dom_movemask(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+    return (uint64)(uint)_mm_movemask_epi8(a) |
+        ((uint64)(uint)_mm_movemask_epi8(b) << 16) |
+        ((uint64)(uint)_mm_movemask_epi8(c) << 32) |
+        ((uint64)(uint)_mm_movemask_epi8(d) << 48);
+}
+
+static void json_dom_classify(const char* block, struct json_dom_masks* m)
+{
+    __m128i v[4];
+    __m128i quote[4], bs[4], op[4], ws[4];
+    const __m128i c_quote = _mm_set1_epi8('"');
+    const __m128i c_bs = _mm_set1_epi8('\\');
+    const __m128i c_case = _mm_set1_epi8(0x20);
+    const __m128i c_open = _mm_set1_epi8('{');     /* '[' | 0x20 */
+    const __m128i c_close = _mm_set1_epi8('}');    /* ']' | 0x20 */
+    const __m128i c_colon = _mm_set1_epi8(':');
+    const __m128i c_comma = _mm_set1_epi8(',');
+    const __m128i c_space = _mm_set1_epi8(' ');
+    const __m128i c_tab = _mm_set1_epi8('\t');
+    const __m128i c_lf = _mm_set1_epi8('\n');
+    const __m128i c_cr = _mm_set1_epi8('\r');
+
+    for (int i = 0; i < 4; i++) {
+        v[i] = _mm_loadu_si128((const __m128i*)(block + i*16));
+        __m128i lc = _mm_or_si128(v[i], c_case);
+        quote[i] = _mm_cmpeq_epi8(v[i], c_quote);
+        bs[i] = _mm_cmpeq_epi8(v[i], c_bs);
+        op[i] = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(lc, c_open), _mm_cmpeq_epi8(lc, c_close)),
+                             _mm_or_si128(_mm_cmpeq_epi8(v[i], c_colon),
+                                          _mm_cmpeq_epi8(v[i], c_comma)));
+        ws[i] = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v[i], c_space),
+                                          _mm_cmpeq_epi8(v[i], c_tab)),
+                             _mm_or_si128(_mm_cmpeq_epi8(v[i], c_lf),
+                                          _mm_cmpeq_epi8(v[i], c_cr)));
+    }
+
+    m->quote = json_dom_movemask(quote[0], quote[1], quote[2], quote[3]);
+    m->bs = json_dom_movemask(bs[0], bs[1], bs[2], bs[3]);
+    m->op = json_dom_movemask(op[0], op[1], op[2], op[3]);
+    m->ws = json_dom_movemask(ws[0], ws[1], ws[2], ws[3]);
+}
+#else
+static void json_dom_classify(const char* block, struct json_dom_masks* m)
+{
+    memset(m, 0x00, sizeof(struct json_dom_masks));
+    for (int i = 0; i < 64; i++)    {
+        uint64 bit = 1ull << i;
+        switch (block[i])   {
+        case '"':   m->quote |= bit;    break;
+        case '\\':  m->bs |= bit;       break;
+        case '{':
+        case '}':
+        case '[':
+        case ']':
+        case ':':
+        case ',':   m->op |= bit;       break;
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':  m->ws |= bit;       break;
+        default:    break;
+        }
+    }
+}
+#endif
+
+/* characters that are escaped by odd runs of backslashes, prev_escaped carries the escape of -
+ * the first character of the next block */
+INLINE uint64 json_dom_escaped(uint64 bs, uint64* prev_escaped)
+{
+    uint64 potential = bs & ~*prev_escaped;
+    /* subtraction turns runs that start on even bits into 1s, xor with odd bits leaves the escape -
+     * chars and the escaped (terminal) chars of each run */
+    uint64 codes = (((potential << 1) | JSON_BITS_ODD) - potential) ^ JSON_BITS_ODD;
+    uint64 escaped = codes ^ (bs | *prev_escaped);
+    *prev_escaped = (codes & bs) >> 63;
+    return escaped;
+}
+
+INLINE uint64 json_dom_prefixxor(uint64 n)
+{
+    n ^= n << 1;
+    n ^= n << 2;
+    n ^= n << 4;
+    n ^= n << 8;
+    n ^= n << 16;
+    n ^= n << 32;
+    return n;
+}
+
+/* stage 1: writes positions of operators, string starts and scalar starts to idx, idx must have -
+ * room for len+1 items, returns number of items, or -1 if a string is not terminated */
+static int json_dom_index(const char* str, size_t len, uint* idx)
+{
+    char tail[64];
+    uint64 prev_escaped = 0;
+    uint64 prev_instr = 0;
+    uint64 prev_scalar = 0;
+    uint cnt = 0;
+
+    for (size_t offset = 0; offset < len; offset += 64)    {
+        const char* block = str + offset;
+        if (len - offset < 64)  {
+            /* last block is padded with whitespace */
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, block, len - offset);
+            block = tail;
+        }
+
+        struct json_dom_masks m;
+        json_dom_classify(block, &m);
+
+        uint64 quote = m.quote & ~json_dom_escaped(m.bs, &prev_escaped);
+        uint64 instr = json_dom_prefixxor(quote) ^ prev_instr;  /* opening quote and contents */
+        prev_instr = (uint64)((int64)instr >> 63);
+
+        uint64 scalar = ~(m.op | m.ws | m.quote | instr);
+        uint64 scalar_start = scalar & ~((scalar << 1) | prev_scalar);
+        prev_scalar = scalar >> 63;
+
+        uint64 s = ((m.op | scalar_start) & ~instr) | (quote & instr);
+        while (s != 0)  {
+            idx[cnt++] = (uint)offset + json_dom_ctz(s);
+            s &= s - 1;
+        }
+    }
+
+    return prev_instr == 0 ? (int)cnt : -1;
+}
+
+/*************************************************************************************************/
+INLINE int json_dom_isdelim(const struct json_dom_parser* p, size_t pos)
+{
+    if (pos >= p->len)
+        return TRUE;
+    char c = p->str[pos];
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ',' || c == ':' ||
+        c == ']' || c == '}' || c == '[' || c == '{' || c == '"';
+}
+
+static int json_dom_hex4(const char* s, const char* end)
+{
+    if (end - s < 4)
+        return -1;
+    int n = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = s[i];
+        if (c >= '0' && c <= '9')       n = (n << 4) | (c - '0');
+        else if (c >= 'a' && c <= 'f')  n = (n << 4) | (c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F')  n = (n << 4) | (c - 'A' + 10);
+        else                            return -1;
+    }
+    return n;
+}
+
+/* decodes string that starts at the quote into the string area, returns NULL if invalid */
+static char* json_dom_string(struct json_dom_parser* p, size_t pos)
+{
+    const char* s = p->str + pos + 1;
+    const char* end = p->str + p->len;
+    char* r = p->strs;
+    char* d = r;
+
+    for (;;)    {
+        /* plain characters are copied in runs */
+        const char* run = s;
+        while (s < end && *s != '"' && *s != '\\' && (uint8)*s >= 0x20)
+            s++;
+        memcpy(d, run, s - run);
+        d += s - run;
+
+        if (s == end || (uint8)*s < 0x20)
+            return NULL;
+        if (*s++ == '"')
+            break;
+
+        if (s == end)
+            return NULL;
+        int cp;
+        switch (*s++)   {
+        case '"':   cp = '"';   break;
+        case '\\':  cp = '\\';  break;
+        case '/':   cp = '/';   break;
+        case 'b':   cp = '\b';  break;
+        case 'f':   cp = '\f';  break;
+        case 'n':   cp = '\n';  break;
+        case 'r':   cp = '\r';  break;
+        case 't':   cp = '\t';  break;
+        case 'u':
+            cp = json_dom_hex4(s, end);
+            if (cp == -1)
+                return NULL;
+            s += 4;
+            /* utf-16 surrogate pair */
+            if (cp >= 0xd800 && cp < 0xdc00)    {
+                int lo = (end - s >= 2 && s[0] == '\\' && s[1] == 'u') ? json_dom_hex4(s + 2, end) :
+                    -1;
+                if (lo < 0xdc00 || lo >= 0xe000)
+                    return NULL;
+                s += 6;
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+            }
+            break;
+        default:
+            return NULL;
+        }
+
+        /* escapes are longer than their utf-8 encoding, so decoded string fits the input size */
+        if (cp < 0x80)  {
+            *d++ = (char)cp;
+        }   else if (cp < 0x800)    {
+            *d++ = (char)(0xc0 | (cp >> 6));
+            *d++ = (char)(0x80 | (cp & 0x3f));
+        }   else if (cp < 0x10000)  {
+            *d++ = (char)(0xe0 | (cp >> 12));
+            *d++ = (char)(0x80 | ((cp >> 6) & 0x3f));
+            *d++ = (char)(0x80 | (cp & 0x3f));
+        }   else    {
+            *d++ = (char)(0xf0 | (cp >> 18));
+            *d++ = (char)(0x80 | ((cp >> 12) & 0x3f));
+            *d++ = (char)(0x80 | ((cp >> 6) & 0x3f));
+            *d++ = (char)(0x80 | (cp & 0x3f));
+        }
+    }
+
+    *d++ = 0;
+    p->strs = d;
+    return r;
+}
+
+/* parses true/false/null or number that starts at pos, returns FALSE if invalid */
+static int json_dom_scalar(struct json_dom_parser* p, size_t pos, cJSON* node)
+{
+    const char* s = p->str + pos;
+    size_t remain = p->len - pos;
+
+    if (remain >= 4 && memcmp(s, "true", 4) == 0 && json_dom_isdelim(p, pos + 4))   {
+        node->type = cJSON_True;
+        node->valueint = 1;
+        return TRUE;
+    }   else if (remain >= 5 && memcmp(s, "false", 5) == 0 && json_dom_isdelim(p, pos + 5))  {
+        node->type = cJSON_False;
+        return TRUE;
+    }   else if (remain >= 4 && memcmp(s, "null", 4) == 0 && json_dom_isdelim(p, pos + 4))   {
+        node->type = cJSON_NULL;
+        return TRUE;
+    }
+
+    /* numbers are copied, because input is not necessarily null-terminated */
+    char num[JSON_DOM_NUMLEN];
+    size_t len = 0;
+    while (!json_dom_isdelim(p, pos + len)) {
+        char c = s[len];
+        if (len == JSON_DOM_NUMLEN - 1 ||
+            !((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E'))
+        {
+            return FALSE;
+        }
+        num[len++] = c;
+    }
+    num[len] = 0;
+    if (num[0] != '-' && (num[0] < '0' || num[0] > '9'))
+        return FALSE;
+
+    char* end;
+    node->valuedouble = strtod(num, &end);
+    if (end != num + len)
+        return FALSE;
+    node->type = cJSON_Number;
+    node->valueint = (int)node->valuedouble;
+    return TRUE;
+}
+
+/* reads key string and it's ':' at idx[*pi] */
+static const char* json_dom_key(struct json_dom_parser* p, uint* pi, char** pkey)
+{
+    uint i = *pi;
+    if (i + 1 >= p->idx_cnt || p->str[p->idx[i]] != '"')
+        return "expected key string";
+    *pkey = json_dom_string(p, p->idx[i]);
+    if (*pkey == NULL)
+        return "invalid string";
+    if (p->str[p->idx[i + 1]] != ':')
+        return "expected ':'";
+    *pi = i + 2;
+    return NULL;
+}
+
+/* stage 2: builds the tree from the index, root is the first node, returns error message */
+static const char* json_dom_build(struct json_dom_parser* p)
+{
+    const char* str = p->str;
+    const uint* idx = p->idx;
+    uint cnt = p->idx_cnt;
+    uint i = 0;
+    int depth = 0;
+    char* key = NULL;
+    const char* err;
+
+    for (;;)    {
+        /* value */
+        if (i >= cnt)
+            return "unexpected end of data";
+        size_t pos = idx[i++];
+        char c = str[pos];
+
+        /* nodes are counted from the index, malformed data may need more */
+        if (p->nodes == p->nodes_end)
+            return "invalid value";
+        cJSON* node = p->nodes++;
+        memset(node, 0x00, sizeof(cJSON));
+        node->string = key;
+        key = NULL;
+        if (depth > 0)  {
+            struct json_dom_level* parent = &p->stack[depth - 1];
+            if (parent->last != NULL)   {
+                parent->last->next = node;
+                node->prev = parent->last;
+            }   else    {
+                parent->node->child = node;
+            }
+            parent->last = node;
+        }
+
+        if (c == '{' || c == '[')   {
+            if (depth == JSON_DOM_DEPTH)
+                return "too many nested values";
+            node->type = (c == '{') ? cJSON_Object : cJSON_Array;
+            p->stack[depth].node = node;
+            p->stack[depth].last = NULL;
+            depth++;
+
+            if (i < cnt && str[idx[i]] == (c == '{' ? '}' : ']'))   {
+                i++;
+                depth--;
+            }   else if (c == '{')  {
+                if ((err = json_dom_key(p, &i, &key)) != NULL)
+                    return err;
+                continue;
+            }   else    {
+                continue;
+            }
+        }   else if (c == '"')  {
+            node->type = cJSON_String;
+            node->valuestring = json_dom_string(p, pos);
+            if (node->valuestring == NULL)
+                return "invalid string";
+        }   else if (!json_dom_scalar(p, pos, node))    {
+            return "invalid value";
+        }
+
+        /* separators and ends of containers, until the next value */
+        for (;;)    {
+            if (depth == 0)
+                return i == cnt ? NULL : "unexpected data after the root value";
+            if (i >= cnt)
+                return "unexpected end of data";
+
+            const cJSON* parent = p->stack[depth - 1].node;
+            c = str[idx[i++]];
+            if (c == ',')   {
+                if (parent->type == cJSON_Object && (err = json_dom_key(p, &i, &key)) != NULL)
+                    return err;
+                break;
+            }   else if (c == (parent->type == cJSON_Object ? '}' : ']'))   {
+                depth--;
+            }   else    {
+                return parent->type == cJSON_Object ? "expected ',' or '}'" :
+                    "expected ',' or ']'";
+            }
+        }
+    }
+}
+
+static void json_dom_setflags(cJSON* nodes, cJSON* end)
+{
+    for (cJSON* n = nodes; n < end; n++)
+        n->type |= JSON_DOM_NODE;
+    nodes->type |= JSON_DOM_ROOT;
+}
+
+/*************************************************************************************************/
+json_t json_parsedom(const char* str, size_t len, struct allocator* alloc)
+{
+    /* utf-8 BOM */
+    if (len >= 3 && memcmp(str, "\xef\xbb\xbf", 3) == 0)   {
+        str += 3;
+        len -= 3;
+    }
+    if (len >= UINT32_MAX)  {
+        err_printf(__FILE__, __LINE__, "JSON parse failed: data is too large");
+        return NULL;
+    }
+
+    uint* idx = (uint*)A_ALLOC(alloc, sizeof(uint)*(len + 1), 0);
+    if (idx == NULL)    {
+        err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+        return NULL;
+    }
+
+    int idx_cnt = json_dom_index(str, len, idx);
+    if (idx_cnt <= 0)   {
+        A_FREE(alloc, idx);
+        err_printf(__FILE__, __LINE__, "JSON parse failed: %s",
+                   idx_cnt == 0 ? "empty data" : "unterminated string");
+        return NULL;
+    }
+
+    /* every item in the index is a value, except separators, closing brackets and keys */
+    int node_cnt = 0;
+    for (int i = 0; i < idx_cnt; i++)   {
+        char c = str[idx[i]];
+        if (c == ':')
+            node_cnt--;
+        else if (c != ',' && c != ']' && c != '}')
+            node_cnt++;
+    }
+    node_cnt = maxi(node_cnt, 1);
+
+    /* decoded strings are never longer than the input */
+    size_t size = sizeof(struct json_dom) + sizeof(cJSON)*node_cnt + len + 1;
+    struct json_dom* dom = (struct json_dom*)A_ALLOC(alloc, size, 0);
+    if (dom == NULL)    {
+        A_FREE(alloc, idx);
+        err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+        return NULL;
+    }
+    dom->alloc = alloc;
+    dom->size = size;
+
+    struct json_dom_parser* p = (struct json_dom_parser*)ALLOC(sizeof(struct json_dom_parser), 0);
+    if (p == NULL)  {
+        A_FREE(alloc, dom);
+        A_FREE(alloc, idx);
+        err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+        return NULL;
+    }
+    cJSON* root = (cJSON*)(dom + 1);
+    p->str = str;
+    p->len = len;
+    p->idx = idx;
+    p->idx_cnt = (uint)idx_cnt;
+    p->nodes = root;
+    p->nodes_end = root + node_cnt;
+    p->strs = (char*)(root + node_cnt);
+
+    const char* err = json_dom_build(p);
+    if (err == NULL)
+        json_dom_setflags(root, p->nodes);
+    FREE(p);
+    A_FREE(alloc, idx);
+
+    if (err != NULL)    {
+        err_printf(__FILE__, __LINE__, "JSON parse failed: %s", err);
+        A_FREE(alloc, dom);
+        return NULL;
+    }
+    return root;
+}
+
+json_t json_parsedomf(file_t f, struct allocator* alloc)
+{
+    /* memory files are parsed in place */
+    size_t pos = fio_getpos(f);
+    size_t size = fio_getsize(f) - pos;
+    enum file_type type = fio_gettype(f);
+    if ((type == FILE_TYPE_MEM || type == FILE_TYPE_MMAP) && fio_getptr(f) != NULL)
+        return json_parsedom((const char*)fio_getptr(f) + pos, size, alloc);
+
+    char* buffer = (char*)A_ALLOC(alloc, size + 1, 0);
+    if (buffer == NULL) {
+        err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+        return NULL;
+    }
+    if (fio_read(f, buffer, 1, size) != size)   {
+        A_FREE(alloc, buffer);
+        err_printf(__FILE__, __LINE__, "JSON load failed: could not read file '%s'",
+                   fio_getpath(f));
+        return NULL;
+    }
+
+    json_t j = json_parsedom(buffer, size, alloc);
+    A_FREE(alloc, buffer);
+    return j;
+}
+
+int json_dom_destroy(json_t j)
+{
+    if (!BIT_CHECK(j->type, JSON_DOM_NODE))
+        return FALSE;
+
+    /* nodes of the tree are freed with the root */
+    ASSERT(BIT_CHECK(j->type, JSON_DOM_ROOT));
+    struct json_dom* dom = (struct json_dom*)j - 1;
+    A_FREE(dom->alloc, dom);
+    return TRUE;
+}
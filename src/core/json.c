@@ -14,6 +14,7 @@
  ***********************************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "cJSON/cJSON.h"
 
@@ -31,6 +32,10 @@
 #define JSON_ALLOC_256   4
 #define JSON_ALLOC_CNT   5
 
+#define JSON_READER_CHUNK (64*1024)
+#define JSON_READER_TOKEN 256
+#define JSON_READER_DEPTH 256
+
 /*************************************************************************************************
  * types/globals
  */
@@ -42,6 +47,38 @@ struct json_mgr
 
 static struct json_mgr* g_json = NULL;
 
+/* json-dom.c */
+int json_dom_destroy(json_t j);
+
+enum json_reader_state
+{
+    JSON_STATE_VALUE = 0,   /* root value, or value of a key */
+    JSON_STATE_VALUE_FIRST, /* first value of an array, or end of the array */
+    JSON_STATE_KEY_FIRST,   /* first key of an object, or end of the object */
+    JSON_STATE_NEXT,        /* separator, or end of the container */
+    JSON_STATE_DONE         /* root value is read */
+};
+
+struct json_reader
+{
+    file_t f;
+    struct allocator* alloc;
+    const char* data;   /* current chunk, or whole data of memory files */
+    size_t pos;
+    size_t size;
+    char* chunk;    /* NULL if data of memory file is used directly */
+    char* token;    /* decoded key/string or text of the number */
+    size_t token_len;
+    size_t token_max;
+    fl64 num;
+    int b;
+    int line;
+    enum json_reader_state state;
+    enum json_event event;
+    int depth;
+    char stack[JSON_READER_DEPTH];  /* '{' or '[' for each container */
+};
+
 /*************************************************************************************************/
 INLINE void* json_alloc_putsize(void* ptr, uint sz)
 {
@@ -289,7 +326,8 @@ void json_destroy(json_t j)
     ASSERT(g_json);
 
     ASSERT(j != NULL);
-    cJSON_Delete(j);
+    if (!json_dom_destroy(j))
+        cJSON_Delete(j);
 }
 
 void json_seti(json_t j, int n)
@@ -374,7 +412,7 @@ int json_getb(json_t j)
 
 enum json_type json_gettype(json_t j)
 {
-    int t = (j)->type;
+    int t = (j)->type & 0xff;  /* upper bits are flags */
     if (t == 0)
         return JSON_BOOL;
     return (enum json_type)t;
@@ -467,3 +505,464 @@ void json_replaceitem_inarr(json_t obj, int idx, json_t item)
 {
     cJSON_ReplaceItemInArray(obj, idx, item);
 }
+
+/*************************************************************************************************
+ * streaming reader
+ */
+static int json_reader_fill(struct json_reader* r)
+{
+    if (r->chunk == NULL)
+        return FALSE;
+    r->data = r->chunk;
+    r->pos = 0;
+    r->size = fio_read(r->f, r->chunk, 1, JSON_READER_CHUNK);
+    return r->size > 0;
+}
+
+INLINE int json_reader_peek(struct json_reader* r)
+{
+    if (r->pos == r->size && !json_reader_fill(r))
+        return -1;
+    return (uint8)r->data[r->pos];
+}
+
+INLINE int json_reader_getc(struct json_reader* r)
+{
+    int c = json_reader_peek(r);
+    if (c != -1)
+        r->pos++;
+    return c;
+}
+
+static int json_reader_skipws(struct json_reader* r)
+{
+    for (;;)    {
+        while (r->pos < r->size)    {
+            char c = r->data[r->pos];
+            if (c == '\n')
+                r->line++;
+            else if (c != ' ' && c != '\t' && c != '\r')
+                return (uint8)c;
+            r->pos++;
+        }
+        if (!json_reader_fill(r))
+            return -1;
+    }
+}
+
+static enum json_event json_reader_fail(struct json_reader* r, const char* msg)
+{
+    err_printf(__FILE__, __LINE__, "JSON parse '%s' failed: %s (line: %d)", fio_getpath(r->f), msg,
+               r->line);
+    r->event = JSON_EVENT_ERROR;
+    return JSON_EVENT_ERROR;
+}
+
+static int json_reader_append(struct json_reader* r, const char* str, size_t len)
+{
+    if (r->token_len + len + 1 > r->token_max)  {
+        size_t token_max = r->token_max*2;
+        while (r->token_len + len + 1 > token_max)
+            token_max *= 2;
+        char* token = (char*)A_REALLOC(r->alloc, r->token, token_max, 0);
+        if (token == NULL)
+            return FALSE;
+        r->token = token;
+        r->token_max = token_max;
+    }
+    memcpy(r->token + r->token_len, str, len);
+    r->token_len += len;
+    return TRUE;
+}
+
+/* appends code point as utf-8 */
+static int json_reader_appendcp(struct json_reader* r, uint cp)
+{
+    char s[4];
+    if (cp < 0x80)  {
+        s[0] = (char)cp;
+        return json_reader_append(r, s, 1);
+    }   else if (cp < 0x800)    {
+        s[0] = (char)(0xc0 | (cp >> 6));
+        s[1] = (char)(0x80 | (cp & 0x3f));
+        return json_reader_append(r, s, 2);
+    }   else if (cp < 0x10000)  {
+        s[0] = (char)(0xe0 | (cp >> 12));
+        s[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+        s[2] = (char)(0x80 | (cp & 0x3f));
+        return json_reader_append(r, s, 3);
+    }   else    {
+        s[0] = (char)(0xf0 | (cp >> 18));
+        s[1] = (char)(0x80 | ((cp >> 12) & 0x3f));
+        s[2] = (char)(0x80 | ((cp >> 6) & 0x3f));
+        s[3] = (char)(0x80 | (cp & 0x3f));
+        return json_reader_append(r, s, 4);
+    }
+}
+
+/* reads 4 hex digits of \u escape, returns -1 if invalid */
+static int json_reader_hex4(struct json_reader* r)
+{
+    int n = 0;
+    for (int i = 0; i < 4; i++) {
+        int c = json_reader_getc(r);
+        if (c >= '0' && c <= '9')       n = (n << 4) | (c - '0');
+        else if (c >= 'a' && c <= 'f')  n = (n << 4) | (c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F')  n = (n << 4) | (c - 'A' + 10);
+        else                            return -1;
+    }
+    return n;
+}
+
+/* reads string after the opening quote into the token buffer, returns error message or NULL */
+static const char* json_reader_readstr(struct json_reader* r)
+{
+    r->token_len = 0;
+    for (;;)    {
+        /* plain characters are copied in runs */
+        const char* s = r->data + r->pos;
+        const char* e = r->data + r->size;
+        const char* p = s;
+        while (p < e && *p != '"' && *p != '\\' && (uint8)*p >= 0x20)
+            p++;
+        if (p > s && !json_reader_append(r, s, p - s))
+            return "out of memory";
+        r->pos = p - r->data;
+
+        if (p == e) {
+            if (!json_reader_fill(r))
+                return "unterminated string";
+            continue;
+        }
+
+        r->pos++;
+        if (*p == '"')  {
+            r->token[r->token_len] = 0;
+            return NULL;
+        }   else if (*p != '\\')    {
+            return "invalid character in string";
+        }
+
+        int c = json_reader_getc(r);
+        int cp;
+        switch (c)  {
+        case '"':
+        case '\\':
+        case '/':   cp = c;     break;
+        case 'b':   cp = '\b';  break;
+        case 'f':   cp = '\f';  break;
+        case 'n':   cp = '\n';  break;
+        case 'r':   cp = '\r';  break;
+        case 't':   cp = '\t';  break;
+        case 'u':
+            cp = json_reader_hex4(r);
+            if (cp == -1)
+                return "invalid unicode escape";
+            /* utf-16 surrogate pair */
+            if (cp >= 0xd800 && cp < 0xdc00)    {
+                int lo = (json_reader_getc(r) == '\\' && json_reader_getc(r) == 'u') ?
+                    json_reader_hex4(r) : -1;
+                if (lo < 0xdc00 || lo >= 0xe000)
+                    return "invalid unicode surrogate pair";
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+            }
+            break;
+        default:
+            return "invalid escape sequence";
+        }
+
+        if (!json_reader_appendcp(r, (uint)cp))
+            return "out of memory";
+    }
+}
+
+static const char* json_reader_readnum(struct json_reader* r)
+{
+    r->token_len = 0;
+    for (;;)    {
+        const char* s = r->data + r->pos;
+        const char* e = r->data + r->size;
+        const char* p = s;
+        while (p < e && ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.' ||
+               *p == 'e' || *p == 'E'))
+        {
+            p++;
+        }
+        if (p > s && !json_reader_append(r, s, p - s))
+            return "out of memory";
+        r->pos = p - r->data;
+        if (p < e || !json_reader_fill(r))
+            break;
+    }
+    r->token[r->token_len] = 0;
+
+    char* end;
+    r->num = strtod(r->token, &end);
+    if (end != r->token + r->token_len)
+        return "invalid number";
+    return NULL;
+}
+
+static int json_reader_readlit(struct json_reader* r, const char* lit)
+{
+    for (const char* l = lit; *l != 0; l++) {
+        if (json_reader_getc(r) != *l)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+INLINE void json_reader_endvalue(struct json_reader* r)
+{
+    r->state = (r->depth == 0) ? JSON_STATE_DONE : JSON_STATE_NEXT;
+}
+
+static enum json_event json_reader_close(struct json_reader* r, int c)
+{
+    ASSERT(r->depth > 0);
+    int obj = r->stack[r->depth - 1] == '{';
+    if (c != (obj ? '}' : ']'))
+        return json_reader_fail(r, obj ? "expected ',' or '}'" : "expected ',' or ']'");
+    r->pos++;
+    r->depth--;
+    json_reader_endvalue(r);
+    r->event = (c == '}') ? JSON_EVENT_OBJECT_END : JSON_EVENT_ARRAY_END;
+    return r->event;
+}
+
+static enum json_event json_reader_key(struct json_reader* r, int c)
+{
+    if (c != '"')
+        return json_reader_fail(r, "expected key string");
+    r->pos++;
+    const char* err = json_reader_readstr(r);
+    if (err != NULL)
+        return json_reader_fail(r, err);
+    if (json_reader_skipws(r) != ':')
+        return json_reader_fail(r, "expected ':'");
+    r->pos++;
+    r->state = JSON_STATE_VALUE;
+    r->event = JSON_EVENT_KEY;
+    return r->event;
+}
+
+static enum json_event json_reader_value(struct json_reader* r, int c)
+{
+    const char* err = NULL;
+    switch (c)  {
+    case '{':
+    case '[':
+        if (r->depth == JSON_READER_DEPTH)
+            return json_reader_fail(r, "too many nested values");
+        r->pos++;
+        r->stack[r->depth++] = (char)c;
+        r->state = (c == '{') ? JSON_STATE_KEY_FIRST : JSON_STATE_VALUE_FIRST;
+        r->event = (c == '{') ? JSON_EVENT_OBJECT_BEGIN : JSON_EVENT_ARRAY_BEGIN;
+        return r->event;
+    case '"':
+        r->pos++;
+        err = json_reader_readstr(r);
+        r->event = JSON_EVENT_STRING;
+        break;
+    case 't':
+    case 'f':
+        r->b = (c == 't');
+        err = json_reader_readlit(r, r->b ? "true" : "false") ? NULL : "invalid literal";
+        r->event = JSON_EVENT_BOOL;
+        break;
+    case 'n':
+        err = json_reader_readlit(r, "null") ? NULL : "invalid literal";
+        r->event = JSON_EVENT_NULL;
+        break;
+    case -1:
+        err = "unexpected end of file";
+        break;
+    default:
+        if (c == '-' || (c >= '0' && c <= '9')) {
+            err = json_reader_readnum(r);
+            r->event = JSON_EVENT_NUM;
+        }   else    {
+            err = "unexpected character";
+        }
+        break;
+    }
+
+    if (err != NULL)
+        return json_reader_fail(r, err);
+    json_reader_endvalue(r);
+    return r->event;
+}
+
+json_reader_t json_reader_create(file_t f, struct allocator* alloc)
+{
+    ASSERT(f != NULL);
+
+    /* memory files are read in place, disk files are read in chunks */
+    enum file_type type = fio_gettype(f);
+    int inplace = (type == FILE_TYPE_MEM || type == FILE_TYPE_MMAP) && fio_getptr(f) != NULL;
+    size_t size = sizeof(struct json_reader) + (inplace ? 0 : JSON_READER_CHUNK);
+
+    struct json_reader* r = (struct json_reader*)A_ALLOC(alloc, size, 0);
+    if (r == NULL)  {
+        err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+        return NULL;
+    }
+    memset(r, 0x00, sizeof(struct json_reader));
+    r->f = f;
+    r->alloc = alloc;
+    r->line = 1;
+    r->token_max = JSON_READER_TOKEN;
+    r->token = (char*)A_ALLOC(alloc, JSON_READER_TOKEN, 0);
+    if (r->token == NULL)   {
+        err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+        A_FREE(alloc, r);
+        return NULL;
+    }
+    r->token[0] = 0;
+
+    if (inplace)    {
+        size_t pos = fio_getpos(f);
+        r->data = (const char*)fio_getptr(f) + pos;
+        r->size = fio_getsize(f) - pos;
+    }   else    {
+        r->chunk = (char*)(r + 1);
+        json_reader_fill(r);
+    }
+
+    /* utf-8 BOM */
+    if (r->size >= 3 && memcmp(r->data, "\xef\xbb\xbf", 3) == 0)
+        r->pos = 3;
+    return r;
+}
+
+void json_reader_destroy(json_reader_t r)
+{
+    ASSERT(r);
+    struct allocator* alloc = r->alloc;
+    A_FREE(alloc, r->token);
+    A_FREE(alloc, r);
+}
+
+enum json_event json_reader_next(json_reader_t r)
+{
+    if (r->event == JSON_EVENT_ERROR || r->event == JSON_EVENT_END)
+        return r->event;
+
+    int c = json_reader_skipws(r);
+    switch (r->state)   {
+    case JSON_STATE_DONE:
+        if (c != -1)
+            return json_reader_fail(r, "unexpected data after the root value");
+        r->event = JSON_EVENT_END;
+        return r->event;
+    case JSON_STATE_NEXT:
+        if (c != ',')
+            return json_reader_close(r, c);
+        r->pos++;
+        c = json_reader_skipws(r);
+        if (r->stack[r->depth - 1] == '{')
+            return json_reader_key(r, c);
+        return json_reader_value(r, c);
+    case JSON_STATE_KEY_FIRST:
+        return (c == '}') ? json_reader_close(r, c) : json_reader_key(r, c);
+    case JSON_STATE_VALUE_FIRST:
+        return (c == ']') ? json_reader_close(r, c) : json_reader_value(r, c);
+    default:
+        return json_reader_value(r, c);
+    }
+}
+
+result_t json_reader_skip(json_reader_t r)
+{
+    if (r->event == JSON_EVENT_KEY) {
+        json_reader_next(r);
+        if (r->event == JSON_EVENT_ERROR)
+            return RET_FAIL;
+    }
+    if (r->event != JSON_EVENT_OBJECT_BEGIN && r->event != JSON_EVENT_ARRAY_BEGIN)
+        return RET_OK;
+
+    /* only brackets outside of strings are counted, contents are not decoded */
+    int depth = 1;
+    int instr = FALSE;
+    for (;;)    {
+        while (r->pos < r->size)    {
+            char c = r->data[r->pos++];
+            if (instr)  {
+                if (c == '\\')  {
+                    if (json_reader_getc(r) == -1)  {
+                        json_reader_fail(r, "unterminated string");
+                        return RET_FAIL;
+                    }
+                }   else if (c == '"')  {
+                    instr = FALSE;
+                }
+            }   else if (c == '"')  {
+                instr = TRUE;
+            }   else if (c == '{' || c == '[')  {
+                depth++;
+            }   else if (c == '}' || c == ']')  {
+                if (--depth == 0)   {
+                    r->depth--;
+                    json_reader_endvalue(r);
+                    r->event = (c == '}') ? JSON_EVENT_OBJECT_END : JSON_EVENT_ARRAY_END;
+                    return RET_OK;
+                }
+            }   else if (c == '\n') {
+                r->line++;
+            }
+        }
+        if (!json_reader_fill(r))   {
+            json_reader_fail(r, "unexpected end of file");
+            return RET_FAIL;
+        }
+    }
+}
+
+const char* json_reader_gets(json_reader_t r, OUT size_t* plen)
+{
+    if (plen != NULL)
+        *plen = r->token_len;
+    return r->token;
+}
+
+fl64 json_reader_getf(json_reader_t r)
+{
+    return r->num;
+}
+
+int json_reader_geti(json_reader_t r)
+{
+    return (int)r->num;
+}
+
+int json_reader_getb(json_reader_t r)
+{
+    return r->b;
+}
+
+int json_reader_getdepth(json_reader_t r)
+{
+    return r->depth;
+}
+
+result_t json_parsesax(file_t f, struct allocator* alloc, pfn_json_sax fn, void* param)
+{
+    json_reader_t r = json_reader_create(f, alloc);
+    if (r == NULL)
+        return RET_OUTOFMEMORY;
+
+    result_t ret = RET_OK;
+    enum json_event e;
+    while ((e = json_reader_next(r)) > JSON_EVENT_END)  {
+        if (!fn(r, e, param))   {
+            ret = RET_ABORT;
+            break;
+        }
+    }
+    if (e == JSON_EVENT_ERROR)
+        ret = RET_FAIL;
+
+    json_reader_destroy(r);
+    return ret;
+}
@@ -15,39 +15,239 @@
 
 
 #include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
 #include "dhcore/pak-file.h"
 #include "dhcore/err.h"
 #include "dhcore/pak-file-fmt.h"
 #include "dhcore/str.h"
 #include "dhcore/numeric.h"
+#include "dhcore/util.h"
+#include "dhcore/mt.h"
+#include "dhcore/task-mgr.h"
+#include "dhcore/linked-list.h"
+#include "dhcore/log.h"
 
 #define ITEM_BLOCK_SIZE     100
-#define PAK_MAJOR_VERSION   1
-#define PAK_MINOR_VERSION   0
+#define STRINGS_BLOCK_SIZE  4096
+#define PAK_MAJOR_VERSION   2
+#define PAK_MINOR_VERSION   1
+#define PAK_V1_MINOR_VERSION 3
+#define PAK_DIR_ALIGN       16
+#define PAK_BLOCK_SIZE      (64*1024)
+#define PAK_PARALLEL_BLOCKS 8   /* entries with this many blocks are decompressed by workers */
+#define PAK_PUT_BATCH       64
+#define PAK_BATCH_WINDOW    (4*1024*1024)
+#define PAK_BATCH_GAP       (64*1024)   /* entries closer than this are read together */
 #define HSEED           8263
+#define VERIFY_SAMPLE_RATE  16
+#define CACHE_TABLE_SIZE    4093
+#define CACHE_POOL_BLOCK    256
 
 /*************************************************************************************************/
+INLINE uint pak_blockcnt(size_t size, uint block_size)
+{
+    return (uint)((size + block_size - 1)/block_size);
+}
+
+/* entry data may not be aligned, so offsets are read with memcpy */
+INLINE uint pak_blockoffset(const uint8* entry, uint idx)
+{
+    uint offset;
+    memcpy(&offset, entry + idx*sizeof(uint), sizeof(uint));
+    return offset;
+}
+
+/* compresses each block of src independently (see pak-file-fmt.h), dest must have
+ * sizeof(uint)*(block_cnt+1) + block_cnt*zip_compressedsize(block_size) bytes
+ * returns size of the entry (offsets + compressed blocks) */
+static size_t pak_compressblocks(uint8* dest, const uint8* src, size_t size, uint block_size,
+                                 enum compress_mode mode)
+{
+    uint block_cnt = pak_blockcnt(size, block_size);
+    size_t block_bound = zip_compressedsize(block_size);
+    uint offset = (uint)(sizeof(uint)*(block_cnt + 1));
+
+    for (uint i = 0; i < block_cnt; i++)    {
+        const uint8* raw = src + (size_t)i*block_size;
+        size_t raw_sz = minsz(block_size, size - (size_t)i*block_size);
+
+        memcpy(dest + i*sizeof(uint), &offset, sizeof(uint));
+        size_t block_sz = zip_compress(dest + offset, block_bound, raw, raw_sz, mode);
+        if (block_sz == 0 || block_sz >= raw_sz)    {
+            /* incompressible block, store it as-is */
+            memcpy(dest + offset, raw, raw_sz);
+            block_sz = raw_sz;
+        }
+        offset += (uint)block_sz;
+    }
+    memcpy(dest + block_cnt*sizeof(uint), &offset, sizeof(uint));
+
+    return offset;
+}
+
+/* decompresses blocks [first_block, first_block+block_cnt) of the entry into dest
+ * offsets: block offsets table, starting from first_block's offset
+ * data: compressed data of the entry, starting from data_start offset of the entry */
+static int pak_decompressblocks(uint8* dest, const uint8* offsets, const uint8* data,
+                                uint data_start, const struct pak_item* item, uint block_size,
+                                uint first_block, uint block_cnt)
+{
+    for (uint i = 0; i < block_cnt; i++)   {
+        uint start = pak_blockoffset(offsets, i);
+        uint end = pak_blockoffset(offsets, i + 1);
+        size_t raw_sz = minsz(block_size, item->unzip_size - (size_t)(first_block + i)*block_size);
+
+        if (end < start || start < data_start || end > item->size)
+            return FALSE;
+
+        const uint8* block = data + (start - data_start);
+        if (end - start == raw_sz)  {
+            memcpy(dest, block, raw_sz);
+        }   else if (zip_decompress_codec(dest, raw_sz, block, end - start,
+                                        (enum compress_codec)item->codec) != raw_sz)
+        {
+            return FALSE;
+        }
+        dest += raw_sz;
+    }
+    return TRUE;
+}
+
+struct pak_unzip_params
+{
+    const struct pak_item* item;
+    const uint8* entry;
+    uint8* dest;
+    uint block_size;
+    uint block_cnt;
+    atom_t next;
+    atom_t fails;
+};
+
+static void pak_unzip_task(void* params, void* result, uint thread_id, uint job_id, int worker_idx)
+{
+    struct pak_unzip_params* p = (struct pak_unzip_params*)params;
+    uint i;
+    while ((i = (uint)MT_ATOMIC_INCR(p->next) - 1) < p->block_cnt)   {
+        if (!pak_decompressblocks(p->dest + (size_t)i*p->block_size, p->entry + i*sizeof(uint),
+                                  p->entry, 0, p->item, p->block_size, i, 1))
+        {
+            MT_ATOMIC_INCR(p->fails);
+        }
+    }
+}
+
+/* decompresses all blocks of the entry into dest, blocks are shared between task manager workers
+ * and the caller. must be called from the main thread, same as tsk_dispatch */
+static int pak_decompressblocks_parallel(uint8* dest, const uint8* entry,
+                                         const struct pak_item* item, uint block_size)
+{
+    struct pak_unzip_params params;
+    params.item = item;
+    params.entry = entry;
+    params.dest = dest;
+    params.block_size = block_size;
+    params.block_cnt = pak_blockcnt(item->unzip_size, block_size);
+    params.next = 0;
+    params.fails = 0;
+
+    uint job_id = tsk_dispatch(pak_unzip_task, TSK_CONTEXT_ALL, TSK_THREADS_ALL, &params, NULL);
+    if (job_id != 0)    {
+        tsk_wait(job_id);
+        tsk_destroy(job_id);
+    }   else    {
+        pak_unzip_task(&params, NULL, 0, 0, 0);
+    }
+    return params.fails == 0;
+}
+
+/*************************************************************************************************/
+INLINE const char* pak_itempath(const struct pak_file* pak, const struct pak_item* item)
+{
+    return pak->strings + item->path_offset;
+}
+
+static result_t pak_buildtable(struct pak_file* pak, struct hashtable_frozen* ftable)
+{
+    uint cnt = pak->item_cnt;
+    uint* keys = (uint*)A_ALLOC(mem_heap(), sizeof(uint)*cnt*2 + 1, 0);
+    if (keys == NULL)
+        return RET_OUTOFMEMORY;
+    uint* values = keys + cnt;
+
+    for (uint i = 0; i < cnt; i++)   {
+        keys[i] = hash_str(pak_itempath(pak, &pak->items[i]));
+        values[i] = i + 1;
+    }
+
+    result_t r = hashtable_frozen_build(mem_heap(), mem_heap(), ftable, keys, values, cnt, 0);
+    A_FREE(mem_heap(), keys);
+    return r;
+}
+
+/* fills hash-table of the paths, for paks that don't have the prebuilt one */
+static result_t pak_filltable(struct pak_file* pak, struct allocator* alloc, uint mem_id)
+{
+    result_t r = hashtable_open_create(alloc, &pak->table, pak->item_cnt, ITEM_BLOCK_SIZE, mem_id);
+    if (IS_FAIL(r))
+        return r;
+
+    for (uint i = 0; i < pak->item_cnt; i++)
+        hashtable_open_add(&pak->table, hash_str(pak_itempath(pak, &pak->items[i])), i + 1);
+    return RET_OK;
+}
+
+/* writes zeros until file position is aligned to PAK_DIR_ALIGN, returns the aligned position */
+static uint64 pak_writealign(FILE* f)
+{
+    static const uint8 zeros[PAK_DIR_ALIGN] = {0};
+    long pos = ftell(f);
+    long aligned_pos = (long)(((pos + PAK_DIR_ALIGN - 1)/PAK_DIR_ALIGN)*PAK_DIR_ALIGN);
+    if (aligned_pos > pos)
+        fwrite(zeros, aligned_pos - pos, 1, f);
+    return (uint64)aligned_pos;
+}
+
 static void pak_finalize(struct pak_file* pak)
 {
     ASSERT(pak->f != NULL);
     ASSERT(pak->init_create);
 
-    /* re-write header and item table into the file */
+    /* write the directory (see pak-file-fmt.h) after files data, then re-write the header */
     struct pak_header header;
     memset(&header, 0x00, sizeof(header));
 
     /* current position is assumed to be the end of the files data */
     strcpy(header.sig, PAK_SIGN);
     header.version = (PAK_MAJOR_VERSION<<16) | (PAK_MINOR_VERSION&0xffff);
-    header.items_cnt = pak->items.item_cnt;
-    header.items_offset = ftell(pak->f);
+    header.items_cnt = pak->item_cnt;
     header.compress_mode = (uint)pak->compress_mode;
+    header.block_size = pak->block_size;
+
+    header.items_offset = pak_writealign(pak->f);
+    fwrite(pak->items, sizeof(struct pak_item), pak->item_cnt, pak->f);
+    header.hashes_offset = pak_writealign(pak->f);
+    fwrite(pak->zip_hashes, sizeof(hash_t), pak->item_cnt, pak->f);
+
+    /* build frozen hash-table from file paths and write it's blob after items, so that
+     * pak_open doesn't have to hash all the paths again */
+    struct hashtable_frozen ftable;
+    if (IS_OK(pak_buildtable(pak, &ftable)))  {
+        size_t blob_size;
+        const void* blob = hashtable_frozen_getblob(&ftable, &blob_size);
+        header.table_offset = pak_writealign(pak->f);
+        header.table_size = (uint)blob_size;
+        fwrite(blob, blob_size, 1, pak->f);
+        hashtable_frozen_destroy(&ftable);
+    }
+
+    header.strings_offset = (uint64)ftell(pak->f);
+    header.strings_size = (uint)pak->new_strings.item_cnt;
+    fwrite(pak->strings, pak->new_strings.item_cnt, 1, pak->f);
 
     fseek(pak->f, 0, SEEK_SET);
     fwrite(&header, sizeof(header), 1, pak->f);
-
-    fseek(pak->f, (long)header.items_offset, SEEK_SET);
-    fwrite(pak->items.buffer, pak->items.item_sz, pak->items.item_cnt, pak->f);
 }
 
 result_t pak_create(struct pak_file* pak, struct allocator* alloc,
@@ -66,8 +266,17 @@ result_t pak_create(struct pak_file* pak, struct allocator* alloc,
     }
 
     /* init internal data for arbiatary writing */
-    r = arr_create(alloc, &pak->items, sizeof(struct pak_item),
+    pak->alloc = alloc;
+    r = arr_create(alloc, &pak->new_items, sizeof(struct pak_item),
                    ITEM_BLOCK_SIZE, ITEM_BLOCK_SIZE, mem_id);
+    if (IS_OK(r))   {
+        r = arr_create(alloc, &pak->new_strings, sizeof(char), STRINGS_BLOCK_SIZE,
+                       STRINGS_BLOCK_SIZE, mem_id);
+    }
+    if (IS_OK(r))   {
+        r = arr_create(alloc, &pak->new_hashes, sizeof(hash_t), ITEM_BLOCK_SIZE,
+                       ITEM_BLOCK_SIZE, mem_id);
+    }
     if (IS_FAIL(r))     {
         err_printn(__FILE__, __LINE__, r);
         return r;
@@ -82,12 +291,153 @@ result_t pak_create(struct pak_file* pak, struct allocator* alloc,
     /* reserve size for the header */
     fseek(pak->f, sizeof(struct pak_header), SEEK_SET);
     pak->compress_mode = mode;
+    pak->block_size = PAK_BLOCK_SIZE;
     pak->init_create = TRUE;
 
     return RET_OK;
 }
 
 
+/* v2.0 directory: items, table and strings are used directly from the mapped pak, or read into
+ * one buffer */
+static result_t pak_loaddir(struct pak_file* pak, struct pak_header* header, int minor,
+                            uint mem_id)
+{
+    /* v2.0 paks (header doesn't have hashes field) */
+    if (minor == 0)
+        header->hashes_offset = 0;
+
+    uint64 dir_size = header->strings_offset + header->strings_size - header->items_offset;
+    uint64 items_size = header->items_cnt*sizeof(struct pak_item);
+
+    if (header->strings_offset + header->strings_size < header->items_offset ||
+        header->items_offset % PAK_DIR_ALIGN != 0 ||
+        header->strings_size == 0 ||
+        header->items_offset + items_size > header->strings_offset ||
+        (header->table_size > 0 &&
+         (header->table_offset < header->items_offset + items_size ||
+          header->table_offset + header->table_size > header->strings_offset)) ||
+        (header->hashes_offset != 0 &&
+         (header->hashes_offset < header->items_offset + items_size ||
+          header->hashes_offset + header->items_cnt*sizeof(hash_t) > header->strings_offset)))
+    {
+        return RET_FAIL;
+    }
+
+    const uint8* dir;
+    pak->dir_size = (size_t)dir_size;
+    if (pak->map != NULL && header->items_offset + dir_size <= pak->map_size)  {
+        dir = pak->map + header->items_offset;
+    }   else    {
+        pak->dir = A_ALLOC(pak->alloc, (size_t)dir_size, mem_id);
+        if (pak->dir == NULL)
+            return RET_OUTOFMEMORY;
+        if (util_readat(pak->f, pak->dir, (size_t)dir_size, header->items_offset) != dir_size)
+            return RET_FAIL;
+        dir = (const uint8*)pak->dir;
+    }
+
+    pak->items = (const struct pak_item*)dir;
+    pak->item_cnt = (uint)header->items_cnt;
+    pak->strings = (const char*)dir + (header->strings_offset - header->items_offset);
+    if (pak->strings[header->strings_size - 1] != 0)
+        return RET_FAIL;
+    if (header->hashes_offset != 0) {
+        pak->zip_hashes = (const hash_t*)(dir + (header->hashes_offset - header->items_offset));
+    }
+
+    /* table blob is owned by the directory */
+    if (header->table_size > 0) {
+        return hashtable_frozen_load(&pak->ftable,
+                                     dir + (header->table_offset - header->items_offset),
+                                     header->table_size);
+    }
+    return pak_filltable(pak, pak->alloc, mem_id);
+}
+
+/* v1.x directory: items have fixed size paths, so they are converted to v2 items and strings */
+static result_t pak_loaddir_v1(struct pak_file* pak, struct pak_header* header, int minor,
+                               uint mem_id)
+{
+    /* v1.0 paks (header doesn't have table fields) */
+    if (minor == 0)  {
+        header->table_offset = 0;
+        header->table_size = 0;
+    }
+
+    /* v1.0/v1.1 paks store compressed entries as a single stream */
+    if (minor < 2)
+        header->block_size = 0;
+
+    size_t item_sz = (minor >= 3) ? sizeof(struct pak_item_v1) :
+        offsetof(struct pak_item_v1, codec);
+    uint cnt = (uint)header->items_cnt;
+    uint8* old_items = (uint8*)A_ALLOC(mem_heap(), item_sz*cnt, 0);
+    if (old_items == NULL)
+        return RET_OUTOFMEMORY;
+    if (util_readat(pak->f, old_items, item_sz*cnt, header->items_offset) != item_sz*cnt)   {
+        A_FREE(mem_heap(), old_items);
+        return RET_FAIL;
+    }
+
+    size_t strings_size = 0;
+    for (uint i = 0; i < cnt; i++)  {
+        const struct pak_item_v1* old = (const struct pak_item_v1*)(old_items + i*item_sz);
+        strings_size += strlen(old->filepath) + 1;
+    }
+
+    pak->dir = A_ALLOC(pak->alloc, sizeof(struct pak_item)*cnt + strings_size, mem_id);
+    if (pak->dir == NULL)   {
+        A_FREE(mem_heap(), old_items);
+        return RET_OUTOFMEMORY;
+    }
+
+    struct pak_item* items = (struct pak_item*)pak->dir;
+    char* strings = (char*)(items + cnt);
+    enum compress_codec codec = zip_getcodec((enum compress_mode)header->compress_mode);
+    uint path_offset = 0;
+    for (uint i = 0; i < cnt; i++)  {
+        const struct pak_item_v1* old = (const struct pak_item_v1*)(old_items + i*item_sz);
+        struct pak_item* item = &items[i];
+        uint path_sz = (uint)strlen(old->filepath) + 1;
+        memcpy(strings + path_offset, old->filepath, path_sz);
+
+        item->offset = old->offset;
+        item->size = old->size;
+        item->unzip_size = old->unzip_size;
+        hash_set(&item->hash, old->hash);
+        item->codec = (minor >= 3) ? old->codec : (uint)codec;
+        item->path_offset = path_offset;
+        path_offset += path_sz;
+    }
+    A_FREE(mem_heap(), old_items);
+
+    pak->items = items;
+    pak->item_cnt = cnt;
+    pak->strings = strings;
+
+    if (header->table_size > 0)  {
+        /* load prebuilt frozen table, blob is owned by the table (freed in destroy) */
+        void* blob = A_ALLOC(pak->alloc, header->table_size, mem_id);
+        if (blob == NULL)
+            return RET_OUTOFMEMORY;
+        if (util_readat(pak->f, blob, header->table_size, header->table_offset) !=
+            header->table_size)
+        {
+            A_FREE(pak->alloc, blob);
+            return RET_FAIL;
+        }
+        result_t r = hashtable_frozen_load(&pak->ftable, blob, header->table_size);
+        if (IS_FAIL(r)) {
+            A_FREE(pak->alloc, blob);
+            return r;
+        }
+        pak->ftable.alloc = pak->alloc;
+        return RET_OK;
+    }
+    return pak_filltable(pak, pak->alloc, mem_id);
+}
+
 result_t pak_open(struct pak_file* pak, struct allocator* alloc, const char* pakfilepath,
                   uint mem_id)
 {
@@ -103,45 +453,41 @@ result_t pak_open(struct pak_file* pak, struct allocator* alloc, const char* pak
 
     /* read header */
     struct pak_header header;
+    memset(&header, 0x00, sizeof(header));
     fread(&header, sizeof(header), 1, pak->f);
     int major = (header.version >> 16) & 0xffff;
     int minor = (header.version) & 0xffff;
 
     if (!str_isequal(header.sig, PAK_SIGN) ||
-        (major != PAK_MAJOR_VERSION || minor != PAK_MINOR_VERSION) ||
+        !((major == PAK_MAJOR_VERSION && minor <= PAK_MINOR_VERSION) ||
+          (major == 1 && minor <= PAK_V1_MINOR_VERSION)) ||
         header.items_cnt == 0)
     {
         err_printf(__FILE__, __LINE__, "opening pak-file failed: file '%s' is an invalid pak",
                    pakfilepath);
+        pak_close(pak);
         return RET_FAIL;
     }
 
-    /* init internal data for reading */
-    r = arr_create(alloc, &pak->items, sizeof(struct pak_item),
-                   (uint)header.items_cnt, ITEM_BLOCK_SIZE, mem_id);
-    if (IS_FAIL(r))     {
-        err_printn(__FILE__, __LINE__, r);
-        return r;
-    }
-
-    r = hashtable_open_create(alloc, &pak->table, (uint)header.items_cnt, ITEM_BLOCK_SIZE, mem_id);
-    if (IS_FAIL(r))     {
-        err_printn(__FILE__, __LINE__, r);
-        return r;
-    }
+    /* map the whole pak, so directory and file data can be used without reading into buffers
+     * if mapping fails, we just fall back to reading from the file */
+    pak->map = (const uint8*)util_mapfile(pakfilepath, &pak->map_size);
+    pak->alloc = alloc;
 
-    /* load items */
-    fseek(pak->f, (long)header.items_offset, SEEK_SET);
-    fread(pak->items.buffer, sizeof(struct pak_item), (size_t)header.items_cnt, pak->f);
-    pak->items.item_cnt = (uint)header.items_cnt;
+    if (major == 1)
+        r = pak_loaddir_v1(pak, &header, minor, mem_id);
+    else
+        r = pak_loaddir(pak, &header, minor, mem_id);
 
-    struct pak_item* items = (struct pak_item*)pak->items.buffer;
-    for (uint i = 0; i < header.items_cnt; i++)   {
-        struct pak_item* item = &items[i];
-        hashtable_open_add(&pak->table, hash_str(item->filepath), i);
+    if (IS_FAIL(r)) {
+        err_printf(__FILE__, __LINE__, "opening pak-file failed: file '%s' has invalid directory",
+                   pakfilepath);
+        pak_close(pak);
+        return r;
     }
 
     pak->compress_mode = (enum compress_mode)header.compress_mode;
+    pak->block_size = header.block_size;
 
     return RET_OK;
 }
@@ -153,29 +499,115 @@ void pak_close(struct pak_file* pak)
 
     if (pak->f != NULL)
         fclose(pak->f);
+    if (pak->map != NULL)
+        util_unmapfile((void*)pak->map, pak->map_size);
 
     hashtable_open_destroy(&pak->table);
-    arr_destroy(&pak->items);
+    hashtable_frozen_destroy(&pak->ftable);
+    arr_destroy(&pak->new_items);
+    arr_destroy(&pak->new_strings);
+    arr_destroy(&pak->new_hashes);
+    if (pak->dir != NULL)
+        A_FREE(pak->alloc, pak->dir);
+    if (pak->verified != NULL)
+        A_FREE(pak->alloc, (void*)pak->verified);
 
     memset(pak, 0x00, sizeof(struct pak_file));
 }
 
+result_t pak_unmap(struct pak_file* pak)
+{
+    if (pak->map == NULL)
+        return RET_OK;
+
+    if (pak->dir == NULL && pak->items != NULL)    {
+        /* directory points to the mapped data, copy it and rebase the pointers */
+        const uint8* old_dir = (const uint8*)pak->items;
+        uint8* dir = (uint8*)A_ALLOC(pak->alloc, pak->dir_size, 0);
+        if (dir == NULL)
+            return RET_OUTOFMEMORY;
+        memcpy(dir, old_dir, pak->dir_size);
+
+        if (!hashtable_frozen_isempty(&pak->ftable))   {
+            size_t blob_size;
+            const uint8* blob = (const uint8*)hashtable_frozen_getblob(&pak->ftable, &blob_size);
+            hashtable_frozen_load(&pak->ftable, dir + (blob - old_dir), blob_size);
+        }
+        pak->items = (const struct pak_item*)dir;
+        pak->strings = (const char*)dir + (pak->strings - (const char*)old_dir);
+        if (pak->zip_hashes != NULL)  {
+            pak->zip_hashes = (const hash_t*)(dir +
+                ((const uint8*)pak->zip_hashes - old_dir));
+        }
+        pak->dir = dir;
+    }
+
+    util_unmapfile((void*)pak->map, pak->map_size);
+    pak->map = NULL;
+    pak->map_size = 0;
+    return RET_OK;
+}
+
+result_t pak_setverify(struct pak_file* pak, enum pak_verify verify, uint flags,
+                       uint sample_rate)
+{
+    if (pak->verified != NULL)  {
+        A_FREE(pak->alloc, (void*)pak->verified);
+        pak->verified = NULL;
+    }
+
+    if (verify == PAK_VERIFY_FIRST && pak->item_cnt > 0) {
+        size_t sz = sizeof(atom_t)*((pak->item_cnt + 31)/32);
+        pak->verified = (atom_t*)A_ALLOC(pak->alloc, sz, 0);
+        if (pak->verified == NULL)
+            return RET_OUTOFMEMORY;
+        memset((void*)pak->verified, 0x00, sz);
+    }
+
+    pak->verify = verify;
+    pak->verify_flags = flags;
+    pak->sample_rate = (sample_rate != 0) ? sample_rate : VERIFY_SAMPLE_RATE;
+    pak->fetch_cnt = 0;
+    return RET_OK;
+}
+
 int pak_isopen(struct pak_file* pak)
 {
     return (pak->f != NULL);
 }
 
-result_t pak_putfile(struct pak_file* pak, struct allocator* tmp_alloc, file_t src_file,
-                     const char* dest_path)
+/* entry data that is read, hashed and compressed, ready to be written into the pak */
+struct pak_entry
+{
+    void* buffer; /* raw file data */
+    void* compress_buffer; /* compressed data, NULL if pak is not compressed */
+    size_t size; /* size of the data that goes into the pak (compressed or raw) */
+    size_t unzip_size;
+    hash_t hash;
+    hash_t zip_hash; /* hash of the data that goes into the pak */
+    enum compress_codec codec;
+    result_t r;
+};
+
+/* parameters for parallel pak_putfiles task, each worker picks the next entry in the batch */
+struct pak_put_params
+{
+    struct pak_file* pak;
+    const file_t* src_files;
+    struct pak_entry* entries;
+    int cnt;
+    atom_t next;
+};
+
+static result_t pak_prepentry(struct pak_file* pak, struct allocator* alloc, file_t src_file,
+                              struct pak_entry* e)
 {
     ASSERT(fio_isopen(src_file));
 
+    memset(e, 0x00, sizeof(struct pak_entry));
     size_t size = fio_getsize(src_file);
-    size_t compress_size;
-
-    if (size == 0)      {
+    if (size == 0)
         return RET_OK;
-    }
 
     if (size > UINT32_MAX)  {
         err_printf(__FILE__, __LINE__, "put file into pak failed: file '%s' is more than 4gb",
@@ -183,121 +615,1134 @@ result_t pak_putfile(struct pak_file* pak, struct allocator* tmp_alloc, file_t s
         return RET_FAIL;
     }
 
-    /* compress/copy the file data into the pak file */
-    void* file_buffer = A_ALLOC(tmp_alloc, size, 0);
-    if (file_buffer == NULL)    {
+    e->buffer = A_ALLOC(alloc, size, 0);
+    if (e->buffer == NULL)    {
         err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
         return RET_OUTOFMEMORY;
     }
-    fio_read(src_file, file_buffer, size, 1);
-    hash_t file_hash = hash_murmur128(file_buffer, size, HSEED);
+    fio_read(src_file, e->buffer, size, 1);
+    e->hash = hash_murmur128(e->buffer, size, HSEED);
+    e->unzip_size = size;
+    e->codec = zip_getcodec(pak->compress_mode);
 
-    if (pak->compress_mode != COMPRESS_NONE)    {
-        /* compress the buffer, then write it into the pak-file */
-        compress_size = zip_compressedsize(size);
-        void* compress_buffer = A_ALLOC(tmp_alloc, compress_size, 0);
-        if (compress_buffer == NULL)    {
-            A_FREE(tmp_alloc, file_buffer);
+    if (e->codec != COMPRESS_CODEC_STORE)    {
+        /* compress the buffer in blocks */
+        uint block_cnt = pak_blockcnt(size, pak->block_size);
+        size_t compress_size = sizeof(uint)*(block_cnt + 1) +
+            block_cnt*zip_compressedsize(pak->block_size);
+        e->compress_buffer = A_ALLOC(alloc, compress_size, 0);
+        if (e->compress_buffer == NULL)    {
             err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
             return RET_OUTOFMEMORY;
         }
 
-        compress_size = zip_compress(compress_buffer, compress_size, file_buffer, size,
-                                     pak->compress_mode);
-        fwrite(compress_buffer, compress_size, 1, pak->f);
-        A_FREE(tmp_alloc, compress_buffer);
+        e->size = pak_compressblocks((uint8*)e->compress_buffer, (const uint8*)e->buffer,
+                                     size, pak->block_size, pak->compress_mode);
+        e->zip_hash = hash_murmur128(e->compress_buffer, e->size, HSEED);
     }    else    {
-        /* just copy the buffer into target */
-        fwrite(file_buffer, size, 1, pak->f);
-        compress_size = size;
+        e->size = size;
+        hash_set(&e->zip_hash, e->hash);
+    }
+
+    return RET_OK;
+}
+
+static void pak_freeentry(struct allocator* alloc, struct pak_entry* e)
+{
+    if (e->compress_buffer != NULL)
+        A_FREE(alloc, e->compress_buffer);
+    if (e->buffer != NULL)
+        A_FREE(alloc, e->buffer);
+    e->compress_buffer = NULL;
+    e->buffer = NULL;
+}
+
+/* looks for an item with the same content as the entry, returns NULL if not found */
+static const struct pak_item* pak_finddup(struct pak_file* pak, const struct hashtable_open* dedup,
+                                          const struct pak_entry* e)
+{
+    struct hashtable_item* titem = hashtable_open_find(dedup, (uint)e->hash.h[0]);
+    if (titem == NULL)
+        return NULL;
+
+    const struct pak_item* item = &pak->items[titem->value - 1];
+    if (item->unzip_size != e->unzip_size || !hash_isequal(item->hash, e->hash))
+        return NULL;
+    return item;
+}
+
+/* writes entry data into the pak (unless 'dup' is given) and adds it's item description */
+static result_t pak_writeentry(struct pak_file* pak, const struct pak_entry* e, const char* dest_path,
+                           const struct pak_item* dup)
+{
+    uint64 offset;
+    size_t size;
+    enum compress_codec codec;
+    hash_t zip_hash;
+
+    /* 'dup' points into the item array, which may be reallocated below, so keep it's index */
+    uint dup_idx = (dup != NULL) ? (uint)(dup - pak->items) : INVALID_INDEX;
+
+    /* reserve memory for item description first, so we don't write data that is not referenced */
+    const char* path = (dest_path[0] == '/') ? (dest_path + 1) : dest_path;
+    int path_sz = (int)strlen(path) + 1;
+    if (arr_needexpand(&pak->new_items) && IS_FAIL(arr_expand(&pak->new_items)))
+        return RET_OUTOFMEMORY;
+    if (arr_needexpand(&pak->new_hashes) && IS_FAIL(arr_expand(&pak->new_hashes)))
+        return RET_OUTOFMEMORY;
+    if (pak->new_strings.max_cnt - pak->new_strings.item_cnt < path_sz &&
+        IS_FAIL(arr_expand(&pak->new_strings)))
+    {
+        return RET_OUTOFMEMORY;
+    }
+
+    char* strings = (char*)pak->new_strings.buffer;
+    struct pak_item* items = (struct pak_item*)pak->new_items.buffer;
+    hash_t* zip_hashes = (hash_t*)pak->new_hashes.buffer;
+
+    if (dup_idx == INVALID_INDEX)   {
+        offset = (uint64)ftell(pak->f);
+        size = e->size;
+        codec = e->codec;
+        hash_set(&zip_hash, e->zip_hash);
+        fwrite(e->compress_buffer != NULL ? e->compress_buffer : e->buffer, e->size, 1, pak->f);
+    }   else    {
+        /* identical content is already in the pak, share it's data */
+        offset = items[dup_idx].offset;
+        size = items[dup_idx].size;
+        codec = (enum compress_codec)items[dup_idx].codec;
+        hash_set(&zip_hash, zip_hashes[dup_idx]);
     }
-    A_FREE(tmp_alloc, file_buffer);
 
     /* add file item description */
-    if (arr_needexpand(&pak->items))
-        arr_expand(&pak->items);
-    struct pak_item* items = (struct pak_item*)pak->items.buffer;
-    struct pak_item* item = &items[pak->items.item_cnt];
-    strcpy(item->filepath, (dest_path[0] == '/') ? (dest_path + 1) : (dest_path));
-    item->offset = ftell(pak->f) - compress_size;
-    item->size = (uint)compress_size;
-    item->unzip_size = (uint)size;
-    hash_set(&item->hash, file_hash);
+    struct pak_item* item = &items[pak->new_items.item_cnt];
+    memcpy(strings + pak->new_strings.item_cnt, path, path_sz);
+    item->path_offset = (uint)pak->new_strings.item_cnt;
+    pak->new_strings.item_cnt += path_sz;
+    item->offset = offset;
+    item->size = (uint)size;
+    item->unzip_size = (uint)e->unzip_size;
+    hash_set(&item->hash, e->hash);
+    item->codec = (uint)codec;
+    hash_set(&zip_hashes[pak->new_hashes.item_cnt++], zip_hash);
 
     /* Add ID to hash-table */
-    uint file_id = ++pak->items.item_cnt;
-    hashtable_open_add(&pak->table, hash_str(dest_path), file_id);
-
+    uint file_id = ++pak->new_items.item_cnt;
+    pak->items = items;
+    pak->item_cnt = file_id;
+    pak->strings = strings;
+    pak->zip_hashes = zip_hashes;
+    hashtable_open_add(&pak->table, hash_str(path), file_id);
     return RET_OK;
 }
 
+static void pak_put_task(void* params, void* result, uint thread_id, uint job_id, int worker_idx)
+{
+    struct pak_put_params* p = (struct pak_put_params*)params;
+    int idx;
+    while ((idx = (int)MT_ATOMIC_INCR(p->next) - 1) < p->cnt)   {
+        p->entries[idx].r = pak_prepentry(p->pak, mem_heap(), p->src_files[idx],
+                                          &p->entries[idx]);
+    }
+}
+
+result_t pak_putfile(struct pak_file* pak, struct allocator* tmp_alloc, file_t src_file,
+                     const char* dest_path)
+{
+    struct pak_entry e;
+    result_t r = pak_prepentry(pak, tmp_alloc, src_file, &e);
+    if (IS_OK(r) && e.unzip_size > 0)
+        r = pak_writeentry(pak, &e, dest_path, NULL);
+    pak_freeentry(tmp_alloc, &e);
+    return r;
+}
+
+result_t pak_putfiles(struct pak_file* pak, struct allocator* tmp_alloc, const file_t* src_files,
+                      const char* const* dest_paths, int file_cnt, uint flags)
+{
+    result_t r = RET_OK;
+    struct hashtable_open dedup;
+    memset(&dedup, 0x00, sizeof(dedup));
+
+    struct pak_entry* entries = (struct pak_entry*)A_ALLOC(tmp_alloc,
+        sizeof(struct pak_entry)*PAK_PUT_BATCH, 0);
+    if (entries == NULL)    {
+        err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+        return RET_OUTOFMEMORY;
+    }
+
+    if (BIT_CHECK(flags, PAK_PUT_DEDUP))    {
+        /* index the content of the items that are already in the pak */
+        uint item_cnt = pak->item_cnt;
+        r = hashtable_open_create(mem_heap(), &dedup, maxui(item_cnt + file_cnt, 1),
+                                  ITEM_BLOCK_SIZE, 0);
+        if (IS_FAIL(r)) {
+            A_FREE(tmp_alloc, entries);
+            err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+            return RET_OUTOFMEMORY;
+        }
+        for (uint i = 0; i < item_cnt; i++)
+            hashtable_open_add(&dedup, (uint)pak->items[i].hash.h[0], i + 1);
+    }
+
+    /* process files in batches: workers (and the caller) read/hash/compress the entries of the
+     * batch concurrently, then the caller writes them into the pak in the original order.
+     * batching bounds the memory that is held by the prepared entries */
+    for (int i = 0; i < file_cnt && IS_OK(r); i += PAK_PUT_BATCH)  {
+        struct pak_put_params params;
+        params.pak = pak;
+        params.src_files = src_files + i;
+        params.entries = entries;
+        params.cnt = mini(PAK_PUT_BATCH, file_cnt - i);
+        params.next = 0;
+
+        uint job_id = tsk_dispatch(pak_put_task, TSK_CONTEXT_ALL, TSK_THREADS_ALL, &params, NULL);
+        if (job_id != 0)    {
+            tsk_wait(job_id);
+            tsk_destroy(job_id);
+        }   else    {
+            pak_put_task(&params, NULL, 0, 0, 0);
+        }
+
+        for (int k = 0; k < params.cnt; k++)  {
+            struct pak_entry* e = &entries[k];
+            if (IS_OK(r))
+                r = e->r;
+
+            if (IS_OK(r) && e->unzip_size > 0) {
+                const struct pak_item* dup = NULL;
+                if (BIT_CHECK(flags, PAK_PUT_DEDUP))    {
+                    dup = pak_finddup(pak, &dedup, e);
+                    if (dup == NULL)    {
+                        hashtable_open_add(&dedup, (uint)e->hash.h[0],
+                                           pak->item_cnt + 1);
+                    }
+                }
+                r = pak_writeentry(pak, e, dest_paths[i + k], dup);
+            }
+            pak_freeentry(mem_heap(), e);
+        }
+    }
+
+    if (BIT_CHECK(flags, PAK_PUT_DEDUP))
+        hashtable_open_destroy(&dedup);
+    A_FREE(tmp_alloc, entries);
+    return r;
+}
+
 uint pak_findfile(struct pak_file* pak, const char* filepath)
 {
     /* if path starts with '/' ignore the first char */
     const char* rpath = (filepath[0] == '/') ? (filepath + 1) : filepath;
 
-    struct hashtable_item* titem = hashtable_open_find(&pak->table, hash_str(rpath));
+    uint hash = hash_str(rpath);
+
+    if (!hashtable_frozen_isempty(&pak->ftable))    {
+        const struct hashtable_frozen_item* fitem = hashtable_frozen_find(&pak->ftable, hash);
+        return (fitem != NULL) ? fitem->value : 0;
+    }
+
+    struct hashtable_item* titem = hashtable_open_find(&pak->table, hash);
     if (titem != NULL)     return (uint)titem->value;
     else                   return 0;
 }
 
-file_t pak_getfile(struct pak_file* pak, struct allocator* alloc, struct allocator* tmp_alloc,
-                   uint file_id, uint mem_id)
+/* returns pointer to item's data in the mapped pak, NULL if pak is not mapped */
+static const uint8* pak_getmapped(struct pak_file* pak, const struct pak_item* item)
+{
+    if (pak->map == NULL || item->offset + item->size > pak->map_size)
+        return NULL;
+    return pak->map + item->offset;
+}
+
+static int pak_checkhash(const struct pak_file* pak, const struct pak_item* item, const void* data)
+{
+    hash_t h = hash_murmur128(data, item->unzip_size, HSEED);
+    if (!hash_isequal(h, item->hash))   {
+        err_printf(__FILE__, __LINE__, "pak get-file failed: data validity error for '%s'",
+                   pak_itempath(pak, item));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static int pak_checkziphash(const struct pak_file* pak, uint file_id, const void* data)
+{
+    const struct pak_item* item = &pak->items[file_id-1];
+    hash_t h = hash_murmur128(data, item->size, HSEED);
+    if (!hash_isequal(h, pak->zip_hashes[file_id-1]))   {
+        err_printf(__FILE__, __LINE__, "pak get-file failed: compressed data validity error for '%s'",
+                   pak_itempath(pak, item));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* decides if the fetched file should be verified, by the verification policy of the pak */
+static int pak_shouldverify(struct pak_file* pak, uint file_id)
+{
+    switch (pak->verify)    {
+    case PAK_VERIFY_OFF:
+        return FALSE;
+    case PAK_VERIFY_FIRST:
+    {
+        uint idx = file_id - 1;
+        return (MT_ATOMIC_LOAD_ACQ(pak->verified[idx >> 5]) & ((atom_t)1 << (idx & 31))) == 0;
+    }
+    case PAK_VERIFY_SAMPLED:
+        return ((MT_ATOMIC_INCR(pak->fetch_cnt) - 1) % pak->sample_rate) == 0;
+    default:
+        return TRUE;
+    }
+}
+
+/* marks file as verified, so PAK_VERIFY_FIRST policy skips it on the next fetches
+ * if multiple threads fetch the file at the same time, all of them may verify it, which is fine */
+static void pak_setverified(struct pak_file* pak, uint file_id)
+{
+    if (pak->verify != PAK_VERIFY_FIRST)
+        return;
+
+    uint idx = file_id - 1;
+    atom_t* word = &pak->verified[idx >> 5];
+    atom_t bit = (atom_t)1 << (idx & 31);
+    atom_t v;
+    do  {
+        v = *word;
+    }   while ((v & bit) == 0 && MT_ATOMIC_CAS(*word, v, v | bit) != v);
+}
+
+/* decompresses (or copies) raw data of the entry into unzip_buffer, and verifies it by the
+ * verification policy of the pak. entry can be the same as unzip_buffer for stored entries
+ * parallel: blocks of large entries are decompressed by task manager workers (main thread only) */
+static int pak_unzipentry(struct pak_file* pak, uint file_id, const uint8* entry,
+                          void* unzip_buffer, int parallel)
+{
+    const struct pak_item* item = &pak->items[file_id-1];
+    int verify = pak_shouldverify(pak, file_id);
+    int r = TRUE;
+
+    if (item->codec != COMPRESS_CODEC_STORE)    {
+        /* verify compressed data instead of decompressed one, if it's requested and available */
+        if (verify && BIT_CHECK(pak->verify_flags, PAK_VERIFY_COMPRESSED) &&
+            pak->zip_hashes != NULL)
+        {
+            r = pak_checkziphash(pak, file_id, entry);
+            verify = FALSE;
+            if (r)
+                pak_setverified(pak, file_id);
+        }
+
+        uint block_cnt = pak->block_size != 0 ? pak_blockcnt(item->unzip_size, pak->block_size) : 0;
+        if (r && parallel && block_cnt >= PAK_PARALLEL_BLOCKS)  {
+            r = pak_decompressblocks_parallel((uint8*)unzip_buffer, entry, item, pak->block_size);
+        }   else if (r && pak->block_size != 0)   {
+            r = pak_decompressblocks((uint8*)unzip_buffer, entry, entry, 0, item, pak->block_size,
+                                     0, block_cnt);
+        }   else if (r)    {
+            r = zip_decompress_codec(unzip_buffer, item->unzip_size, entry, item->size,
+                                     (enum compress_codec)item->codec) == item->unzip_size;
+        }
+    }   else if (entry != unzip_buffer)    {
+        memcpy(unzip_buffer, entry, item->unzip_size);
+    }
+
+    /* check hash validity */
+    if (r && verify)    {
+        r = pak_checkhash(pak, item, unzip_buffer);
+        if (r)
+            pak_setverified(pak, file_id);
+    }
+    return r;
+}
+
+static file_t pak_fetchfile(struct pak_file* pak, struct allocator* alloc,
+                            struct allocator* tmp_alloc, uint file_id, uint mem_id, int parallel)
 {
     ASSERT(file_id != 0);
-    ASSERT(file_id < (uint)pak->items.item_cnt+1);
+    ASSERT(file_id < pak->item_cnt+1);
 
-    struct pak_item* items = (struct pak_item*)pak->items.buffer;
-    struct pak_item* item = &items[file_id-1];
+    const struct pak_item* item = &pak->items[file_id-1];
+    const uint8* entry = pak_getmapped(pak, item);
+    void* file_buffer = NULL;
+    int r = TRUE;
 
-    void* file_buffer = A_ALLOC(tmp_alloc, item->size, 0);
     void* unzip_buffer = A_ALLOC(alloc, item->unzip_size, 0);
-
-    if (file_buffer == NULL || unzip_buffer == NULL)    {
+    if (unzip_buffer == NULL)   {
         err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
         return NULL;
     }
 
-    fseek(pak->f, (long)item->offset, SEEK_SET);
-    fread(file_buffer, item->size, 1, pak->f);
-    if (pak->compress_mode != COMPRESS_NONE)
-        zip_decompress(unzip_buffer, item->unzip_size, file_buffer, item->size);
-    else
-        memcpy(unzip_buffer, file_buffer, item->unzip_size);
+    /* decompress directly from the mapped pak, or read compressed data into temp buffer */
+    if (entry == NULL && item->codec != COMPRESS_CODEC_STORE)  {
+        file_buffer = A_ALLOC(tmp_alloc, item->size, 0);
+        if (file_buffer == NULL)    {
+            A_FREE(alloc, unzip_buffer);
+            err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+            return NULL;
+        }
+        r = util_readat(pak->f, file_buffer, item->size, item->offset) == item->size;
+        entry = (const uint8*)file_buffer;
+    }   else if (entry == NULL)    {
+        /* uncompressed: read straight into the destination buffer */
+        r = util_readat(pak->f, unzip_buffer, item->unzip_size, item->offset) == item->unzip_size;
+        entry = (const uint8*)unzip_buffer;
+    }
 
-    A_FREE(tmp_alloc, file_buffer);
+    if (r)  {
+        r = pak_unzipentry(pak, file_id, entry, unzip_buffer, parallel);
+    }   else    {
+        err_printf(__FILE__, __LINE__, "pak get-file failed: could not read '%s'",
+                   pak_itempath(pak, item));
+    }
+    if (file_buffer != NULL)
+        A_FREE(tmp_alloc, file_buffer);
 
-    /* check hash validity */
-    hash_t h = hash_murmur128(unzip_buffer, item->unzip_size, HSEED);
-    if (!hash_isequal(h, item->hash))   {
-        err_printf(__FILE__, __LINE__, "pak get-file failed: data validity error for '%s'",
-                   item->filepath);
+    if (!r) {
         A_FREE(alloc, unzip_buffer);
-        return RET_FAIL;
+        return NULL;
     }
 
     /* attach it to a file and return */
-    return fio_attachmem(alloc, unzip_buffer, item->unzip_size, item->filepath, mem_id);
+    return fio_attachmem(alloc, unzip_buffer, item->unzip_size, pak_itempath(pak, item), mem_id);
+}
+
+/* pak_getfile and pak_getfile_mapped can be called from multiple threads: they only read from the
+ * mapped data or with positional reads (util_readat), and never touch the shared file position */
+file_t pak_getfile(struct pak_file* pak, struct allocator* alloc, struct allocator* tmp_alloc,
+                   uint file_id, uint mem_id)
+{
+    return pak_fetchfile(pak, alloc, tmp_alloc, file_id, mem_id, FALSE);
+}
+
+file_t pak_getfile_parallel(struct pak_file* pak, struct allocator* alloc,
+                            struct allocator* tmp_alloc, uint file_id, uint mem_id)
+{
+    return pak_fetchfile(pak, alloc, tmp_alloc, file_id, mem_id, TRUE);
+}
+
+/* decompressed entry in the cache, data follows the item */
+struct pak_cache_item
+{
+    hash_t hash;    /* hash of the decompressed data (pak_item::hash) */
+    size_t size;
+    int refcnt; /* open views, only unreferenced items are in the lru list */
+    struct pak_cache* cache;
+    struct linked_list lru_node;
+    uint8* data;
+};
+
+struct pak_cache
+{
+    mt_mutex mtx;
+    size_t budget;
+    size_t size;    /* size of the cached data */
+    uint64 hits;
+    uint64 misses;
+    struct hashtable_chained table; /* key: first word of content hash, value: pak_cache_item* */
+    struct pool_alloc table_pool;   /* items of table */
+    struct allocator table_alloc;
+    struct linked_list* lru;    /* unreferenced items, most recently used first */
+    struct linked_list* lru_last;
+};
+
+/* data is kept aligned after the item */
+#define CACHE_ITEM_SIZE ((sizeof(struct pak_cache_item) + 15) & ~((size_t)15))
+
+struct pak_cache* pak_cache_create(size_t budget)
+{
+    struct pak_cache* cache = (struct pak_cache*)ALLOC(sizeof(struct pak_cache), 0);
+    if (cache == NULL)  {
+        err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+        return NULL;
+    }
+    memset(cache, 0x00, sizeof(struct pak_cache));
+    mt_mutex_init(&cache->mtx);
+    cache->budget = budget;
+
+    result_t r = mem_pool_create(mem_heap(), &cache->table_pool,
+                                 sizeof(struct hashtable_item_chained), CACHE_POOL_BLOCK, 0);
+    if (IS_OK(r))   {
+        mem_pool_bindalloc(&cache->table_pool, &cache->table_alloc);
+        r = hashtable_chained_create(mem_heap(), &cache->table_alloc, &cache->table,
+                                     CACHE_TABLE_SIZE, 0);
+    }
+    if (IS_FAIL(r)) {
+        err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+        pak_cache_destroy(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+void pak_cache_destroy(struct pak_cache* cache)
+{
+    ASSERT(cache);
+
+    int refs = 0;
+    if (cache->table.pslots != NULL)    {
+        for (int i = 0; i < cache->table.slots_cnt; i++)    {
+            for (struct linked_list* node = cache->table.pslots[i]; node != NULL;
+                 node = node->next)
+            {
+                struct hashtable_item_chained* titem = (struct hashtable_item_chained*)node->data;
+                struct pak_cache_item* item = (struct pak_cache_item*)titem->value;
+                refs += item->refcnt > 0;
+                A_ALIGNED_FREE(mem_heap(), item);
+            }
+        }
+        hashtable_chained_destroy(&cache->table);
+    }
+    if (refs > 0)
+        log_printf(LOG_WARNING, "pak-cache: destroying %d entries that have open views", refs);
+
+    mem_pool_destroy(&cache->table_pool);
+    mt_mutex_release(&cache->mtx);
+    FREE(cache);
+}
+
+size_t pak_cache_getstats(struct pak_cache* cache, OUT uint64* phits, OUT uint64* pmisses)
+{
+    mt_mutex_lock(&cache->mtx);
+    size_t size = cache->size;
+    if (phits != NULL)
+        *phits = cache->hits;
+    if (pmisses != NULL)
+        *pmisses = cache->misses;
+    mt_mutex_unlock(&cache->mtx);
+    return size;
+}
+
+void pak_setcache(struct pak_file* pak, struct pak_cache* cache)
+{
+    pak->cache = cache;
+}
+
+/* walks the slot of the hash, colliding keys of different contents are skipped */
+static struct hashtable_item_chained* pak_cache_find(struct pak_cache* cache, hash_t hash,
+                                                     size_t size)
+{
+    uint key = (uint)hash.h[0];
+    struct linked_list* node = cache->table.pslots[key % cache->table.slots_cnt];
+    for (; node != NULL; node = node->next) {
+        struct hashtable_item_chained* titem = (struct hashtable_item_chained*)node->data;
+        const struct pak_cache_item* item = (const struct pak_cache_item*)titem->value;
+        if (titem->hash == key && item->size == size && hash_isequal(item->hash, hash))
+            return titem;
+    }
+    return NULL;
+}
+
+static void pak_cache_lruremove(struct pak_cache* cache, struct pak_cache_item* item)
+{
+    if (cache->lru_last == &item->lru_node)
+        cache->lru_last = item->lru_node.prev;
+    list_remove(&cache->lru, &item->lru_node);
+}
+
+/* evicts least recently used items (that are not referenced) until 'reserve' bytes fit the budget */
+static void pak_cache_evict(struct pak_cache* cache, size_t reserve)
+{
+    while (cache->size + reserve > cache->budget && cache->lru_last != NULL)    {
+        struct pak_cache_item* item = (struct pak_cache_item*)cache->lru_last->data;
+        pak_cache_lruremove(cache, item);
+        hashtable_chained_remove(&cache->table, pak_cache_find(cache, item->hash, item->size));
+        cache->size -= item->size;
+        A_ALIGNED_FREE(mem_heap(), item);
+    }
+}
+
+/* takes a reference of the item, must be called in lock */
+static void pak_cache_addref(struct pak_cache* cache, struct pak_cache_item* item)
+{
+    if (item->refcnt++ == 0)
+        pak_cache_lruremove(cache, item);
+}
+
+static void pak_cache_closeview(const void* data, void* param)
+{
+    struct pak_cache_item* item = (struct pak_cache_item*)param;
+    struct pak_cache* cache = item->cache;
+
+    mt_mutex_lock(&cache->mtx);
+    ASSERT(item->refcnt > 0);
+    if (--item->refcnt == 0)    {
+        list_add(&cache->lru, &item->lru_node, item);
+        if (cache->lru_last == NULL)
+            cache->lru_last = &item->lru_node;
+        pak_cache_evict(cache, 0);
+    }
+    mt_mutex_unlock(&cache->mtx);
+}
+
+/* decompresses the entry into a new cache item, returns NULL if failed */
+static struct pak_cache_item* pak_cache_load(struct pak_file* pak, struct allocator* tmp_alloc,
+                                             uint file_id)
+{
+    const struct pak_item* item = &pak->items[file_id-1];
+    struct pak_cache_item* citem = (struct pak_cache_item*)A_ALIGNED_ALLOC(mem_heap(),
+        CACHE_ITEM_SIZE + item->unzip_size, 0);
+    if (citem == NULL)  {
+        err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+        return NULL;
+    }
+    memset(citem, 0x00, sizeof(struct pak_cache_item));
+    hash_set(&citem->hash, item->hash);
+    citem->size = item->unzip_size;
+    citem->cache = pak->cache;
+    citem->data = (uint8*)citem + CACHE_ITEM_SIZE;
+
+    const uint8* entry = pak_getmapped(pak, item);
+    void* file_buffer = NULL;
+    int r = TRUE;
+    if (entry == NULL && item->codec != COMPRESS_CODEC_STORE)  {
+        file_buffer = A_ALLOC(tmp_alloc, item->size, 0);
+        if (file_buffer == NULL)    {
+            A_ALIGNED_FREE(mem_heap(), citem);
+            err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+            return NULL;
+        }
+        r = util_readat(pak->f, file_buffer, item->size, item->offset) == item->size;
+        entry = (const uint8*)file_buffer;
+    }   else if (entry == NULL)    {
+        r = util_readat(pak->f, citem->data, item->unzip_size, item->offset) == item->unzip_size;
+        entry = citem->data;
+    }
+
+    if (r)
+        r = pak_unzipentry(pak, file_id, entry, citem->data, FALSE);
+    if (file_buffer != NULL)
+        A_FREE(tmp_alloc, file_buffer);
+    if (!r) {
+        A_ALIGNED_FREE(mem_heap(), citem);
+        return NULL;
+    }
+    return citem;
+}
+
+/* fetches the entry from the cache as a view, decompresses it into the cache if it's not there */
+static file_t pak_getfile_cached(struct pak_file* pak, struct allocator* tmp_alloc, uint file_id)
+{
+    struct pak_cache* cache = pak->cache;
+    const struct pak_item* item = &pak->items[file_id-1];
+    struct pak_cache_item* citem = NULL;
+
+    mt_mutex_lock(&cache->mtx);
+    struct hashtable_item_chained* titem = pak_cache_find(cache, item->hash, item->unzip_size);
+    if (titem != NULL)  {
+        citem = (struct pak_cache_item*)titem->value;
+        pak_cache_addref(cache, citem);
+        cache->hits++;
+    }
+    mt_mutex_unlock(&cache->mtx);
+
+    if (citem == NULL)  {
+        /* decompress outside of the lock, other threads can fetch cached entries meanwhile */
+        struct pak_cache_item* new_item = pak_cache_load(pak, tmp_alloc, file_id);
+        if (new_item == NULL)
+            return NULL;
+
+        /* another thread may have loaded the same content meanwhile */
+        mt_mutex_lock(&cache->mtx);
+        titem = pak_cache_find(cache, item->hash, item->unzip_size);
+        if (titem != NULL)  {
+            citem = (struct pak_cache_item*)titem->value;
+            pak_cache_addref(cache, citem);
+        }   else if (IS_OK(hashtable_chained_add(&cache->table, (uint)item->hash.h[0],
+                                                 (iptr_t)new_item)))
+        {
+            pak_cache_evict(cache, item->unzip_size);
+            citem = new_item;
+            citem->refcnt = 1;
+            cache->size += item->unzip_size;
+        }
+        cache->misses++;
+        mt_mutex_unlock(&cache->mtx);
+
+        if (citem != new_item)
+            A_ALIGNED_FREE(mem_heap(), new_item);
+        if (citem == NULL)
+            return NULL;
+    }
+
+    file_t f = fio_attachview(citem->data, citem->size, pak_itempath(pak, item),
+                              pak_cache_closeview, citem);
+    if (f == NULL)
+        pak_cache_closeview(citem->data, citem);
+    return f;
+}
+
+file_t pak_getfile_mapped(struct pak_file* pak, struct allocator* alloc,
+                          struct allocator* tmp_alloc, uint file_id, uint mem_id)
+{
+    ASSERT(file_id != 0);
+    ASSERT(file_id < pak->item_cnt+1);
+
+    const struct pak_item* item = &pak->items[file_id-1];
+    const uint8* mapped = pak_getmapped(pak, item);
+
+    if (item->codec != COMPRESS_CODEC_STORE || mapped == NULL)  {
+        /* entries that are larger than the whole cache are not cached */
+        if (pak->cache != NULL && item->unzip_size <= pak->cache->budget)
+            return pak_getfile_cached(pak, tmp_alloc, file_id);
+        return pak_getfile(pak, alloc, tmp_alloc, file_id, mem_id);
+    }
+
+    if (pak_shouldverify(pak, file_id)) {
+        if (!pak_checkhash(pak, item, mapped))
+            return NULL;
+        pak_setverified(pak, file_id);
+    }
+    return fio_createview(mapped, item->unzip_size, pak_itempath(pak, item));
+}
+
+/* requested entry of pak_getfiles_batch */
+struct pak_batch_entry
+{
+    uint64 offset;  /* offset of the entry's data in the pak, requests are sorted by it */
+    uint file_id;
+    int idx;    /* index of the request */
+    const uint8* data;  /* raw data of the entry (mapped, read window or unzip buffer) */
+    void* raw;  /* entry that doesn't fit in the read window is read into it's own buffer */
+    void* buffer;   /* unzipped data, which is attached to the result file */
+    int r;
+};
+
+/* parameters for parallel pak_getfiles_batch task, each worker picks the next entry in the window */
+struct pak_batch_params
+{
+    struct pak_file* pak;
+    struct pak_batch_entry* entries;
+    int cnt;
+    atom_t next;
+};
+
+static int pak_batch_cmp(const void* a, const void* b)
+{
+    uint64 oa = ((const struct pak_batch_entry*)a)->offset;
+    uint64 ob = ((const struct pak_batch_entry*)b)->offset;
+    return (oa > ob) - (oa < ob);
+}
+
+static void pak_batch_task(void* params, void* result, uint thread_id, uint job_id, int worker_idx)
+{
+    struct pak_batch_params* p = (struct pak_batch_params*)params;
+    int idx;
+    while ((idx = (int)MT_ATOMIC_INCR(p->next) - 1) < p->cnt)   {
+        struct pak_batch_entry* e = &p->entries[idx];
+        if (e->buffer != NULL && e->data != NULL)
+            e->r = pak_unzipentry(p->pak, e->file_id, e->data, e->buffer, FALSE);
+        if (e->raw != NULL)  {
+            A_FREE(mem_heap(), e->raw);
+            e->raw = NULL;
+        }
+    }
+}
+
+/* inflates entries of the window on workers, returns job id, 0 if entries are processed by caller */
+static uint pak_batch_dispatch(struct pak_batch_params* params, struct pak_file* pak,
+                               struct pak_batch_entry* entries, int cnt, enum tsk_run_context ctx)
+{
+    params->pak = pak;
+    params->entries = entries;
+    params->cnt = cnt;
+    params->next = 0;
+    if (cnt == 0)
+        return 0;
+
+    uint job_id = tsk_dispatch(pak_batch_task, ctx, TSK_THREADS_ALL, params, NULL);
+    if (job_id == 0)
+        pak_batch_task(params, NULL, 0, 0, 0);
+    return job_id;
+}
+
+/* reads span of the pak into the window, entries of the span are dropped if reading fails */
+static void pak_batch_readspan(struct pak_file* pak, uint8* window, size_t window_offset,
+                               uint64 offset, size_t size, struct pak_batch_entry* entries, int cnt)
+{
+    if (size == 0 || util_readat(pak->f, window + window_offset, size, offset) == size)
+        return;
+    for (int i = 0; i < cnt; i++)   {
+        if (entries[i].data >= window && entries[i].data < window + PAK_BATCH_WINDOW)
+            entries[i].data = NULL;
+    }
+}
+
+result_t pak_getfiles_batch(struct pak_file* pak, struct allocator* alloc,
+                            struct allocator* tmp_alloc, const uint* file_ids, int file_cnt,
+                            OUT file_t* files, uint mem_id)
+{
+    result_t r = RET_OK;
+    memset(files, 0x00, sizeof(file_t)*file_cnt);
+    if (file_cnt == 0)
+        return RET_OK;
+
+    struct pak_batch_entry* entries = (struct pak_batch_entry*)A_ALLOC(tmp_alloc,
+        sizeof(struct pak_batch_entry)*file_cnt, 0);
+    if (entries == NULL)    {
+        err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+        return RET_OUTOFMEMORY;
+    }
+    memset(entries, 0x00, sizeof(struct pak_batch_entry)*file_cnt);
+
+    /* requests are sorted by their data offset, so the pak is read forward */
+    for (int i = 0; i < file_cnt; i++)  {
+        ASSERT(file_ids[i] != 0);
+        ASSERT(file_ids[i] < pak->item_cnt+1);
+        struct pak_batch_entry* e = &entries[i];
+        const struct pak_item* item = &pak->items[file_ids[i]-1];
+        e->offset = item->offset;
+        e->file_id = file_ids[i];
+        e->idx = i;
+        e->buffer = A_ALLOC(alloc, item->unzip_size, 0);
+        if (e->buffer == NULL)
+            r = RET_OUTOFMEMORY;
+    }
+    qsort(entries, file_cnt, sizeof(struct pak_batch_entry), pak_batch_cmp);
+
+    if (pak->map != NULL)   {
+        /* mapped pak: entries are inflated straight from the mapping, by workers and the caller */
+        struct pak_batch_params params;
+        for (int i = 0; i < file_cnt; i++)
+            entries[i].data = pak_getmapped(pak, &pak->items[entries[i].file_id-1]);
+        uint job_id = pak_batch_dispatch(&params, pak, entries, file_cnt, TSK_CONTEXT_ALL);
+        if (job_id != 0)    {
+            tsk_wait(job_id);
+            tsk_destroy(job_id);
+        }
+    }   else    {
+        /* compressed data is read into two windows, neighbor entries are coalesced into one big read.
+         * workers inflate the entries of one window, while the caller reads the next one */
+        struct pak_batch_params params[2];
+        uint jobs[2] = {0, 0};
+        uint8* windows[2];
+        windows[0] = (uint8*)A_ALLOC(tmp_alloc, PAK_BATCH_WINDOW, 0);
+        windows[1] = windows[0] != NULL ?
+            (uint8*)A_ALLOC(tmp_alloc, PAK_BATCH_WINDOW, 0) : NULL;
+        if (windows[1] == NULL) {
+            if (windows[0] != NULL)
+                A_FREE(tmp_alloc, windows[0]);
+            for (int i = 0; i < file_cnt; i++)  {
+                if (entries[i].buffer != NULL)
+                    A_FREE(alloc, entries[i].buffer);
+            }
+            A_FREE(tmp_alloc, entries);
+            err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+            return RET_OUTOFMEMORY;
+        }
+
+        int w = 0;
+        int first = 0;  /* first entry of the window */
+        int span_first = 0;
+        uint64 span_offset = 0;
+        uint64 span_end = 0;
+        size_t span_start = 0;  /* start of the span in window */
+        size_t used = 0;
+
+        for (int i = 0; i <= file_cnt; i++)  {
+            struct pak_batch_entry* e = i < file_cnt ? &entries[i] : NULL;
+            const struct pak_item* item = e != NULL ? &pak->items[e->file_id-1] : NULL;
+            int in_window = e != NULL && item->codec != COMPRESS_CODEC_STORE &&
+                item->size <= PAK_BATCH_WINDOW;
+
+            /* extend current span with the entry, if it's close enough and fits in the window */
+            uint64 end = e != NULL ? e->offset + item->size : 0;
+            if (end < span_end)
+                end = span_end;
+            if (in_window && used > 0 && e->offset <= span_end + PAK_BATCH_GAP &&
+                span_start + (size_t)(end - span_offset) <= PAK_BATCH_WINDOW)
+            {
+                span_end = end;
+                e->data = windows[w] + span_start + (size_t)(e->offset - span_offset);
+                used = span_start + (size_t)(span_end - span_offset);
+                continue;
+            }
+
+            if (e == NULL || in_window)  {
+                /* close current span, and dispatch the window if entry doesn't fit in it */
+                pak_batch_readspan(pak, windows[w], span_start, span_offset,
+                                   used - span_start, entries + span_first, i - span_first);
+                if (e == NULL || used + item->size > PAK_BATCH_WINDOW)    {
+                    /* task manager runs one job at a time, previous window must be finished */
+                    if (jobs[1-w] != 0)   {
+                        tsk_wait(jobs[1-w]);
+                        tsk_destroy(jobs[1-w]);
+                        jobs[1-w] = 0;
+                    }
+                    jobs[w] = pak_batch_dispatch(&params[w], pak, entries + first, i - first,
+                                                 TSK_CONTEXT_ALL_NO_MAIN);
+                    first = i;
+                    used = 0;
+                    w = 1 - w;
+                }
+                if (e == NULL)
+                    break;
+
+                span_first = i;
+                span_offset = e->offset;
+                span_end = e->offset + item->size;
+                span_start = used;
+                used += item->size;
+                e->data = windows[w] + span_start;
+            }   else if (e->buffer != NULL)   {
+                /* stored entries are read straight into their buffers, and large compressed
+                 * entries into their own buffers */
+                if (item->codec == COMPRESS_CODEC_STORE)    {
+                    e->data = (const uint8*)e->buffer;
+                    if (util_readat(pak->f, e->buffer, item->size, e->offset) != item->size)
+                        e->data = NULL;
+                }   else    {
+                    e->raw = A_ALLOC(mem_heap(), item->size, 0);
+                    if (e->raw != NULL &&
+                        util_readat(pak->f, e->raw, item->size, e->offset) == item->size)
+                    {
+                        e->data = (const uint8*)e->raw;
+                    }
+                }
+            }
+        }
+
+        for (int i = 0; i < 2; i++) {
+            if (jobs[i] != 0)   {
+                tsk_wait(jobs[i]);
+                tsk_destroy(jobs[i]);
+            }
+        }
+        A_FREE(tmp_alloc, windows[1]);
+        A_FREE(tmp_alloc, windows[0]);
+    }
+
+    /* attach unzipped buffers to files, in the order of requests */
+    for (int i = 0; i < file_cnt; i++)  {
+        struct pak_batch_entry* e = &entries[i];
+        const struct pak_item* item = &pak->items[e->file_id-1];
+        if (e->raw != NULL)
+            A_FREE(mem_heap(), e->raw);
+        if (e->buffer == NULL)
+            continue;
+
+        if (e->r)   {
+            files[e->idx] = fio_attachmem(alloc, e->buffer, item->unzip_size,
+                                          pak_itempath(pak, item), mem_id);
+        }
+        if (files[e->idx] == NULL)  {
+            A_FREE(alloc, e->buffer);
+            if (IS_OK(r))
+                r = RET_FAIL;
+        }
+    }
+
+    A_FREE(tmp_alloc, entries);
+    return r;
+}
+
+/* reads raw (compressed) data of the entry, from mapped pak or file, returns FALSE if fails */
+static int pak_readraw(struct pak_file* pak, const struct pak_item* item, void* buffer,
+                       size_t size, size_t offset)
+{
+    const uint8* mapped = pak_getmapped(pak, item);
+    if (mapped != NULL) {
+        memcpy(buffer, mapped + offset, size);
+        return TRUE;
+    }
+    return util_readat(pak->f, buffer, size, item->offset + offset) == size;
+}
+
+size_t pak_readfile(struct pak_file* pak, struct allocator* tmp_alloc, uint file_id,
+                    void* buffer, size_t offset, size_t size)
+{
+    ASSERT(file_id != 0);
+    ASSERT(file_id < pak->item_cnt+1);
+
+    const struct pak_item* item = &pak->items[file_id-1];
+
+    if (offset >= item->unzip_size)
+        return 0;
+    size = minsz(size, item->unzip_size - offset);
+
+    if (item->codec == COMPRESS_CODEC_STORE)
+        return pak_readraw(pak, item, buffer, size, offset) ? size : 0;
+
+    if (pak->block_size == 0)   {
+        /* single stream (v1.0/v1.1 paks), we have to decompress the whole file */
+        file_t f = pak_getfile(pak, tmp_alloc, tmp_alloc, file_id, 0);
+        if (f == NULL)
+            return 0;
+        memcpy(buffer, (const uint8*)fio_getptr(f) + offset, size);
+        fio_close(f);
+        return size;
+    }
+
+    /* decompress only the blocks that overlap the range */
+    uint block_size = pak->block_size;
+    uint first_block = (uint)(offset/block_size);
+    uint block_cnt = (uint)((offset + size - 1)/block_size) - first_block + 1;
+    size_t block_offset = offset - (size_t)first_block*block_size;
+
+    /* full blocks are decompressed directly into buffer */
+    uint8* unzip_buffer = (uint8*)buffer;
+    if (block_offset != 0 || (size % block_size) != 0)   {
+        unzip_buffer = (uint8*)A_ALLOC(tmp_alloc, (size_t)block_cnt*block_size, 0);
+        if (unzip_buffer == NULL)   {
+            err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+            return 0;
+        }
+    }
+
+    int r;
+    const uint8* mapped = pak_getmapped(pak, item);
+    if (mapped != NULL) {
+        r = pak_decompressblocks(unzip_buffer, mapped + first_block*sizeof(uint), mapped, 0, item,
+                                 block_size, first_block, block_cnt);
+    }   else    {
+        /* read offsets of the blocks, then only their compressed data */
+        size_t table_sz = sizeof(uint)*(block_cnt + 1);
+        uint* offsets = (uint*)A_ALLOC(tmp_alloc, table_sz, 0);
+        uint8* data = NULL;
+        r = FALSE;
+        if (offsets != NULL &&
+            util_readat(pak->f, offsets, table_sz, item->offset + first_block*sizeof(uint)) ==
+            table_sz &&
+            offsets[0] <= offsets[block_cnt] && offsets[block_cnt] <= item->size)
+        {
+            data = (uint8*)A_ALLOC(tmp_alloc, offsets[block_cnt] - offsets[0], 0);
+        }
+        if (data != NULL)   {
+            size_t data_sz = offsets[block_cnt] - offsets[0];
+            if (util_readat(pak->f, data, data_sz, item->offset + offsets[0]) == data_sz)   {
+                r = pak_decompressblocks(unzip_buffer, (const uint8*)offsets, data, offsets[0],
+                                         item, block_size, first_block, block_cnt);
+            }
+            A_FREE(tmp_alloc, data);
+        }
+        if (offsets != NULL)
+            A_FREE(tmp_alloc, offsets);
+    }
+
+    if (unzip_buffer != buffer) {
+        if (r)
+            memcpy(buffer, unzip_buffer + block_offset, size);
+        A_FREE(tmp_alloc, unzip_buffer);
+    }
+    return r ? size : 0;
+}
+
+/* stream over an entry, keeps the last decompressed block for small sequential reads */
+struct pak_stream
+{
+    struct pak_file* pak;
+    struct allocator* alloc;
+    uint file_id;
+    uint block_idx; /* block that is in buffer, INVALID_INDEX if none */
+    size_t block_len;
+    uint8* buffer;
+};
+
+static size_t pak_stream_read(void* buffer, size_t offset, size_t size, void* param)
+{
+    struct pak_stream* s = (struct pak_stream*)param;
+    const struct pak_item* item = &s->pak->items[s->file_id-1];
+    uint block_size = s->pak->block_size;
+
+    if (item->codec == COMPRESS_CODEC_STORE)
+        return pak_readfile(s->pak, s->alloc, s->file_id, buffer, offset, size);
+
+    uint8* dest = (uint8*)buffer;
+    size_t remain = size;
+    while (remain > 0)  {
+        uint block = (uint)(offset/block_size);
+        size_t block_offset = offset - (size_t)block*block_size;
+
+        if (block != s->block_idx)  {
+            /* whole blocks (and the tail of the entry) are decompressed directly into the
+             * destination, range is always inside the entry (fio_read clamps it) */
+            size_t sz = remain;
+            if (block_offset == 0 && (sz >= block_size || offset + sz == item->unzip_size))  {
+                if (offset + sz < item->unzip_size)
+                    sz -= sz % block_size;
+                if (pak_readfile(s->pak, s->alloc, s->file_id, dest, offset, sz) != sz)
+                    break;
+                dest += sz;
+                offset += sz;
+                remain -= sz;
+                continue;
+            }
+
+            size_t start = (size_t)block*block_size;
+            sz = minsz(block_size, item->unzip_size - start);
+            if (pak_readfile(s->pak, s->alloc, s->file_id, s->buffer, start, sz) != sz)   {
+                s->block_idx = INVALID_INDEX;
+                break;
+            }
+            s->block_idx = block;
+            s->block_len = sz;
+        }
+
+        size_t sz = minsz(remain, s->block_len - block_offset);
+        memcpy(dest, s->buffer + block_offset, sz);
+        dest += sz;
+        offset += sz;
+        remain -= sz;
+    }
+    return size - remain;
+}
+
+static void pak_stream_close(void* param)
+{
+    struct pak_stream* s = (struct pak_stream*)param;
+    A_FREE(s->alloc, s);
+}
+
+file_t pak_openstream(struct pak_file* pak, struct allocator* alloc, uint file_id)
+{
+    ASSERT(file_id != 0);
+    ASSERT(file_id < pak->item_cnt+1);
+
+    const struct pak_item* item = &pak->items[file_id-1];
+
+    /* single stream (v1.0/v1.1 paks) can't be read in parts */
+    if (item->codec != COMPRESS_CODEC_STORE && pak->block_size == 0)
+        return pak_getfile(pak, alloc, alloc, file_id, 0);
+
+    size_t buffer_sz = item->codec != COMPRESS_CODEC_STORE ? pak->block_size : 0;
+    struct pak_stream* s = (struct pak_stream*)A_ALLOC(alloc,
+        sizeof(struct pak_stream) + buffer_sz, 0);
+    if (s == NULL)  {
+        err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+        return NULL;
+    }
+    s->pak = pak;
+    s->alloc = alloc;
+    s->file_id = file_id;
+    s->block_idx = INVALID_INDEX;
+    s->block_len = 0;
+    s->buffer = (uint8*)(s + 1);
+
+    file_t f = fio_attachstream(item->unzip_size, pak_itempath(pak, item), pak_stream_read,
+                                pak_stream_close, s);
+    if (f == NULL)
+        A_FREE(alloc, s);
+    return f;
 }
 
 char* pak_createfilelist(struct pak_file* pak, struct allocator* alloc, OUT int* pcnt)
 {
 	ASSERT(pcnt);
-	if (arr_isempty(&pak->items))	{
+	if (pak->item_cnt == 0)	{
 		*pcnt = 0;
 		return NULL;
 	}
 
-	char* filelist = (char*)A_ALLOC(alloc, DH_PATH_MAX*pak->items.item_cnt, 0);
+	char* filelist = (char*)A_ALLOC(alloc, DH_PATH_MAX*pak->item_cnt, 0);
 	if (filelist == NULL)	{
 		*pcnt = 0;
 		return NULL;
 	}
-	memset(filelist, 0x00, DH_PATH_MAX*pak->items.item_cnt);
+	memset(filelist, 0x00, DH_PATH_MAX*pak->item_cnt);
 
-	*pcnt = pak->items.item_cnt;
+	*pcnt = (int)pak->item_cnt;
     for (int i = 0; i < *pcnt; i++)
-		strcpy(filelist + i*DH_PATH_MAX, ((struct pak_item*)pak->items.buffer)[i].filepath);
+		str_safecpy(filelist + i*DH_PATH_MAX, DH_PATH_MAX, pak_itempath(pak, &pak->items[i]));
 	return filelist;
 }
 
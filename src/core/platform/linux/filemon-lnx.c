@@ -0,0 +1,315 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#include "dhcore/types.h"
+
+/* native file monitoring backend (inotify), used by file-io when efsw (_FILEMON_) is not enabled */
+#if defined(_LINUX_) && !defined(_FILEMON_)
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "dhcore/mem-mgr.h"
+#include "dhcore/hash-table.h"
+#include "dhcore/array.h"
+#include "dhcore/str.h"
+#include "dhcore/log.h"
+#include "dhcore/err.h"
+
+#define MON_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE)
+#define MON_WATCH_CNT 128
+#define MON_READ_SIZE (64*1024)
+
+/* filepath: path of the file relative to the watched root directory, NULL if whole directory
+ * contents must be considered changed (event queue overflow)
+ * modified: file content is changed, listing: file is added/removed */
+typedef void (*pfn_fio_lnx_mon)(const char* filepath, int modified, int listing, void* param);
+
+/* each directory in the watched tree has it's own inotify watch */
+struct mon_watch
+{
+    int wd;
+    int root_id;
+    char path[DH_PATH_MAX]; /* relative to root directory, empty for the root itself */
+};
+
+struct mon_root
+{
+    int id;
+    char path[DH_PATH_MAX];
+};
+
+struct mon_lnx
+{
+    int fd;
+    int next_id;
+    struct hashtable_open watches;  /* key: wd, value: mon_watch* */
+    struct array roots; /* item: mon_root */
+};
+
+static struct mon_lnx g_mon = {-1};
+
+/*************************************************************************************************/
+static void fio_lnx_mon_watchtree(int root_id, char* path, size_t path_len, size_t root_len,
+                                  pfn_fio_lnx_mon fn, void* param)
+{
+    int wd = inotify_add_watch(g_mon.fd, path, MON_EVENTS | IN_ONLYDIR | IN_DONT_FOLLOW);
+    if (wd == -1)   {
+        log_printf(LOG_WARNING, "file-mon: could not watch '%s': %s", path, strerror(errno));
+        return;
+    }
+
+    /* a directory that is reachable from multiple roots (nested vdirs) is watched once,
+     * inotify returns the same wd for it, and the first root keeps reporting it's changes */
+    if (hashtable_open_find(&g_mon.watches, (uint)wd) == NULL)  {
+        struct mon_watch* w = (struct mon_watch*)ALLOC(sizeof(struct mon_watch), 0);
+        if (w == NULL)  {
+            inotify_rm_watch(g_mon.fd, wd);
+            return;
+        }
+        w->wd = wd;
+        w->root_id = root_id;
+        str_safecpy(w->path, sizeof(w->path), path_len > root_len ? path + root_len + 1 : "");
+        hashtable_open_add(&g_mon.watches, (uint)wd, (iptr_t)w);
+    }
+
+    DIR* d = opendir(path);
+    if (d == NULL)
+        return;
+
+    struct dirent* e;
+    while ((e = readdir(d)) != NULL)    {
+        if (str_isequal(e->d_name, ".") || str_isequal(e->d_name, ".."))
+            continue;
+
+        size_t name_len = strlen(e->d_name);
+        if (path_len + name_len + 2 > DH_PATH_MAX)
+            continue;
+        path[path_len] = '/';
+        memcpy(path + path_len + 1, e->d_name, name_len + 1);
+
+        int isdir;
+        if (e->d_type == DT_DIR || e->d_type == DT_REG) {
+            isdir = e->d_type == DT_DIR;
+        }   else    {
+            struct stat s;
+            if (lstat(path, &s) != 0)
+                continue;
+            isdir = S_ISDIR(s.st_mode);
+        }
+
+        /* files of the directories that are added after watching are reported as new files,
+         * because they may be written before the directory is watched */
+        if (isdir)
+            fio_lnx_mon_watchtree(root_id, path, path_len + name_len + 1, root_len, fn, param);
+        else if (fn != NULL)
+            fn(path + root_len + 1, TRUE, TRUE, param);
+    }
+    path[path_len] = 0;
+    closedir(d);
+}
+
+/* removes watches of the root that are under relpath, empty relpath removes all of them */
+static void fio_lnx_mon_unwatchtree(int root_id, const char* relpath)
+{
+    size_t len = strlen(relpath);
+    for (int i = 0; i < g_mon.watches.slots_cnt; i++)   {
+        struct hashtable_item* item = &g_mon.watches.items[i];
+        if (item->hash == 0)
+            continue;
+
+        struct mon_watch* w = (struct mon_watch*)item->value;
+        if (w->root_id != root_id)
+            continue;
+        if (len == 0 ||
+            (strncmp(w->path, relpath, len) == 0 && (w->path[len] == 0 || w->path[len] == '/')))
+        {
+            inotify_rm_watch(g_mon.fd, w->wd);
+            hashtable_open_remove(&g_mon.watches, item);
+            FREE(w);
+        }
+    }
+}
+
+static const struct mon_root* fio_lnx_mon_findroot(int root_id)
+{
+    const struct mon_root* roots = (const struct mon_root*)g_mon.roots.buffer;
+    for (int i = 0; i < g_mon.roots.item_cnt; i++)  {
+        if (roots[i].id == root_id)
+            return &roots[i];
+    }
+    return NULL;
+}
+
+/* adds watches for a new directory in the tree, and reports it's files */
+static void fio_lnx_mon_adddir(const struct mon_watch* w, const char* relpath,
+                               pfn_fio_lnx_mon fn, void* param)
+{
+    char path[DH_PATH_MAX];
+    const struct mon_root* root = fio_lnx_mon_findroot(w->root_id);
+    if (root == NULL)
+        return;
+
+    size_t root_len = strlen(root->path);
+    size_t rel_len = strlen(relpath);
+    if (root_len + rel_len + 2 > DH_PATH_MAX)
+        return;
+    memcpy(path, root->path, root_len);
+    path[root_len] = '/';
+    memcpy(path + root_len + 1, relpath, rel_len + 1);
+    fio_lnx_mon_watchtree(w->root_id, path, root_len + rel_len + 1, root_len, fn, param);
+}
+
+/*************************************************************************************************/
+/* watches the directory and it's subdirectories, returns id of the watched root, -1 if failed */
+int fio_lnx_mon_addwatch(const char* dir)
+{
+    char path[DH_PATH_MAX];
+
+    if (g_mon.fd == -1) {
+        g_mon.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (g_mon.fd == -1) {
+            log_printf(LOG_WARNING, "file-mon: inotify init failed: %s", strerror(errno));
+            return -1;
+        }
+
+        if (IS_FAIL(hashtable_open_create(mem_heap(), &g_mon.watches, MON_WATCH_CNT,
+                                          MON_WATCH_CNT, 0)) ||
+            IS_FAIL(arr_create(mem_heap(), &g_mon.roots, sizeof(struct mon_root), 5, 5, 0)))
+        {
+            err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+            return -1;
+        }
+    }
+
+    str_safecpy(path, sizeof(path), dir);
+    size_t len = strlen(path);
+    if (len > 1 && path[len-1] == '/')
+        path[--len] = 0;
+
+    struct mon_root* root = (struct mon_root*)arr_add(&g_mon.roots);
+    if (root == NULL)
+        return -1;
+    root->id = ++g_mon.next_id;
+    strcpy(root->path, path);
+
+    int cnt = g_mon.watches.items_cnt;
+    fio_lnx_mon_watchtree(root->id, path, len, len, NULL, NULL);
+    if (g_mon.watches.items_cnt == cnt) {
+        g_mon.roots.item_cnt--;
+        return -1;
+    }
+    return root->id;
+}
+
+void fio_lnx_mon_removewatch(int root_id)
+{
+    if (g_mon.fd == -1)
+        return;
+
+    fio_lnx_mon_unwatchtree(root_id, "");
+
+    struct mon_root* roots = (struct mon_root*)g_mon.roots.buffer;
+    for (int i = 0; i < g_mon.roots.item_cnt; i++)  {
+        if (roots[i].id == root_id) {
+            roots[i] = roots[--g_mon.roots.item_cnt];
+            break;
+        }
+    }
+}
+
+/* reads all pending events without blocking and reports them to the callback */
+void fio_lnx_mon_poll(pfn_fio_lnx_mon fn, void* param)
+{
+    uint8 buff[MON_READ_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    char filepath[DH_PATH_MAX];
+
+    if (g_mon.fd == -1)
+        return;
+
+    for (;;)    {
+        ssize_t bytes = read(g_mon.fd, buff, sizeof(buff));
+        if (bytes == -1 && errno == EINTR)
+            continue;
+        if (bytes <= 0)
+            break;  /* EAGAIN: no more events */
+
+        for (const uint8* p = buff; p < buff + bytes; ) {
+            const struct inotify_event* e = (const struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + e->len;
+
+            if (e->mask & IN_Q_OVERFLOW)    {
+                log_print(LOG_WARNING, "file-mon: event queue overflow, some changes are lost");
+                fn(NULL, FALSE, TRUE, param);
+                continue;
+            }
+
+            struct hashtable_item* item = hashtable_open_find(&g_mon.watches, (uint)e->wd);
+            if (item == NULL)
+                continue;   /* removed by us, remaining events are dropped */
+            struct mon_watch* w = (struct mon_watch*)item->value;
+
+            /* directory is deleted or unmounted, kernel removed the watch */
+            if (e->mask & IN_IGNORED)   {
+                hashtable_open_remove(&g_mon.watches, item);
+                FREE(w);
+                continue;
+            }
+
+            if (e->len == 0)
+                continue;
+            int n = w->path[0] != 0 ?
+                snprintf(filepath, sizeof(filepath), "%s/%s", w->path, e->name) :
+                snprintf(filepath, sizeof(filepath), "%s", e->name);
+            if (n <= 0 || n >= (int)sizeof(filepath))
+                continue;
+
+            if (e->mask & IN_ISDIR) {
+                if (e->mask & (IN_CREATE | IN_MOVED_TO))
+                    fio_lnx_mon_adddir(w, filepath, fn, param);
+                else if (e->mask & IN_MOVED_FROM)
+                    fio_lnx_mon_unwatchtree(w->root_id, filepath);
+                fn(NULL, FALSE, TRUE, param);
+            }   else    {
+                fn(filepath, (e->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) != 0,
+                   (e->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)) != 0, param);
+            }
+        }
+    }
+}
+
+void fio_lnx_mon_release()
+{
+    if (g_mon.fd == -1)
+        return;
+
+    for (int i = 0; i < g_mon.watches.slots_cnt; i++)   {
+        struct hashtable_item* item = &g_mon.watches.items[i];
+        if (item->hash != 0)
+            FREE((struct mon_watch*)item->value);
+    }
+    hashtable_open_destroy(&g_mon.watches);
+    arr_destroy(&g_mon.roots);
+    close(g_mon.fd);
+    memset(&g_mon, 0x00, sizeof(g_mon));
+    g_mon.fd = -1;
+}
+
+#endif /* _LINUX_ && !_FILEMON_ */
@@ -13,6 +13,10 @@
  *
  ***********************************************************************************/
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* O_DIRECT */
+#endif
+
 #include "dhcore/util.h"
 
 #if defined(_POSIXLIB_)
@@ -27,6 +31,11 @@
 #include <pwd.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/uio.h>
+#include <limits.h>
 
 #if defined(_LINUX_)
 #include <sys/sendfile.h>
@@ -40,6 +49,13 @@
 #include "dhcore/str.h"
 #include "dhcore/path.h"
 
+/* maximum number of buffers in each writev call */
+#if defined(IOV_MAX) && IOV_MAX < 256
+#define UTIL_IOV_MAX IOV_MAX
+#else
+#define UTIL_IOV_MAX 256
+#endif
+
 char* util_runcmd(const char* cmd)
 {
     char buff[4096];
@@ -177,4 +193,265 @@ int util_delfile(const char* filepath)
     return unlink(filepath);
 }
 
+void* util_mapfile(const char* filepath, OUT size_t* psize)
+{
+    *psize = 0;
+    int fd = open(filepath, O_RDONLY);
+    if (fd == -1)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)  {
+        close(fd);
+        return NULL;
+    }
+
+    /* mapping keeps a reference to the file, so we can close the descriptor */
+    void* ptr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED)
+        return NULL;
+
+    *psize = (size_t)st.st_size;
+    return ptr;
+}
+
+void util_unmapfile(void* ptr, size_t size)
+{
+    munmap(ptr, size);
+}
+
+size_t util_readat(FILE* f, void* buffer, size_t size, uint64 offset)
+{
+    int fd = fileno(f);
+    size_t total = 0;
+    while (total < size)    {
+        ssize_t r = pread(fd, (uint8*)buffer + total, size - total, (off_t)(offset + total));
+        if (r <= 0) {
+            if (r < 0 && errno == EINTR)
+                continue;
+            break;
+        }
+        total += (size_t)r;
+    }
+    return total;
+}
+
+size_t util_writegather(FILE* f, const void* const* buffers, const size_t* sizes, int cnt)
+{
+    struct iovec iov[UTIL_IOV_MAX];
+    int fd = fileno(f);
+    size_t total = 0;
+    int idx = 0;
+    size_t skip = 0;    /* bytes of buffers[idx] that are already written (partial writes) */
+
+    fflush(f);
+    while (idx < cnt)   {
+        int iov_cnt = 0;
+        for (int i = idx; i < cnt && iov_cnt < UTIL_IOV_MAX; i++)   {
+            iov[iov_cnt].iov_base = (uint8*)buffers[i] + (i == idx ? skip : 0);
+            iov[iov_cnt].iov_len = sizes[i] - (i == idx ? skip : 0);
+            iov_cnt++;
+        }
+
+        ssize_t r = writev(fd, iov, iov_cnt);
+        if (r <= 0) {
+            if (r < 0 && errno == EINTR)
+                continue;
+            break;
+        }
+        total += (size_t)r;
+
+        /* advance over written buffers */
+        size_t written = (size_t)r;
+        while (idx < cnt && written >= sizes[idx] - skip)    {
+            written -= sizes[idx] - skip;
+            skip = 0;
+            idx++;
+        }
+        skip += written;
+    }
+    return total;
+}
+
+iptr_t util_openfd(const char* filepath, uint flags, OUT uint64* psize)
+{
+    int oflags = (flags & UTIL_FD_WRITE) ? (O_WRONLY | O_CREAT | O_TRUNC) : O_RDONLY;
+#if defined(O_CLOEXEC)
+    oflags |= O_CLOEXEC;
+#endif
+#if defined(O_DIRECT)
+    if (flags & UTIL_FD_DIRECT)
+        oflags |= O_DIRECT;
+#endif
+
+    int fd = open(filepath, oflags, 0666);
+    if (fd == -1)
+        return UTIL_FD_INVALID;
+
+#if defined(F_NOCACHE)
+    if (flags & UTIL_FD_DIRECT)
+        fcntl(fd, F_NOCACHE, 1);
+#endif
+    if (flags & UTIL_FD_SEQUENTIAL) {
+#if defined(POSIX_FADV_SEQUENTIAL)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#elif defined(F_RDAHEAD)
+        fcntl(fd, F_RDAHEAD, 1);
+#endif
+    }
+
+    if (psize != NULL)  {
+        struct stat s;
+        *psize = fstat(fd, &s) == 0 ? (uint64)s.st_size : 0;
+    }
+    return (iptr_t)fd;
+}
+
+void util_closefd(iptr_t fd)
+{
+    close((int)fd);
+}
+
+size_t util_readfd(iptr_t fd, void* buffer, size_t size, uint64 offset)
+{
+    size_t total = 0;
+    while (total < size)    {
+        ssize_t r = pread((int)fd, (uint8*)buffer + total, size - total, (off_t)(offset + total));
+        if (r <= 0) {
+            if (r < 0 && errno == EINTR)
+                continue;
+            break;
+        }
+        total += (size_t)r;
+    }
+    return total;
+}
+
+size_t util_readscatter(iptr_t fd, void* const* buffers, const size_t* sizes, int cnt,
+                        uint64 offset)
+{
+#if defined(_LINUX_)
+    struct iovec iov[UTIL_IOV_MAX];
+    size_t total = 0;
+    int idx = 0;
+    size_t skip = 0;    /* bytes of buffers[idx] that are already read (partial reads) */
+
+    while (idx < cnt)   {
+        int iov_cnt = 0;
+        for (int i = idx; i < cnt && iov_cnt < UTIL_IOV_MAX; i++)   {
+            iov[iov_cnt].iov_base = (uint8*)buffers[i] + (i == idx ? skip : 0);
+            iov[iov_cnt].iov_len = sizes[i] - (i == idx ? skip : 0);
+            iov_cnt++;
+        }
+
+        ssize_t r = preadv((int)fd, iov, iov_cnt, (off_t)(offset + total));
+        if (r <= 0) {
+            if (r < 0 && errno == EINTR)
+                continue;
+            break;
+        }
+        total += (size_t)r;
+
+        /* advance over filled buffers */
+        size_t read_sz = (size_t)r;
+        while (idx < cnt && read_sz >= sizes[idx] - skip)    {
+            read_sz -= sizes[idx] - skip;
+            skip = 0;
+            idx++;
+        }
+        skip += read_sz;
+    }
+    return total;
+#else
+    /* preadv is not available on all posix systems */
+    size_t total = 0;
+    for (int i = 0; i < cnt; i++)   {
+        size_t r = util_readfd(fd, buffers[i], sizes[i], offset + total);
+        total += r;
+        if (r < sizes[i])
+            break;
+    }
+    return total;
+#endif
+}
+
+size_t util_writefd(iptr_t fd, const void* buffer, size_t size, uint64 offset)
+{
+    size_t total = 0;
+    while (total < size)    {
+        ssize_t r = pwrite((int)fd, (const uint8*)buffer + total, size - total,
+                           (off_t)(offset + total));
+        if (r <= 0) {
+            if (r < 0 && errno == EINTR)
+                continue;
+            break;
+        }
+        total += (size_t)r;
+    }
+    return total;
+}
+
+/* path holds the directory (path_len chars) and is extended for each entry in place,
+ * entries are reported relative to the walked root (root_len chars) */
+static void util_walkdir_recursive(char* path, size_t path_len, size_t root_len,
+                                   pfn_util_walkdir fn, void* param)
+{
+    DIR* d = opendir(path);
+    if (d == NULL)
+        return;
+
+    struct dirent* e;
+    while ((e = readdir(d)) != NULL)    {
+        if (str_isequal(e->d_name, ".") || str_isequal(e->d_name, ".."))
+            continue;
+
+        /* skip paths that don't fit into DH_PATH_MAX */
+        size_t name_len = strlen(e->d_name);
+        if (path_len + name_len + 2 > DH_PATH_MAX)
+            continue;
+        path[path_len] = '/';
+        memcpy(path + path_len + 1, e->d_name, name_len + 1);
+
+        /* d_type is not supported by all file-systems, symlinks to files are followed, but
+         * symlinks to directories are not (they may create cycles) */
+        int isdir;
+        if (e->d_type == DT_DIR)    {
+            isdir = TRUE;
+        }   else if (e->d_type == DT_REG)   {
+            isdir = FALSE;
+        }   else    {
+            struct stat s;
+            if (stat(path, &s) != 0)
+                continue;
+            isdir = S_ISDIR(s.st_mode);
+            if (isdir && e->d_type == DT_LNK)
+                continue;
+            if (isdir && e->d_type == DT_UNKNOWN && lstat(path, &s) == 0 && S_ISLNK(s.st_mode))
+                continue;
+        }
+
+        if (isdir)
+            util_walkdir_recursive(path, path_len + name_len + 1, root_len, fn, param);
+        else
+            fn(path + root_len + 1, param);
+    }
+    path[path_len] = 0;
+    closedir(d);
+}
+
+int util_walkdir(const char* dir, pfn_util_walkdir fn, void* param)
+{
+    char path[DH_PATH_MAX];
+    if (!util_pathisdir(dir))
+        return FALSE;
+
+    str_safecpy(path, sizeof(path), dir);
+    size_t len = strlen(path);
+    if (len > 1 && path[len-1] == '/')
+        path[--len] = 0;
+    util_walkdir_recursive(path, len, len, fn, param);
+    return TRUE;
+}
+
 #endif /* _POSIX_ */
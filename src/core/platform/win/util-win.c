@@ -20,6 +20,7 @@
 #include "dhcore/win.h"
 #include <conio.h>
 #include <Shlobj.h>
+#include <io.h>
 
 #include "dhcore/err.h"
 #include "dhcore/str.h"
@@ -99,4 +100,231 @@ int util_delfile(const char* filepath)
     return DeleteFile(filepath);
 }
 
+void* util_mapfile(const char* filepath, OUT size_t* psize)
+{
+    *psize = 0;
+    HANDLE f = CreateFile(filepath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (f == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(f, &size) || size.QuadPart == 0) {
+        CloseHandle(f);
+        return NULL;
+    }
+
+    /* the view keeps references to mapping and file, so both handles can be closed */
+    HANDLE m = CreateFileMapping(f, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(f);
+    if (m == NULL)
+        return NULL;
+
+    void* ptr = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(m);
+    if (ptr == NULL)
+        return NULL;
+
+    *psize = (size_t)size.QuadPart;
+    return ptr;
+}
+
+void util_unmapfile(void* ptr, size_t size)
+{
+    UnmapViewOfFile(ptr);
+}
+
+size_t util_readat(FILE* f, void* buffer, size_t size, uint64 offset)
+{
+    HANDLE h = (HANDLE)_get_osfhandle(_fileno(f));
+    size_t total = 0;
+    while (total < size)    {
+        OVERLAPPED ov;
+        DWORD read_sz = 0;
+        uint64 pos = offset + total;
+        memset(&ov, 0x00, sizeof(ov));
+        ov.Offset = (DWORD)(pos & 0xffffffff);
+        ov.OffsetHigh = (DWORD)(pos >> 32);
+        size_t chunk_sz = size - total;
+        if (chunk_sz > 0x40000000)
+            chunk_sz = 0x40000000;
+        if (!ReadFile(h, (uint8*)buffer + total, (DWORD)chunk_sz, &read_sz, &ov) || read_sz == 0)
+            break;
+        total += read_sz;
+    }
+    return total;
+}
+
+size_t util_writegather(FILE* f, const void* const* buffers, const size_t* sizes, int cnt)
+{
+    /* WriteFileGather needs unbuffered handles and page-sized buffers, so buffers are written
+     * one by one, bypassing stdio buffers */
+    HANDLE h = (HANDLE)_get_osfhandle(_fileno(f));
+    size_t total = 0;
+
+    fflush(f);
+    for (int i = 0; i < cnt; i++)   {
+        size_t offset = 0;
+        while (offset < sizes[i])   {
+            DWORD write_sz = 0;
+            size_t chunk_sz = sizes[i] - offset;
+            if (chunk_sz > 0x40000000)
+                chunk_sz = 0x40000000;
+            if (!WriteFile(h, (const uint8*)buffers[i] + offset, (DWORD)chunk_sz, &write_sz, NULL) ||
+                write_sz == 0)
+            {
+                return total;
+            }
+            offset += write_sz;
+            total += write_sz;
+        }
+    }
+    return total;
+}
+
+iptr_t util_openfd(const char* filepath, uint flags, OUT uint64* psize)
+{
+    DWORD attrs = FILE_ATTRIBUTE_NORMAL;
+    if (flags & UTIL_FD_SEQUENTIAL)
+        attrs |= FILE_FLAG_SEQUENTIAL_SCAN;
+    if (flags & UTIL_FD_DIRECT)
+        attrs |= FILE_FLAG_NO_BUFFERING;
+
+    HANDLE h;
+    if (flags & UTIL_FD_WRITE)  {
+        h = CreateFile(filepath, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, attrs, NULL);
+    }   else    {
+        h = CreateFile(filepath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                       OPEN_EXISTING, attrs, NULL);
+    }
+    if (h == INVALID_HANDLE_VALUE)
+        return UTIL_FD_INVALID;
+
+    if (psize != NULL)  {
+        LARGE_INTEGER sz;
+        *psize = GetFileSizeEx(h, &sz) ? (uint64)sz.QuadPart : 0;
+    }
+    return (iptr_t)h;
+}
+
+void util_closefd(iptr_t fd)
+{
+    CloseHandle((HANDLE)fd);
+}
+
+size_t util_readfd(iptr_t fd, void* buffer, size_t size, uint64 offset)
+{
+    size_t total = 0;
+    while (total < size)    {
+        OVERLAPPED ov;
+        DWORD read_sz = 0;
+        uint64 pos = offset + total;
+        memset(&ov, 0x00, sizeof(ov));
+        ov.Offset = (DWORD)(pos & 0xffffffff);
+        ov.OffsetHigh = (DWORD)(pos >> 32);
+        size_t chunk_sz = size - total;
+        if (chunk_sz > 0x40000000)
+            chunk_sz = 0x40000000;
+        if (!ReadFile((HANDLE)fd, (uint8*)buffer + total, (DWORD)chunk_sz, &read_sz, &ov) ||
+            read_sz == 0)
+        {
+            break;
+        }
+        total += read_sz;
+    }
+    return total;
+}
+
+size_t util_readscatter(iptr_t fd, void* const* buffers, const size_t* sizes, int cnt,
+                        uint64 offset)
+{
+    /* ReadFileScatter needs unbuffered handles and page-sized buffers, so buffers are read
+     * one by one */
+    size_t total = 0;
+    for (int i = 0; i < cnt; i++)   {
+        size_t r = util_readfd(fd, buffers[i], sizes[i], offset + total);
+        total += r;
+        if (r < sizes[i])
+            break;
+    }
+    return total;
+}
+
+size_t util_writefd(iptr_t fd, const void* buffer, size_t size, uint64 offset)
+{
+    size_t total = 0;
+    while (total < size)    {
+        OVERLAPPED ov;
+        DWORD write_sz = 0;
+        uint64 pos = offset + total;
+        memset(&ov, 0x00, sizeof(ov));
+        ov.Offset = (DWORD)(pos & 0xffffffff);
+        ov.OffsetHigh = (DWORD)(pos >> 32);
+        size_t chunk_sz = size - total;
+        if (chunk_sz > 0x40000000)
+            chunk_sz = 0x40000000;
+        if (!WriteFile((HANDLE)fd, (const uint8*)buffer + total, (DWORD)chunk_sz, &write_sz, &ov) ||
+            write_sz == 0)
+        {
+            break;
+        }
+        total += write_sz;
+    }
+    return total;
+}
+
+/* path holds the directory (path_len chars) and is extended for each entry in place,
+ * entries are reported relative to the walked root (root_len chars) */
+static void util_walkdir_recursive(char* path, size_t path_len, size_t root_len,
+                                   pfn_util_walkdir fn, void* param)
+{
+    WIN32_FIND_DATA fd;
+
+    if (path_len + 3 > DH_PATH_MAX)
+        return;
+    strcpy(path + path_len, "\\*");
+    HANDLE h = FindFirstFile(path, &fd);
+    if (h == INVALID_HANDLE_VALUE)  {
+        path[path_len] = 0;
+        return;
+    }
+
+    do  {
+        if (str_isequal(fd.cFileName, ".") || str_isequal(fd.cFileName, ".."))
+            continue;
+
+        /* skip paths that don't fit into DH_PATH_MAX */
+        size_t name_len = strlen(fd.cFileName);
+        if (path_len + name_len + 2 > DH_PATH_MAX)
+            continue;
+        path[path_len] = '/';
+        memcpy(path + path_len + 1, fd.cFileName, name_len + 1);
+
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)   {
+            /* junctions and directory symlinks are not followed, they may create cycles */
+            if (fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
+                continue;
+            util_walkdir_recursive(path, path_len + name_len + 1, root_len, fn, param);
+        }   else    {
+            fn(path + root_len + 1, param);
+        }
+    }   while (FindNextFile(h, &fd));
+    path[path_len] = 0;
+    FindClose(h);
+}
+
+int util_walkdir(const char* dir, pfn_util_walkdir fn, void* param)
+{
+    char path[DH_PATH_MAX];
+    if (!util_pathisdir(dir))
+        return FALSE;
+
+    str_safecpy(path, sizeof(path), dir);
+    size_t len = strlen(path);
+    if (len > 1 && (path[len-1] == '\\' || path[len-1] == '/'))
+        path[--len] = 0;
+    util_walkdir_recursive(path, len, len, fn, param);
+    return TRUE;
+}
+
 #endif /* _WIN_ */
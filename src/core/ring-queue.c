@@ -0,0 +1,226 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#include "dhcore/ring-queue.h"
+#include "dhcore/mt.h"
+#include "dhcore/err.h"
+#include "dhcore/numeric.h"
+
+/* item data is placed after cell's sequence number, 8 bytes keep 64bit items aligned */
+#define RINGQ_CELL_HDR sizeof(uint64)
+
+#if defined(_WIN_)
+#define RINGQ_CAS(dest, cmp_value, swap_value)  \
+    (uint)InterlockedCompareExchange((long volatile*)&(dest), (long)(swap_value), (long)(cmp_value))
+#else
+#define RINGQ_CAS(dest, cmp_value, swap_value)  \
+    MT_ATOMIC_CAS(dest, cmp_value, swap_value)
+#endif
+
+INLINE volatile uint* ringq_cellseq(const struct ring_queue* rq, uint pos)
+{
+    return (volatile uint*)(rq->cells + (pos & rq->mask)*rq->cell_sz);
+}
+
+INLINE uint8* ringq_celldata(const struct ring_queue* rq, uint pos)
+{
+    return rq->cells + (pos & rq->mask)*rq->cell_sz + RINGQ_CELL_HDR;
+}
+
+result_t ringq_create(struct allocator* alloc, struct ring_queue* rq,
+                      enum ringq_type type, int item_sz, int capacity, uint mem_id)
+{
+    ASSERT(item_sz > 0);
+    ASSERT(capacity > 0);
+
+    memset(rq, 0x00, sizeof(struct ring_queue));
+
+    /* round capacity up to power of two, so positions can wrap with a mask */
+    uint cap = 1;
+    while (cap < (uint)capacity)
+        cap <<= 1;
+
+    rq->alloc = alloc;
+    rq->mask = cap - 1;
+    rq->item_sz = (uint)item_sz;
+    rq->cell_sz = (uint)aligni((int)RINGQ_CELL_HDR + item_sz, (int)RINGQ_CELL_HDR);
+    rq->flags = (uint)type;
+
+    rq->cells = (uint8*)A_ALIGNED_ALLOC(alloc, rq->cell_sz*cap, mem_id);
+    if (rq->cells == NULL)
+        return RET_OUTOFMEMORY;
+
+    for (uint i = 0; i < cap; i++)
+        *ringq_cellseq(rq, i) = i;
+
+    return RET_OK;
+}
+
+void ringq_destroy(struct ring_queue* rq)
+{
+    ASSERT(rq != NULL);
+
+    if (rq->cells != NULL)  {
+        ASSERT(rq->alloc != NULL);
+        A_ALIGNED_FREE(rq->alloc, rq->cells);
+        rq->cells = NULL;
+    }
+}
+
+/* a cell at 'pos' is free for producers if seq == pos, and published for consumers if
+ * seq == pos + 1. consumers release the cell for the next lap by setting seq = pos + capacity */
+int ringq_push(struct ring_queue* rq, const void* item)
+{
+    uint pos = rq->tail;
+
+    if (BIT_CHECK(rq->flags, RINGQ_SINGLE_PRODUCER))    {
+        if (MT_ATOMIC_LOAD_ACQ(*ringq_cellseq(rq, pos)) != pos)
+            return FALSE;
+        rq->tail = pos + 1;
+    }   else    {
+        while (TRUE)    {
+            int dif = (int)(MT_ATOMIC_LOAD_ACQ(*ringq_cellseq(rq, pos)) - pos);
+            if (dif == 0)   {
+                uint prev = RINGQ_CAS(rq->tail, pos, pos + 1);
+                if (prev == pos)
+                    break;
+                pos = prev;
+            }   else if (dif < 0)   {
+                return FALSE;   /* full */
+            }   else    {
+                pos = rq->tail;
+            }
+        }
+    }
+
+    memcpy(ringq_celldata(rq, pos), item, rq->item_sz);
+    MT_ATOMIC_STORE_REL(*ringq_cellseq(rq, pos), pos + 1);
+    return TRUE;
+}
+
+int ringq_pop(struct ring_queue* rq, void* item)
+{
+    uint pos = rq->head;
+
+    if (BIT_CHECK(rq->flags, RINGQ_SINGLE_CONSUMER))    {
+        if (MT_ATOMIC_LOAD_ACQ(*ringq_cellseq(rq, pos)) != pos + 1)
+            return FALSE;
+        rq->head = pos + 1;
+    }   else    {
+        while (TRUE)    {
+            int dif = (int)(MT_ATOMIC_LOAD_ACQ(*ringq_cellseq(rq, pos)) - (pos + 1));
+            if (dif == 0)   {
+                uint prev = RINGQ_CAS(rq->head, pos, pos + 1);
+                if (prev == pos)
+                    break;
+                pos = prev;
+            }   else if (dif < 0)   {
+                return FALSE;   /* empty */
+            }   else    {
+                pos = rq->head;
+            }
+        }
+    }
+
+    memcpy(item, ringq_celldata(rq, pos), rq->item_sz);
+    MT_ATOMIC_STORE_REL(*ringq_cellseq(rq, pos), pos + rq->mask + 1);
+    return TRUE;
+}
+
+/* batches scan ahead for cells that are ready (free/published) and claim them with a single index
+ * update. once claimed, the cells can't be touched by other threads until we publish/release them,
+ * so unlike claiming first and then waiting, a stalled thread never blocks the others */
+int ringq_push_batch(struct ring_queue* rq, const void* items, int item_cnt)
+{
+    uint pos = rq->tail;
+    uint cnt;
+    uint max_cnt = minui((uint)item_cnt, rq->mask + 1);
+
+    while (TRUE)    {
+        cnt = 0;
+        while (cnt < max_cnt && MT_ATOMIC_LOAD_ACQ(*ringq_cellseq(rq, pos + cnt)) == pos + cnt)
+            cnt++;
+        if (cnt == 0)   {
+            /* first cell is not free: queue is full, or another producer claimed it */
+            if ((int)(MT_ATOMIC_LOAD_ACQ(*ringq_cellseq(rq, pos)) - pos) < 0)
+                return 0;
+            pos = rq->tail;
+            continue;
+        }
+
+        if (BIT_CHECK(rq->flags, RINGQ_SINGLE_PRODUCER))    {
+            rq->tail = pos + cnt;
+            break;
+        }
+
+        uint prev = RINGQ_CAS(rq->tail, pos, pos + cnt);
+        if (prev == pos)
+            break;
+        pos = prev;
+    }
+
+    const uint8* src = (const uint8*)items;
+    for (uint i = 0; i < cnt; i++)  {
+        memcpy(ringq_celldata(rq, pos + i), src + i*rq->item_sz, rq->item_sz);
+        MT_ATOMIC_STORE_REL(*ringq_cellseq(rq, pos + i), pos + i + 1);
+    }
+
+    return (int)cnt;
+}
+
+int ringq_pop_batch(struct ring_queue* rq, void* items, int max_cnt)
+{
+    uint pos = rq->head;
+    uint cnt;
+    uint cap = rq->mask + 1;
+    uint mcnt = minui((uint)max_cnt, cap);
+
+    while (TRUE)    {
+        cnt = 0;
+        while (cnt < mcnt && MT_ATOMIC_LOAD_ACQ(*ringq_cellseq(rq, pos + cnt)) == pos + cnt + 1)
+            cnt++;
+        if (cnt == 0)   {
+            /* first cell is not published: queue is empty, or another consumer took it */
+            if ((int)(MT_ATOMIC_LOAD_ACQ(*ringq_cellseq(rq, pos)) - (pos + 1)) < 0)
+                return 0;
+            pos = rq->head;
+            continue;
+        }
+
+        if (BIT_CHECK(rq->flags, RINGQ_SINGLE_CONSUMER))    {
+            rq->head = pos + cnt;
+            break;
+        }
+
+        uint prev = RINGQ_CAS(rq->head, pos, pos + cnt);
+        if (prev == pos)
+            break;
+        pos = prev;
+    }
+
+    uint8* dest = (uint8*)items;
+    for (uint i = 0; i < cnt; i++)  {
+        memcpy(dest + i*rq->item_sz, ringq_celldata(rq, pos + i), rq->item_sz);
+        MT_ATOMIC_STORE_REL(*ringq_cellseq(rq, pos + i), pos + i + cap);
+    }
+
+    return (int)cnt;
+}
+
+int ringq_count(const struct ring_queue* rq)
+{
+    int cnt = (int)(rq->tail - rq->head);
+    return clampi(cnt, 0, (int)(rq->mask + 1));
+}
@@ -18,6 +18,27 @@
 
 #define MAX_COMMAND_LIST    128
 
+/* value names used by built-in methods, hashes are precomputed in rpc_init */
+enum rpc_builtin_name
+{
+    RPC_NAME_NAME = 0,
+    RPC_NAME_METHOD,
+    RPC_NAME_DESCRIPTION,
+    RPC_NAME_PARAMS,
+    RPC_NAME_RESULT,
+    RPC_NAME_METHODS,
+    RPC_NAME_COUNT
+};
+
+static const char* g_builtin_names[] = {
+    "Name",
+    "Method",
+    "Description",
+    "Params",
+    "Result",
+    "Methods"
+};
+
 /* types */
 struct rpc_cmd
 {
@@ -26,6 +47,8 @@ struct rpc_cmd
     uint result_cnt;
     struct rpc_value* params;
     int param_cnt;
+    uint* result_hashes;    /* precomputed name hashes for results */
+    uint* param_hashes;     /* precomputed name hashes for params */
     void* user_param;
     pfn_rpc_cmd run_fn;
     char desc[256];
@@ -35,11 +58,16 @@ struct rpc_mgr
 {
     struct array cmds;  /* item: rpc_cmd */
     struct hashtable_open cmd_tbl;  /* key: name, value: cmd_id */
+    uint names[RPC_NAME_COUNT]; /* hashes of built-in value names */
 };
 
 /* globals */
 static struct rpc_mgr* g_rpc = NULL;
 
+/* fwd */
+static struct rpc_vblock* rpc_vblock_create_hashed(const struct rpc_value* values,
+    const uint* name_hashes, uint value_cnt, struct allocator* alloc);
+
 /*************************************************************************************************/
 INLINE struct rpc_cmd* rpc_cmd_get(uint id)
 {
@@ -86,15 +114,15 @@ static const char* rpc_get_valuetype_str(enum rpc_value_type type, uint stride)
 static struct rpc_result* rpc_method_help(struct rpc_vblock* results, struct rpc_vblock* params, 
     int id, void* user_param)
 {
-    const char* name = rpc_vblock_gets(params, RPC_VALUE(Name));
+    const char* name = rpc_vblock_gets(params, g_rpc->names[RPC_NAME_NAME]);
     uint cmd_id = rpc_cmd_find(name);
     if (cmd_id == 0)    {
         return rpc_return_error(id, RPC_ERROR_METHODNOTFOUND, "method '%s' not found", name);
     }   else    {
         struct rpc_cmd* cmd = rpc_cmd_get(cmd_id);
 
-        rpc_vblock_sets(results, RPC_VALUE(Method), name);
-        rpc_vblock_sets(results, RPC_VALUE(Description), cmd->desc);
+        rpc_vblock_sets(results, g_rpc->names[RPC_NAME_METHOD], name);
+        rpc_vblock_sets(results, g_rpc->names[RPC_NAME_DESCRIPTION], cmd->desc);
 
         /* params string */
         char param_str[512];
@@ -114,7 +142,7 @@ static struct rpc_result* rpc_method_help(struct rpc_vblock* results, struct rpc
                 rpc_get_valuetype_str(value->type, value->stride), arr_str, optional);
             strcat(param_str, param_line);
         }
-        rpc_vblock_sets(results, RPC_VALUE(Params), param_str);
+        rpc_vblock_sets(results, g_rpc->names[RPC_NAME_PARAMS], param_str);
 
         /* results string */
         char result_str[512];
@@ -130,7 +158,7 @@ static struct rpc_result* rpc_method_help(struct rpc_vblock* results, struct rpc
                 rpc_get_valuetype_str(value->type, value->stride), arr_str);
             strcat(result_str, result_line);
         }
-        rpc_vblock_sets(results, RPC_VALUE(Result), result_str);
+        rpc_vblock_sets(results, g_rpc->names[RPC_NAME_RESULT], result_str);
 
         return rpc_make_result(results, id, NULL);
     }
@@ -142,9 +170,9 @@ static struct rpc_result* rpc_method_listmethods(struct rpc_vblock* results, str
     int i;
     for (i = 0; i < g_rpc->cmds.item_cnt && i < MAX_COMMAND_LIST; i++)     {
         struct rpc_cmd* cmd = &ARR_ITEM(g_rpc->cmds, struct rpc_cmd, i);
-        rpc_vblock_sets_idx(results, RPC_VALUE(Methods), i, cmd->name);
+        rpc_vblock_sets_idx(results, g_rpc->names[RPC_NAME_METHODS], i, cmd->name);
     }
-    rpc_vblock_set_arrcnt(results, RPC_VALUE(Methods), i); 
+    rpc_vblock_set_arrcnt(results, g_rpc->names[RPC_NAME_METHODS], i); 
 
     return rpc_make_result(results, id, NULL);
 }
@@ -152,6 +180,13 @@ static struct rpc_result* rpc_method_listmethods(struct rpc_vblock* results, str
 /* */
 struct rpc_vblock* rpc_vblock_create(const struct rpc_value* values, uint value_cnt, 
     struct allocator* alloc)
+{
+    return rpc_vblock_create_hashed(values, NULL, value_cnt, alloc);
+}
+
+/* name_hashes: precomputed hashes of value names, if NULL, names are hashed here */
+static struct rpc_vblock* rpc_vblock_create_hashed(const struct rpc_value* values,
+    const uint* name_hashes, uint value_cnt, struct allocator* alloc)
 {
     /* estimate size */
     size_t buff_sz = 0;
@@ -161,6 +196,7 @@ struct rpc_vblock* rpc_vblock_create(const struct rpc_value* values, uint value_
     size_t total_sz = 
         sizeof(struct rpc_vblock) +
         sizeof(struct rpc_value)*value_cnt + 
+        sizeof(uint)*value_cnt +
         hashtable_fixed_estimate_size(value_cnt) +
         buff_sz;
 
@@ -183,9 +219,17 @@ struct rpc_vblock* rpc_vblock_create(const struct rpc_value* values, uint value_
     memcpy(vb->values, values, sizeof(struct rpc_value)*value_cnt);
     vb->value_cnt = value_cnt;
 
+    vb->name_hashes = (uint*)A_ALLOC(&stack_alloc, sizeof(uint)*value_cnt, 0);
+    if (name_hashes != NULL)    {
+        memcpy(vb->name_hashes, name_hashes, sizeof(uint)*value_cnt);
+    }   else    {
+        for (uint i = 0; i < value_cnt; i++)
+            vb->name_hashes[i] = hash_str(values[i].name);
+    }
+
     hashtable_fixed_create(&stack_alloc, &vb->vtbl, value_cnt, 0);
     for (uint i = 0; i < value_cnt; i++)
-        hashtable_fixed_add(&vb->vtbl, hash_str(values[i].name), i);
+        hashtable_fixed_add(&vb->vtbl, vb->name_hashes[i], i);
 
     vb->buff = (uint8*)A_ALLOC(&stack_alloc, buff_sz, 0);
     memset(vb->buff, 0x00, buff_sz);
@@ -446,6 +490,8 @@ result_t rpc_init()
     if (IS_FAIL(r))
         return err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
 
+    hash_str_table(g_rpc->names, g_builtin_names, RPC_NAME_COUNT);
+
     /* register help method */
     const struct rpc_value help_params[] = {
         {"Name", RPC_VALUE_STRING, 0, 32, 1, FALSE}
@@ -482,6 +528,10 @@ void rpc_release()
                 FREE(c->params);
             if (c->results != NULL)
                 FREE(c->results);
+            if (c->param_hashes != NULL)
+                FREE(c->param_hashes);
+            if (c->result_hashes != NULL)
+                FREE(c->result_hashes);
         }
         arr_destroy(&g_rpc->cmds);
 
@@ -513,7 +563,7 @@ struct rpc_result* rpc_return_error(int id, enum rpc_error_code code, const char
 struct rpc_result* rpc_process(const char* json_rpc)
 {
     /* parse json */
-    json_t jroot = json_parsestring(json_rpc);
+    json_t jroot = json_parsedom(json_rpc, strlen(json_rpc), mem_heap());
     if (jroot == NULL)  {
         err_printf(__FILE__, __LINE__, "JSON-RPC: parsing json '%s' failed", json_rpc);
         return NULL;
@@ -534,15 +584,17 @@ struct rpc_result* rpc_process(const char* json_rpc)
     /* create and parse params */
     struct rpc_vblock* vbparams = NULL;
 
-    vbparams = rpc_vblock_create(cmd->params, cmd->param_cnt, mem_heap());
+    vbparams = rpc_vblock_create_hashed(cmd->params, cmd->param_hashes, cmd->param_cnt,
+        mem_heap());
     ASSERT(vbparams);
     if (jparams != NULL)    {
         for (int i = 0; i < cmd->param_cnt; i++)    {
             struct rpc_value* p = &cmd->params[i];
+            uint name_hash = cmd->param_hashes[i];
 
             json_t jp = json_getitem(jparams, p->name);
             if (jp != NULL) {
-                enum rpc_value_type type = rpc_vblock_gettype(vbparams, hash_str(p->name));
+                enum rpc_value_type type = rpc_vblock_gettype(vbparams, name_hash);
                 if (type == RPC_VALUE_NULL) {
                     json_destroy(jroot);
                     rpc_vblock_destroy(vbparams);
@@ -551,14 +603,14 @@ struct rpc_result* rpc_process(const char* json_rpc)
                 }
                 switch (type)   {
                     case RPC_VALUE_INT:
-                    rpc_vblock_seti(vbparams, hash_str(p->name), json_geti(jp));
+                    rpc_vblock_seti(vbparams, name_hash, json_geti(jp));
                     break;
                     case RPC_VALUE_INT2:
                     {
                         struct vec2i v;
                         for (int i = 0, c = mini(json_getarr_count(jp), 2); i < c; i++)
                             v.n[i] = json_geti(json_getarr_item(jp, i));
-                        rpc_vblock_set2i(vbparams, hash_str(p->name), &v);
+                        rpc_vblock_set2i(vbparams, name_hash, &v);
                     }
                     break;
                     case RPC_VALUE_INT3:
@@ -568,7 +620,6 @@ struct rpc_result* rpc_process(const char* json_rpc)
                     case RPC_VALUE_INT_ARRAY:
                     {
                         int max_cnt = p->array_cnt;
-                        uint name_hash = hash_str(p->name);
                         int c = mini(json_getarr_count(jp), max_cnt);
                         for (int i = 0; i < c; i++)   {
                             rpc_vblock_seti_idx(vbparams, name_hash, i,
@@ -578,14 +629,14 @@ struct rpc_result* rpc_process(const char* json_rpc)
                     }
                     break;
                     case RPC_VALUE_FLOAT:
-                    rpc_vblock_setf(vbparams, hash_str(p->name), json_getf(jp));
+                    rpc_vblock_setf(vbparams, name_hash, json_getf(jp));
                     break;
                     case RPC_VALUE_FLOAT2:
                     {
                         struct vec2f v;
                         for (int i = 0, c = mini(json_getarr_count(jp), 2); i < c; i++)
                             v.f[i] = json_getf(json_getarr_item(jp, i));
-                        rpc_vblock_set2f(vbparams, hash_str(p->name), &v);
+                        rpc_vblock_set2f(vbparams, name_hash, &v);
                     }
                     break;
                     case RPC_VALUE_FLOAT3:
@@ -593,7 +644,7 @@ struct rpc_result* rpc_process(const char* json_rpc)
                         struct vec3f v;
                         for (int i = 0, c = mini(json_getarr_count(jp), 3); i < c; i++)
                             v.f[i] = json_getf(json_getarr_item(jp, i));
-                        rpc_vblock_set3f(vbparams, hash_str(p->name), &v);
+                        rpc_vblock_set3f(vbparams, name_hash, &v);
                     }
                     break;
                     case RPC_VALUE_FLOAT4:
@@ -601,20 +652,19 @@ struct rpc_result* rpc_process(const char* json_rpc)
                         struct vec4f v;
                         for (int i = 0, c = mini(json_getarr_count(jp), 4); i < c; i++)
                             v.f[i] = json_getf(json_getarr_item(jp, i));
-                        rpc_vblock_set3f(vbparams, hash_str(p->name), &v);
+                        rpc_vblock_set3f(vbparams, name_hash, &v);
                     }
                     break;
                     case RPC_VALUE_BOOL:
-                    rpc_vblock_setb(vbparams, hash_str(p->name), json_geti(jp));
+                    rpc_vblock_setb(vbparams, name_hash, json_geti(jp));
                     break;
                     case RPC_VALUE_STRING:
-                    rpc_vblock_sets(vbparams, hash_str(p->name), json_gets(jp));
+                    rpc_vblock_sets(vbparams, name_hash, json_gets(jp));
                     break;
 
                     case RPC_VALUE_STRING_ARRAY:
                     {
                         int max_cnt = p->array_cnt;
-                        uint name_hash = hash_str(p->name);
                         int c = mini(json_getarr_count(jp), max_cnt);
                         for (int i = 0; i < c; i++)   {
                             rpc_vblock_sets_idx(vbparams, name_hash, i, 
@@ -635,7 +685,8 @@ struct rpc_result* rpc_process(const char* json_rpc)
     }   /*endif: jparams != NULL */
 
     /* run method */
-    struct rpc_vblock* vbres = rpc_vblock_create(cmd->results, cmd->result_cnt, mem_heap());
+    struct rpc_vblock* vbres = rpc_vblock_create_hashed(cmd->results, cmd->result_hashes,
+        cmd->result_cnt, mem_heap());
     ASSERT(vbres);
     struct rpc_result* r = cmd->run_fn(vbres, vbparams, id, cmd->user_param);
     rpc_vblock_destroy(vbres);
@@ -653,14 +704,14 @@ struct rpc_result* rpc_make_result(struct rpc_vblock* ret, int id, struct rpc_er
 
         for (uint i = 0; i < ret->value_cnt; i++)   {
             struct rpc_value* value = &ret->values[i];
+            uint name_hash = ret->name_hashes[i];
             switch (value->type)    {
                 case RPC_VALUE_INT:
                 json_additem_toobj(jresult, value->name, 
-                    json_create_num(rpc_vblock_geti(ret, hash_str(value->name))));
+                    json_create_num(rpc_vblock_geti(ret, name_hash)));
                 break;
                 case RPC_VALUE_INT_ARRAY:
                 {
-                    uint name_hash = hash_str(value->name);
                     json_t jints = json_create_arr();
                     for (int k = 0; k< value->array_cnt; k++)    {
                         json_additem_toarr(jints, 
@@ -671,38 +722,37 @@ struct rpc_result* rpc_make_result(struct rpc_vblock* ret, int id, struct rpc_er
                 break;
                 case RPC_VALUE_INT2:
                 json_additem_toobj(jresult, value->name, 
-                    json_create_arri(rpc_vblock_get2i(ret, hash_str(value->name)).n, 2));
+                    json_create_arri(rpc_vblock_get2i(ret, name_hash).n, 2));
                 break;
                 case RPC_VALUE_INT3:
                 case RPC_VALUE_INT4:
                 ASSERT(0);
                 case RPC_VALUE_FLOAT:
                 json_additem_toobj(jresult, value->name, 
-                    json_create_num(rpc_vblock_getf(ret, hash_str(value->name))));
+                    json_create_num(rpc_vblock_getf(ret, name_hash)));
                 break;
                 case RPC_VALUE_FLOAT2:
                 json_additem_toobj(jresult, value->name, 
-                    json_create_arrf(rpc_vblock_get2f(ret, hash_str(value->name)).f, 2));
+                    json_create_arrf(rpc_vblock_get2f(ret, name_hash).f, 2));
                 break;
                 case RPC_VALUE_FLOAT3:
                 json_additem_toobj(jresult, value->name, 
-                    json_create_arrf(rpc_vblock_get3f(ret, hash_str(value->name)).f, 3));
+                    json_create_arrf(rpc_vblock_get3f(ret, name_hash).f, 3));
                 break;
                 case RPC_VALUE_FLOAT4:
                 json_additem_toobj(jresult, value->name, 
-                    json_create_arrf(rpc_vblock_get4f(ret, hash_str(value->name)).f, 4));
+                    json_create_arrf(rpc_vblock_get4f(ret, name_hash).f, 4));
                 break;
                 case RPC_VALUE_BOOL:
                 json_additem_toobj(jresult, value->name, 
-                    json_create_bool(rpc_vblock_getb(ret, hash_str(value->name))));
+                    json_create_bool(rpc_vblock_getb(ret, name_hash)));
                 break;
                 case RPC_VALUE_STRING:
                 json_additem_toobj(jresult, value->name, 
-                    json_create_str(rpc_vblock_gets(ret, hash_str(value->name))));
+                    json_create_str(rpc_vblock_gets(ret, name_hash)));
                 break;
                 case RPC_VALUE_STRING_ARRAY:
                 {
-                    uint name_hash = hash_str(value->name);
                     json_t jstrs = json_create_arr();
                     for (int k = 0; k< value->array_cnt; k++)    {
                         json_additem_toarr(jstrs, 
@@ -799,6 +849,11 @@ result_t rpc_registercmd(const char* name, pfn_rpc_cmd run_fn, const struct rpc_
         ASSERT(cmd->params);
         memcpy(cmd->params, params, param_cnt*sizeof(struct rpc_value));
         cmd->param_cnt = param_cnt;
+
+        cmd->param_hashes = (uint*)ALLOC(sizeof(uint)*param_cnt, 0);
+        ASSERT(cmd->param_hashes);
+        for (uint i = 0; i < param_cnt; i++)
+            cmd->param_hashes[i] = hash_str(params[i].name);
     }
 
     if (result_cnt > 0) {
@@ -806,6 +861,11 @@ result_t rpc_registercmd(const char* name, pfn_rpc_cmd run_fn, const struct rpc_
         ASSERT(cmd->results);
         memcpy(cmd->results, results, result_cnt*sizeof(struct rpc_value));
         cmd->result_cnt = result_cnt;
+
+        cmd->result_hashes = (uint*)ALLOC(sizeof(uint)*result_cnt, 0);
+        ASSERT(cmd->result_hashes);
+        for (uint i = 0; i < result_cnt; i++)
+            cmd->result_hashes[i] = hash_str(results[i].name);
     }
 
     /* fix param/result offsets */
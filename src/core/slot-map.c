@@ -0,0 +1,216 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#include "dhcore/slot-map.h"
+#include "dhcore/err.h"
+#include "dhcore/numeric.h"
+
+/* fwd */
+static result_t slotmap_expand(struct slot_map* sm);
+static void slotmap_initslots(struct slot_map* sm, int start_idx, int end_idx);
+
+result_t slotmap_create(struct allocator* alloc, struct slot_map* sm,
+                        const int* stream_sizes, int stream_cnt,
+                        int init_item_cnt, int expand_cnt, uint mem_id)
+{
+    ASSERT(stream_cnt > 0 && stream_cnt <= SLOTMAP_STREAMS_MAX);
+    ASSERT(init_item_cnt > 0);
+
+    memset(sm, 0x00, sizeof(struct slot_map));
+    sm->alloc = alloc;
+    sm->stream_cnt = stream_cnt;
+    sm->expand_sz = maxi(expand_cnt, 1);
+    sm->mem_id = mem_id;
+    sm->free_slot = INVALID_INDEX;
+
+    sm->slots = (struct slotmap_slot*)A_ALIGNED_ALLOC(alloc,
+        sizeof(struct slotmap_slot)*init_item_cnt, mem_id);
+    sm->dense_slots = (uint*)A_ALIGNED_ALLOC(alloc, sizeof(uint)*init_item_cnt, mem_id);
+    if (sm->slots == NULL || sm->dense_slots == NULL)   {
+        slotmap_destroy(sm);
+        return RET_OUTOFMEMORY;
+    }
+
+    for (int i = 0; i < stream_cnt; i++)  {
+        ASSERT(stream_sizes[i] > 0);
+        sm->stream_sizes[i] = stream_sizes[i];
+        sm->streams[i] = A_ALIGNED_ALLOC(alloc, stream_sizes[i]*init_item_cnt, mem_id);
+        if (sm->streams[i] == NULL) {
+            slotmap_destroy(sm);
+            return RET_OUTOFMEMORY;
+        }
+    }
+
+    sm->max_cnt = init_item_cnt;
+    slotmap_initslots(sm, 0, init_item_cnt);
+
+    return RET_OK;
+}
+
+void slotmap_destroy(struct slot_map* sm)
+{
+    ASSERT(sm != NULL);
+
+    if (sm->alloc == NULL)
+        return;
+
+    for (int i = 0; i < sm->stream_cnt; i++)  {
+        if (sm->streams[i] != NULL)
+            A_ALIGNED_FREE(sm->alloc, sm->streams[i]);
+    }
+
+    if (sm->dense_slots != NULL)
+        A_ALIGNED_FREE(sm->alloc, sm->dense_slots);
+    if (sm->slots != NULL)
+        A_ALIGNED_FREE(sm->alloc, sm->slots);
+
+    memset(sm, 0x00, sizeof(struct slot_map));
+    sm->free_slot = INVALID_INDEX;
+}
+
+/* push slots [start_idx, end_idx) to the free list, in order, so lower slots are used first */
+static void slotmap_initslots(struct slot_map* sm, int start_idx, int end_idx)
+{
+    for (int i = end_idx - 1; i >= start_idx; i--)    {
+        sm->slots[i].dense_idx = sm->free_slot;
+        sm->slots[i].gen = 1;
+        sm->free_slot = (uint)i;
+    }
+}
+
+static result_t slotmap_expand(struct slot_map* sm)
+{
+    int newsz = sm->max_cnt + sm->expand_sz;
+
+    struct slotmap_slot* slots = (struct slotmap_slot*)A_ALIGNED_REALLOC(sm->alloc, sm->slots,
+        sizeof(struct slotmap_slot)*newsz, sm->mem_id);
+    if (slots == NULL)
+        return RET_OUTOFMEMORY;
+    sm->slots = slots;
+
+    uint* dense_slots = (uint*)A_ALIGNED_REALLOC(sm->alloc, sm->dense_slots, sizeof(uint)*newsz,
+        sm->mem_id);
+    if (dense_slots == NULL)
+        return RET_OUTOFMEMORY;
+    sm->dense_slots = dense_slots;
+
+    for (int i = 0; i < sm->stream_cnt; i++)  {
+        void* stream = A_ALIGNED_REALLOC(sm->alloc, sm->streams[i], sm->stream_sizes[i]*newsz,
+            sm->mem_id);
+        if (stream == NULL)
+            return RET_OUTOFMEMORY;
+        sm->streams[i] = stream;
+    }
+
+    slotmap_initslots(sm, sm->max_cnt, newsz);
+    sm->max_cnt = newsz;
+    return RET_OK;
+}
+
+reshandle_t slotmap_add(struct slot_map* sm)
+{
+    if (sm->free_slot == INVALID_INDEX)    {
+        ASSERT(sm->item_cnt == sm->max_cnt);
+        if (IS_FAIL(slotmap_expand(sm)))
+            return INVALID_HANDLE;
+    }
+
+    uint slot_idx = sm->free_slot;
+    struct slotmap_slot* slot = &sm->slots[slot_idx];
+    sm->free_slot = slot->dense_idx;
+
+    uint dense_idx = (uint)sm->item_cnt++;
+    slot->dense_idx = dense_idx;
+    sm->dense_slots[dense_idx] = slot_idx;
+
+    return SLOTMAP_MAKE_HANDLE(slot_idx, slot->gen);
+}
+
+INLINE struct slotmap_slot* slotmap_getslot(const struct slot_map* sm, reshandle_t hdl)
+{
+    uint slot_idx = SLOTMAP_HANDLE_INDEX(hdl);
+    if (hdl == INVALID_HANDLE || slot_idx >= (uint)sm->max_cnt)
+        return NULL;
+    struct slotmap_slot* slot = &sm->slots[slot_idx];
+    return slot->gen == SLOTMAP_HANDLE_GEN(hdl) ? slot : NULL;
+}
+
+void slotmap_remove(struct slot_map* sm, reshandle_t hdl)
+{
+    struct slotmap_slot* slot = slotmap_getslot(sm, hdl);
+    if (slot == NULL)
+        return;
+
+    /* move last item into removed item's place, for all streams */
+    uint dense_idx = slot->dense_idx;
+    uint last_idx = (uint)(sm->item_cnt - 1);
+    if (dense_idx != last_idx)  {
+        for (int i = 0; i < sm->stream_cnt; i++)  {
+            int sz = sm->stream_sizes[i];
+            uint8* buff = (uint8*)sm->streams[i];
+            memcpy(buff + dense_idx*sz, buff + last_idx*sz, sz);
+        }
+
+        uint last_slot = sm->dense_slots[last_idx];
+        sm->dense_slots[dense_idx] = last_slot;
+        sm->slots[last_slot].dense_idx = dense_idx;
+    }
+    sm->item_cnt--;
+
+    /* invalidate handle and put slot back to free list
+     * generation 0 is never used, so INVALID_HANDLE-like values never get valid */
+    slot->gen = (slot->gen + 1 != 0) ? (slot->gen + 1) : 1;
+    slot->dense_idx = sm->free_slot;
+    sm->free_slot = SLOTMAP_HANDLE_INDEX(hdl);
+}
+
+int slotmap_isvalid(const struct slot_map* sm, reshandle_t hdl)
+{
+    return slotmap_getslot(sm, hdl) != NULL;
+}
+
+int slotmap_index(const struct slot_map* sm, reshandle_t hdl)
+{
+    struct slotmap_slot* slot = slotmap_getslot(sm, hdl);
+    return slot != NULL ? (int)slot->dense_idx : -1;
+}
+
+reshandle_t slotmap_handle(const struct slot_map* sm, int idx)
+{
+    ASSERT(idx >= 0 && idx < sm->item_cnt);
+    uint slot_idx = sm->dense_slots[idx];
+    return SLOTMAP_MAKE_HANDLE(slot_idx, sm->slots[slot_idx].gen);
+}
+
+void* slotmap_get(const struct slot_map* sm, reshandle_t hdl, int stream)
+{
+    ASSERT(stream < sm->stream_cnt);
+    struct slotmap_slot* slot = slotmap_getslot(sm, hdl);
+    if (slot == NULL)
+        return NULL;
+    return (uint8*)sm->streams[stream] + slot->dense_idx*sm->stream_sizes[stream];
+}
+
+void slotmap_clear(struct slot_map* sm)
+{
+    /* bump generation of used slots, so all previous handles are invalidated */
+    for (int i = 0; i < sm->item_cnt; i++)    {
+        struct slotmap_slot* slot = &sm->slots[sm->dense_slots[i]];
+        slot->gen = (slot->gen + 1 != 0) ? (slot->gen + 1) : 1;
+        slot->dense_idx = sm->free_slot;
+        sm->free_slot = sm->dense_slots[i];
+    }
+    sm->item_cnt = 0;
+}
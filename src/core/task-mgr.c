@@ -262,6 +262,9 @@ static void tsk_job_destroy(struct tsk_job* job)
 uint tsk_dispatch(pfn_tsk_run run_fn, enum tsk_run_context ctx, int thread_cnt, void* params,
                   void* result)
 {
+    if (g_tsk == NULL)
+        return 0;
+
     /* look for available threads based on specified context mode */
     int* thread_idxs = g_tsk->thread_idxs;
     int tsk_thread_cnt = g_tsk->thread_cnt;
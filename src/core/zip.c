@@ -13,20 +13,46 @@
  *
  ***********************************************************************************/
 
+#include <ctype.h>
 #include "dhcore/err.h"
 #include "dhcore/mem-mgr.h"
 #include "dhcore/zip.h"
+#include "dhcore/numeric.h"
+#include "dhcore/hash-table.h"
+#include "dhcore/pool-alloc.h"
+#include "dhcore/hash.h"
+#include "dhcore/str.h"
+#include "dhcore/util.h"
 #include "miniz/miniz.h"
+#include "lz4/lz4.h"
 
 /* */
+enum compress_codec zip_getcodec(enum compress_mode mode)
+{
+    switch (mode)   {
+        case COMPRESS_NONE:     return COMPRESS_CODEC_STORE;
+        case COMPRESS_LZ4:      return COMPRESS_CODEC_LZ4;
+        default:                return COMPRESS_CODEC_DEFLATE;
+    }
+}
+
 size_t zip_compressedsize(size_t src_size)
 {
-    return (size_t)compressBound((mz_ulong)src_size);
+    return maxsz((size_t)compressBound((mz_ulong)src_size),
+                 (size_t)LZ4_COMPRESSBOUND((uint64)src_size));
 }
 
 size_t zip_compress(void* dest_buffer, size_t dest_size,
                     const void* buffer, size_t size, enum compress_mode mode)
 {
+    if (mode == COMPRESS_LZ4)   {
+        if (size > LZ4_MAX_INPUT_SIZE)
+            return 0;
+        int r = LZ4_compress_default((const char*)buffer, (char*)dest_buffer, (int)size,
+                                     (int)minsz(dest_size, INT32_MAX));
+        return (size_t)r;
+    }
+
     int c_level;
     switch (mode)   {
         case COMPRESS_NORMAL:   c_level = Z_DEFAULT_COMPRESSION;    break;
@@ -48,58 +74,233 @@ size_t zip_decompress(void* dest_buffer, size_t dest_size, const void* buffer, s
     return (r == Z_OK) ? (size_t)dsize : 0;
 }
 
-zip_t zip_open(const char *filepath)
+size_t zip_decompress_codec(void* dest_buffer, size_t dest_size, const void* buffer, size_t size,
+                            enum compress_codec codec)
 {
-    mz_zip_archive *zip = (mz_zip_archive*)ALLOC(sizeof(mz_zip_archive), 0);
-    if (zip == NULL)
-        return NULL;
-    memset(zip, 0x00, sizeof(mz_zip_archive));
-
-    if (!mz_zip_reader_init_file(zip, filepath, 0)) {
-        FREE(zip);
-        return NULL;
+    switch (codec)  {
+        case COMPRESS_CODEC_DEFLATE:
+            return zip_decompress(dest_buffer, dest_size, buffer, size);
+        case COMPRESS_CODEC_LZ4:
+        {
+            if (size > INT32_MAX || dest_size > INT32_MAX)
+                return 0;
+            int r = LZ4_decompress_safe((const char*)buffer, (char*)dest_buffer, (int)size,
+                                        (int)dest_size);
+            return (r >= 0) ? (size_t)r : 0;
+        }
+        case COMPRESS_CODEC_STORE:
+            if (size > dest_size)
+                return 0;
+            memcpy(dest_buffer, buffer, size);
+            return size;
+        default:
+            return 0;
     }
+}
 
-    return zip;
+#define ZIP_INDEX_MIN 17
+#define ZIP_INDEX_BLOCK 256
+#define ZIP_LOCAL_HEADER_SIZE 30
+
+/* zip archive that is opened for reading, entries are found by a hash index of their names, which
+ * is built over the central directory once when the archive is opened */
+struct zip_archive
+{
+    mz_zip_archive mz;
+    struct hashtable_chained index; /* key: hash of lower-case entry name, value: entry index */
+    struct pool_alloc index_pool;   /* items of index */
+    struct allocator index_alloc;
+    const uint8* data;  /* whole archive in memory (mapped or user buffer), NULL if read from file */
+    size_t size;
+    int mapped; /* data is mapped by zip_open, and is unmapped on close */
+};
+
+/* entry names are case-insensitive (same as mz_zip_reader_locate_file) */
+static uint zip_hashname(const char* name)
+{
+    char lname[DH_PATH_MAX];
+    size_t i;
+    for (i = 0; name[i] != 0 && i < sizeof(lname) - 1; i++)
+        lname[i] = (char)tolower((int)(uint8)name[i]);
+    lname[i] = 0;
+    return hash_str(lname);
 }
 
-zip_t zip_open_mem(const char *buff, size_t buff_sz)
+static result_t zip_buildindex(struct zip_archive* zip)
+{
+    char name[DH_PATH_MAX];
+    uint cnt = mz_zip_reader_get_num_files(&zip->mz);
+
+    result_t r = mem_pool_create(mem_heap(), &zip->index_pool,
+                                 sizeof(struct hashtable_item_chained), ZIP_INDEX_BLOCK, 0);
+    if (IS_FAIL(r))
+        return r;
+    mem_pool_bindalloc(&zip->index_pool, &zip->index_alloc);
+
+    /* chained tables don't grow, so there is one slot for each entry */
+    r = hashtable_chained_create(mem_heap(), &zip->index_alloc, &zip->index,
+                                 maxi((int)cnt, ZIP_INDEX_MIN), 0);
+    if (IS_FAIL(r))
+        return r;
+
+    for (uint i = 0; i < cnt; i++)  {
+        if (mz_zip_reader_is_file_a_directory(&zip->mz, i) ||
+            mz_zip_reader_get_filename(&zip->mz, i, name, sizeof(name)) == 0)
+        {
+            continue;
+        }
+        r = hashtable_chained_add(&zip->index, zip_hashname(name), (iptr_t)i);
+        if (IS_FAIL(r))
+            return r;
+    }
+    return RET_OK;
+}
+
+static zip_t zip_init(const void* data, size_t size, const char* filepath, int mapped)
 {
-    mz_zip_archive *zip = (mz_zip_archive*)ALLOC(sizeof(mz_zip_archive), 0);
+    struct zip_archive* zip = (struct zip_archive*)ALLOC(sizeof(struct zip_archive), 0);
     if (zip == NULL)
         return NULL;
-    memset(zip, 0x00, sizeof(mz_zip_archive));
+    memset(zip, 0x00, sizeof(struct zip_archive));
 
-    if (!mz_zip_reader_init_mem(zip, buff, buff_sz, 0)) {
+    mz_bool r = data != NULL ? mz_zip_reader_init_mem(&zip->mz, data, size, 0) :
+        mz_zip_reader_init_file(&zip->mz, filepath, 0);
+    if (!r) {
         FREE(zip);
         return NULL;
     }
+    zip->data = (const uint8*)data;
+    zip->size = size;
+    zip->mapped = mapped;
 
+    if (IS_FAIL(zip_buildindex(zip)))   {
+        err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+        zip->mapped = FALSE;    /* caller unmaps the data */
+        zip_close(zip);
+        return NULL;
+    }
+    return zip;
+}
+
+zip_t zip_open(const char *filepath)
+{
+    /* archive is mapped, so stored entries can be fetched without copying (zip_getfile_mapped),
+     * and central directory is read directly from memory */
+    size_t size;
+    void* data = util_mapfile(filepath, &size);
+    zip_t zip = zip_init(data, size, filepath, data != NULL);
+    if (zip == NULL && data != NULL)
+        util_unmapfile(data, size);
     return zip;
 }
 
+zip_t zip_open_mem(const char *buff, size_t buff_sz)
+{
+    return zip_init(buff, buff_sz, NULL, FALSE);
+}
+
 void zip_close(zip_t zip)
 {
     ASSERT(zip);
-    mz_zip_reader_end(zip);
+    mz_zip_reader_end(&zip->mz);
+    if (zip->index.pslots != NULL)
+        hashtable_chained_destroy(&zip->index);
+    mem_pool_destroy(&zip->index_pool);
+    if (zip->mapped)
+        util_unmapfile((void*)zip->data, zip->size);
+    FREE(zip);
 }
 
-file_t zip_getfile(zip_t zip, const char *filepath, struct allocator *alloc)
+uint zip_findfile(zip_t zip, const char* filepath)
 {
-    int idx = mz_zip_reader_locate_file(zip, filepath, NULL, 0);
-    if (idx == -1)
-        return NULL;
+    char name[DH_PATH_MAX];
+    uint key = zip_hashname(filepath);
 
+    /* walk the slot, names of colliding entries are compared to find the right one */
+    struct linked_list* node = zip->index.pslots[key % zip->index.slots_cnt];
+    for (; node != NULL; node = node->next) {
+        struct hashtable_item_chained* item = (struct hashtable_item_chained*)node->data;
+        if (item->hash == key &&
+            mz_zip_reader_get_filename(&zip->mz, (mz_uint)item->value, name, sizeof(name)) != 0 &&
+            str_isequal_nocase(name, filepath))
+        {
+            return (uint)item->value + 1;
+        }
+    }
+    return 0;
+}
+
+file_t zip_getfile_id(zip_t zip, uint file_id, struct allocator* alloc, uint mem_id)
+{
+    ASSERT(file_id != 0);
+    char name[DH_PATH_MAX];
     mz_zip_archive_file_stat stat;
-    mz_zip_reader_file_stat(zip, idx, &stat);
+    mz_uint idx = file_id - 1;
 
-    void *buff = A_ALLOC(alloc, (size_t)stat.m_uncomp_size, 0);
+    if (!mz_zip_reader_file_stat(&zip->mz, idx, &stat) ||
+        mz_zip_reader_get_filename(&zip->mz, idx, name, sizeof(name)) == 0)
+    {
+        return NULL;
+    }
+
+    void *buff = A_ALLOC(alloc, (size_t)stat.m_uncomp_size, mem_id);
     if (buff == NULL)
         return NULL;
-    if (!mz_zip_reader_extract_to_mem(zip, idx, buff, (size_t)stat.m_uncomp_size, 0))   {
+    if (!mz_zip_reader_extract_to_mem(&zip->mz, idx, buff, (size_t)stat.m_uncomp_size, 0))   {
         A_FREE(alloc, buff);
         return NULL;
     }
 
-    return fio_attachmem(alloc, buff, (size_t)stat.m_uncomp_size, filepath, 0);
+    return fio_attachmem(alloc, buff, (size_t)stat.m_uncomp_size, name, mem_id);
+}
+
+/* returns data of the stored (not compressed) entry inside the archive memory, NULL if the entry is
+ * compressed, encrypted or archive is not in memory */
+static const uint8* zip_getstored(zip_t zip, const mz_zip_archive_file_stat* stat)
+{
+    if (zip->data == NULL || stat->m_method != 0 || (stat->m_bit_flag & 0x1) ||
+        stat->m_comp_size != stat->m_uncomp_size)
+    {
+        return NULL;
+    }
+
+    /* entry data is after the local header, which has it's own name and extra field lengths */
+    uint64 ofs = stat->m_local_header_ofs;
+    if (ofs + ZIP_LOCAL_HEADER_SIZE > zip->size)
+        return NULL;
+    const uint8* header = zip->data + ofs;
+    if (header[0] != 0x50 || header[1] != 0x4b || header[2] != 0x03 || header[3] != 0x04)
+        return NULL;
+    ofs += ZIP_LOCAL_HEADER_SIZE + (header[26] | ((uint)header[27] << 8)) +
+        (header[28] | ((uint)header[29] << 8));
+    if (ofs + stat->m_comp_size > zip->size)
+        return NULL;
+    return zip->data + ofs;
+}
+
+file_t zip_getfile_mapped(zip_t zip, uint file_id, struct allocator* alloc, uint mem_id)
+{
+    ASSERT(file_id != 0);
+    char name[DH_PATH_MAX];
+    mz_zip_archive_file_stat stat;
+    mz_uint idx = file_id - 1;
+
+    if (!mz_zip_reader_file_stat(&zip->mz, idx, &stat))
+        return NULL;
+
+    const uint8* data = zip_getstored(zip, &stat);
+    if (data == NULL)
+        return zip_getfile_id(zip, file_id, alloc, mem_id);
+
+    if (mz_zip_reader_get_filename(&zip->mz, idx, name, sizeof(name)) == 0)
+        return NULL;
+    return fio_createview(data, (size_t)stat.m_uncomp_size, name);
+}
+
+file_t zip_getfile(zip_t zip, const char *filepath, struct allocator *alloc)
+{
+    uint file_id = zip_findfile(zip, filepath);
+    if (file_id == 0)
+        return NULL;
+    return zip_getfile_id(zip, file_id, alloc, 0);
 }
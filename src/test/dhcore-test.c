@@ -37,8 +37,21 @@ static const struct unit_test_desc g_tests[] = {
     {test_mempool, "pool", "Pool allocator"},
     {test_thread, "thread", "Basic threads"},
     {test_taskmgr, "taskmgr", "Task manager"},
-    {test_hashtable, "hashtable_fixed", "Hash tables (fixed)"}
-    /*, {test_efsw, "watcher", "filesystem monitoring"}*/
+    {test_hashtable, "hashtable_fixed", "Hash tables (fixed)"},
+    {test_hash, "hash", "String hashing (compile-time)"},
+    {test_slotmap, "slotmap", "Slot-map container"},
+    {test_ringq, "ringq", "Lock-free ring queues"},
+    {test_pak, "pak", "Concurrent pak loads"},
+    {test_fioasync, "fio_async", "Asynchronous file loading"},
+    {test_zip, "zip", "Compression codecs (benchmark)"},
+    {test_vdir, "vdir", "Virtual directory lookups"},
+    {test_memfile, "memfile", "Memory files (chunked writes)"},
+    {test_filemon, "filemon", "File monitoring (debounced)"},
+    {test_diskfile, "diskfile", "Buffered disk files"},
+    {test_zipmount, "zipmount", "Zip archives in virtual filesystem"},
+    {test_paklayer, "paklayer", "Layered pak files (patches)"},
+    {test_jsonsax, "json_sax", "Streaming JSON reader (benchmark)"},
+    {test_jsondom, "json_dom", "Indexed JSON trees (benchmark)"}
 };
 
 static int g_testidx = -1;
@@ -60,6 +73,34 @@ void cmd_gettest(command_t* cmd, void* param)
         g_testidx = 5;
     }   else if (str_isequal_nocase(cmd->arg, "hashtable")) {
         g_testidx = 6;
+    }   else if (str_isequal_nocase(cmd->arg, "hash")) {
+        g_testidx = 7;
+    }   else if (str_isequal_nocase(cmd->arg, "slotmap")) {
+        g_testidx = 8;
+    }   else if (str_isequal_nocase(cmd->arg, "ringq")) {
+        g_testidx = 9;
+    }   else if (str_isequal_nocase(cmd->arg, "pak")) {
+        g_testidx = 10;
+    }   else if (str_isequal_nocase(cmd->arg, "fio_async")) {
+        g_testidx = 11;
+    }   else if (str_isequal_nocase(cmd->arg, "zip")) {
+        g_testidx = 12;
+    }   else if (str_isequal_nocase(cmd->arg, "vdir")) {
+        g_testidx = 13;
+    }   else if (str_isequal_nocase(cmd->arg, "memfile")) {
+        g_testidx = 14;
+    }   else if (str_isequal_nocase(cmd->arg, "filemon")) {
+        g_testidx = 15;
+    }   else if (str_isequal_nocase(cmd->arg, "diskfile")) {
+        g_testidx = 16;
+    }   else if (str_isequal_nocase(cmd->arg, "zipmount")) {
+        g_testidx = 17;
+    }   else if (str_isequal_nocase(cmd->arg, "paklayer")) {
+        g_testidx = 18;
+    }   else if (str_isequal_nocase(cmd->arg, "json_sax")) {
+        g_testidx = 19;
+    }   else if (str_isequal_nocase(cmd->arg, "json_dom")) {
+        g_testidx = 20;
     }
 }
 
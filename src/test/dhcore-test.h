@@ -24,9 +24,22 @@ void test_heap();
 void test_freelist();
 void test_mempool();
 void test_thread();
-void test_efsw();
 void test_taskmgr();
+void test_ringq();
+void test_pak();
+void test_fioasync();
+void test_zip();
+void test_vdir();
+void test_memfile();
+void test_filemon();
+void test_diskfile();
+void test_zipmount();
+void test_paklayer();
+void test_jsonsax();
+void test_jsondom();
 _EXTERN_ void test_hashtable();
+_EXTERN_ void test_hash();
+_EXTERN_ void test_slotmap();
 
 INLINE void fill_buffer(void* buffer, size_t size)
 {
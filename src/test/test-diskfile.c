@@ -0,0 +1,157 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#include <stdio.h>
+#include "dhcore-test.h"
+#include "dhcore/core.h"
+#include "dhcore/file-io.h"
+#include "dhcore/path.h"
+#include "dhcore/util.h"
+#include "dhcore/timer.h"
+
+#define DISKFILE_TEST_SIZE (16*1024*1024)
+#define DISKFILE_TEST_RECORD 97  /* odd size, so records cross buffer boundaries */
+
+static uint8 diskfile_test_byte(size_t offset)
+{
+    return (uint8)((offset*31) ^ (offset >> 13));
+}
+
+/* reads the whole file in small records, like parsers do, and checks it's content */
+static int diskfile_test_read(file_t f)
+{
+    uint8 record[DISKFILE_TEST_RECORD];
+    size_t offset = 0;
+    size_t cnt;
+    int fails = 0;
+
+    while ((cnt = fio_read(f, record, 1, sizeof(record))) > 0)  {
+        for (size_t i = 0; i < cnt; i++)
+            fails += record[i] != diskfile_test_byte(offset + i);
+        offset += cnt;
+    }
+    return fails + (offset != DISKFILE_TEST_SIZE);
+}
+
+/* scatter reads a header and two arrays, like mesh loaders do */
+static int diskfile_test_readv(file_t f)
+{
+    uint8 header[DISKFILE_TEST_RECORD];
+    struct fio_iovec iov[3];
+    int fails = 0;
+
+    iov[0].buffer = header;
+    iov[0].size = sizeof(header);
+    iov[1].size = 1024*1024;
+    iov[2].size = DISKFILE_TEST_SIZE - iov[1].size - iov[0].size;
+    iov[1].buffer = A_ALLOC(mem_heap(), iov[1].size, 0);
+    iov[2].buffer = A_ALLOC(mem_heap(), iov[2].size, 0);
+    if (iov[1].buffer == NULL || iov[2].buffer == NULL)
+        return 1;
+
+    fio_seek(f, SEEK_MODE_START, 0);
+    fails += fio_readv(f, iov, 3) != DISKFILE_TEST_SIZE;
+    size_t offset = 0;
+    for (int i = 0; i < 3; i++) {
+        for (size_t c = 0; c < iov[i].size; c++)
+            fails += ((uint8*)iov[i].buffer)[c] != diskfile_test_byte(offset + c);
+        offset += iov[i].size;
+    }
+
+    A_FREE(mem_heap(), iov[1].buffer);
+    A_FREE(mem_heap(), iov[2].buffer);
+    return fails;
+}
+
+void test_diskfile()
+{
+    char filepath[DH_PATH_MAX];
+    uint8 record[DISKFILE_TEST_RECORD];
+    int fails = 0;
+
+    path_join(filepath, util_gettempdir(filepath), "dhcore-diskfile.bin", NULL);
+
+    file_t f = fio_createdisk(filepath);
+    if (f == NULL)  {
+        log_printf(LOG_WARNING, "could not create '%s'", filepath);
+        return;
+    }
+    uint64 t0 = timer_querytick();
+    for (size_t offset = 0; offset < DISKFILE_TEST_SIZE; offset += sizeof(record))  {
+        size_t sz = minsz(sizeof(record), DISKFILE_TEST_SIZE - offset);
+        for (size_t i = 0; i < sz; i++)
+            record[i] = diskfile_test_byte(offset + i);
+        fio_write(f, record, sz, 1);
+    }
+    fio_close(f);
+    fl64 write_tm = timer_calctm(t0, timer_querytick());
+
+    /* buffered reads */
+    t0 = timer_querytick();
+    f = fio_opendisk(filepath, TRUE);
+    if (f != NULL && fio_getsize(f) == DISKFILE_TEST_SIZE)  {
+        fails += diskfile_test_read(f);
+
+        /* seek back into the read-ahead buffer */
+        fio_seek(f, SEEK_MODE_END, -10);
+        fails += fio_read(f, record, 4, 3) != 2 || fio_getpos(f) != DISKFILE_TEST_SIZE;
+        fio_seek(f, SEEK_MODE_CUR, -20);
+        fails += fio_read(f, record, 1, 1) != 1 ||
+            record[0] != diskfile_test_byte(DISKFILE_TEST_SIZE - 20);
+        fails += diskfile_test_readv(f);
+    }   else    {
+        fails++;
+    }
+    if (f != NULL)
+        fio_close(f);
+    fl64 read_tm = timer_calctm(t0, timer_querytick());
+
+    /* stdio, for comparison */
+    t0 = timer_querytick();
+    FILE* ff = fopen(filepath, "rb");
+    if (ff != NULL) {
+        size_t offset = 0;
+        size_t cnt;
+        while ((cnt = fread(record, 1, sizeof(record), ff)) > 0)  {
+            for (size_t i = 0; i < cnt; i++)
+                fails += record[i] != diskfile_test_byte(offset + i);
+            offset += cnt;
+        }
+        fclose(ff);
+    }
+    fl64 stdio_tm = timer_calctm(t0, timer_querytick());
+
+    /* direct I/O */
+    fio_setdiskbuffer(1024*1024, 1024*1024);
+    t0 = timer_querytick();
+    f = fio_opendisk(filepath, TRUE);
+    if (f != NULL)  {
+        fails += diskfile_test_read(f);
+        fio_close(f);
+    }   else    {
+        fails++;
+    }
+    fl64 direct_tm = timer_calctm(t0, timer_querytick());
+    fio_setdiskbuffer(128*1024, 0);
+
+    log_printf(LOG_TEXT, "write: %.3fs, read: %.3fs, stdio read: %.3fs, direct read: %.3fs",
+               write_tm, read_tm, stdio_tm, direct_tm);
+    util_delfile(filepath);
+
+    if (fails == 0)
+        log_print(LOG_TEXT, "done.");
+    else
+        log_printf(LOG_WARNING, "%d checks failed", fails);
+}
@@ -0,0 +1,133 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#include "dhcore-test.h"
+#include "dhcore/core.h"
+#include "dhcore/file-io.h"
+#include "dhcore/path.h"
+#include "dhcore/util.h"
+#include "dhcore/timer.h"
+
+#define FILEMON_TEST_FILES 300
+#define FILEMON_TEST_REWRITES 20
+#define FILEMON_TEST_TIMEOUT 3.0
+
+static void filemon_test_write(const char* filepath, int n)
+{
+    char data[32];
+    file_t f = fio_createdisk(filepath);
+    if (f != NULL)  {
+        fio_write(f, data, sprintf(data, "data %d", n), 1);
+        fio_close(f);
+    }
+}
+
+static void filemon_test_modified(const char* filepath, reshandle_t hdl, uptr_t param1,
+                                  uptr_t param2)
+{
+    ((int*)param1)[param2]++;
+}
+
+/* updates monitoring until all registered files are delivered, or timeout */
+static fl64 filemon_test_update(const int* cnts, int cnt)
+{
+    uint64 t0 = timer_querytick();
+    fl64 tm;
+    do  {
+        util_sleep(5);
+        fio_mon_update();
+        tm = timer_calctm(t0, timer_querytick());
+
+        int delivered = 0;
+        for (int i = 0; i < cnt; i++)
+            delivered += cnts[i] > 0;
+        if (delivered == cnt)
+            break;
+    }   while (tm < FILEMON_TEST_TIMEOUT);
+    return tm;
+}
+
+void test_filemon()
+{
+    char root[DH_PATH_MAX];
+    char subdir[DH_PATH_MAX];
+    char filepath[DH_PATH_MAX];
+    char filename[64];
+    int cnts[2] = {0, 0};
+    int fails = 0;
+
+    if (!fio_mon_avail())   {
+        log_print(LOG_WARNING, "file monitoring is not available in this build");
+        return;
+    }
+
+    util_gettempdir(root);
+    path_join(root, root, "dhcore-filemon", NULL);
+    path_join(subdir, root, "sub", NULL);
+    util_makedir(root);
+    filemon_test_write(path_join(filepath, root, "watched.txt", NULL), 0);
+
+    fio_mon_setdebounce(50);
+    if (!fio_addvdir(root, TRUE))   {
+        log_print(LOG_WARNING, "could not monitor temp directory");
+        return;
+    }
+    fio_mon_reg("watched.txt", filemon_test_modified, INVALID_HANDLE, (uptr_t)cnts, 0);
+    fio_mon_reg("sub/new.txt", filemon_test_modified, INVALID_HANDLE, (uptr_t)cnts, 1);
+
+    /* hot-reload storm: many files are rewritten many times, the watched file is delivered once */
+    uint64 t0 = timer_querytick();
+    for (int r = 0; r < FILEMON_TEST_REWRITES; r++) {
+        filemon_test_write(path_join(filepath, root, "watched.txt", NULL), r);
+        for (int i = 0; i < FILEMON_TEST_FILES; i++)    {
+            sprintf(filename, "file%d.txt", i);
+            filemon_test_write(path_join(filepath, root, filename, NULL), r);
+        }
+        fio_mon_update();
+    }
+    fl64 write_tm = timer_calctm(t0, timer_querytick());
+    fl64 tm = filemon_test_update(cnts, 1);
+    fails += cnts[0] != 1;
+    log_printf(LOG_TEXT, "%d writes in %.3fs, delivered in %.3fs",
+               FILEMON_TEST_REWRITES*(FILEMON_TEST_FILES + 1), write_tm, tm);
+
+    /* files of new directories are watched */
+    util_makedir(subdir);
+    filemon_test_write(path_join(filepath, subdir, "new.txt", NULL), 0);
+    filemon_test_update(cnts, 2);
+    fails += cnts[1] != 1;
+
+    /* nothing is delivered without changes */
+    cnts[0] = cnts[1] = 0;
+    util_sleep(100);
+    fio_mon_update();
+    fails += cnts[0] + cnts[1] != 0;
+
+    fio_mon_unreg("watched.txt");
+    fio_mon_unreg("sub/new.txt");
+    fio_clearvdirs();
+
+    util_delfile(path_join(filepath, root, "watched.txt", NULL));
+    util_delfile(path_join(filepath, subdir, "new.txt", NULL));
+    for (int i = 0; i < FILEMON_TEST_FILES; i++)    {
+        sprintf(filename, "file%d.txt", i);
+        util_delfile(path_join(filepath, root, filename, NULL));
+    }
+
+    if (fails == 0)
+        log_print(LOG_TEXT, "done.");
+    else
+        log_printf(LOG_WARNING, "%d checks failed", fails);
+}
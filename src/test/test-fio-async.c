@@ -0,0 +1,123 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#include "dhcore-test.h"
+#include "dhcore/core.h"
+#include "dhcore/file-io.h"
+#include "dhcore/path.h"
+#include "dhcore/util.h"
+
+#define FIO_ASYNC_TEST_FILES 32
+
+struct fio_async_test
+{
+    int loaded;
+    int fails;
+    reshandle_t canceled;
+};
+
+static void fio_async_test_done(file_t f, const char* filepath, reshandle_t req, void* param)
+{
+    struct fio_async_test* t = (struct fio_async_test*)param;
+    int idx;
+    char expected[64];
+
+    sscanf(filepath, "dhcore-async%d.txt", &idx);
+    sprintf(expected, "async file %d", idx);
+
+    if (f == NULL || req == t->canceled || fio_getsize(f) != strlen(expected) ||
+        memcmp(fio_getptr(f), expected, strlen(expected)) != 0)
+    {
+        t->fails++;
+    }
+    if (f != NULL)
+        fio_close(f);
+    t->loaded++;
+}
+
+void test_fioasync()
+{
+    struct fio_async_test t;
+    char dir[DH_PATH_MAX];
+    char filepath[DH_PATH_MAX];
+    char filename[64];
+    char data[64];
+
+    memset(&t, 0x00, sizeof(t));
+    t.canceled = INVALID_HANDLE;
+    util_gettempdir(dir);
+
+    for (int i = 0; i < FIO_ASYNC_TEST_FILES; i++)  {
+        sprintf(filename, "dhcore-async%d.txt", i);
+        int len = sprintf(data, "async file %d", i);
+        file_t f = fio_createdisk(path_join(filepath, dir, filename, NULL));
+        fio_write(f, data, len, 1);
+        fio_close(f);
+    }
+
+    fio_addvdir(dir, FALSE);
+    if (IS_FAIL(fio_async_initmgr(2, FIO_ASYNC_TEST_FILES + 1)))  {
+        log_print(LOG_WARNING, "initializing async loading failed");
+        return;
+    }
+
+    log_printf(LOG_TEXT, "loading %d files asynchronously ...", FIO_ASYNC_TEST_FILES + 1);
+    reshandle_t first = INVALID_HANDLE;
+    for (int i = 0; i < FIO_ASYNC_TEST_FILES; i++)  {
+        sprintf(filename, "dhcore-async%d.txt", i);
+        reshandle_t req = fio_openmem_async(mem_heap(), filename, FALSE, 0,
+            (enum fio_async_priority)(i % FIO_ASYNC_PRIORITY_CNT), fio_async_test_done, &t);
+        if (req == INVALID_HANDLE)
+            t.fails++;
+        if (i == 0)
+            first = req;
+        /* request may already be taken by I/O threads, it's delivered in that case */
+        if (i == FIO_ASYNC_TEST_FILES/2 && fio_async_cancel(req))
+            t.canceled = req;
+    }
+
+    /* missing file, callback receives NULL */
+    fio_openmem_async(mem_heap(), "dhcore-async-missing.txt", FALSE, 0, FIO_ASYNC_LOW,
+        fio_async_test_done, &t);
+    /* queue is full */
+    if (fio_openmem_async(mem_heap(), "dhcore-async0.txt", FALSE, 0, FIO_ASYNC_LOW,
+        fio_async_test_done, &t) != INVALID_HANDLE)
+    {
+        t.fails++;
+    }
+
+    while (fio_async_pending() > 0)   {
+        fio_async_update();
+        util_sleep(1);
+    }
+
+    /* delivered requests can't be cancelled */
+    if (fio_async_cancel(first))
+        t.fails++;
+
+    /* canceled request is not delivered, missing one is delivered as a failure */
+    int expected = FIO_ASYNC_TEST_FILES + 1 - (t.canceled != INVALID_HANDLE ? 1 : 0);
+    if (t.loaded != expected || t.fails != 1)
+        log_printf(LOG_WARNING, "loaded %d files, %d failed", t.loaded, t.fails);
+    else
+        log_print(LOG_TEXT, "done.");
+
+    fio_async_releasemgr();
+    fio_clearvdirs();
+    for (int i = 0; i < FIO_ASYNC_TEST_FILES; i++)  {
+        sprintf(filename, "dhcore-async%d.txt", i);
+        util_delfile(path_join(filepath, dir, filename, NULL));
+    }
+}
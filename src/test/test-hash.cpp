@@ -0,0 +1,58 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#include "dhcore-test.h"
+#include "dhcore/core.h"
+#include "dhcore/hash.h"
+#include "dhcore/timer.h"
+
+using namespace dh;
+
+void test_hash()
+{
+    static const char* strs[] = {
+        "", "a", "ab", "abc", "abcd", "Name", "Method", "Description",
+        "position", "textures/hello.dds", "a_much_longer_string_to_hash_with_tail12"
+    };
+    const uint hashes[] = {
+        HASH_LITERAL(""), HASH_LITERAL("a"), HASH_LITERAL("ab"), HASH_LITERAL("abc"),
+        HASH_LITERAL("abcd"), HASH_LITERAL("Name"), HASH_LITERAL("Method"),
+        HASH_LITERAL("Description"), HASH_LITERAL("position"), HASH_LITERAL("textures/hello.dds"),
+        HASH_LITERAL("a_much_longer_string_to_hash_with_tail12")
+    };
+    const uint cnt = sizeof(strs)/sizeof(char*);
+
+    log_printf(LOG_TEXT, "comparing %d compile-time string hashes with hash_str ...", cnt);
+    uint fails = 0;
+    for (uint i = 0; i < cnt; i++)  {
+        if (hashes[i] != hash_str(strs[i]))   {
+            log_printf(LOG_WARNING, "hash mismatch for '%s': 0x%x != 0x%x", strs[i], hashes[i],
+                hash_str(strs[i]));
+            fails++;
+        }
+    }
+
+    uint table[sizeof(strs)/sizeof(char*)];
+    hash_str_table(table, strs, cnt);
+    for (uint i = 0; i < cnt; i++)  {
+        if (table[i] != hashes[i])
+            fails++;
+    }
+
+    if (fails == 0)
+        log_print(LOG_TEXT, "done.");
+    else
+        log_printf(LOG_WARNING, "%d failures.", fails);
+}
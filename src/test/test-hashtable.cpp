@@ -48,6 +48,56 @@ void test_hashtable()
         htable.value(keys[i]);
     printf("time: %f\n", tm.end());
 
+    int *values = (int*)ALLOC(sizeof(int)*item_cnt, 0);
+    ASSERT(values);
+    printf("searching %d items (batch) ...\n", item_cnt);
+    tm.begin();
+    htable.find_batch((const uint*)keys, item_cnt, values);
+    printf("time: %f\n", tm.end());
+
+    int mismatch_cnt = 0;
+    for (int i = 0; i < item_cnt; i++)  {
+        if (values[i] != htable.value(keys[i]))
+            mismatch_cnt++;
+    }
+    if (mismatch_cnt > 0)
+        printf("batch search failed: %d mismatches\n", mismatch_cnt);
+    FREE(values);
+
     htable.destroy();
+
+    /* frozen (perfect hash) table needs unique keys */
+    uint *fkeys = (uint*)ALLOC(sizeof(uint)*item_cnt*2, 0);
+    ASSERT(fkeys);
+    uint *fvalues = fkeys + item_cnt;
+    for (int i = 0; i < item_cnt; i++)  {
+        fkeys[i] = hash_u64((uint64)i + 1);
+        fvalues[i] = (uint)i;
+    }
+
+    hashtable_frozen ftable;
+    printf("building frozen hashtable with %d items ...\n", item_cnt);
+    tm.begin();
+    if (IS_OK(hashtable_frozen_build(mem_heap(), mem_heap(), &ftable, fkeys, fvalues, item_cnt, 0)))   {
+        printf("time: %f\n", tm.end());
+
+        printf("searching %d items ...\n", item_cnt);
+        int fail_cnt = 0;
+        tm.begin();
+        for (int i = 0; i < item_cnt; i++)  {
+            const hashtable_frozen_item *item = hashtable_frozen_find(&ftable, fkeys[i]);
+            if (item == nullptr || item->value != fvalues[i])
+                fail_cnt++;
+        }
+        printf("time: %f\n", tm.end());
+        if (fail_cnt > 0)
+            printf("frozen search failed: %d items\n", fail_cnt);
+
+        hashtable_frozen_destroy(&ftable);
+    }   else    {
+        printf("building frozen hashtable failed\n");
+    }
+
+    FREE(fkeys);
     FREE(keys);
 }
@@ -17,6 +17,25 @@
 #include "dhcore/core.h"
 #include "dhcore/json.h"
 #include "dhcore/file-io.h"
+#include "dhcore/path.h"
+#include "dhcore/util.h"
+#include "dhcore/timer.h"
+#include "dhcore/str.h"
+
+#define JSON_TEST_ENTITIES 40000
+
+struct json_test_stats
+{
+    int keys;
+    int nums;
+    fl64 sum;
+    int strs;
+    size_t str_bytes;
+    int bools;
+    int nulls;
+    int objs;
+    int arrs;
+};
 
 void test_json()
 {
@@ -37,3 +56,310 @@ void test_json()
         fio_close(f);
     }
 }
+
+/* writes a large level-like file, and counts the values that readers should see */
+static int json_test_create(const char* filepath, struct json_test_stats* st)
+{
+    char text[256];
+    char decoded[64];
+    file_t f = fio_createdisk(filepath);
+    if (f == NULL)
+        return FALSE;
+
+    memset(st, 0x00, sizeof(struct json_test_stats));
+    const char* header = "{\"name\": \"level\", \"version\": 3,\n\"entities\": [\n";
+    fio_write(f, header, strlen(header), 1);
+    st->keys += 4;
+    st->nums += 1;
+    st->sum += 3.0;
+    st->strs += 2;
+    st->str_bytes += 5 + 7;    /* level, footer */
+    st->objs += 1;
+    st->arrs += 1;
+
+    for (int i = 0; i < JSON_TEST_ENTITIES; i++)    {
+        int n = sprintf(text, "%s{\"id\":%d, \"name\":\"ent\\u00e9 \\\"%d\\\"\\n\", "
+                        "\"pos\":[%.1f, %d, 2.25], \"visible\":%s, \"parent\":null,\n"
+                        "  \"props\":{\"mass\":1.5e2, \"tags\":[\"a\", \"b\"]}}\n",
+                        i > 0 ? "," : "", i, i, i*0.5, -i, (i & 1) ? "true" : "false");
+        fio_write(f, text, n, 1);
+
+        st->keys += 8;
+        st->nums += 5;
+        st->sum += (fl64)i + i*0.5 - (fl64)i + 2.25 + 150.0;
+        st->strs += 3;
+        st->str_bytes += sprintf(decoded, "ent\xc3\xa9 \"%d\"\n", i) + 2;
+        st->bools += 1;
+        st->nulls += 1;
+        st->objs += 2;
+        st->arrs += 2;
+    }
+
+    const char* footer = "],\n\"footer\": \"end\\ud83d\\ude00\"}\n";
+    fio_write(f, footer, strlen(footer), 1);
+    fio_close(f);
+    return TRUE;
+}
+
+static int json_test_sax(json_reader_t r, enum json_event e, void* param)
+{
+    struct json_test_stats* st = (struct json_test_stats*)param;
+    size_t len;
+    switch (e)  {
+    case JSON_EVENT_KEY:    st->keys++;     break;
+    case JSON_EVENT_NUM:    st->nums++;     st->sum += json_reader_getf(r);  break;
+    case JSON_EVENT_STRING:
+        json_reader_gets(r, &len);
+        st->strs++;
+        st->str_bytes += len;
+        break;
+    case JSON_EVENT_BOOL:   st->bools++;    break;
+    case JSON_EVENT_NULL:   st->nulls++;    break;
+    case JSON_EVENT_OBJECT_BEGIN:   st->objs++;     break;
+    case JSON_EVENT_ARRAY_BEGIN:    st->arrs++;     break;
+    default:    break;
+    }
+    return TRUE;
+}
+
+static int json_test_checkstats(const struct json_test_stats* st, const struct json_test_stats* e)
+{
+    return st->keys == e->keys && st->nums == e->nums && st->sum == e->sum &&
+        st->strs == e->strs && st->str_bytes == e->str_bytes && st->bools == e->bools &&
+        st->nulls == e->nulls && st->objs == e->objs && st->arrs == e->arrs;
+}
+
+/* parses the text with a reader, and returns the last event */
+static enum json_event json_test_parsestr(const char* text)
+{
+    file_t f = fio_createview(text, strlen(text), "test.json");
+    json_reader_t r = json_reader_create(f, mem_heap());
+    enum json_event e;
+    while ((e = json_reader_next(r)) > JSON_EVENT_END)
+        ;
+    json_reader_destroy(r);
+    fio_close(f);
+    return e;
+}
+
+void test_jsonsax()
+{
+    char filepath[DH_PATH_MAX];
+    struct json_test_stats expected;
+    struct json_test_stats st;
+    int fails = 0;
+
+    path_join(filepath, util_gettempdir(filepath), "dhcore-level.json", NULL);
+    if (!json_test_create(filepath, &expected)) {
+        log_print(LOG_WARNING, "creating json file failed");
+        return;
+    }
+
+    /* cJSON tree */
+    uint64 t0 = timer_querytick();
+    file_t f = fio_opendisk(filepath, TRUE);
+    json_t j = f != NULL ? json_parsefilef(f, mem_heap()) : NULL;
+    fl64 tree_tm = timer_calctm(t0, timer_querytick());
+    if (j != NULL)  {
+        json_t jents = json_getitem(j, "entities");
+        if (json_getarr_count(jents) != JSON_TEST_ENTITIES ||
+            !str_isequal(json_gets(json_getitem(json_getarr_item(jents, 0), "name")),
+                         "ent\xc3\xa9 \"0\"\n"))
+        {
+            fails++;
+        }
+        json_destroy(j);
+    }   else    {
+        fails++;
+    }
+    if (f != NULL)
+        fio_close(f);
+
+    /* SAX, disk file is read in chunks */
+    memset(&st, 0x00, sizeof(st));
+    t0 = timer_querytick();
+    f = fio_opendisk(filepath, TRUE);
+    if (f == NULL || json_parsesax(f, mem_heap(), json_test_sax, &st) != RET_OK)
+        fails++;
+    fl64 disk_tm = timer_calctm(t0, timer_querytick());
+    if (f != NULL)
+        fio_close(f);
+    fails += !json_test_checkstats(&st, &expected);
+
+    /* pull reader, mapped file is read in place */
+    memset(&st, 0x00, sizeof(st));
+    t0 = timer_querytick();
+    f = fio_openmmap(filepath, TRUE);
+    json_reader_t r = f != NULL ? json_reader_create(f, mem_heap()) : NULL;
+    if (r != NULL)  {
+        enum json_event e;
+        while ((e = json_reader_next(r)) > JSON_EVENT_END)
+            json_test_sax(r, e, &st);
+        fails += e != JSON_EVENT_END;
+        json_reader_destroy(r);
+    }
+    fl64 mmap_tm = timer_calctm(t0, timer_querytick());
+    if (f != NULL)
+        fio_close(f);
+    fails += !json_test_checkstats(&st, &expected);
+
+    log_printf(LOG_TEXT, "%d entities, cJSON tree: %.3fs, stream (disk): %.3fs, "
+               "stream (mmap): %.3fs", JSON_TEST_ENTITIES, tree_tm, disk_tm, mmap_tm);
+
+    /* skipping the entities array */
+    f = fio_opendisk(filepath, TRUE);
+    r = f != NULL ? json_reader_create(f, mem_heap()) : NULL;
+    if (r != NULL)  {
+        int keys = 0;
+        enum json_event e;
+        while ((e = json_reader_next(r)) > JSON_EVENT_END)    {
+            if (e != JSON_EVENT_KEY)
+                continue;
+            keys++;
+            if (str_isequal(json_reader_gets(r, NULL), "entities"))
+                json_reader_skip(r);
+            else if (str_isequal(json_reader_gets(r, NULL), "footer"))
+                fails += json_reader_next(r) != JSON_EVENT_STRING ||
+                    !str_isequal(json_reader_gets(r, NULL), "end\xf0\x9f\x98\x80");
+        }
+        fails += e != JSON_EVENT_END || keys != 4;
+        json_reader_destroy(r);
+    }   else    {
+        fails++;
+    }
+    if (f != NULL)
+        fio_close(f);
+    util_delfile(filepath);
+
+    /* malformed input */
+    fails += json_test_parsestr(" [ ] ") != JSON_EVENT_END;
+    fails += json_test_parsestr("{\"a\": [1, 2,]}") != JSON_EVENT_ERROR;
+    fails += json_test_parsestr("{\"a\" 1}") != JSON_EVENT_ERROR;
+    fails += json_test_parsestr("[1, 2") != JSON_EVENT_ERROR;
+    fails += json_test_parsestr("\"abc") != JSON_EVENT_ERROR;
+    fails += json_test_parsestr("[1] 2") != JSON_EVENT_ERROR;
+    err_clear();
+
+    if (fails == 0)
+        log_print(LOG_TEXT, "done.");
+    else
+        log_printf(LOG_WARNING, "%d checks failed", fails);
+}
+
+static int json_test_checkdom(json_t j)
+{
+    if (j == NULL)
+        return FALSE;
+
+    json_t jents = json_getitem(j, "entities");
+    json_t jent = json_getarr_item(jents, 1);
+    json_t jpos = json_getitem(jent, "pos");
+    json_t jprops = json_getitem(jent, "props");
+    json_t jlast = json_getarr_item(jents, JSON_TEST_ENTITIES - 1);
+    return json_gettype(j) == JSON_OBJECT && json_geti_child(j, "version", 0) == 3 &&
+        json_getarr_count(jents) == JSON_TEST_ENTITIES &&
+        json_geti_child(jent, "id", 0) == 1 &&
+        str_isequal(json_gets_child(jent, "name", ""), "ent\xc3\xa9 \"1\"\n") &&
+        json_getarr_count(jpos) == 3 && json_getf(json_getarr_item(jpos, 0)) == 0.5f &&
+        json_geti(json_getarr_item(jpos, 1)) == -1 &&
+        json_getb_child(jent, "visible", FALSE) &&
+        json_gettype(json_getitem(jent, "parent")) == JSON_NULL &&
+        json_getf_child(jprops, "mass", 0.0f) == 150.0f &&
+        str_isequal(json_gets(json_getarr_item(json_getitem(jprops, "tags"), 1)), "b") &&
+        json_geti_child(jlast, "id", 0) == JSON_TEST_ENTITIES - 1 &&
+        str_isequal(json_gets_child(j, "footer", ""), "end\xf0\x9f\x98\x80");
+}
+
+/* dom and cJSON trees must be printed the same */
+static int json_test_comparedom(const char* text)
+{
+    json_t j1 = json_parsestring(text);
+    json_t j2 = json_parsedom(text, strlen(text), mem_heap());
+    int r = FALSE;
+    if (j1 != NULL && j2 != NULL)   {
+        char* s1 = json_savetobuffer(j1, NULL, TRUE);
+        char* s2 = json_savetobuffer(j2, NULL, TRUE);
+        r = s1 != NULL && s2 != NULL && str_isequal(s1, s2);
+        json_deletebuffer(s1);
+        json_deletebuffer(s2);
+    }
+    if (j1 != NULL)
+        json_destroy(j1);
+    if (j2 != NULL)
+        json_destroy(j2);
+    return r;
+}
+
+void test_jsondom()
+{
+    char filepath[DH_PATH_MAX];
+    struct json_test_stats expected;
+    int fails = 0;
+
+    path_join(filepath, util_gettempdir(filepath), "dhcore-level.json", NULL);
+    if (!json_test_create(filepath, &expected)) {
+        log_print(LOG_WARNING, "creating json file failed");
+        return;
+    }
+
+    /* cJSON tree */
+    uint64 t0 = timer_querytick();
+    file_t f = fio_opendisk(filepath, TRUE);
+    json_t j = f != NULL ? json_parsefilef(f, mem_heap()) : NULL;
+    fails += !json_test_checkdom(j);
+    if (j != NULL)
+        json_destroy(j);
+    fl64 tree_tm = timer_calctm(t0, timer_querytick());
+    if (f != NULL)
+        fio_close(f);
+
+    /* indexed tree, from disk file and in place from mapped file */
+    t0 = timer_querytick();
+    f = fio_opendisk(filepath, TRUE);
+    j = f != NULL ? json_parsedomf(f, mem_heap()) : NULL;
+    fails += !json_test_checkdom(j);
+    if (j != NULL)
+        json_destroy(j);
+    fl64 disk_tm = timer_calctm(t0, timer_querytick());
+    if (f != NULL)
+        fio_close(f);
+
+    t0 = timer_querytick();
+    f = fio_openmmap(filepath, TRUE);
+    j = f != NULL ? json_parsedomf(f, mem_heap()) : NULL;
+    fails += !json_test_checkdom(j);
+    if (j != NULL)
+        json_destroy(j);
+    fl64 mmap_tm = timer_calctm(t0, timer_querytick());
+    if (f != NULL)
+        fio_close(f);
+    util_delfile(filepath);
+
+    log_printf(LOG_TEXT, "%d entities (parse+destroy), cJSON tree: %.3fs, dom (disk): %.3fs, "
+               "dom (mmap): %.3fs", JSON_TEST_ENTITIES, tree_tm, disk_tm, mmap_tm);
+
+    /* escapes, and strings/values that cross 64 byte blocks of the index */
+    fails += !json_test_comparedom("{\"a\\\\\":\"\\\\\\\"{\", \"b\" : [1, -2, 3.5, true, false, null,"
+                                   " {}, [], \"\"], \"long string that crosses the block ]}\" :"
+                                   " {\"x\\\\\\\\\":\"\\u00e9\\ud83d\\ude00\", \"y\": [[[{\"z\":"
+                                   " 12345678}]]]},\n\"c\":\"end\"}");
+    fails += !json_test_comparedom("  \"root\"  ");
+    fails += !json_test_comparedom("[0, 125, -0.25]");
+
+    /* malformed input */
+    const char* invalid[] = {"", "{\"a\": [1, 2,]}", "{\"a\" 1}", "[1, 2", "\"abc", "[1] 2",
+                             "[tru]", "{\"a\":1,}", "[1 2]", "[0x10]", "{\"a\\q\":1}", "[:]"};
+    for (uint i = 0; i < sizeof(invalid)/sizeof(const char*); i++)  {
+        j = json_parsedom(invalid[i], strlen(invalid[i]), mem_heap());
+        if (j != NULL)  {
+            fails++;
+            json_destroy(j);
+        }
+    }
+    err_clear();
+
+    if (fails == 0)
+        log_print(LOG_TEXT, "done.");
+    else
+        log_printf(LOG_WARNING, "%d checks failed", fails);
+}
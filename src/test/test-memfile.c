@@ -0,0 +1,106 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#include "dhcore-test.h"
+#include "dhcore/core.h"
+#include "dhcore/file-io.h"
+#include "dhcore/path.h"
+#include "dhcore/util.h"
+#include "dhcore/timer.h"
+
+#define MEMFILE_TEST_SIZE (32*1024*1024)
+#define MEMFILE_TEST_RECORD 97  /* odd size, so records cross block boundaries */
+
+/* writes records of deterministic data until file reaches the test size */
+static fl64 memfile_test_write(file_t f)
+{
+    uint8 record[MEMFILE_TEST_RECORD];
+    uint64 t0 = timer_querytick();
+    for (size_t offset = 0; offset < MEMFILE_TEST_SIZE; offset += MEMFILE_TEST_RECORD)  {
+        for (int i = 0; i < MEMFILE_TEST_RECORD; i++)
+            record[i] = (uint8)((offset + i)*31);
+        fio_write(f, record, MEMFILE_TEST_RECORD, 1);
+    }
+    return timer_calctm(t0, timer_querytick());
+}
+
+static int memfile_test_check(const uint8* data, size_t size)
+{
+    if (size != ((MEMFILE_TEST_SIZE + MEMFILE_TEST_RECORD - 1)/MEMFILE_TEST_RECORD)*
+        MEMFILE_TEST_RECORD)
+    {
+        return FALSE;
+    }
+    for (size_t i = 0; i < size; i++)   {
+        if (data[i] != (uint8)(i*31))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+void test_memfile()
+{
+    char filepath[DH_PATH_MAX];
+    int fails = 0;
+    size_t size;
+
+    path_join(filepath, util_gettempdir(filepath), "dhcore-memfile.bin", NULL);
+    log_printf(LOG_TEXT, "writing %dMB in %d byte records ...", MEMFILE_TEST_SIZE/(1024*1024),
+               MEMFILE_TEST_RECORD);
+
+    /* contiguous memory file */
+    file_t f = fio_createmem(mem_heap(), "memfile", 0);
+    fl64 mem_tm = memfile_test_write(f);
+    void* data = fio_detachmem(f, &size, NULL);
+    fails += !memfile_test_check((const uint8*)data, size);
+    A_FREE(mem_heap(), data);
+    fio_close(f);
+
+    /* chunked memory file */
+    f = fio_createmem_chunked(mem_heap(), "memfile", 0);
+    fl64 chunked_tm = memfile_test_write(f);
+    log_printf(LOG_TEXT, "mem: %.3fs, chunked: %.3fs", mem_tm, chunked_tm);
+
+    /* random access: read across block boundaries */
+    uint8 record[MEMFILE_TEST_RECORD];
+    size_t offset = 64*1024 - 10;
+    fio_seek(f, SEEK_MODE_START, (int)offset);
+    if (fio_read(f, record, sizeof(record), 1) != 1 || fio_getpos(f) != offset + sizeof(record))
+        fails++;
+    for (int i = 0; i < MEMFILE_TEST_RECORD; i++)
+        fails += record[i] != (uint8)((offset + i)*31);
+
+    /* gather write to disk, then flatten */
+    if (IS_FAIL(fio_savemem(f, filepath)))
+        fails++;
+    data = fio_detachmem(f, &size, NULL);
+    fails += !memfile_test_check((const uint8*)data, size);
+    A_FREE(mem_heap(), data);
+    fio_close(f);
+
+    f = fio_openmem(mem_heap(), filepath, TRUE, 0);
+    if (f != NULL)  {
+        fails += !memfile_test_check((const uint8*)fio_getptr(f), fio_getsize(f));
+        fio_close(f);
+    }   else    {
+        fails++;
+    }
+    util_delfile(filepath);
+
+    if (fails == 0)
+        log_print(LOG_TEXT, "done.");
+    else
+        log_printf(LOG_WARNING, "%d checks failed", fails);
+}
@@ -0,0 +1,464 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#include "dhcore-test.h"
+#include "dhcore/core.h"
+#include "dhcore/pak-file.h"
+#include "dhcore/pak-file-fmt.h"
+#include "dhcore/task-mgr.h"
+#include "dhcore/hwinfo.h"
+#include "dhcore/path.h"
+#include "dhcore/util.h"
+#include "dhcore/mt.h"
+#include "dhcore/timer.h"
+#include "dhcore/numeric.h"
+
+#define PAK_TEST_FILES 64
+#define PAK_TEST_PASSES 20
+#define PAK_TEST_DUPS 8
+#define PAK_TEST_SMALL_FILES 160    /* more than the item array grows at once */
+#define PAK_TEST_LARGE_SIZE (16*1024*1024 + 1234)
+
+struct pak_test
+{
+    struct pak_file* pak;
+    atom_t loads;
+    atom_t fails;
+};
+
+/* deterministic content for each test file, so workers can validate without shared buffers */
+static size_t pak_test_data(uint8* data, int idx)
+{
+    size_t size = 1000 + (size_t)idx*2531;
+    uint seed = (uint)idx*7919 + 1;
+    for (size_t i = 0; i < size; i++)   {
+        seed = seed*1103515245 + 12345;
+        data[i] = (uint8)((seed >> 16) % 13 + 'a');    /* compressible */
+    }
+    return size;
+}
+
+static void pak_test_task(void* params, void* result, uint thread_id, uint job_id, int worker_idx)
+{
+    struct pak_test* t = (struct pak_test*)params;
+    uint8* expected = (uint8*)ALLOC(1000 + PAK_TEST_FILES*2531, 0);
+    char filepath[DH_PATH_MAX];
+    int loads = 0;
+    int fails = 0;
+
+    for (int p = 0; p < PAK_TEST_PASSES; p++)   {
+        for (int i = 0; i < PAK_TEST_FILES; i++)    {
+            /* each worker walks the files in a different order */
+            int idx = (i + worker_idx*7 + p) % PAK_TEST_FILES;
+            sprintf(filepath, "data/file%d.bin", idx);
+            size_t size = pak_test_data(expected, idx);
+
+            uint file_id = pak_findfile(t->pak, filepath);
+            file_t f = file_id != 0 ?
+                pak_getfile(t->pak, mem_heap(), mem_heap(), file_id, 0) : NULL;
+            if (f == NULL || fio_getsize(f) != size ||
+                memcmp(fio_getptr(f), expected, size) != 0)
+            {
+                fails++;
+            }
+            if (f != NULL)
+                fio_close(f);
+
+            /* random access: read a range that crosses block boundaries */
+            size_t offset = (size*(size_t)(worker_idx + p + 1)/(PAK_TEST_PASSES + 8)) % size;
+            size_t range_sz = minsz(size - offset, 70000);
+            uint8* range = (uint8*)ALLOC(range_sz, 0);
+            if (file_id == 0 ||
+                pak_readfile(t->pak, mem_heap(), file_id, range, offset, range_sz) != range_sz ||
+                memcmp(range, expected + offset, range_sz) != 0)
+            {
+                fails++;
+            }
+            FREE(range);
+            loads++;
+        }
+    }
+
+    FREE(expected);
+    MT_ATOMIC_ADD(t->loads, loads);
+    MT_ATOMIC_ADD(t->fails, fails);
+}
+
+/* fetches all files (and copies) through a cache, copies and second fetches must be cache hits */
+static int pak_test_cache(struct pak_file* pak, char paths[][DH_PATH_MAX], int cnt)
+{
+    int fails = 0;
+    uint64 hits, misses;
+    uint8* expected = (uint8*)ALLOC(1000 + PAK_TEST_FILES*2531, 0);
+    file_t views[PAK_TEST_FILES + PAK_TEST_DUPS];
+    struct pak_cache* cache = pak_cache_create(8*1024*1024);
+    int cached = pak->items[0].codec != COMPRESS_CODEC_STORE || pak->map == NULL;
+    pak_setcache(pak, cache);
+
+    for (int p = 0; p < 2; p++) {
+        for (int i = 0; i < cnt; i++)   {
+            size_t size = pak_test_data(expected, i % PAK_TEST_FILES);
+            views[i] = pak_getfile_mapped(pak, mem_heap(), mem_heap(),
+                                          pak_findfile(pak, paths[i]), 0);
+            if (views[i] == NULL || fio_getsize(views[i]) != size ||
+                memcmp(fio_getptr(views[i]), expected, size) != 0)
+            {
+                fails++;
+            }
+        }
+
+        /* copies share the data of the originals, while they are open */
+        for (int i = PAK_TEST_FILES; i < cnt && cached; i++)   {
+            if (views[i] == NULL || fio_getptr(views[i]) != fio_getptr(views[i - PAK_TEST_FILES]))
+                fails++;
+        }
+        for (int i = 0; i < cnt; i++)   {
+            if (views[i] != NULL)
+                fio_close(views[i]);
+        }
+    }
+
+    /* each content is decompressed once, all files fit in the budget */
+    pak_cache_getstats(cache, &hits, &misses);
+    if (cached && (misses != PAK_TEST_FILES || hits != (uint64)cnt*2 - PAK_TEST_FILES))
+        fails++;
+
+    pak_setcache(pak, NULL);
+    pak_cache_destroy(cache);
+    FREE(expected);
+    return fails;
+}
+
+static int pak_test_run(const char* pakpath, enum compress_mode mode, int mapped,
+                        enum pak_verify verify, uint verify_flags)
+{
+    struct pak_file pak;
+    file_t files[PAK_TEST_FILES + PAK_TEST_DUPS];
+    char paths[PAK_TEST_FILES + PAK_TEST_DUPS][DH_PATH_MAX];
+    const char* dest_paths[PAK_TEST_FILES + PAK_TEST_DUPS];
+
+    if (IS_FAIL(pak_create(&pak, mem_heap(), pakpath, mode, 0)))
+        return 1;
+
+    /* last files are copies of the first ones, they should be deduplicated */
+    for (int i = 0; i < PAK_TEST_FILES + PAK_TEST_DUPS; i++)    {
+        int idx = i % PAK_TEST_FILES;
+        if (i < PAK_TEST_FILES)
+            sprintf(paths[i], "data/file%d.bin", idx);
+        else
+            sprintf(paths[i], "data/copy%d.bin", idx);
+        uint8* data = (uint8*)ALLOC(1000 + PAK_TEST_FILES*2531, 0);
+        ASSERT(data);
+        files[i] = fio_attachmem(mem_heap(), data, pak_test_data(data, idx), paths[i], 0);
+        dest_paths[i] = paths[i];
+    }
+
+    result_t r = pak_putfiles(&pak, mem_heap(), files, dest_paths,
+                              PAK_TEST_FILES + PAK_TEST_DUPS, PAK_PUT_DEDUP);
+
+    for (int i = 0; i < PAK_TEST_FILES + PAK_TEST_DUPS; i++)    {
+        size_t size;
+        FREE(fio_detachmem(files[i], &size, NULL));
+        fio_close(files[i]);
+    }
+    pak_close(&pak);
+    if (IS_FAIL(r))
+        return 1;
+
+    if (IS_FAIL(pak_open(&pak, mem_heap(), pakpath, 0)))
+        return 1;
+
+    /* drop the mapping to exercise positional reads from the shared file */
+    if (!mapped)
+        pak_unmap(&pak);
+    pak_setverify(&pak, verify, verify_flags, 0);
+
+    struct pak_test t;
+    memset(&t, 0x00, sizeof(t));
+    t.pak = &pak;
+
+    /* copies must point to the data of the originals */
+    const struct pak_item* items = pak.items;
+    for (int i = 0; i < PAK_TEST_DUPS; i++) {
+        uint copy_id = pak_findfile(&pak, paths[PAK_TEST_FILES + i]);
+        uint orig_id = pak_findfile(&pak, paths[i]);
+        if (copy_id == 0 || orig_id == 0 || items[copy_id-1].offset != items[orig_id-1].offset)
+            t.fails++;
+    }
+
+    uint64 t0 = timer_querytick();
+    uint job = tsk_dispatch(pak_test_task, TSK_CONTEXT_ALL, TSK_THREADS_ALL, &t, NULL);
+    tsk_wait(job);
+    tsk_destroy(job);
+    fl64 tm = timer_calctm(t0, timer_querytick());
+
+    /* all fetched files must be marked as verified (dups are not fetched) */
+    if (verify == PAK_VERIFY_FIRST) {
+        for (int i = 0; i < PAK_TEST_FILES; i++)    {
+            uint idx = pak_findfile(&pak, paths[i]) - 1;
+            if ((pak.verified[idx >> 5] & ((atom_t)1 << (idx & 31))) == 0)
+                t.fails++;
+        }
+    }
+
+    /* batch load of all files (and copies) in reverse order, compared with serial loads */
+    uint ids[PAK_TEST_FILES + PAK_TEST_DUPS];
+    file_t batch[PAK_TEST_FILES + PAK_TEST_DUPS];
+    uint8* expected = (uint8*)ALLOC(1000 + PAK_TEST_FILES*2531, 0);
+    for (int i = 0; i < PAK_TEST_FILES + PAK_TEST_DUPS; i++)
+        ids[i] = pak_findfile(&pak, paths[PAK_TEST_FILES + PAK_TEST_DUPS - 1 - i]);
+
+    t0 = timer_querytick();
+    for (int i = 0; i < PAK_TEST_FILES + PAK_TEST_DUPS; i++)
+        fio_close(pak_getfile(&pak, mem_heap(), mem_heap(), ids[i], 0));
+    fl64 serial_tm = timer_calctm(t0, timer_querytick());
+
+    t0 = timer_querytick();
+    if (IS_FAIL(pak_getfiles_batch(&pak, mem_heap(), mem_heap(), ids,
+                                   PAK_TEST_FILES + PAK_TEST_DUPS, batch, 0)))
+    {
+        t.fails++;
+    }
+    fl64 batch_tm = timer_calctm(t0, timer_querytick());
+
+    for (int i = 0; i < PAK_TEST_FILES + PAK_TEST_DUPS; i++)    {
+        size_t size = pak_test_data(expected, (PAK_TEST_FILES + PAK_TEST_DUPS - 1 - i) %
+                                    PAK_TEST_FILES);
+        if (batch[i] == NULL || fio_getsize(batch[i]) != size ||
+            memcmp(fio_getptr(batch[i]), expected, size) != 0)
+        {
+            t.fails++;
+        }
+        if (batch[i] != NULL)
+            fio_close(batch[i]);
+    }
+    FREE(expected);
+
+    t.fails += pak_test_cache(&pak, paths, PAK_TEST_FILES + PAK_TEST_DUPS);
+
+    const char* mode_name = "deflate";
+    if (mode == COMPRESS_NONE)
+        mode_name = "uncompressed";
+    else if (mode == COMPRESS_LZ4)
+        mode_name = "lz4";
+    log_printf(LOG_TEXT, "%s, %s: %d loads in %.3fs, batch: %.3fs (serial %.3fs), %d failed",
+        mode_name, mapped ? "mapped" : "pread", (int)t.loads, tm, batch_tm, serial_tm,
+        (int)t.fails);
+
+    pak_close(&pak);
+    util_delfile(pakpath);
+    return (int)t.fails;
+}
+
+/* many small files with copies spread among them, copies are put after the item arrays grow */
+static int pak_test_dedup(const char* pakpath)
+{
+    struct pak_file pak;
+    file_t files[PAK_TEST_SMALL_FILES];
+    char paths[PAK_TEST_SMALL_FILES][DH_PATH_MAX];
+    char data[PAK_TEST_SMALL_FILES][64];
+    const char* dest_paths[PAK_TEST_SMALL_FILES];
+    int fails = 0;
+
+    if (IS_FAIL(pak_create(&pak, mem_heap(), pakpath, COMPRESS_NORMAL, 0)))
+        return 1;
+
+    /* every 5th file is a copy of one of the first files, including the one that grows the items */
+    for (int i = 0; i < PAK_TEST_SMALL_FILES; i++)  {
+        int idx = (i % 5 == 0) ? (i % 17) : i;
+        sprintf(paths[i], "small/file%d.txt", i);
+        sprintf(data[i], "small file content %d, small file content %d", idx, idx);
+        files[i] = fio_attachmem(mem_heap(), data[i], strlen(data[i]), paths[i], 0);
+        dest_paths[i] = paths[i];
+    }
+
+    result_t r = pak_putfiles(&pak, mem_heap(), files, dest_paths, PAK_TEST_SMALL_FILES,
+                              PAK_PUT_DEDUP);
+    for (int i = 0; i < PAK_TEST_SMALL_FILES; i++)  {
+        size_t size;
+        fio_detachmem(files[i], &size, NULL);
+        fio_close(files[i]);
+    }
+    pak_close(&pak);
+    if (IS_FAIL(r) || IS_FAIL(pak_open(&pak, mem_heap(), pakpath, 0)))
+        return 1;
+
+    for (int i = 0; i < PAK_TEST_SMALL_FILES; i++)  {
+        uint file_id = pak_findfile(&pak, paths[i]);
+        file_t f = file_id != 0 ?
+            pak_getfile(&pak, mem_heap(), mem_heap(), file_id, 0) : NULL;
+        if (f == NULL || fio_getsize(f) != strlen(data[i]) ||
+            memcmp(fio_getptr(f), data[i], strlen(data[i])) != 0)
+        {
+            fails++;
+        }
+        if (f != NULL)
+            fio_close(f);
+
+        uint orig_id = pak_findfile(&pak, paths[i % 17]);
+        if (i % 5 == 0 && (file_id == 0 || orig_id == 0 ||
+            pak.items[file_id-1].offset != pak.items[orig_id-1].offset))
+        {
+            fails++;
+        }
+    }
+
+    log_printf(LOG_TEXT, "dedup: %d small files, %d failed", PAK_TEST_SMALL_FILES, fails);
+    pak_close(&pak);
+    util_delfile(pakpath);
+    return fails;
+}
+
+/* one large file, fetched serially, by workers and as a stream that is read in odd sized parts */
+static int pak_test_large(const char* pakpath, enum compress_mode mode)
+{
+    static const size_t part_sizes[] = {1, 1000, 65536, 70001, 3*65536, 200000};
+    struct pak_file pak;
+    int fails = 0;
+
+    uint8* data = (uint8*)ALLOC(PAK_TEST_LARGE_SIZE, 0);
+    uint8* part = (uint8*)ALLOC(200000, 0);
+    ASSERT(data && part);
+    uint seed = 1;
+    for (size_t i = 0; i < PAK_TEST_LARGE_SIZE; i++)    {
+        seed = seed*1103515245 + 12345;
+        data[i] = (uint8)((seed >> 16) % 13 + 'a');
+    }
+
+    if (IS_FAIL(pak_create(&pak, mem_heap(), pakpath, mode, 0))) {
+        FREE(part);
+        FREE(data);
+        return 1;
+    }
+    file_t src = fio_attachmem(mem_heap(), data, PAK_TEST_LARGE_SIZE, "data/large.bin", 0);
+    result_t r = pak_putfile(&pak, mem_heap(), src, "data/large.bin");
+    size_t size;
+    fio_detachmem(src, &size, NULL);
+    fio_close(src);
+    pak_close(&pak);
+    if (IS_FAIL(r) || IS_FAIL(pak_open(&pak, mem_heap(), pakpath, 0)))   {
+        FREE(part);
+        FREE(data);
+        return 1;
+    }
+
+    uint file_id = pak_findfile(&pak, "data/large.bin");
+    uint64 t0 = timer_querytick();
+    file_t f = file_id != 0 ? pak_getfile(&pak, mem_heap(), mem_heap(), file_id, 0) : NULL;
+    fl64 serial_tm = timer_calctm(t0, timer_querytick());
+    if (f == NULL || fio_getsize(f) != PAK_TEST_LARGE_SIZE ||
+        memcmp(fio_getptr(f), data, PAK_TEST_LARGE_SIZE) != 0)
+    {
+        fails++;
+    }
+    if (f != NULL)
+        fio_close(f);
+
+    t0 = timer_querytick();
+    f = file_id != 0 ? pak_getfile_parallel(&pak, mem_heap(), mem_heap(), file_id, 0) : NULL;
+    fl64 parallel_tm = timer_calctm(t0, timer_querytick());
+    if (f == NULL || fio_getsize(f) != PAK_TEST_LARGE_SIZE ||
+        memcmp(fio_getptr(f), data, PAK_TEST_LARGE_SIZE) != 0)
+    {
+        fails++;
+    }
+    if (f != NULL)
+        fio_close(f);
+
+    /* stream: sequential reads that start and end at different offsets of the blocks */
+    t0 = timer_querytick();
+    f = file_id != 0 ? pak_openstream(&pak, mem_heap(), file_id) : NULL;
+    if (f != NULL && fio_gettype(f) == FILE_TYPE_STREAM &&
+        fio_getsize(f) == PAK_TEST_LARGE_SIZE)
+    {
+        size_t offset = 0;
+        for (int i = 0; offset < PAK_TEST_LARGE_SIZE; i++)  {
+            size_t part_sz = part_sizes[i % (sizeof(part_sizes)/sizeof(size_t))];
+            size_t read_sz = fio_read(f, part, 1, part_sz);
+            if (read_sz != minsz(part_sz, PAK_TEST_LARGE_SIZE - offset) ||
+                memcmp(part, data + offset, read_sz) != 0)
+            {
+                fails++;
+                break;
+            }
+            offset += read_sz;
+        }
+        if (fio_read(f, part, 1, 1) != 0)
+            fails++;
+
+        /* random access */
+        fio_seek(f, SEEK_MODE_START, 1000000);
+        if (fio_read(f, part, 1, 100000) != 100000 || memcmp(part, data + 1000000, 100000) != 0)
+            fails++;
+        fio_seek(f, SEEK_MODE_END, 10);
+        if (fio_read(f, part, 1, 100) != 10 ||
+            memcmp(part, data + PAK_TEST_LARGE_SIZE - 10, 10) != 0)
+        {
+            fails++;
+        }
+    }   else    {
+        fails++;
+    }
+    if (f != NULL)
+        fio_close(f);
+    fl64 stream_tm = timer_calctm(t0, timer_querytick());
+
+    const char* mode_name = "deflate";
+    if (mode == COMPRESS_NONE)
+        mode_name = "uncompressed";
+    else if (mode == COMPRESS_LZ4)
+        mode_name = "lz4";
+    log_printf(LOG_TEXT, "%s, large file: serial %.3fs, parallel %.3fs, stream %.3fs, %d failed",
+        mode_name, serial_tm, parallel_tm, stream_tm, fails);
+
+    pak_close(&pak);
+    util_delfile(pakpath);
+    FREE(part);
+    FREE(data);
+    return fails;
+}
+
+void test_pak()
+{
+    struct hwinfo info;
+    hw_getinfo(&info, HWINFO_CPU);
+
+    int thread_cnt = maxi(info.cpu_core_cnt, 4);
+    log_printf(LOG_TEXT, "loading files from one pak in %d threads ...", thread_cnt);
+    tsk_initmgr(thread_cnt, 0, 0, 0);
+
+    char pakpath[DH_PATH_MAX];
+    path_join(pakpath, util_gettempdir(pakpath), "dhcore-test.pak", NULL);
+
+    int fails = 0;
+    fails += pak_test_run(pakpath, COMPRESS_NONE, TRUE, PAK_VERIFY_ALWAYS, 0);
+    fails += pak_test_run(pakpath, COMPRESS_NONE, FALSE, PAK_VERIFY_FIRST, 0);
+    fails += pak_test_run(pakpath, COMPRESS_NORMAL, TRUE, PAK_VERIFY_FIRST, PAK_VERIFY_COMPRESSED);
+    fails += pak_test_run(pakpath, COMPRESS_NORMAL, FALSE, PAK_VERIFY_ALWAYS,
+                          PAK_VERIFY_COMPRESSED);
+    fails += pak_test_run(pakpath, COMPRESS_LZ4, TRUE, PAK_VERIFY_SAMPLED, 0);
+    fails += pak_test_run(pakpath, COMPRESS_LZ4, FALSE, PAK_VERIFY_OFF, 0);
+    fails += pak_test_dedup(pakpath);
+    fails += pak_test_large(pakpath, COMPRESS_NONE);
+    fails += pak_test_large(pakpath, COMPRESS_NORMAL);
+    fails += pak_test_large(pakpath, COMPRESS_LZ4);
+
+    tsk_releasemgr();
+
+    if (fails == 0)
+        log_print(LOG_TEXT, "done.");
+    else
+        log_printf(LOG_WARNING, "%d failures.", fails);
+}
@@ -0,0 +1,144 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#include "dhcore-test.h"
+#include "dhcore/core.h"
+#include "dhcore/file-io.h"
+#include "dhcore/pak-file.h"
+#include "dhcore/path.h"
+#include "dhcore/util.h"
+#include "dhcore/timer.h"
+
+#define PAKLAYER_TEST_FILES 2000
+#define PAKLAYER_TEST_PATCHED 10    /* every n'th file is in the patch */
+#define PAKLAYER_TEST_LOOKUPS 100000
+
+/* writes pak with files that have the layer name as content, patch only contains some of them */
+static int paklayer_test_create(const char* pakpath, const char* layer, int step)
+{
+    struct pak_file pak;
+    char name[64];
+
+    if (IS_FAIL(pak_create(&pak, mem_heap(), pakpath, COMPRESS_NONE, 0)))
+        return FALSE;
+
+    result_t r = RET_OK;
+    for (int i = 0; i < PAKLAYER_TEST_FILES && IS_OK(r); i += step)   {
+        sprintf(name, "data/file%d.txt", i);
+        file_t f = fio_attachmem(mem_heap(), (void*)layer, strlen(layer), name, 0);
+        r = pak_putfile(&pak, mem_heap(), f, name);
+        size_t size;
+        fio_detachmem(f, &size, NULL);
+        fio_close(f);
+    }
+    pak_close(&pak);
+    return IS_OK(r);
+}
+
+static int paklayer_test_check(const char* filepath, const char* expected)
+{
+    file_t f = fio_openmem(mem_heap(), filepath, FALSE, 0);
+    if (f == NULL)
+        return expected == NULL;
+
+    int r = expected != NULL && fio_getsize(f) == strlen(expected) &&
+        memcmp(fio_getptr(f), expected, strlen(expected)) == 0;
+    fio_close(f);
+    return r;
+}
+
+void test_paklayer()
+{
+    char base_path[DH_PATH_MAX];
+    char patch_path[DH_PATH_MAX];
+    char name[64];
+    struct pak_file base;
+    struct pak_file patch;
+    int fails = 0;
+
+    util_gettempdir(base_path);
+    util_gettempdir(patch_path);
+    path_join(base_path, base_path, "dhcore-base.pak", NULL);
+    path_join(patch_path, patch_path, "dhcore-patch.pak", NULL);
+    if (!paklayer_test_create(base_path, "base", 1) ||
+        !paklayer_test_create(patch_path, "patch", PAKLAYER_TEST_PATCHED) ||
+        IS_FAIL(pak_open(&base, mem_heap(), base_path, 0)))
+    {
+        log_print(LOG_WARNING, "creating paks failed");
+        return;
+    }
+    if (IS_FAIL(pak_open(&patch, mem_heap(), patch_path, 0)))   {
+        log_print(LOG_WARNING, "opening patch pak failed");
+        pak_close(&base);
+        return;
+    }
+
+    /* patch is added after the base, but it's priority is higher */
+    fio_addpak(&base);
+    if (IS_FAIL(fio_addpak_layer(&patch, 1)))
+        fails++;
+
+    fails += !paklayer_test_check("data/file0.txt", "patch");
+    fails += !paklayer_test_check("/data/file10.txt", "patch");
+    fails += !paklayer_test_check("data/file11.txt", "base");
+    fails += !paklayer_test_check("data/missing.txt", NULL);
+
+    file_t f = fio_openmmap("data/file20.txt", FALSE);
+    if (f == NULL || fio_getsize(f) != 5 || memcmp(fio_getptr(f), "patch", 5) != 0)
+        fails++;
+    if (f != NULL)
+        fio_close(f);
+
+    /* lookups */
+    uint64 t0 = timer_querytick();
+    int found = 0;
+    for (int i = 0; i < PAKLAYER_TEST_LOOKUPS; i++) {
+        sprintf(name, (i & 1) ? "data/file%d.txt" : "data/nofile%d.txt", i % PAKLAYER_TEST_FILES);
+        f = fio_openmem(mem_heap(), name, FALSE, 0);
+        if (f != NULL)  {
+            found++;
+            fio_close(f);
+        }
+    }
+    fl64 tm = timer_calctm(t0, timer_querytick());
+    if (found != PAKLAYER_TEST_LOOKUPS/2)
+        fails++;
+    log_printf(LOG_TEXT, "%d opens (half missing) in 2 layers: %.3fs", PAKLAYER_TEST_LOOKUPS, tm);
+
+    /* removing the patch restores the files of the base */
+    fio_removepak(&patch);
+    fails += !paklayer_test_check("data/file0.txt", "base");
+    fails += !paklayer_test_check("data/file10.txt", "base");
+
+    /* same priority, first added pak wins */
+    fio_addpak(&patch);
+    fails += !paklayer_test_check("data/file10.txt", "base");
+    fio_removepak(&base);
+    fails += !paklayer_test_check("data/file10.txt", "patch");
+    fails += !paklayer_test_check("data/file11.txt", NULL);
+
+    fio_clearpaks();
+    fails += !paklayer_test_check("data/file10.txt", NULL);
+
+    pak_close(&patch);
+    pak_close(&base);
+    util_delfile(base_path);
+    util_delfile(patch_path);
+
+    if (fails == 0)
+        log_print(LOG_TEXT, "done.");
+    else
+        log_printf(LOG_WARNING, "%d checks failed", fails);
+}
@@ -0,0 +1,180 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#include "dhcore-test.h"
+#include "dhcore/core.h"
+#include "dhcore/ring-queue.h"
+#include "dhcore/mt.h"
+#include "dhcore/timer.h"
+#include "dhcore/util.h"
+
+#define RINGQ_TEST_ITEMS 2000000
+#define RINGQ_TEST_BATCH 32
+
+struct ringq_test
+{
+    struct ring_queue q;
+    int batch;
+    int producer_cnt;
+    int consumer_cnt;
+    uint items_per_producer;
+    atom_t consumed;
+    atom_t sum;
+    atom_t order_fails;
+};
+
+static result_t ringq_producer(mt_thread thread)
+{
+    struct ringq_test* t = (struct ringq_test*)mt_thread_getparam1(thread);
+    uint64 id = (uint64)(uptr_t)mt_thread_getparam2(thread);
+    uint64 items[RINGQ_TEST_BATCH];
+    uint i = 0;
+
+    while (i < t->items_per_producer)   {
+        if (t->batch)   {
+            uint cnt = minui(RINGQ_TEST_BATCH, t->items_per_producer - i);
+            for (uint k = 0; k < cnt; k++)
+                items[k] = (id << 32) | (i + k);
+            cnt = ringq_push_batch(&t->q, items, cnt);
+            i += cnt;
+            if (cnt == 0)
+                util_sleep(0);  /* full, let consumers run */
+        }   else    {
+            uint64 item = (id << 32) | i;
+            if (ringq_push(&t->q, &item))
+                i++;
+            else
+                util_sleep(0);
+        }
+    }
+    return RET_ABORT;
+}
+
+static result_t ringq_consumer(mt_thread thread)
+{
+    struct ringq_test* t = (struct ringq_test*)mt_thread_getparam1(thread);
+    uint64 total = (uint64)t->items_per_producer*t->producer_cnt;
+    uint64 items[RINGQ_TEST_BATCH];
+    uint last[8];
+    int check_order = (t->consumer_cnt == 1);
+    uint64 sum = 0;
+    uint order_fails = 0;
+
+    memset(last, 0xff, sizeof(last));
+
+    while ((uint64)t->consumed < total)   {
+        int cnt = t->batch ? ringq_pop_batch(&t->q, items, RINGQ_TEST_BATCH) :
+            ringq_pop(&t->q, items);
+        for (int k = 0; k < cnt; k++)   {
+            uint idx = (uint)(items[k] & 0xffffffff);
+            uint p = (uint)(items[k] >> 32);
+            sum += idx;
+            /* with single consumer, items of each producer must come out in order */
+            if (check_order)    {
+                if (idx != last[p] + 1)
+                    order_fails++;
+                last[p] = idx;
+            }
+        }
+        if (cnt > 0)
+            MT_ATOMIC_ADD(t->consumed, cnt);
+        else
+            util_sleep(0);  /* empty, let producers run */
+    }
+
+    MT_ATOMIC_ADD(t->sum, (atom_t)sum);
+    MT_ATOMIC_ADD(t->order_fails, (atom_t)order_fails);
+    return RET_ABORT;
+}
+
+static int ringq_runtest(enum ringq_type type, const char* name, int producer_cnt,
+                         int consumer_cnt, int batch)
+{
+    struct ringq_test t;
+    mt_thread threads[16];
+    int fails = 0;
+
+    memset(&t, 0x00, sizeof(t));
+    t.batch = batch;
+    t.producer_cnt = producer_cnt;
+    t.consumer_cnt = consumer_cnt;
+    t.items_per_producer = RINGQ_TEST_ITEMS/producer_cnt;
+    if (IS_FAIL(ringq_create(mem_heap(), &t.q, type, sizeof(uint64), 4096, 0)))
+        return 1;
+
+    uint64 t0 = timer_querytick();
+    for (int i = 0; i < consumer_cnt; i++)  {
+        threads[i] = mt_thread_create(ringq_consumer, NULL, NULL, MT_THREAD_NORMAL, 0, 0,
+            &t, NULL);
+    }
+    for (int i = 0; i < producer_cnt; i++)  {
+        threads[consumer_cnt + i] = mt_thread_create(ringq_producer, NULL, NULL, MT_THREAD_NORMAL,
+            0, 0, &t, (void*)(uptr_t)i);
+    }
+    for (int i = 0; i < producer_cnt + consumer_cnt; i++)
+        mt_thread_destroy(threads[i]);
+    fl64 tm = timer_calctm(t0, timer_querytick());
+
+    uint64 n = (uint64)t.items_per_producer;
+    uint64 expected = (n*(n - 1)/2)*producer_cnt;
+    if ((uint64)t.sum != expected || t.order_fails != 0 || ringq_count(&t.q) != 0)
+        fails++;
+
+    log_printf(LOG_TEXT, "%s %dP/%dC%s: %.2f M items/s%s", name, producer_cnt, consumer_cnt,
+        batch ? " (batch)" : "", (double)(n*producer_cnt)/tm/1000000.0,
+        fails ? " - FAILED" : "");
+
+    ringq_destroy(&t.q);
+    return fails;
+}
+
+void test_ringq()
+{
+    int fails = 0;
+
+    /* basic single-threaded checks */
+    struct ring_queue q;
+    uint items[8];
+    uint item;
+    ringq_create(mem_heap(), &q, RINGQ_SPSC, sizeof(uint), 6, 0);
+    if (ringq_capacity(&q) != 8)
+        fails++;
+    for (uint i = 0; i < 8; i++)
+        fails += !ringq_push(&q, &i);
+    if (ringq_push(&q, &item) || ringq_count(&q) != 8)
+        fails++;
+    if (ringq_pop_batch(&q, items, 5) != 5 || items[4] != 4)
+        fails++;
+    if (ringq_push_batch(&q, items, 8) != 5)
+        fails++;
+    if (!ringq_pop(&q, &item) || item != 5)
+        fails++;
+    ringq_destroy(&q);
+
+    log_print(LOG_TEXT, "ring queue throughput:");
+    for (int batch = 0; batch < 2; batch++) {
+        fails += ringq_runtest(RINGQ_SPSC, "SPSC", 1, 1, batch);
+        fails += ringq_runtest(RINGQ_MPSC, "MPSC", 2, 1, batch);
+        fails += ringq_runtest(RINGQ_MPSC, "MPSC", 4, 1, batch);
+        fails += ringq_runtest(RINGQ_SPMC, "SPMC", 1, 2, batch);
+        fails += ringq_runtest(RINGQ_MPMC, "MPMC", 2, 2, batch);
+        fails += ringq_runtest(RINGQ_MPMC, "MPMC", 4, 4, batch);
+    }
+
+    if (fails == 0)
+        log_print(LOG_TEXT, "done.");
+    else
+        log_printf(LOG_WARNING, "%d failures.", fails);
+}
@@ -0,0 +1,106 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#include "dhcore-test.h"
+#include "dhcore/core.h"
+#include "dhcore/slot-map.h"
+#include "dhcore/timer.h"
+
+using namespace dh;
+
+struct slotmap_particle
+{
+    float pos[3];
+    float radius;
+};
+
+void test_slotmap()
+{
+    const int item_cnt = 100000;
+    uint fails = 0;
+
+    /* AoS: add all, remove every other item, and check remaining handles */
+    SlotMap<slotmap_particle> sm;
+    reshandle_t* handles = (reshandle_t*)ALLOC(sizeof(reshandle_t)*item_cnt, 0);
+    ASSERT(handles);
+    sm.create(1000, 1000);
+
+    log_printf(LOG_TEXT, "adding %d items to slot-map ...", item_cnt);
+    for (int i = 0; i < item_cnt; i++)    {
+        slotmap_particle p;
+        p.pos[0] = p.pos[1] = p.pos[2] = 0.0f;
+        p.radius = (float)i;
+        handles[i] = sm.add(p);
+    }
+
+    log_print(LOG_TEXT, "removing half of the items ...");
+    for (int i = 0; i < item_cnt; i += 2)
+        sm.remove(handles[i]);
+
+    for (int i = 0; i < item_cnt; i++)    {
+        slotmap_particle* p = sm.get(handles[i]);
+        if ((i & 1) == 0)   {
+            if (p != NULL || sm.is_valid(handles[i]))
+                fails++;
+        }   else if (p == NULL || p->radius != (float)i)    {
+            fails++;
+        }
+    }
+
+    /* re-added items must reuse slots with new generations */
+    reshandle_t h = sm.add();
+    if (h == handles[0] || SLOTMAP_HANDLE_INDEX(h) != SLOTMAP_HANDLE_INDEX(handles[item_cnt-2]))
+        fails++;
+    sm.remove(h);
+
+    /* dense iteration */
+    uint64 t0 = timer_querytick();
+    float sum = 0.0f;
+    for (int i = 0; i < sm.count(); i++)
+        sum += sm[i].radius;
+    log_printf(LOG_TEXT, "iterated %d items in %fs (sum=%f)", sm.count(),
+        timer_calctm(t0, timer_querytick()), sum);
+    if (sm.count() != item_cnt/2)
+        fails++;
+    sm.destroy();
+
+    /* SoA: two streams */
+    slot_map soa;
+    const int streams[] = {sizeof(float)*3, sizeof(float)};
+    slotmap_create(mem_heap(), &soa, streams, 2, 100, 100, 0);
+    for (int i = 0; i < 1000; i++)    {
+        reshandle_t hdl = slotmap_add(&soa);
+        *(float*)slotmap_get(&soa, hdl, 1) = (float)i;
+        handles[i] = hdl;
+    }
+    slotmap_remove(&soa, handles[10]);
+    float* radiuses = SLOTMAP_STREAM(soa, float, 1);
+    for (int i = 0; i < SLOTMAP_COUNT(soa); i++) {
+        reshandle_t hdl = slotmap_handle(&soa, i);
+        if (slotmap_index(&soa, hdl) != i || radiuses[i] != *(float*)slotmap_get(&soa, hdl, 1))
+            fails++;
+    }
+    slotmap_clear(&soa);
+    if (slotmap_isvalid(&soa, handles[0]) || !slotmap_isempty(&soa))
+        fails++;
+    slotmap_destroy(&soa);
+
+    FREE(handles);
+
+    if (fails == 0)
+        log_print(LOG_TEXT, "done.");
+    else
+        log_printf(LOG_WARNING, "%d failures.", fails);
+}
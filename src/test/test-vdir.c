@@ -0,0 +1,124 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#include "dhcore-test.h"
+#include "dhcore/core.h"
+#include "dhcore/file-io.h"
+#include "dhcore/path.h"
+#include "dhcore/util.h"
+#include "dhcore/timer.h"
+
+#define VDIR_TEST_FILES 200
+#define VDIR_TEST_LOOKUPS 20000
+
+static void vdir_test_write(const char* filepath, const char* data)
+{
+    file_t f = fio_createdisk(filepath);
+    if (f != NULL)  {
+        fio_write(f, data, strlen(data), 1);
+        fio_close(f);
+    }
+}
+
+/* opens file through vdirs, and checks it's content */
+static int vdir_test_check(const char* filepath, const char* expected)
+{
+    file_t f = fio_openmem(mem_heap(), filepath, FALSE, 0);
+    if (f == NULL)
+        return expected == NULL;
+
+    int r = expected != NULL && fio_getsize(f) == strlen(expected) &&
+        memcmp(fio_getptr(f), expected, strlen(expected)) == 0;
+    fio_close(f);
+    return r;
+}
+
+void test_vdir()
+{
+    char root[DH_PATH_MAX];
+    char dir1[DH_PATH_MAX];
+    char dir2[DH_PATH_MAX];
+    char subdir[DH_PATH_MAX];
+    char filepath[DH_PATH_MAX];
+    char filename[64];
+    int fails = 0;
+
+    util_gettempdir(root);
+    path_join(root, root, "dhcore-vdir", NULL);
+    path_join(dir1, root, "patch", NULL);
+    path_join(dir2, root, "data", NULL);
+    path_join(subdir, dir2, "sub", NULL);
+    util_makedir(root);
+    util_makedir(dir1);
+    util_makedir(dir2);
+    util_makedir(subdir);
+
+    /* files in the first vdir override the ones in the second */
+    for (int i = 0; i < VDIR_TEST_FILES; i++)   {
+        sprintf(filename, "file%d.txt", i);
+        vdir_test_write(path_join(filepath, subdir, filename, NULL), "data");
+    }
+    vdir_test_write(path_join(filepath, dir2, "shared.txt", NULL), "data");
+    vdir_test_write(path_join(filepath, dir1, "shared.txt", NULL), "patch");
+
+    fio_addvdir(dir1, FALSE);
+    fio_addvdir(dir2, FALSE);
+
+    fails += !vdir_test_check("shared.txt", "patch");
+    fails += !vdir_test_check("sub/file0.txt", "data");
+    fails += !vdir_test_check("missing.txt", NULL);
+
+    /* files that are added after indexing are found by probing */
+    vdir_test_write(path_join(filepath, dir2, "new.txt", NULL), "new");
+    fails += !vdir_test_check("new.txt", "new");
+
+    /* missing paths are cached until refresh */
+    vdir_test_write(path_join(filepath, dir2, "missing.txt", NULL), "found");
+    fails += !vdir_test_check("missing.txt", NULL);
+    util_delfile(path_join(filepath, dir1, "shared.txt", NULL));
+    fio_refreshvdirs();
+    fails += !vdir_test_check("missing.txt", "found");
+    fails += !vdir_test_check("shared.txt", "data");
+
+    /* lookups */
+    uint64 t0 = timer_querytick();
+    int found = 0;
+    for (int i = 0; i < VDIR_TEST_LOOKUPS; i++) {
+        sprintf(filename, (i & 1) ? "sub/file%d.txt" : "sub/nofile%d.txt", i % VDIR_TEST_FILES);
+        file_t f = fio_opendisk(filename, FALSE);
+        if (f != NULL)  {
+            found++;
+            fio_close(f);
+        }
+    }
+    fl64 tm = timer_calctm(t0, timer_querytick());
+    if (found != VDIR_TEST_LOOKUPS/2)
+        fails++;
+    log_printf(LOG_TEXT, "%d lookups (half missing) in %.3fs", VDIR_TEST_LOOKUPS, tm);
+
+    fio_clearvdirs();
+    for (int i = 0; i < VDIR_TEST_FILES; i++)   {
+        sprintf(filename, "file%d.txt", i);
+        util_delfile(path_join(filepath, subdir, filename, NULL));
+    }
+    util_delfile(path_join(filepath, dir2, "shared.txt", NULL));
+    util_delfile(path_join(filepath, dir2, "new.txt", NULL));
+    util_delfile(path_join(filepath, dir2, "missing.txt", NULL));
+
+    if (fails == 0)
+        log_print(LOG_TEXT, "done.");
+    else
+        log_printf(LOG_WARNING, "%d checks failed", fails);
+}
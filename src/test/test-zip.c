@@ -0,0 +1,167 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#include "dhcore-test.h"
+#include "dhcore/core.h"
+#include "dhcore/zip.h"
+#include "dhcore/timer.h"
+#include "dhcore/numeric.h"
+
+#define ZIP_TEST_SIZE (2*1024*1024)
+#define ZIP_TEST_BLOCK (64*1024)    /* same as pak blocks */
+#define ZIP_TEST_DECODE_TIME 0.25
+
+/* sample corpus, generated so it looks like typical asset data */
+static void zip_test_text(uint8* data, size_t size)
+{
+    static const char* words[] = {
+        "the", "of", "and", "texture", "mesh", "shader", "light", "render", "position",
+        "normal", "material", "scene", "object", "camera", "animation", "bone", "frame",
+        "vertex", "index", "buffer", "a", "to", "is", "in", "for", "with"
+    };
+    const int word_cnt = sizeof(words)/sizeof(char*);
+    size_t i = 0;
+    while (i < size)    {
+        const char* w = words[rand_geti(0, word_cnt - 1)];
+        while (*w != 0 && i < size)
+            data[i++] = (uint8)*w++;
+        if (i < size)
+            data[i++] = (rand_geti(0, 12) == 0) ? '\n' : ' ';
+    }
+}
+
+static void zip_test_json(uint8* data, size_t size)
+{
+    size_t i = 0;
+    char record[256];
+    while (i < size)    {
+        int n = sprintf(record,
+            "{\"name\": \"node%d\", \"pos\": [%.3f, %.3f, %.3f], \"visible\": %s},\n",
+            rand_geti(0, 5000), rand_getf(-100.0f, 100.0f), rand_getf(-100.0f, 100.0f),
+            rand_getf(-100.0f, 100.0f), rand_geti(0, 1) ? "true" : "false");
+        size_t cnt = minsz((size_t)n, size - i);
+        memcpy(data + i, record, cnt);
+        i += cnt;
+    }
+}
+
+static void zip_test_mesh(uint8* data, size_t size)
+{
+    /* grid of vertices: position, normal, texcoord */
+    float* f = (float*)data;
+    size_t cnt = size/sizeof(float);
+    for (size_t i = 0; i + 8 <= cnt; i += 8)    {
+        size_t v = i/8;
+        f[i] = (float)(v % 256);
+        f[i + 1] = rand_getf(0.0f, 0.1f);
+        f[i + 2] = (float)(v / 256);
+        f[i + 3] = 0.0f;
+        f[i + 4] = 1.0f;
+        f[i + 5] = 0.0f;
+        f[i + 6] = (float)(v % 256)/255.0f;
+        f[i + 7] = (float)(v / 256)/255.0f;
+    }
+}
+
+static void zip_test_noise(uint8* data, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        data[i] = (uint8)rand_geti(0, 255);
+}
+
+/* compresses the corpus in blocks, then decompresses it repeatedly for timing */
+static int zip_test_run(const char* name, const uint8* data, enum compress_mode mode,
+                        const char* mode_name)
+{
+    uint block_cnt = (uint)((ZIP_TEST_SIZE + ZIP_TEST_BLOCK - 1)/ZIP_TEST_BLOCK);
+    size_t bound = zip_compressedsize(ZIP_TEST_BLOCK);
+    uint8* zdata = (uint8*)ALLOC(bound*block_cnt, 0);
+    uint8* udata = (uint8*)ALLOC(ZIP_TEST_SIZE, 0);
+    size_t* zsizes = (size_t*)ALLOC(sizeof(size_t)*block_cnt, 0);
+    enum compress_codec codec = zip_getcodec(mode);
+    size_t total_sz = 0;
+    int fails = 0;
+    ASSERT(zdata && udata && zsizes);
+
+    uint64 t0 = timer_querytick();
+    for (uint i = 0; i < block_cnt; i++)    {
+        size_t raw_sz = minsz(ZIP_TEST_BLOCK, ZIP_TEST_SIZE - (size_t)i*ZIP_TEST_BLOCK);
+        zsizes[i] = zip_compress(zdata + i*bound, bound, data + (size_t)i*ZIP_TEST_BLOCK, raw_sz,
+                                 mode);
+        if (zsizes[i] == 0)
+            fails++;
+        total_sz += zsizes[i];
+    }
+    fl64 compress_tm = timer_calctm(t0, timer_querytick());
+
+    int passes = 0;
+    fl64 decode_tm = 0.0;
+    t0 = timer_querytick();
+    do  {
+        for (uint i = 0; i < block_cnt; i++)    {
+            size_t raw_sz = minsz(ZIP_TEST_BLOCK, ZIP_TEST_SIZE - (size_t)i*ZIP_TEST_BLOCK);
+            if (zip_decompress_codec(udata + (size_t)i*ZIP_TEST_BLOCK, raw_sz, zdata + i*bound,
+                                     zsizes[i], codec) != raw_sz)
+            {
+                fails++;
+            }
+        }
+        passes++;
+        decode_tm = timer_calctm(t0, timer_querytick());
+    }   while (decode_tm < ZIP_TEST_DECODE_TIME && fails == 0);
+
+    if (memcmp(udata, data, ZIP_TEST_SIZE) != 0)
+        fails++;
+
+    fl64 mb = (fl64)ZIP_TEST_SIZE/(1024.0*1024.0);
+    log_printf(LOG_TEXT, "%-6s %-7s ratio: %5.1f%%, compress: %7.1f MB/s, decode: %7.1f MB/s",
+        name, mode_name, 100.0*(fl64)total_sz/(fl64)ZIP_TEST_SIZE, mb/compress_tm,
+        mb*passes/decode_tm);
+
+    FREE(zsizes);
+    FREE(udata);
+    FREE(zdata);
+    return fails;
+}
+
+void test_zip()
+{
+    typedef void (*pfn_corpus)(uint8* data, size_t size);
+    static const pfn_corpus corpus_fns[] = {zip_test_text, zip_test_json, zip_test_mesh,
+        zip_test_noise};
+    static const char* corpus_names[] = {"text", "json", "mesh", "noise"};
+    static const enum compress_mode modes[] = {COMPRESS_FAST, COMPRESS_NORMAL, COMPRESS_BEST,
+        COMPRESS_LZ4};
+    static const char* mode_names[] = {"fast", "normal", "best", "lz4"};
+
+    uint8* data = (uint8*)ALLOC(ZIP_TEST_SIZE, 0);
+    ASSERT(data);
+
+    log_printf(LOG_TEXT, "compressing %dkb samples in %dkb blocks ...", ZIP_TEST_SIZE/1024,
+        ZIP_TEST_BLOCK/1024);
+    int fails = 0;
+    for (uint i = 0; i < sizeof(corpus_fns)/sizeof(pfn_corpus); i++)   {
+        corpus_fns[i](data, ZIP_TEST_SIZE);
+        for (uint k = 0; k < sizeof(modes)/sizeof(enum compress_mode); k++)
+            fails += zip_test_run(corpus_names[i], data, modes[k], mode_names[k]);
+    }
+
+    FREE(data);
+
+    if (fails == 0)
+        log_print(LOG_TEXT, "done.");
+    else
+        log_printf(LOG_WARNING, "%d failures.", fails);
+}
@@ -0,0 +1,219 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#include "dhcore-test.h"
+#include "dhcore/core.h"
+#include "dhcore/file-io.h"
+#include "dhcore/zip.h"
+#include "dhcore/path.h"
+#include "dhcore/util.h"
+#include "dhcore/timer.h"
+
+#define ZIPMOUNT_TEST_FILES 2000
+#define ZIPMOUNT_TEST_SIZE 1000
+#define ZIPMOUNT_TEST_LOOKUPS 100000
+
+struct zipmount_entry
+{
+    uint crc;
+    uint size;
+    uint zip_size;
+    uint offset;
+    uint16 method;
+};
+
+static uint zipmount_test_crc(const uint8* data, size_t size)
+{
+    uint crc = 0xffffffff;
+    for (size_t i = 0; i < size; i++)   {
+        crc ^= data[i];
+        for (int k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+static void zipmount_test_write16(file_t f, uint n)
+{
+    uint8 b[2] = {(uint8)n, (uint8)(n >> 8)};
+    fio_write(f, b, sizeof(b), 1);
+}
+
+static void zipmount_test_write32(file_t f, uint n)
+{
+    uint8 b[4] = {(uint8)n, (uint8)(n >> 8), (uint8)(n >> 16), (uint8)(n >> 24)};
+    fio_write(f, b, sizeof(b), 1);
+}
+
+static void zipmount_test_data(uint8* data, int idx)
+{
+    for (int i = 0; i < ZIPMOUNT_TEST_SIZE; i++)
+        data[i] = (uint8)('a' + (i/16 + idx) % 26);
+}
+
+/* writes zip archive with odd entries stored and even entries deflated */
+static int zipmount_test_create(const char* filepath)
+{
+    char name[64];
+    uint8 data[ZIPMOUNT_TEST_SIZE];
+    struct zipmount_entry entries[ZIPMOUNT_TEST_FILES];
+    size_t zip_size = zip_compressedsize(ZIPMOUNT_TEST_SIZE);
+    uint8* zip_data = (uint8*)ALLOC(zip_size, 0);
+    file_t f = fio_createdisk(filepath);
+    if (f == NULL || zip_data == NULL)
+        return FALSE;
+
+    for (int i = 0; i < ZIPMOUNT_TEST_FILES; i++)   {
+        struct zipmount_entry* e = &entries[i];
+        sprintf(name, "data/File%d.txt", i);
+        zipmount_test_data(data, i);
+
+        const uint8* stored = data;
+        e->crc = zipmount_test_crc(data, ZIPMOUNT_TEST_SIZE);
+        e->size = ZIPMOUNT_TEST_SIZE;
+        e->zip_size = ZIPMOUNT_TEST_SIZE;
+        e->offset = (uint)fio_getpos(f);
+        e->method = 0;
+        if ((i & 1) == 0)   {
+            /* zip entries are raw deflate streams, zlib header and adler32 are skipped */
+            size_t n = zip_compress(zip_data, zip_size, data, ZIPMOUNT_TEST_SIZE, COMPRESS_NORMAL);
+            stored = zip_data + 2;
+            e->zip_size = (uint)n - 6;
+            e->method = 8;
+        }
+
+        zipmount_test_write32(f, 0x04034b50);
+        zipmount_test_write16(f, 20);
+        zipmount_test_write16(f, 0);
+        zipmount_test_write16(f, e->method);
+        zipmount_test_write32(f, 0);
+        zipmount_test_write32(f, e->crc);
+        zipmount_test_write32(f, e->zip_size);
+        zipmount_test_write32(f, e->size);
+        zipmount_test_write16(f, (uint)strlen(name));
+        zipmount_test_write16(f, i % 3);    /* extra field, so local headers have different sizes */
+        fio_write(f, name, strlen(name), 1);
+        fio_write(f, "\0\0", i % 3, 1);
+        fio_write(f, stored, e->zip_size, 1);
+    }
+
+    uint dir_offset = (uint)fio_getpos(f);
+    for (int i = 0; i < ZIPMOUNT_TEST_FILES; i++)   {
+        const struct zipmount_entry* e = &entries[i];
+        sprintf(name, "data/File%d.txt", i);
+        zipmount_test_write32(f, 0x02014b50);
+        zipmount_test_write16(f, 20);
+        zipmount_test_write16(f, 20);
+        zipmount_test_write16(f, 0);
+        zipmount_test_write16(f, e->method);
+        zipmount_test_write32(f, 0);
+        zipmount_test_write32(f, e->crc);
+        zipmount_test_write32(f, e->zip_size);
+        zipmount_test_write32(f, e->size);
+        zipmount_test_write16(f, (uint)strlen(name));
+        zipmount_test_write16(f, 0);
+        zipmount_test_write16(f, 0);
+        zipmount_test_write16(f, 0);
+        zipmount_test_write16(f, 0);
+        zipmount_test_write32(f, 0);
+        zipmount_test_write32(f, e->offset);
+        fio_write(f, name, strlen(name), 1);
+    }
+    uint dir_size = (uint)fio_getpos(f) - dir_offset;
+
+    zipmount_test_write32(f, 0x06054b50);
+    zipmount_test_write16(f, 0);
+    zipmount_test_write16(f, 0);
+    zipmount_test_write16(f, ZIPMOUNT_TEST_FILES);
+    zipmount_test_write16(f, ZIPMOUNT_TEST_FILES);
+    zipmount_test_write32(f, dir_size);
+    zipmount_test_write32(f, dir_offset);
+    zipmount_test_write16(f, 0);
+
+    fio_close(f);
+    FREE(zip_data);
+    return TRUE;
+}
+
+static int zipmount_test_check(file_t f, int idx)
+{
+    uint8 data[ZIPMOUNT_TEST_SIZE];
+    if (f == NULL)
+        return FALSE;
+
+    zipmount_test_data(data, idx);
+    int r = fio_getsize(f) == ZIPMOUNT_TEST_SIZE &&
+        memcmp(fio_getptr(f), data, ZIPMOUNT_TEST_SIZE) == 0;
+    fio_close(f);
+    return r;
+}
+
+void test_zipmount()
+{
+    char filepath[DH_PATH_MAX];
+    char name[64];
+    int fails = 0;
+
+    path_join(filepath, util_gettempdir(filepath), "dhcore-zipmount.zip", NULL);
+    if (!zipmount_test_create(filepath)) {
+        log_print(LOG_WARNING, "creating zip failed");
+        return;
+    }
+
+    zip_t zip = zip_open(filepath);
+    if (zip == NULL)    {
+        log_print(LOG_WARNING, "opening zip failed");
+        util_delfile(filepath);
+        return;
+    }
+    fio_addzip(zip);
+
+    /* memory files, and views into the archive for stored entries */
+    for (int i = 0; i < 8; i++) {
+        sprintf(name, "data/File%d.txt", i);
+        fails += !zipmount_test_check(fio_openmem(mem_heap(), name, FALSE, 0), i);
+
+        file_t f = fio_openmmap(name, FALSE);
+        if (f == NULL || fio_gettype(f) != ((i & 1) ? FILE_TYPE_MMAP : FILE_TYPE_MEM))
+            fails++;
+        fails += !zipmount_test_check(f, i);
+    }
+    fails += !zipmount_test_check(fio_openmem(mem_heap(), "DATA/file10.TXT", FALSE, 0), 10);
+    fails += fio_openmem(mem_heap(), "data/missing.txt", FALSE, 0) != NULL;
+    fails += zip_findfile(zip, "data") != 0;
+    fails += !zipmount_test_check(zip_getfile(zip, "data/File3.txt", mem_heap()), 3);
+
+    /* lookups */
+    uint64 t0 = timer_querytick();
+    int found = 0;
+    for (int i = 0; i < ZIPMOUNT_TEST_LOOKUPS; i++) {
+        sprintf(name, (i & 1) ? "data/File%d.txt" : "data/NoFile%d.txt", i % ZIPMOUNT_TEST_FILES);
+        found += zip_findfile(zip, name) != 0;
+    }
+    fl64 tm = timer_calctm(t0, timer_querytick());
+    if (found != ZIPMOUNT_TEST_LOOKUPS/2)
+        fails++;
+    log_printf(LOG_TEXT, "%d lookups (half missing) in %d entries: %.3fs", ZIPMOUNT_TEST_LOOKUPS,
+               ZIPMOUNT_TEST_FILES, tm);
+
+    fio_clearzips();
+    zip_close(zip);
+    util_delfile(filepath);
+
+    if (fails == 0)
+        log_print(LOG_TEXT, "done.");
+    else
+        log_printf(LOG_WARNING, "%d checks failed", fails);
+}
@@ -35,13 +35,25 @@ win32-msvc2013 | win32-msvc2012 | win32-msvc2010 {
 
 SOURCES += \
     dhcore-test.c \
+    test-diskfile.c \
+    test-filemon.c \
+    test-fio-async.c \
     test-freelist.c \
     test-heap.c \
     test-json.c \
+    test-memfile.c \
+    test-pak.c \
+    test-paklayer.c \
     test-pool.c \
+    test-ringq.c \
     test-taskmgr.c \
     test-thread.c \
-    test-hashtable.cpp
+    test-vdir.c \
+    test-zip.c \
+    test-zipmount.c \
+    test-hashtable.cpp \
+    test-hash.cpp \
+    test-slotmap.cpp
 
 HEADERS += \
     dhcore-test.h